@@ -19,29 +19,24 @@ func VerificarDuplicidad(sensorAdapter *sensor.SensorAdapter, tplCapturado []byt
 		return f.Errorf("No se encuentran templates en la base de datos: %w", err)
 	}
 
-	//recorre el mapa de templates
-	for run, existingTpl := range allTemplates {
-		//compara el score de cada una
-		score, err := sensorAdapter.CompararHuellas(tplCapturado, existingTpl)
-		//hay templates corruptos
-		if err != nil {
-			f.Fprintf(os.Stderr, "(-)[GO]: error al comparar el run %s: %v\n", run, err)
-			continue
-		}
+	//comparamos contra todos los templates en una sola llamada a C++
+	run, _, err := sensorAdapter.BuscarEnTemplates(tplCapturado, allTemplates, db.MatchThreshold)
+	if err != nil {
+		return f.Errorf("error al comparar la huella: %w", err)
+	}
 
-		//hay huellas identicas?
-		if score >= db.MatchThreshold {
-			//si, devolvemos error de huella duplicada
-			f.Fprintf(os.Stderr, "(-) ERROR: La huella esta registrada dentro del sistema\n")
-			nombreAlumno := "Desconocido"
-			if user, err := database.GetUser(run); err == nil && user != nil {
-				nombreAlumno = user.NombreCompleto
-			}
-			f.Fprintf(os.Stderr, "    Pertenece al RUN: %s\n", run)
-			f.Fprintf(os.Stderr, "	  Nombre de alumno: %s\n", nombreAlumno)
-			f.Fprintf(os.Stderr, "    No se puede enrolar la misma huella dos veces.\n")
-			return f.Errorf("huella duplicada con el run: %s", run)
+	//hay huellas identicas?
+	if run != "" {
+		//si, devolvemos error de huella duplicada
+		f.Fprintf(os.Stderr, "(-) ERROR: La huella esta registrada dentro del sistema\n")
+		nombreAlumno := "Desconocido"
+		if user, err := database.GetUser(run); err == nil && user != nil {
+			nombreAlumno = user.NombreCompleto
 		}
+		f.Fprintf(os.Stderr, "    Pertenece al RUN: %s\n", run)
+		f.Fprintf(os.Stderr, "	  Nombre de alumno: %s\n", nombreAlumno)
+		f.Fprintf(os.Stderr, "    No se puede enrolar la misma huella dos veces.\n")
+		return f.Errorf("huella duplicada con el run: %s", run)
 	}
 
 	return nil
@@ -65,8 +65,8 @@ def procesar_excel_a_sql(ruta_excel, archivo_salida, rut_inicio=20000001):
 
             nombre_completo = f"{nombres} {apaterno} {amaterno}".strip().replace('  ', ' ')
 
-            # Usamos ON CONFLICT para NO sobreescribir la huella dactilar si el alumno ya existe
-            insert_usuario = f"INSERT INTO Usuarios (run_id, dv, nombre_completo, id_rol, template_huella, activo) VALUES ('{run_id}', '{dv}', '{nombre_completo}', 3, X'', 1) ON CONFLICT(run_id) DO UPDATE SET nombre_completo=excluded.nombre_completo, dv=excluded.dv;"
+            # Usamos ON CONFLICT (y no REPLACE) para NO borrar la huella dactilar si el alumno ya existe (vive en TemplatesHuella)
+            insert_usuario = f"INSERT INTO Usuarios (run_id, dv, nombre_completo, id_rol, activo) VALUES ('{run_id}', '{dv}', '{nombre_completo}', 3, 1) ON CONFLICT(run_id) DO UPDATE SET nombre_completo=excluded.nombre_completo, dv=excluded.dv;"
             inserts_usuarios.append(f"-- #{contador_global}\n{insert_usuario}")
 
             # Procesar curso y letra
@@ -54,13 +54,17 @@ func EnrollUsers(sensor *digitador.SensorAdapter,
 		var respHuella string
 		f.Scan(&respHuella)
 		if respHuella == "s" || respHuella == "S" {
-			f.Println("Coloque su dedo en el sensor (tiene 10 segundos)...")
-			var err error
-			plantilla, err = sensor.CapturarHuellaTimeout(10 * time.Second)
+			f.Println("Apoye el mismo dedo 3 veces, levantándolo entre cada captura (10 segundos por captura)...")
+			enrolamiento, err := sensor.EnrolarHuella(10*time.Second, 0)
 			if err != nil {
+				if enrolamiento != nil {
+					f.Printf("(-) Capturas tomadas: %d, scores entre capturas: %v\n", enrolamiento.Capturas, enrolamiento.Scores)
+				}
 				f.Println(err)
 				return
 			}
+			plantilla = enrolamiento.Plantilla
+			f.Printf("(+) Huella enrolada con calidad %d/100.\n", enrolamiento.Calidad)
 
 			// 6. Verificamos la duplicidad de la huella
 			err = enroll.VerificarDuplicidad(sensor, plantilla, dbRepo)
@@ -39,16 +39,11 @@ func MenuTicket(sensor *digitador.SensorAdapter, dbRepo *repo.SQLiteUserReposito
 		return
 	}
 
-	var runIDEncontrado string
-	for run, templateDB := range allTemplates {
-		score, err := sensor.CompararHuellas(plantillaCapturada, templateDB)
-		if err != nil {
-			continue
-		}
-		if score >= db.MatchThreshold {
-			runIDEncontrado = run
-			break
-		}
+	// todo el lote se compara en una sola llamada a C++
+	runIDEncontrado, _, err := sensor.BuscarEnTemplates(plantillaCapturada, allTemplates, db.MatchThreshold)
+	if err != nil {
+		f.Printf("(-) [GO]: Error comparando huellas: %v\n", err)
+		return
 	}
 
 	// 3. ¿Se encontró al estudiante?
@@ -0,0 +1,396 @@
+// sensorbench mide los caminos calientes del sensor (C++ y el puente CGO)
+// con el backend de reproduccion, sin huellero ni base de datos.
+//
+// Para cada cantidad de alumnos (-alumnos) y de shards de la cache 1:N
+// (-shards) mide:
+//   - captura:        hilo de captura -> template entregado a Go
+//   - pipeline:       hilo de captura -> hilo de 1:N -> run entregado a Go
+//   - match_1a1:      CompararHuellas, un cruce de CGO por comparacion
+//   - match_lote:     CompararHuellasLote, un solo cruce para todo el lote
+//   - identify_1n:    DBIdentify1N contra todo el cache (con -hilos en paralelo)
+//   - precarga_lote:  DBAddLote1N de todo el curso
+//   - precarga_arena: AbrirArena + CargarArena del mismo curso
+//   - cruce_cgo:      DBCount1N, el costo fijo de cruzar el puente
+//
+// Los resultados se escriben en JSON (-salida). Con -base se comparan contra
+// una corrida guardada y el programa termina con error si la mediana de algun
+// caso quedo mas lenta que -tolerancia veces la base. La base guardada
+// (baseline.json) es de una corrida en Linux con el backend de reproduccion y
+// un solo CPU, asi que sus casos con -hilos 4 no sirven de referencia (ver
+// compararBase): conviene regenerarla en el NUC antes de usarla ahi.
+//
+// Uso (desde Digitador/):
+//
+//	go run ./cmd/sensorbench -alumnos 500,2000,10000 -shards 1,2,4 -hilos 1,4 \
+//	    -base cmd/sensorbench/baseline.json
+package main
+
+import (
+	"encoding/json"
+	"flag"
+	"fmt"
+	"os"
+	"path/filepath"
+	"runtime"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+
+	Sensor "Pydigitador/core/Hardware/Sensor"
+)
+
+// mismo largo y semillas que ReplayBackend::syntheticTemplate
+const tamanoSintetico = 1024
+
+// variable que lee Sensor::initSensor para la cantidad de shards
+const envShards = "DIGITADOR_SENSOR_SHARDS"
+
+// veces que se repite cada carga completa del curso
+const repeticionesCarga = 5
+
+// Resultado es una medicion. La clave para comparar contra la base es
+// Caso + Alumnos + Shards + Hilos
+type Resultado struct {
+	Caso        string  `json:"caso"`
+	Alumnos     int     `json:"alumnos"`
+	Shards      int     `json:"shards"`
+	Hilos       int     `json:"hilos"`
+	Iteraciones int     `json:"iteraciones"`
+	NsOp        float64 `json:"ns_op"`
+	P50Us       float64 `json:"p50_us"`
+	P99Us       float64 `json:"p99_us"`
+	OpsSeg      float64 `json:"ops_seg"`
+}
+
+// Corrida es el archivo JSON completo
+type Corrida struct {
+	Fecha      string      `json:"fecha"`
+	SO         string      `json:"so"`
+	Arq        string      `json:"arq"`
+	CPUs       int         `json:"cpus"`
+	Go         string      `json:"go"`
+	Resultados []Resultado `json:"resultados"`
+}
+
+func (r Resultado) clave() string {
+	return fmt.Sprintf("%s/%d/%d/%d", r.Caso, r.Alumnos, r.Shards, r.Hilos)
+}
+
+// plantillaSintetica replica ReplayBackend::syntheticTemplate (xorshift32)
+func plantillaSintetica(semilla uint32) []byte {
+	out := make([]byte, tamanoSintetico)
+	x := semilla*2654435761 + 1
+	if x == 0 {
+		x = 1
+	}
+	for i := range out {
+		x ^= x << 13
+		x ^= x >> 17
+		x ^= x << 5
+		out[i] = byte(x)
+	}
+	return out
+}
+
+// resumir calcula ns/op, percentiles y ops/s de una serie de duraciones
+// medidas por operacion. total es el tiempo de pared de toda la serie
+func resumir(caso string, alumnos, shards, hilos int, duraciones []time.Duration, total time.Duration) Resultado {
+	sort.Slice(duraciones, func(i, j int) bool { return duraciones[i] < duraciones[j] })
+	n := len(duraciones)
+	r := Resultado{Caso: caso, Alumnos: alumnos, Shards: shards, Hilos: hilos, Iteraciones: n}
+	if n == 0 {
+		return r
+	}
+	var suma time.Duration
+	for _, d := range duraciones {
+		suma += d
+	}
+	r.NsOp = float64(suma.Nanoseconds()) / float64(n)
+	r.P50Us = float64(duraciones[n/2].Nanoseconds()) / 1e3
+	r.P99Us = float64(duraciones[(n*99)/100].Nanoseconds()) / 1e3
+	if total > 0 {
+		r.OpsSeg = float64(n) / total.Seconds()
+	}
+	return r
+}
+
+// medir corre op iteraciones veces repartidas en hilos goroutines
+func medir(iteraciones, hilos int, op func(i int)) ([]time.Duration, time.Duration) {
+	duraciones := make([]time.Duration, iteraciones)
+	var wg sync.WaitGroup
+	inicio := time.Now()
+	for h := 0; h < hilos; h++ {
+		wg.Add(1)
+		go func(h int) {
+			defer wg.Done()
+			for i := h; i < iteraciones; i += hilos {
+				t := time.Now()
+				op(i)
+				duraciones[i] = time.Since(t)
+			}
+		}(h)
+	}
+	wg.Wait()
+	return duraciones, time.Since(inicio)
+}
+
+// sensorConShards crea un sensor de reproduccion con la cantidad de shards
+// pedida (Sensor::initSensor la lee de envShards)
+func sensorConShards(shards int) (*Sensor.SensorAdapter, error) {
+	os.Setenv(envShards, strconv.Itoa(shards))
+	return Sensor.SensorReplay("")
+}
+
+func listaEnteros(texto string) ([]int, error) {
+	var out []int
+	for _, campo := range strings.Split(texto, ",") {
+		campo = strings.TrimSpace(campo)
+		if campo == "" {
+			continue
+		}
+		n, err := strconv.Atoi(campo)
+		if err != nil || n <= 0 {
+			return nil, fmt.Errorf("valor invalido %q", campo)
+		}
+		out = append(out, n)
+	}
+	return out, nil
+}
+
+// correrCurso mide todos los casos para un tamaño de curso y de shards
+func correrCurso(alumnos, shards int, hilos []int, iteraciones int, carpeta string) ([]Resultado, error) {
+	var resultados []Resultado
+
+	runs := make([]string, alumnos)
+	plantillas := make([][]byte, alumnos)
+	for i := range runs {
+		runs[i] = fmt.Sprintf("%d", 10000000+i)
+		plantillas[i] = plantillaSintetica(uint32(i + 1))
+	}
+
+	s, err := sensorConShards(shards)
+	if err != nil {
+		return nil, err
+	}
+	defer s.Cerrar()
+
+	// precarga en lote (la arena queda escrita para medir la carga en frio)
+	rutaArena := filepath.Join(carpeta, fmt.Sprintf("bench-%d-%d.arena", alumnos, shards))
+	os.Remove(rutaArena)
+	if _, _, _, err := s.AbrirArena(rutaArena); err != nil {
+		return nil, err
+	}
+	// se repite para tener una mediana (DBClear1N tambien vacia la arena)
+	var errCarga error
+	d, total := medir(repeticionesCarga, 1, func(int) {
+		if errCarga != nil {
+			return
+		}
+		if err := s.DBClear1N(); err != nil {
+			errCarga = err
+			return
+		}
+		if cargados, err := s.DBAddLote1N(runs, plantillas); err != nil || cargados != alumnos {
+			errCarga = fmt.Errorf("precarga: %d de %d (%v)", cargados, alumnos, err)
+		}
+	})
+	if errCarga != nil {
+		return nil, errCarga
+	}
+	resultados = append(resultados, resumir("precarga_lote", alumnos, shards, 1, d, total))
+
+	// cruce del puente sin trabajo en C++
+	d, total = medir(iteraciones*10, 1, func(int) { s.DBCount1N() })
+	resultados = append(resultados, resumir("cruce_cgo", alumnos, shards, 1, d, total))
+
+	// 1:1 de a una comparacion contra el lote completo en un cruce
+	probe := plantillas[alumnos/2]
+	d, total = medir(iteraciones*10, 1, func(i int) {
+		s.CompararHuellas(probe, plantillas[i%alumnos])
+	})
+	resultados = append(resultados, resumir("match_1a1", alumnos, shards, 1, d, total))
+
+	d, total = medir(iteraciones, 1, func(int) {
+		s.CompararHuellasLote(probe, plantillas, 1, 0)
+	})
+	resultados = append(resultados, resumir("match_lote", alumnos, shards, 1, d, total))
+
+	// 1:N con distintos alumnos como probe
+	for _, h := range hilos {
+		var fallos int64
+		var mu sync.Mutex
+		d, total = medir(iteraciones, h, func(i int) {
+			semilla := (i * 7919) % alumnos
+			if run, _, err := s.DBIdentify1N(plantillas[semilla]); err != nil || run != runs[semilla] {
+				mu.Lock()
+				fallos++
+				mu.Unlock()
+			}
+		})
+		if fallos > 0 {
+			return nil, fmt.Errorf("identify_1n: %d identificaciones erradas", fallos)
+		}
+		resultados = append(resultados, resumir("identify_1n", alumnos, shards, h, d, total))
+	}
+
+	// captura: del hilo de captura de C++ al template en Go
+	d, total = medir(iteraciones, 1, func(int) {
+		s.CapturarHuellaTimeout(time.Second)
+	})
+	resultados = append(resultados, resumir("captura", alumnos, shards, 1, d, total))
+
+	// pipeline: captura e identificacion en hilos de C++, Go recibe el run.
+	// Va despues de captura porque desde aca el pipeline consume la cola
+	fallos := 0
+	d, total = medir(iteraciones, 1, func(int) {
+		if _, err := s.EsperarIdentificacion("", -1, time.Second); err != nil {
+			fallos++
+		}
+	})
+	if fallos > 0 {
+		return nil, fmt.Errorf("pipeline: %d huellas sin identificar", fallos)
+	}
+	resultados = append(resultados, resumir("pipeline", alumnos, shards, 1, d, total))
+
+	// carga en frio desde la arena, cada vez en un sensor nuevo (crear el
+	// sensor no entra en la medicion)
+	s.Cerrar()
+	d = make([]time.Duration, 0, repeticionesCarga)
+	total = 0
+	for i := 0; i < repeticionesCarga; i++ {
+		s2, err := sensorConShards(shards)
+		if err != nil {
+			return nil, err
+		}
+		inicio := time.Now()
+		_, _, _, err = s2.AbrirArena(rutaArena)
+		cargados := 0
+		if err == nil {
+			cargados, err = s2.CargarArena()
+		}
+		dur := time.Since(inicio)
+		s2.Cerrar()
+		if err != nil || cargados != alumnos {
+			return nil, fmt.Errorf("arena: %d de %d (%v)", cargados, alumnos, err)
+		}
+		d = append(d, dur)
+		total += dur
+	}
+	resultados = append(resultados, resumir("precarga_arena", alumnos, shards, 1, d, total))
+	os.Remove(rutaArena)
+
+	return resultados, nil
+}
+
+// compararBase imprime la razon de medianas (p50) contra la base, que en una
+// maquina cargada varia mucho menos que el promedio, y devuelve cuantos casos
+// quedaron mas lentos que la tolerancia. Los casos con varios hilos solo se
+// comparan si las dos corridas tuvieron mas de un CPU: con uno solo los hilos
+// se turnan y la medicion no dice nada del paralelismo
+func compararBase(ruta string, actual []Resultado, cpus int, tolerancia float64) (int, error) {
+	datos, err := os.ReadFile(ruta)
+	if err != nil {
+		return 0, err
+	}
+	var base Corrida
+	if err := json.Unmarshal(datos, &base); err != nil {
+		return 0, err
+	}
+	porClave := make(map[string]Resultado, len(base.Resultados))
+	for _, r := range base.Resultados {
+		porClave[r.clave()] = r
+	}
+
+	regresiones := 0
+	fmt.Printf("\n%-40s %12s %12s %8s\n", "caso/alumnos/shards/hilos", "base p50 us", "p50 us", "razon")
+	for _, r := range actual {
+		b, ok := porClave[r.clave()]
+		if !ok || b.P50Us == 0 {
+			fmt.Printf("%-40s %12s %12.1f %8s\n", r.clave(), "-", r.P50Us, "nuevo")
+			continue
+		}
+		razon := r.P50Us / b.P50Us
+		marca := ""
+		if r.Hilos > 1 && (cpus < 2 || base.CPUs < 2) {
+			marca = "  (1 cpu, no se compara)"
+		} else if razon > tolerancia {
+			marca = "  <-- REGRESION"
+			regresiones++
+		}
+		fmt.Printf("%-40s %12.1f %12.1f %8.2f%s\n", r.clave(), b.P50Us, r.P50Us, razon, marca)
+	}
+	return regresiones, nil
+}
+
+func main() {
+	alumnosFlag := flag.String("alumnos", "500,2000,10000", "cantidades de alumnos enrolados")
+	shardsFlag := flag.String("shards", "1,2,4", "shards de la cache 1:N")
+	hilosFlag := flag.String("hilos", "1,4", "goroutines identificando en paralelo")
+	iteraciones := flag.Int("iter", 200, "iteraciones por caso")
+	salida := flag.String("salida", "sensorbench.json", "archivo JSON de resultados")
+	base := flag.String("base", "", "corrida guardada para comparar (opcional)")
+	tolerancia := flag.Float64("tolerancia", 1.5, "razon p50 sobre la base que cuenta como regresion")
+	flag.Parse()
+
+	alumnos, err := listaEnteros(*alumnosFlag)
+	if err == nil {
+		var shards, hilos []int
+		if shards, err = listaEnteros(*shardsFlag); err == nil {
+			if hilos, err = listaEnteros(*hilosFlag); err == nil {
+				err = correr(alumnos, shards, hilos, *iteraciones, *salida, *base, *tolerancia)
+			}
+		}
+	}
+	if err != nil {
+		fmt.Fprintf(os.Stderr, "(-) [BENCH]: %v\n", err)
+		os.Exit(1)
+	}
+}
+
+func correr(alumnos, shards, hilos []int, iteraciones int, salida, base string, tolerancia float64) error {
+	carpeta, err := os.MkdirTemp("", "sensorbench")
+	if err != nil {
+		return err
+	}
+	defer os.RemoveAll(carpeta)
+
+	corrida := Corrida{
+		Fecha: time.Now().Format(time.RFC3339),
+		SO:    runtime.GOOS,
+		Arq:   runtime.GOARCH,
+		CPUs:  runtime.NumCPU(),
+		Go:    runtime.Version(),
+	}
+	for _, n := range alumnos {
+		for _, k := range shards {
+			resultados, err := correrCurso(n, k, hilos, iteraciones, carpeta)
+			if err != nil {
+				return fmt.Errorf("%d alumnos, %d shards: %w", n, k, err)
+			}
+			corrida.Resultados = append(corrida.Resultados, resultados...)
+		}
+	}
+
+	datos, err := json.MarshalIndent(corrida, "", "  ")
+	if err != nil {
+		return err
+	}
+	if err := os.WriteFile(salida, append(datos, '\n'), 0644); err != nil {
+		return err
+	}
+	fmt.Printf("(+) [BENCH]: %d resultados en %s\n", len(corrida.Resultados), salida)
+
+	if base == "" {
+		return nil
+	}
+	regresiones, err := compararBase(base, corrida.Resultados, corrida.CPUs, tolerancia)
+	if err != nil {
+		return err
+	}
+	if regresiones > 0 {
+		return fmt.Errorf("%d casos mas lentos que %.2fx la base", regresiones, tolerancia)
+	}
+	return nil
+}
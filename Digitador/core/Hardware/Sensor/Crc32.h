@@ -0,0 +1,47 @@
+// Crc32.h
+
+// CRC-32 (IEEE, el de zip y el de hash/crc32 en Go) con tablas, armadas una
+// sola vez. Lo usan el diario de raciones (cada registro) y la arena (la
+// firma de los templates vivos, la misma que TemplatesHuella.checksum).
+// La arena lo pasa por todo el curso en cada arranque y en cada lote, asi que
+// va de a 8 bytes por vuelta (slicing-by-8) en vez de uno
+#pragma once
+
+#include <cstddef>
+
+inline unsigned int crc32Bytes(const unsigned char *data, size_t largo) {
+  struct Tablas {
+    unsigned int v[8][256];
+    Tablas() {
+      for (unsigned int i = 0; i < 256; ++i) {
+        unsigned int c = i;
+        for (int k = 0; k < 8; ++k) {
+          c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        v[0][i] = c;
+      }
+      for (unsigned int i = 0; i < 256; ++i) {
+        for (int t = 1; t < 8; ++t) {
+          v[t][i] = v[0][v[t - 1][i] & 0xFF] ^ (v[t - 1][i] >> 8);
+        }
+      }
+    }
+  };
+  static const Tablas tablas;
+  const unsigned int(*v)[256] = tablas.v;
+
+  unsigned int crc = 0xFFFFFFFFu;
+  size_t i = 0;
+  // los bytes se leen de a uno: no depende de la alineacion ni del endianness
+  for (; i + 8 <= largo; i += 8) {
+    const unsigned char *p = data + i;
+    unsigned int a = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) |
+                            (static_cast<unsigned int>(p[3]) << 24));
+    crc = v[7][a & 0xFF] ^ v[6][(a >> 8) & 0xFF] ^ v[5][(a >> 16) & 0xFF] ^
+          v[4][a >> 24] ^ v[3][p[4]] ^ v[2][p[5]] ^ v[1][p[6]] ^ v[0][p[7]];
+  }
+  for (; i < largo; ++i) {
+    crc = v[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
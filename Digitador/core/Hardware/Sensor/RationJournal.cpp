@@ -0,0 +1,430 @@
+// RationJournal.cpp
+
+// diario de raciones en disco, mapeado en memoria, con group commit
+#include "RationJournal.h"
+#include "Crc32.h"
+#include "SensorLog.h"
+
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(JournalHeader) == 64, "JournalHeader debe medir 64 bytes");
+static_assert(sizeof(JournalRecord) == 128,
+              "JournalRecord debe medir 128 bytes");
+static_assert(sizeof(JournalHeader) <= JOURNAL_DATA_OFFSET,
+              "JournalHeader no cabe antes de los registros");
+
+// crc del registro con el campo crc en 0
+static unsigned int crcRegistro(const JournalRecord &registro) {
+  JournalRecord copia = registro;
+  copia.crc = 0;
+  return crc32Bytes(reinterpret_cast<const unsigned char *>(&copia),
+                    sizeof(copia));
+}
+
+RationJournal::RationJournal()
+    : m_path(), m_map(nullptr), m_mapSize(0), m_header(nullptr),
+      m_records(nullptr), m_capacity(0),
+#ifdef _WIN32
+      m_file(nullptr), m_mapping(nullptr),
+#else
+      m_fd(-1),
+#endif
+      m_nextSeq(1), m_durableSeq(0), m_appliedSeq(0), m_appliedDurableSeq(0),
+      m_headerDirty(false), m_failed(false), m_stop(false) {
+}
+
+RationJournal::~RationJournal() { close(); }
+
+// -----------------------------------------------------------------------------
+// Abrir / cerrar
+// -----------------------------------------------------------------------------
+bool RationJournal::open(const std::string &path) {
+  close();
+  m_path = path;
+
+  // un diario existente se respeta (con su capacidad); uno invalido se
+  // descarta, pero lo dejamos en el log porque pudo tener pendientes
+  if (!mapFile(false) || !scan()) {
+    if (m_map) {
+      SLOG_ERROR("journal", "Diario de raciones invalido, se empieza vacio: %s",
+                 path.c_str());
+    }
+    unmapFile();
+    if (!mapFile(true)) {
+      SLOG_ERROR("journal", "No se pudo crear el diario de raciones: %s",
+                 path.c_str());
+      unmapFile();
+      return false;
+    }
+    std::memset(m_header, 0, sizeof(JournalHeader));
+    m_header->magic = JOURNAL_MAGIC;
+    m_header->version = JOURNAL_VERSION;
+    m_header->recordSize = sizeof(JournalRecord);
+    m_header->capacity = JOURNAL_CAPACITY;
+    m_header->appliedSeq = 0;
+    if (!flushHeader() || !scan()) {
+      unmapFile();
+      return false;
+    }
+  }
+
+  SLOG_INFO("journal", "Diario de raciones abierto: %llu pendientes de %u.",
+            m_durableSeq - m_appliedSeq, m_capacity);
+
+  m_failed = false;
+  m_stop = false;
+  m_headerDirty = false;
+  m_flushThread = std::thread(&RationJournal::flushLoop, this);
+  return true;
+}
+
+void RationJournal::close() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_writtenCv.notify_all();
+  m_durableCv.notify_all();
+  // el hilo termina despues de pasar a disco lo ultimo (registros y header)
+  if (m_flushThread.joinable()) {
+    m_flushThread.join();
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  unmapFile();
+}
+
+bool RationJournal::isOpen() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_map != nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// Mapeo del archivo (lectura/escritura)
+// -----------------------------------------------------------------------------
+bool RationJournal::mapFile(bool crear) {
+  const size_t largoNuevo =
+      JOURNAL_DATA_OFFSET +
+      static_cast<size_t>(JOURNAL_CAPACITY) * sizeof(JournalRecord);
+
+#ifdef _WIN32
+  HANDLE archivo = CreateFileA(
+      m_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+      crear ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (archivo == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  m_file = archivo;
+  LARGE_INTEGER largo;
+  if (crear) {
+    // el archivo queda del largo final, en ceros (posiciones vacias)
+    largo.QuadPart = static_cast<LONGLONG>(largoNuevo);
+    if (!SetFilePointerEx(archivo, largo, nullptr, FILE_BEGIN) ||
+        !SetEndOfFile(archivo)) {
+      return false;
+    }
+  } else if (!GetFileSizeEx(archivo, &largo) ||
+             largo.QuadPart < static_cast<LONGLONG>(JOURNAL_DATA_OFFSET)) {
+    return false;
+  }
+  HANDLE mapping =
+      CreateFileMappingA(archivo, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+  if (!mapping) {
+    return false;
+  }
+  m_mapping = mapping;
+  void *vista = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+  if (!vista) {
+    return false;
+  }
+  m_map = static_cast<unsigned char *>(vista);
+  m_mapSize = static_cast<size_t>(largo.QuadPart);
+#else
+  int fd = ::open(m_path.c_str(), O_RDWR | (crear ? O_CREAT | O_TRUNC : 0),
+                  0644);
+  if (fd < 0) {
+    return false;
+  }
+  m_fd = fd;
+  size_t largo = largoNuevo;
+  if (crear) {
+    // el archivo queda del largo final, en ceros (posiciones vacias)
+    if (ftruncate(fd, static_cast<off_t>(largoNuevo)) != 0) {
+      return false;
+    }
+  } else {
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        st.st_size < static_cast<off_t>(JOURNAL_DATA_OFFSET)) {
+      return false;
+    }
+    largo = static_cast<size_t>(st.st_size);
+  }
+  void *vista =
+      mmap(nullptr, largo, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (vista == MAP_FAILED) {
+    return false;
+  }
+  m_map = static_cast<unsigned char *>(vista);
+  m_mapSize = largo;
+#endif
+
+  m_header = reinterpret_cast<JournalHeader *>(m_map);
+  m_records = reinterpret_cast<JournalRecord *>(m_map + JOURNAL_DATA_OFFSET);
+  return true;
+}
+
+void RationJournal::unmapFile() {
+#ifdef _WIN32
+  if (m_map) {
+    UnmapViewOfFile(m_map);
+  }
+  if (m_mapping) {
+    CloseHandle(static_cast<HANDLE>(m_mapping));
+    m_mapping = nullptr;
+  }
+  if (m_file) {
+    CloseHandle(static_cast<HANDLE>(m_file));
+    m_file = nullptr;
+  }
+#else
+  if (m_map) {
+    munmap(m_map, m_mapSize);
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+#endif
+  m_map = nullptr;
+  m_mapSize = 0;
+  m_header = nullptr;
+  m_records = nullptr;
+  m_capacity = 0;
+}
+
+// -----------------------------------------------------------------------------
+// Buscar los pendientes al abrir
+// -----------------------------------------------------------------------------
+bool RationJournal::scan() {
+  const JournalHeader &h = *m_header;
+  if (h.magic != JOURNAL_MAGIC || h.version != JOURNAL_VERSION ||
+      h.recordSize != sizeof(JournalRecord) || h.capacity == 0 ||
+      m_mapSize - JOURNAL_DATA_OFFSET <
+          static_cast<size_t>(h.capacity) * sizeof(JournalRecord)) {
+    return false;
+  }
+  m_capacity = h.capacity;
+
+  // los pendientes son los que siguen a appliedSeq, sin saltos. Un registro
+  // cortado a la mitad (corte de luz) no pasa el crc y termina la busqueda:
+  // nunca se le confirmo al totem
+  unsigned long long seq = h.appliedSeq + 1;
+  for (unsigned int i = 0; i < m_capacity; ++i, ++seq) {
+    const JournalRecord &r = slot(seq);
+    if (r.seq != seq || r.crc != crcRegistro(r)) {
+      break;
+    }
+  }
+
+  m_appliedSeq = h.appliedSeq;
+  m_appliedDurableSeq = h.appliedSeq;
+  m_durableSeq = seq - 1; // lo que ya estaba en el archivo esta en disco
+  m_nextSeq = seq;
+  return true;
+}
+
+JournalRecord &RationJournal::slot(unsigned long long seq) const {
+  return m_records[(seq - 1) % m_capacity];
+}
+
+// -----------------------------------------------------------------------------
+// Agregar y esperar el disco
+// -----------------------------------------------------------------------------
+unsigned long long RationJournal::append(const JournalRecord &registro) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_map || m_stop || m_failed) {
+    return 0;
+  }
+  // la posicion que toca todavia tiene un registro sin aplicar (o aplicado
+  // pero sin que el header lo diga en disco): Go cae a SQLite directo
+  if (m_nextSeq - m_appliedDurableSeq > m_capacity) {
+    return 0;
+  }
+
+  JournalRecord r = registro;
+  r.seq = m_nextSeq;
+  r.run[JOURNAL_MAX_RUN_LEN] = '\0';
+  r.fecha[JOURNAL_MAX_FECHA_LEN] = '\0';
+  r.terminal[JOURNAL_MAX_TERMINAL_LEN] = '\0';
+  std::memset(r.reserved, 0, sizeof(r.reserved));
+  r.crc = crcRegistro(r);
+  std::memcpy(&slot(r.seq), &r, sizeof(r));
+
+  ++m_nextSeq;
+  m_writtenCv.notify_one();
+  return r.seq;
+}
+
+bool RationJournal::waitDurable(unsigned long long seq, int timeoutMs) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_durableCv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] {
+    return m_durableSeq >= seq || m_failed || m_stop;
+  });
+  return m_durableSeq >= seq;
+}
+
+// -----------------------------------------------------------------------------
+// Group commit: un hilo hace el flush de todo lo que se fue agregando
+// -----------------------------------------------------------------------------
+void RationJournal::flushLoop() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_writtenCv.wait(lock, [this] {
+      return m_stop || m_nextSeq - 1 > m_durableSeq || m_headerDirty;
+    });
+    unsigned long long desde = m_durableSeq + 1;
+    unsigned long long hasta = m_nextSeq - 1;
+    bool header = m_headerDirty;
+    if (hasta < desde && !header) {
+      break; // m_stop y no queda nada por pasar a disco
+    }
+    unsigned long long aplicado = m_appliedSeq;
+    m_headerDirty = false;
+
+    // mientras esperamos al disco los demas siguen agregando: el proximo
+    // flush se los lleva a todos juntos
+    lock.unlock();
+    bool ok = true;
+    if (hasta >= desde) {
+      ok = flushRecords(desde, hasta);
+    }
+    if (ok && header) {
+      ok = flushHeader();
+    }
+    lock.lock();
+
+    if (!ok) {
+      SLOG_ERROR("journal", "Fallo el flush del diario de raciones: %s",
+                 m_path.c_str());
+      m_failed = true;
+      m_durableCv.notify_all();
+      break;
+    }
+    m_durableSeq = hasta >= desde ? hasta : m_durableSeq;
+    m_appliedDurableSeq = header ? aplicado : m_appliedDurableSeq;
+    m_durableCv.notify_all();
+  }
+}
+
+bool RationJournal::flushRecords(unsigned long long desde,
+                                 unsigned long long hasta) {
+  if (hasta - desde + 1 >= m_capacity) {
+    return flushBytes(JOURNAL_DATA_OFFSET,
+                      static_cast<size_t>(m_capacity) * sizeof(JournalRecord));
+  }
+  size_t primero = static_cast<size_t>((desde - 1) % m_capacity);
+  size_t ultimo = static_cast<size_t>((hasta - 1) % m_capacity);
+  if (primero <= ultimo) {
+    return flushBytes(JOURNAL_DATA_OFFSET + primero * sizeof(JournalRecord),
+                      (ultimo - primero + 1) * sizeof(JournalRecord));
+  }
+  // dio la vuelta al anillo: dos tramos
+  return flushBytes(JOURNAL_DATA_OFFSET + primero * sizeof(JournalRecord),
+                    (m_capacity - primero) * sizeof(JournalRecord)) &&
+         flushBytes(JOURNAL_DATA_OFFSET, (ultimo + 1) * sizeof(JournalRecord));
+}
+
+bool RationJournal::flushHeader() {
+  return flushBytes(0, sizeof(JournalHeader));
+}
+
+bool RationJournal::flushBytes(size_t offset, size_t largo) {
+#ifdef _WIN32
+  // FlushViewOfFile solo escribe las paginas: FlushFileBuffers espera al disco
+  return FlushViewOfFile(m_map + offset, largo) &&
+         FlushFileBuffers(static_cast<HANDLE>(m_file));
+#else
+  // msync pide la direccion alineada a pagina
+  size_t pagina = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t inicio = offset - offset % pagina;
+  return msync(m_map + inicio, largo + (offset - inicio), MS_SYNC) == 0;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// Aplicar en SQLite
+// -----------------------------------------------------------------------------
+size_t RationJournal::pending(std::vector<JournalRecord> &out,
+                              size_t max) const {
+  out.clear();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_map) {
+    return 0;
+  }
+  for (unsigned long long seq = m_appliedSeq + 1;
+       seq <= m_durableSeq && out.size() < max; ++seq) {
+    out.push_back(slot(seq));
+  }
+  return out.size();
+}
+
+size_t RationJournal::pendingCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_map || m_durableSeq <= m_appliedSeq) {
+    return 0;
+  }
+  return static_cast<size_t>(m_durableSeq - m_appliedSeq);
+}
+
+bool RationJournal::checkpoint(unsigned long long seq) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_map || seq > m_durableSeq) {
+      return false;
+    }
+    if (seq <= m_appliedSeq) {
+      return true;
+    }
+    // el header llega a disco con el proximo flush: si se pierde, al abrir
+    // se vuelven a aplicar unos pocos y SQLite los ignora (UNIQUE)
+    m_appliedSeq = seq;
+    m_header->appliedSeq = seq;
+    m_headerDirty = true;
+  }
+  m_writtenCv.notify_one();
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// Estado
+// -----------------------------------------------------------------------------
+unsigned long long RationJournal::lastSeq() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_nextSeq - 1;
+}
+
+unsigned long long RationJournal::durableSeq() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_durableSeq;
+}
+
+unsigned long long RationJournal::appliedSeq() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_appliedSeq;
+}
+
+unsigned int RationJournal::capacity() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_capacity;
+}
@@ -0,0 +1,128 @@
+// RationJournal.h
+
+// diario de raciones: archivo de solo agregar, mapeado en memoria, donde queda
+// cada racion aprobada antes de llegar a SQLite. El totem recibe su respuesta
+// apenas el registro esta en disco (un solo flush para todos los que llegaron
+// juntos: group commit) y Go lo pasa despues a RegistrosRaciones en lotes.
+// Si el proceso se cae, al abrir de nuevo quedan pendientes los registros que
+// Go no alcanzo a confirmar: el diario manda hasta que se aplican.
+//
+// Formato (little endian):
+//   JournalHeader, rellenado hasta JOURNAL_DATA_OFFSET
+//   capacity registros JournalRecord de largo fijo, en anillo: el seq n va en
+//   la posicion (n - 1) % capacity
+// Un registro vale si su crc coincide y su seq es el que toca en esa posicion.
+// Una posicion solo se reusa cuando su registro ya se aplico y ese avance
+// (appliedSeq) ya esta en disco.
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define JOURNAL_MAGIC 0x4A544744u // "DGTJ"
+#define JOURNAL_VERSION 1
+#define JOURNAL_DATA_OFFSET 4096   // los registros empiezan en otra pagina
+#define JOURNAL_CAPACITY 16384     // ~2 MB, varios dias de servicio sin SQLite
+#define JOURNAL_MAX_RUN_LEN 31
+#define JOURNAL_MAX_FECHA_LEN 15 // "YYYY-MM-DD"
+#define JOURNAL_MAX_TERMINAL_LEN 31
+
+struct JournalHeader {
+  unsigned int magic;
+  unsigned int version;
+  unsigned int recordSize;
+  unsigned int capacity;
+  unsigned long long appliedSeq; // hasta aca ya esta en RegistrosRaciones
+  unsigned char reserved[40];
+};
+
+// una fila de RegistrosRaciones (sin id_registro, lo pone SQLite)
+struct JournalRecord {
+  unsigned long long seq; // 1, 2, 3, ... (0 = posicion vacia)
+  long long horaEvento;   // epoch ms
+  unsigned int crc;       // CRC-32 del registro con crc en 0
+  unsigned short tipoRacion;
+  unsigned short estado;
+  char run[JOURNAL_MAX_RUN_LEN + 1]; // terminados en '\0'
+  char fecha[JOURNAL_MAX_FECHA_LEN + 1];
+  char terminal[JOURNAL_MAX_TERMINAL_LEN + 1];
+  unsigned char reserved[24];
+};
+
+class RationJournal {
+public:
+  RationJournal();
+  ~RationJournal();
+
+  // abrir (o crear) el archivo, mapearlo, buscar los pendientes y levantar el
+  // hilo que hace los flush. Un archivo de otra version se descarta
+  bool open(const std::string &path);
+  // baja el hilo despues de pasar a disco lo que falte
+  void close();
+  bool isOpen() const;
+
+  // agrega la racion (seq y crc los pone el diario) y devuelve su seq, o 0 si
+  // el diario esta cerrado o lleno de pendientes. No espera al disco
+  unsigned long long append(const JournalRecord &registro);
+
+  // espera hasta timeoutMs que seq quede en disco. false si vence o si el
+  // flush fallo
+  bool waitDurable(unsigned long long seq, int timeoutMs);
+
+  // copia hasta max registros ya en disco y sin aplicar, del mas viejo al mas
+  // nuevo
+  size_t pending(std::vector<JournalRecord> &out, size_t max) const;
+  // cuantos hay en disco sin aplicar (para dimensionar el pending de arriba)
+  size_t pendingCount() const;
+
+  // Go ya los paso a SQLite: todo hasta seq (inclusive) queda aplicado
+  bool checkpoint(unsigned long long seq);
+
+  //====Estado====
+
+  unsigned long long lastSeq() const;
+  unsigned long long durableSeq() const;
+  unsigned long long appliedSeq() const;
+  unsigned int capacity() const;
+
+private:
+  std::string m_path;
+  unsigned char *m_map;
+  size_t m_mapSize;
+  JournalHeader *m_header; // dentro de m_map
+  JournalRecord *m_records;
+  unsigned int m_capacity;
+#ifdef _WIN32
+  void *m_file;    // HANDLE del archivo, para FlushFileBuffers
+  void *m_mapping; // HANDLE del mapping
+#else
+  int m_fd;
+#endif
+
+  // todo lo de abajo bajo m_mutex
+  mutable std::mutex m_mutex;
+  std::condition_variable m_writtenCv; // despierta al hilo de flush
+  std::condition_variable m_durableCv; // despierta a los que esperan disco
+  unsigned long long m_nextSeq;
+  unsigned long long m_durableSeq;
+  unsigned long long m_appliedSeq;        // en memoria
+  unsigned long long m_appliedDurableSeq; // el que esta en el header en disco
+  bool m_headerDirty;
+  bool m_failed; // fallo un flush: nadie mas recibe confirmacion
+  bool m_stop;
+  std::thread m_flushThread;
+
+  bool mapFile(bool crear);
+  void unmapFile();
+  // recorre el anillo desde appliedSeq; false si el archivo no es un diario
+  bool scan();
+  void flushLoop();
+  // pasar a disco los registros [desde, hasta] (seqs) o el header
+  bool flushRecords(unsigned long long desde, unsigned long long hasta);
+  bool flushHeader();
+  bool flushBytes(size_t offset, size_t largo);
+  JournalRecord &slot(unsigned long long seq) const;
+};
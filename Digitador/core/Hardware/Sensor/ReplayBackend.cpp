@@ -0,0 +1,420 @@
+// ReplayBackend.cpp
+
+// backend de reproduccion: todo en memoria, sin hardware ni DLLs
+#include "ReplayBackend.h"
+#include "SensorLog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+// leer un archivo binario completo, false si no existe
+static bool leerArchivo(const std::string &path,
+                        std::vector<unsigned char> &out) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  out.assign(std::istreambuf_iterator<char>(file),
+             std::istreambuf_iterator<char>());
+  return true;
+}
+
+// Constructor
+ReplayBackend::ReplayBackend(const std::string &dir)
+    : m_dir(dir), m_capturas(), m_syntheticCount(REPLAY_SYNTHETIC_COUNT),
+      m_next(0), m_fingerEvery(REPLAY_FINGER_EVERY), m_acquireDelayMs(0),
+      m_initialized(false), m_deviceCount(1), m_devices() {
+  if (!m_dir.empty()) {
+    cargarCapturas();
+  }
+  const char *env = std::getenv(REPLAY_DEVICES_ENV);
+  if (env && std::atoi(env) > 0) {
+    setDeviceCount(std::atoi(env));
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Cargar capturas grabadas desde la carpeta
+// -----------------------------------------------------------------------------
+void ReplayBackend::cargarCapturas() {
+  std::ifstream index((m_dir + "/" + REPLAY_INDEX_FILE).c_str());
+  if (!index) {
+    SLOG_ERROR("replay", "No se encontro %s en %s, se usan templates "
+                         "sinteticos.",
+               REPLAY_INDEX_FILE, m_dir.c_str());
+    return;
+  }
+
+  std::string linea;
+  while (std::getline(index, linea)) {
+    // quitamos el \r de los archivos guardados en Windows
+    if (!linea.empty() && linea[linea.size() - 1] == '\r') {
+      linea.erase(linea.size() - 1);
+    }
+    if (linea.empty() || linea[0] == '#') {
+      continue;
+    }
+
+    std::istringstream campos(linea);
+    std::string tplFile, imgFile;
+    campos >> tplFile >> imgFile;
+
+    Captura captura;
+    if (!leerArchivo(m_dir + "/" + tplFile, captura.templateData) ||
+        captura.templateData.empty()) {
+      SLOG_ERROR("replay", "Template ilegible: %s", tplFile.c_str());
+      continue;
+    }
+    if (!imgFile.empty() && !leerArchivo(m_dir + "/" + imgFile, captura.image)) {
+      SLOG_ERROR("replay", "Imagen ilegible: %s", imgFile.c_str());
+    }
+    m_capturas.push_back(captura);
+  }
+
+  SLOG_INFO("replay", "Capturas cargadas: %zu", m_capturas.size());
+}
+
+// -----------------------------------------------------------------------------
+// Templates sinteticos y score
+// -----------------------------------------------------------------------------
+void ReplayBackend::syntheticTemplate(unsigned int seed,
+                                      std::vector<unsigned char> &out) {
+  out.resize(REPLAY_SYNTHETIC_SIZE);
+
+  // xorshift32, la semilla nunca debe quedar en 0
+  unsigned int x = seed * 2654435761u + 1u;
+  if (x == 0) {
+    x = 1;
+  }
+  for (size_t i = 0; i < out.size(); i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    out[i] = static_cast<unsigned char>(x);
+  }
+}
+
+int ReplayBackend::score(const unsigned char *template1,
+                         unsigned int cbTemplate1,
+                         const unsigned char *template2,
+                         unsigned int cbTemplate2) {
+  if (!template1 || !template2 || cbTemplate1 == 0 || cbTemplate2 == 0) {
+    return ZKFP_ERR_INVALID_PARAM;
+  }
+
+  unsigned int minSize = std::min(cbTemplate1, cbTemplate2);
+  unsigned int maxSize = std::max(cbTemplate1, cbTemplate2);
+  unsigned int iguales = 0;
+  for (unsigned int i = 0; i < minSize; i++) {
+    if (template1[i] == template2[i]) {
+      iguales++;
+    }
+  }
+  return static_cast<int>((100ull * iguales) / maxSize);
+}
+
+// -----------------------------------------------------------------------------
+// Configuracion
+// -----------------------------------------------------------------------------
+void ReplayBackend::setFingerEvery(int n) { m_fingerEvery = n < 1 ? 1 : n; }
+
+void ReplayBackend::setAcquireDelayMs(int ms) {
+  m_acquireDelayMs = ms < 0 ? 0 : ms;
+}
+
+void ReplayBackend::setSyntheticCount(unsigned int count) {
+  m_syntheticCount = count == 0 ? 1 : count;
+}
+
+void ReplayBackend::setDeviceCount(int count) {
+  m_deviceCount = count < 1 ? 1
+                  : count > REPLAY_MAX_DEVICES ? REPLAY_MAX_DEVICES
+                                               : count;
+}
+
+void ReplayBackend::setDeviceConnected(int index, bool connected) {
+  if (index < 0 || index >= REPLAY_MAX_DEVICES) {
+    return;
+  }
+  if (!connected) {
+    m_devices[index].stale.store(true);
+  }
+  m_devices[index].unplugged.store(!connected);
+}
+
+size_t ReplayBackend::getRecordedCount() const { return m_capturas.size(); }
+
+// -----------------------------------------------------------------------------
+// SDK y dispositivo
+// -----------------------------------------------------------------------------
+int ReplayBackend::init() {
+  m_initialized = true;
+  return ZKFP_ERR_OK;
+}
+
+int ReplayBackend::terminate() {
+  m_initialized = false;
+  return ZKFP_ERR_OK;
+}
+
+int ReplayBackend::getDeviceCount() {
+  if (!m_initialized) {
+    return 0;
+  }
+  int conectados = 0;
+  for (int i = 0; i < m_deviceCount; ++i) {
+    if (!m_devices[i].unplugged.load()) {
+      ++conectados;
+    }
+  }
+  return conectados;
+}
+
+void *ReplayBackend::openDevice(int index) {
+  if (!m_initialized || index < 0 || index >= m_deviceCount ||
+      m_devices[index].unplugged.load()) {
+    return nullptr;
+  }
+  m_devices[index].acquireCalls = 0;
+  m_devices[index].stale.store(false);
+  return &m_devices[index];
+}
+
+ReplayBackend::Device *ReplayBackend::deviceOf(void *handle) {
+  for (int i = 0; i < m_deviceCount; ++i) {
+    if (handle == &m_devices[i]) {
+      return &m_devices[i];
+    }
+  }
+  return nullptr;
+}
+
+int ReplayBackend::closeDevice(void *device) {
+  return deviceOf(device) ? ZKFP_ERR_OK : ZKFP_ERR_INVALID_HANDLE;
+}
+
+int ReplayBackend::getCaptureParams(void *device, int &width, int &height,
+                                    int &dpi) {
+  Device *lector = deviceOf(device);
+  if (!lector) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  if (lector->stale.load()) {
+    return ZKFP_ERR_NO_DEVICE;
+  }
+  width = REPLAY_DEFAULT_WIDTH;
+  height = REPLAY_DEFAULT_HEIGHT;
+  dpi = REPLAY_DEFAULT_DPI;
+  return ZKFP_ERR_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Captura: entrega la siguiente captura grabada (o sintetica) en ronda
+// -----------------------------------------------------------------------------
+int ReplayBackend::acquireFingerprint(void *device, unsigned char *image,
+                                      unsigned int cbImage,
+                                      unsigned char *fpTemplate,
+                                      unsigned int *cbTemplate) {
+  Device *lector = deviceOf(device);
+  if (!lector) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  if (!fpTemplate || !cbTemplate) {
+    return ZKFP_ERR_INVALID_PARAM;
+  }
+
+  if (m_acquireDelayMs > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(m_acquireDelayMs));
+  }
+
+  // desenchufado: el SDK no avisa, solo deja de haber dedo
+  if (lector->stale.load()) {
+    return ZKFP_ERR_CAPTURE;
+  }
+
+  // simulamos las lecturas sin dedo entre alumno y alumno
+  if (lector->acquireCalls++ % static_cast<unsigned long long>(m_fingerEvery) !=
+      0) {
+    return ZKFP_ERR_CAPTURE;
+  }
+
+  // los lectores comparten la ronda: cada captura con dedo toma un turno
+  unsigned long long turno = m_next.fetch_add(1);
+
+  std::vector<unsigned char> sintetico;
+  const std::vector<unsigned char> *tpl = nullptr;
+  const std::vector<unsigned char> *img = nullptr;
+
+  if (!m_capturas.empty()) {
+    const Captura &captura = m_capturas[turno % m_capturas.size()];
+    tpl = &captura.templateData;
+    img = &captura.image;
+  } else {
+    syntheticTemplate(static_cast<unsigned int>(turno % m_syntheticCount) + 1,
+                      sintetico);
+    tpl = &sintetico;
+  }
+
+  if (tpl->size() > *cbTemplate) {
+    return ZKFP_ERR_MEMORY_NOT_ENOUGH;
+  }
+  std::memcpy(fpTemplate, tpl->data(), tpl->size());
+  *cbTemplate = static_cast<unsigned int>(tpl->size());
+
+  // imagen: la grabada o el template repetido (para que el buffer cambie)
+  if (image && cbImage > 0) {
+    const std::vector<unsigned char> &fuente =
+        (img && !img->empty()) ? *img : *tpl;
+    for (unsigned int off = 0; off < cbImage;) {
+      unsigned int n = std::min<unsigned int>(
+          cbImage - off, static_cast<unsigned int>(fuente.size()));
+      std::memcpy(image + off, fuente.data(), n);
+      off += n;
+    }
+  }
+
+  return ZKFP_ERR_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Cache 1:N
+// -----------------------------------------------------------------------------
+void *ReplayBackend::dbInit() {
+  if (!m_initialized) {
+    return nullptr;
+  }
+  return new Cache();
+}
+
+int ReplayBackend::dbFree(void *dbCache) {
+  if (!dbCache) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  delete static_cast<Cache *>(dbCache);
+  return ZKFP_ERR_OK;
+}
+
+int ReplayBackend::dbAdd(void *dbCache, unsigned int fid,
+                         const unsigned char *fpTemplate,
+                         unsigned int cbTemplate) {
+  if (!dbCache) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  if (!fpTemplate || cbTemplate == 0) {
+    return ZKFP_ERR_INVALID_PARAM;
+  }
+  Cache *cache = static_cast<Cache *>(dbCache);
+  // como el SDK: un fid que ya esta no se pisa (para eso DBDel + DBAdd)
+  if (cache->templates.count(fid) > 0) {
+    return ZKFP_ERR_FAIL;
+  }
+  cache->templates[fid].assign(fpTemplate, fpTemplate + cbTemplate);
+  return ZKFP_ERR_OK;
+}
+
+int ReplayBackend::dbDel(void *dbCache, unsigned int fid) {
+  if (!dbCache) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  Cache *cache = static_cast<Cache *>(dbCache);
+  // como el SDK: borrar un fid que no esta es un error
+  return cache->templates.erase(fid) > 0 ? ZKFP_ERR_OK : ZKFP_ERR_FAIL;
+}
+
+int ReplayBackend::dbClear(void *dbCache) {
+  if (!dbCache) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  static_cast<Cache *>(dbCache)->templates.clear();
+  return ZKFP_ERR_OK;
+}
+
+int ReplayBackend::dbCount(void *dbCache, unsigned int *count) {
+  if (!dbCache) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  if (!count) {
+    return ZKFP_ERR_INVALID_PARAM;
+  }
+  *count = static_cast<unsigned int>(
+      static_cast<Cache *>(dbCache)->templates.size());
+  return ZKFP_ERR_OK;
+}
+
+int ReplayBackend::dbIdentify(void *dbCache, const unsigned char *fpTemplate,
+                              unsigned int cbTemplate, unsigned int *fid,
+                              unsigned int *score) {
+  if (!dbCache) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  if (!fpTemplate || cbTemplate == 0 || !fid || !score) {
+    return ZKFP_ERR_INVALID_PARAM;
+  }
+
+  Cache *cache = static_cast<Cache *>(dbCache);
+  int mejorScore = -1;
+  unsigned int mejorFid = 0;
+  for (const auto &entry : cache->templates) {
+    int s = ReplayBackend::score(fpTemplate, cbTemplate, entry.second.data(),
+                                 static_cast<unsigned int>(entry.second.size()));
+    if (s > mejorScore) {
+      mejorScore = s;
+      mejorFid = entry.first;
+    }
+  }
+
+  if (mejorScore < REPLAY_MTHRESHOLD) {
+    return ZKFP_ERR_FAIL;
+  }
+  *fid = mejorFid;
+  *score = static_cast<unsigned int>(mejorScore);
+  return ZKFP_ERR_OK;
+}
+
+int ReplayBackend::dbMatch(void *dbCache, const unsigned char *template1,
+                           unsigned int cbTemplate1,
+                           const unsigned char *template2,
+                           unsigned int cbTemplate2) {
+  if (!dbCache) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  return score(template1, cbTemplate1, template2, cbTemplate2);
+}
+
+// sin SDK no hay minucias que fusionar: votamos byte a byte entre las tres
+// capturas (gana el que se repite), asi tres capturas iguales dan el mismo
+// template y una captura distinta no lo arruina. El largo es el de la primera
+int ReplayBackend::dbMerge(void *dbCache, const unsigned char *template1,
+                           unsigned int cbTemplate1,
+                           const unsigned char *template2,
+                           unsigned int cbTemplate2,
+                           const unsigned char *template3,
+                           unsigned int cbTemplate3, unsigned char *regTemp,
+                           unsigned int *cbRegTemp) {
+  if (!dbCache) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  if (!template1 || !template2 || !template3 || cbTemplate1 == 0 ||
+      !regTemp || !cbRegTemp) {
+    return ZKFP_ERR_INVALID_PARAM;
+  }
+  if (*cbRegTemp < cbTemplate1) {
+    return ZKFP_ERR_MEMORY_NOT_ENOUGH;
+  }
+  const unsigned int comun =
+      std::min(cbTemplate1, std::min(cbTemplate2, cbTemplate3));
+  std::memcpy(regTemp, template1, cbTemplate1);
+  for (unsigned int i = 0; i < comun; i++) {
+    unsigned char a = template1[i];
+    unsigned char b = template2[i];
+    unsigned char c = template3[i];
+    regTemp[i] = (a == b || a == c) ? a : (b == c ? b : a);
+  }
+  *cbRegTemp = cbTemplate1;
+  return ZKFP_ERR_OK;
+}
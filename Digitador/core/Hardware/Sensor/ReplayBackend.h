@@ -0,0 +1,139 @@
+// ReplayBackend.h
+
+// backend de software deterministico: reproduce capturas grabadas en disco
+// (o templates sinteticos) y compara en memoria. Sirve para compilar,
+// perfilar y hacer pruebas de carga del flujo completo fuera del NUC.
+#pragma once
+
+#include "SensorBackend.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+// archivo indice dentro de la carpeta de capturas. Una linea por captura:
+//   <template.tpl> [imagen.raw]
+// las lineas vacias o que empiezan con '#' se ignoran
+#define REPLAY_INDEX_FILE "capturas.txt"
+
+#define REPLAY_DEFAULT_WIDTH 300
+#define REPLAY_DEFAULT_HEIGHT 400
+#define REPLAY_DEFAULT_DPI 500
+#define REPLAY_SYNTHETIC_SIZE 1024 // bytes de un template sintetico
+#define REPLAY_SYNTHETIC_COUNT 100 // semillas que se reproducen sin capturas
+#define REPLAY_MTHRESHOLD 70       // score minimo para aceptar un 1:N
+#define REPLAY_FINGER_EVERY 2
+#define REPLAY_MAX_DEVICES 4
+// cantidad de lectores simulados (por defecto 1)
+#define REPLAY_DEVICES_ENV "DIGITADOR_SENSOR_REPLAY_DEVICES"
+
+class ReplayBackend : public SensorBackend {
+public:
+  // dir: carpeta con REPLAY_INDEX_FILE. Si esta vacia o no tiene capturas se
+  // reproducen templates sinteticos con semillas 1..REPLAY_SYNTHETIC_COUNT
+  explicit ReplayBackend(const std::string &dir);
+
+  // template sintetico deterministico para una semilla (misma semilla, mismos
+  // bytes), asi un benchmark puede enrolar N alumnos y luego reproducirlos
+  static void syntheticTemplate(unsigned int seed,
+                                std::vector<unsigned char> &out);
+
+  // score 0..100 entre dos templates (bytes iguales sobre el largo mayor)
+  static int score(const unsigned char *template1, unsigned int cbTemplate1,
+                   const unsigned char *template2, unsigned int cbTemplate2);
+
+  //====Configuracion de la simulacion====
+
+  // solo 1 de cada n capturas trae dedo, el resto devuelve ZKFP_ERR_CAPTURE.
+  // Por defecto 2: dedo, lector vacio, dedo... (el alumno levanta el dedo)
+  void setFingerEvery(int n);
+
+  // latencia simulada del lector por captura
+  void setAcquireDelayMs(int ms);
+
+  // cantidad de semillas sinteticas que se reproducen en ronda
+  void setSyntheticCount(unsigned int count);
+
+  // cantidad de lectores simulados (1..REPLAY_MAX_DEVICES). Todos reproducen
+  // la misma ronda de capturas, cada uno con su propio ritmo de dedo/vacio.
+  // Se fija antes de initSensor
+  void setDeviceCount(int count);
+
+  // simular que se suelta (o se vuelve a enchufar) el USB de un lector. Como
+  // el huellero real, el handle viejo sigue contestando "sin dedo"; solo
+  // cambia la cantidad de conectados y falla todo lo demas hasta reabrirlo
+  void setDeviceConnected(int index, bool connected);
+
+  // cantidad de capturas grabadas cargadas desde disco
+  size_t getRecordedCount() const;
+
+  //====SensorBackend====
+
+  int init() override;
+  int terminate() override;
+
+  int getDeviceCount() override;
+  void *openDevice(int index) override;
+  int closeDevice(void *device) override;
+  int getCaptureParams(void *device, int &width, int &height,
+                       int &dpi) override;
+  int acquireFingerprint(void *device, unsigned char *image,
+                         unsigned int cbImage, unsigned char *fpTemplate,
+                         unsigned int *cbTemplate) override;
+
+  void *dbInit() override;
+  int dbFree(void *dbCache) override;
+  int dbAdd(void *dbCache, unsigned int fid, const unsigned char *fpTemplate,
+            unsigned int cbTemplate) override;
+  int dbDel(void *dbCache, unsigned int fid) override;
+  int dbClear(void *dbCache) override;
+  int dbCount(void *dbCache, unsigned int *count) override;
+  int dbIdentify(void *dbCache, const unsigned char *fpTemplate,
+                 unsigned int cbTemplate, unsigned int *fid,
+                 unsigned int *score) override;
+  int dbMatch(void *dbCache, const unsigned char *template1,
+              unsigned int cbTemplate1, const unsigned char *template2,
+              unsigned int cbTemplate2) override;
+  int dbMerge(void *dbCache, const unsigned char *template1,
+              unsigned int cbTemplate1, const unsigned char *template2,
+              unsigned int cbTemplate2, const unsigned char *template3,
+              unsigned int cbTemplate3, unsigned char *regTemp,
+              unsigned int *cbRegTemp) override;
+
+private:
+  // una captura grabada
+  struct Captura {
+    std::vector<unsigned char> templateData;
+    std::vector<unsigned char> image; // puede venir vacia
+  };
+
+  // cache 1:N en memoria (ordenada por fid para desempatar igual siempre)
+  struct Cache {
+    std::map<unsigned int, std::vector<unsigned char>> templates;
+  };
+
+  // leer REPLAY_INDEX_FILE y los archivos que nombra
+  void cargarCapturas();
+
+  // un lector simulado: su direccion es el handle. Cada lector tiene su
+  // propio hilo de captura en Sensor, asi que su contador es solo suyo
+  struct Device {
+    unsigned long long acquireCalls; // llamadas a acquireFingerprint
+    std::atomic<bool> unplugged;     // lo cambia setDeviceConnected
+    std::atomic<bool> stale;         // handle de antes de desenchufarlo
+  };
+
+  // lector de un handle, o nullptr si no es uno de los nuestros
+  Device *deviceOf(void *handle);
+
+  std::string m_dir;
+  std::vector<Captura> m_capturas;
+  unsigned int m_syntheticCount;
+  std::atomic<unsigned long long> m_next; // siguiente captura a reproducir
+  int m_fingerEvery;
+  int m_acquireDelayMs;
+  bool m_initialized;
+  int m_deviceCount;
+  Device m_devices[REPLAY_MAX_DEVICES];
+};
@@ -1,10 +1,10 @@
 // src/cpp/Sensor.cpp
 
 #include "Sensor.h"
-#include "include/libzkfp.h"
+#include "SensorLog.h"
 #include "include/libzkfperrdef.h" //I want to export ZKFPM_DBIdentify
 #include <chrono>
-#include <iostream>
+#include <cstdlib>
 #include <thread>
 
 // Si no lo tienes definido en otro lado, define el tamaño máximo de template
@@ -12,16 +12,86 @@
 #define MAX_TEMPLATE_SIZE 2048 // Ajusta si tu SDK indica otro valor
 #endif
 
+// milisegundos de steady_clock para fechar las capturas
+static long long ahoraMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// microsegundos transcurridos desde inicio (para las metricas)
+static unsigned long long microsDesde(
+    std::chrono::steady_clock::time_point inicio) {
+  return static_cast<unsigned long long>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - inicio)
+          .count());
+}
+
+// mientras vive, el pipeline de identificacion no saca capturas de la cola:
+// las recibe quien pidio el template crudo (waitTemplate, enrolamiento)
+namespace {
+struct ConsumidorDirecto {
+  explicit ConsumidorDirecto(std::atomic<int> &contador) : m_contador(contador) {
+    m_contador.fetch_add(1);
+  }
+  ~ConsumidorDirecto() { m_contador.fetch_sub(1); }
+  std::atomic<int> &m_contador;
+};
+} // namespace
+
 // Constructor
-Sensor::Sensor()
-    : m_timeoutMs(DEFAULT_TIMEOUT_MS),
-      m_pollIntervalMs(DEFAULT_POLL_INTERVAL_MS), m_deviceHandle(nullptr),
-      m_dbCacheHandle(nullptr), m_imageBuffer(), m_imageWidth(0),
-      m_imageHeight(0), m_isInitialized(false) {}
+Sensor::Sensor() : Sensor(createDefaultBackend()) {}
+
+// Constructor con un backend especifico (ej: ReplayBackend para pruebas)
+Sensor::Sensor(std::unique_ptr<SensorBackend> backend)
+    : m_backend(std::move(backend)), m_timeoutMs(DEFAULT_TIMEOUT_MS),
+      m_pollIntervalMs(DEFAULT_POLL_INTERVAL_MS),
+      m_cache(m_backend.get()), m_shardCount(0), m_isInitialized(false),
+      m_devices(), m_maxDevices(0), m_captureRunning(false),
+      m_captureIdleMs(DEFAULT_CAPTURE_IDLE_MS), m_requireLift(true),
+      m_nextDevice(0), m_directConsumers(0), m_pipelineRunning(false),
+      m_pipelineGroup(), m_watchdogRunning(false), m_watchdogWake(false),
+      m_watchdogIntervalMs(WATCHDOG_INTERVAL_MS) {}
 
 // Destructor
 Sensor::~Sensor() { closeSensor(); }
 
+// shards de la cache 1:N: el pedido explicito, SENSOR_SHARDS_ENV o uno por
+// nucleo (con tope, en el NUC no tiene sentido mas)
+static unsigned int shardsPorDefecto(unsigned int pedido) {
+  if (pedido > 0) {
+    return pedido;
+  }
+  const char *env = std::getenv(SENSOR_SHARDS_ENV);
+  if (env && std::atoi(env) > 0) {
+    return static_cast<unsigned int>(std::atoi(env));
+  }
+  unsigned int nucleos = std::thread::hardware_concurrency();
+  if (nucleos == 0) {
+    return 1;
+  }
+  return nucleos < DEFAULT_MAX_DB_SHARDS ? nucleos : DEFAULT_MAX_DB_SHARDS;
+}
+
+// lectores a abrir: el pedido explicito, SENSOR_DEVICES_ENV o todos los
+// conectados (con tope MAX_SENSOR_DEVICES)
+static int lectoresPorDefecto(unsigned int pedido, int conectados) {
+  int tope = MAX_SENSOR_DEVICES;
+  if (pedido > 0) {
+    tope = static_cast<int>(pedido);
+  } else {
+    const char *env = std::getenv(SENSOR_DEVICES_ENV);
+    if (env && std::atoi(env) > 0) {
+      tope = std::atoi(env);
+    }
+  }
+  if (tope > MAX_SENSOR_DEVICES) {
+    tope = MAX_SENSOR_DEVICES;
+  }
+  return conectados < tope ? conectados : tope;
+}
+
 // -----------------------------------------------------------------------------
 // Inicializar sensor
 // -----------------------------------------------------------------------------
@@ -30,43 +100,80 @@ bool Sensor::initSensor() {
     return true;
   }
 
+  // sin backend no hay nada que inicializar
+  if (!m_backend) {
+    SLOG_ERROR("init", "No hay backend de sensor configurado.");
+    return false;
+  }
+
   // 1) Inicializar SDK PRIMERO (antes de cualquier operación con dispositivos)
-  int ret = ZKFPM_Init();
+  int ret = m_backend->init();
   if (ret != ZKFP_ERR_OK) {
-    std::cerr << "(-) Error al inicializar ZKFP, código: " << ret << std::endl;
+    SLOG_ERROR("init", "Error al inicializar ZKFP, código: %d", ret);
     return false;
   }
 
   // 2) Ver cuántos dispositivos hay (DESPUÉS de Init)
-  int devCount = ZKFPM_GetDeviceCount();
+  int devCount = m_backend->getDeviceCount();
   if (devCount <= 0) {
-    std::cerr << "(-) No se encontraron dispositivos de huella." << std::endl;
-    ZKFPM_Terminate();
+    SLOG_ERROR("init", "No se encontraron dispositivos de huella.");
+    m_backend->terminate();
     return false;
   }
 
-  std::cout << "(+) Dispositivos encontrados: " << devCount << std::endl;
+  SLOG_INFO("init", "Dispositivos encontrados: %d", devCount);
+
+  // 3) Abrir todos los lectores (una fila del casino por lector). Uno que no
+  // abre no impide usar los demas
+  int aAbrir = lectoresPorDefecto(m_maxDevices, devCount);
+  for (int i = 0; i < devCount && static_cast<int>(m_devices.size()) < aAbrir;
+       ++i) {
+    openReader(i);
+  }
+  if (m_devices.empty()) {
+    SLOG_ERROR("init", "No se pudo abrir ningun dispositivo");
+    m_backend->terminate();
+    return false;
+  }
 
-  // 3) Abrir el primer dispositivo (índice 0)
-  m_deviceHandle = ZKFPM_OpenDevice(0);
-  if (!m_deviceHandle) {
-    std::cerr << "(-) No se pudo abrir el dispositivo 0" << std::endl;
-    ZKFPM_Terminate();
+  // 4) Inicializar DB de templates (K caches, una por shard), compartida por
+  // todos los lectores
+  unsigned int shards = shardsPorDefecto(m_shardCount);
+  if (!m_cache.init(shards)) {
+    SLOG_ERROR("init", "Error al inicializar DB de huellas.");
+    closeReaders();
+    m_backend->terminate();
     return false;
   }
 
-  std::cout << "(+) Dispositivo abierto correctamente" << std::endl;
+  m_isInitialized = true;
+  SLOG_INFO("init",
+            "Sensor inicializado correctamente (%u lectores, %u shards 1:N)",
+            getDeviceCount(), shards);
+
+  // 5) Vigilar los lectores: si uno se desconecta se reabre solo
+  startWatchdog();
+  return true;
+}
+
+bool Sensor::openReader(int index) {
+  void *handle = m_backend->openDevice(index);
+  if (!handle) {
+    SLOG_WARN("init", "No se pudo abrir el dispositivo %d", index);
+    return false;
+  }
 
-  // 4) Intentar obtener ancho/alto/DPI
+  // Intentar obtener ancho/alto/DPI
   int width = 0;
   int height = 0;
   int dpi = 0;
 
-  ret = ZKFPM_GetCaptureParamsEx(m_deviceHandle, &width, &height, &dpi);
+  int ret = m_backend->getCaptureParams(handle, width, height, dpi);
   if (ret != ZKFP_ERR_OK) {
-    std::cerr << "(-) Error al obtener ancho de imagen, código: " << ret
-              << std::endl;
-    std::cerr << "    Usando valores por defecto 250x360 @500dpi.\n";
+    SLOG_WARN("init",
+              "Error al obtener ancho de imagen del dispositivo %d, código: "
+              "%d. Usando valores por defecto 250x360 @500dpi.",
+              index, ret);
 
     // Valores por defecto razonables
     width = 250;
@@ -74,30 +181,63 @@ bool Sensor::initSensor() {
     dpi = 500;
   }
 
-  m_imageWidth = width;
-  m_imageHeight = height;
+  std::unique_ptr<Device> device(new Device());
+  device->index = index;
+  device->handle = handle;
+  device->imageWidth = width;
+  device->imageHeight = height;
 
   // Reservar buffer como vector
   const auto pixelCount =
-      static_cast<size_t>(m_imageWidth) * static_cast<size_t>(m_imageHeight);
-  m_imageBuffer.resize(pixelCount);
+      static_cast<size_t>(width) * static_cast<size_t>(height);
+  device->imageBuffer.resize(pixelCount);
 
-  // 5) Inicializar DB de templates
-  m_dbCacheHandle = ZKFPM_DBInit();
-  if (!m_dbCacheHandle) {
-    std::cerr << "(-) Error al inicializar DB de huellas." << std::endl;
-    m_imageBuffer.clear();
-    ZKFPM_CloseDevice(m_deviceHandle);
-    m_deviceHandle = nullptr;
-    ZKFPM_Terminate();
-    return false;
+  device->state.store(DEVICE_STATE_OK);
+  device->errors.store(0);
+  device->reconnects.store(0);
+  device->lastError.store(ZKFP_ERR_OK);
+
+  m_devices.push_back(std::move(device));
+  SLOG_INFO("init", "Dispositivo %d abierto correctamente", index);
+  return true;
+}
+
+void Sensor::closeReaders() {
+  for (size_t i = 0; i < m_devices.size(); ++i) {
+    if (m_devices[i]->handle) {
+      m_backend->closeDevice(m_devices[i]->handle);
+    }
   }
+  m_devices.clear();
+}
 
-  m_isInitialized = true;
-  std::cout << "(+) Sensor inicializado correctamente" << std::endl;
+void Sensor::setMaxDevices(unsigned int devices) { m_maxDevices = devices; }
+
+unsigned int Sensor::getDeviceCount() const {
+  return static_cast<unsigned int>(m_devices.size());
+}
+
+int Sensor::getDeviceIndex(unsigned int position) const {
+  return position < m_devices.size() ? m_devices[position]->index : -1;
+}
+
+bool Sensor::getDeviceStatus(unsigned int position, DeviceStatus &out) const {
+  if (position >= m_devices.size()) {
+    return false;
+  }
+  const Device &device = *m_devices[position];
+  out.index = device.index;
+  out.state = device.state.load();
+  out.errors = device.errors.load();
+  out.reconnects = device.reconnects.load();
+  out.lastError = device.lastError.load();
   return true;
 }
 
+void Sensor::setWatchdogIntervalMs(int ms) {
+  m_watchdogIntervalMs = ms < 0 ? 0 : ms;
+}
+
 // -----------------------------------------------------------------------------
 // Cerrar sensor
 // -----------------------------------------------------------------------------
@@ -106,89 +246,337 @@ bool Sensor::closeSensor() {
     return true;
   }
 
-  // Liberar DB de templates
-  if (m_dbCacheHandle) {
-    ZKFPM_DBFree(m_dbCacheHandle);
-    m_dbCacheHandle = nullptr;
-  }
+  // el watchdog y los hilos de captura usan los dispositivos, los
+  // detenemos primero (los eventos salen de esos hilos)
+  stopEvents();
+  stopWatchdog();
+  stopCaptureLoop();
 
-  // Cerrar dispositivo
-  if (m_deviceHandle) {
-    ZKFPM_CloseDevice(m_deviceHandle);
-    m_deviceHandle = nullptr;
-  }
+  // Liberar DB de templates (grupos, todos los shards y su pool)
+  freeGroups();
+  m_cache.free();
 
-  // Limpiar buffer de imagen
-  m_imageBuffer.clear();
-  m_imageWidth = 0;
-  m_imageHeight = 0;
+  // Cerrar dispositivos (y sus buffers de imagen)
+  closeReaders();
 
   // Terminar SDK
-  ZKFPM_Terminate();
+  m_backend->terminate();
+
+  // lo que quedo sin flush en el diario baja a disco antes de salir
+  closeJournal();
 
   m_isInitialized = false;
+  SensorLog::instance().flush();
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// Watchdog: salud de los lectores y reconexion en caliente
+// -----------------------------------------------------------------------------
+
+// si se suelta el USB el SDK no avisa: o devuelve errores en cada captura o
+// (segun el modelo) sigue contestando "sin dedo". Lo primero lo detecta
+// acquireTemplate contando errores seguidos; lo segundo, el cambio en la
+// cantidad de lectores conectados. En ambos casos se reabre solo ese lector:
+// la cache 1:N, los grupos y los hilos siguen como estaban
+void Sensor::startWatchdog() {
+  if (m_watchdogIntervalMs <= 0 || m_watchdogThread.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_watchdogMutex);
+    m_watchdogRunning = true;
+    m_watchdogWake = false;
+  }
+  m_watchdogThread = std::thread(&Sensor::watchdogLoop, this);
+}
+
+void Sensor::stopWatchdog() {
+  {
+    std::lock_guard<std::mutex> lock(m_watchdogMutex);
+    m_watchdogRunning = false;
+  }
+  m_watchdogCv.notify_all();
+  if (m_watchdogThread.joinable()) {
+    m_watchdogThread.join();
+  }
+}
+
+void Sensor::watchdogLoop() {
+  int conectados = m_backend->getDeviceCount();
+
+  std::unique_lock<std::mutex> lock(m_watchdogMutex);
+  while (m_watchdogRunning) {
+    m_watchdogCv.wait_for(lock,
+                          std::chrono::milliseconds(m_watchdogIntervalMs),
+                          [this] { return !m_watchdogRunning || m_watchdogWake; });
+    if (!m_watchdogRunning) {
+      break;
+    }
+    m_watchdogWake = false;
+
+    // la revision abre y cierra lectores: sin el mutex del watchdog
+    lock.unlock();
+    checkReaders(conectados);
+    lock.lock();
+  }
+}
+
+void Sensor::checkReaders(int &connected) {
+  int ahora = m_backend->getDeviceCount();
+  bool cambio = ahora != connected;
+  if (cambio) {
+    SLOG_WARN("watchdog", "Lectores conectados: %d -> %d", connected, ahora);
+    connected = ahora;
+  }
+
+  for (size_t i = 0; i < m_devices.size(); ++i) {
+    Device &device = *m_devices[i];
+
+    if (device.state.load() == DEVICE_STATE_OK) {
+      if (!cambio) {
+        continue;
+      }
+      // cambio la cantidad de conectados: preguntamos al lector si sigue ahi
+      int ret;
+      {
+        std::lock_guard<std::mutex> lock(device.handleMutex);
+        int width = 0;
+        int height = 0;
+        int dpi = 0;
+        ret = device.handle ? m_backend->getCaptureParams(device.handle, width,
+                                                          height, dpi)
+                            : ZKFP_ERR_NO_DEVICE;
+      }
+      if (ret == ZKFP_ERR_OK) {
+        continue;
+      }
+      markFailed(device, ret);
+    }
+
+    reopenReader(device);
+  }
+}
+
+void Sensor::markFailed(Device &device, int error) {
+  int esperado = DEVICE_STATE_OK;
+  if (!device.state.compare_exchange_strong(esperado, DEVICE_STATE_FAILED)) {
+    return; // ya estaba caido
+  }
+  device.lastError.store(error);
+  SLOG_WARN("watchdog", "Lector %d sin respuesta (codigo %d), se reabrira",
+            device.index, error);
+
+  // que el watchdog no espere a la proxima vuelta
+  {
+    std::lock_guard<std::mutex> lock(m_watchdogMutex);
+    m_watchdogWake = true;
+  }
+  m_watchdogCv.notify_all();
+}
+
+bool Sensor::reopenReader(Device &device) {
+  std::lock_guard<std::mutex> lock(device.handleMutex);
+
+  if (device.handle) {
+    m_backend->closeDevice(device.handle);
+    device.handle = nullptr;
+  }
+
+  // mientras siga desenchufado esto falla en cada vuelta: sin log
+  void *handle = m_backend->openDevice(device.index);
+  if (!handle) {
+    return false;
+  }
+
+  int width = 0;
+  int height = 0;
+  int dpi = 0;
+  if (m_backend->getCaptureParams(handle, width, height, dpi) == ZKFP_ERR_OK &&
+      (width != device.imageWidth || height != device.imageHeight)) {
+    // otro modelo en el mismo puerto
+    device.imageWidth = width;
+    device.imageHeight = height;
+    device.imageBuffer.resize(static_cast<size_t>(width) *
+                              static_cast<size_t>(height));
+  }
+
+  device.handle = handle;
+  device.errors.store(0);
+  device.reconnects.fetch_add(1);
+  device.state.store(DEVICE_STATE_OK);
+  SLOG_INFO("watchdog", "Lector %d reabierto", device.index);
   return true;
 }
 
 // -----------------------------------------------------------------------------
 // Agregar template a la DB en memoria
 // -----------------------------------------------------------------------------
-bool Sensor::DBAdd(const std::vector<unsigned char> &templateData,
-                             int userId) {
-  if (!m_isInitialized || !m_dbCacheHandle) {
-    std::cerr << "(-) Sensor no inicializado o DB inválida." << std::endl;
+bool Sensor::DBAdd(TemplateView templateData, int userId) {
+  if (!m_isInitialized || !m_cache.isReady()) {
+    SLOG_ERROR("db", "Sensor no inicializado o DB inválida.");
     return false;
   }
 
   if (templateData.empty()) {
-    std::cerr << "(-) Template vacío." << std::endl;
+    SLOG_ERROR("db", "Template vacío.");
     return false;
   }
 
-  // Agregar template a la DB en memoria
-  int ret = ZKFPM_DBAdd(m_dbCacheHandle, userId, const_cast<unsigned char*>(templateData.data()),
-                        static_cast<unsigned int>(templateData.size()));
+  // Agregar template a la DB en memoria (directo desde el buffer del llamador)
+  int ret = m_cache.add(static_cast<unsigned int>(userId), templateData.data,
+                        templateData.size);
 
   if (ret != ZKFP_ERR_OK) {
-    std::cerr << "(-) Error al agregar template a la DB, código: " << ret
-              << std::endl;
+    SENSOR_LOG(LOG_LEVEL_ERROR, "db_add", userId, LOG_NA, LOG_NA,
+               "Error al agregar template a la DB, código: %d", ret);
     return false;
   }
 
-  std::cout << "(+) Template agregado a la DB (ID: " << userId << ")."
-            << std::endl;
+  // uno por template en la precarga: solo con depuracion
+  SENSOR_LOG(LOG_LEVEL_DEBUG, "db_add", userId, LOG_NA, LOG_NA,
+             "Template agregado a la DB");
   return true;
 }
 
 // -----------------------------------------------------------------------------
-// Identificar huella en la DB en memoria
+// Agregar un lote de templates a la DB en memoria (carga masiva)
+// -----------------------------------------------------------------------------
+int Sensor::dbAddBatch(const int *ids, const unsigned char *blob,
+                       const unsigned int *offsets, unsigned int count,
+                       int *results) {
+  if (!m_isInitialized || !m_cache.isReady()) {
+    SLOG_ERROR("db", "Sensor no inicializado o DB inválida.");
+    return -1;
+  }
+  if (count > 0 && (!ids || !blob || !offsets || !results)) {
+    return -1;
+  }
+
+  // todo el lote en un solo loop, sin logs por template (un colegio completo
+  // son miles y cada linea a stdout cuesta mas que el DBAdd mismo)
+  std::chrono::steady_clock::time_point inicioCarga =
+      std::chrono::steady_clock::now();
+  int agregados = 0;
+  for (unsigned int i = 0; i < count; ++i) {
+    unsigned int inicio = offsets[i];
+    unsigned int fin = offsets[i + 1];
+    if (fin <= inicio) {
+      results[i] = ZKFP_ERR_INVALID_PARAM;
+      continue;
+    }
+    results[i] = m_cache.add(static_cast<unsigned int>(ids[i]), blob + inicio,
+                             fin - inicio);
+    if (results[i] == ZKFP_ERR_OK) {
+      ++agregados;
+    }
+  }
+  m_metrics.record(OP_LOAD, microsDesde(inicioCarga));
+  return agregados;
+}
+
+// -----------------------------------------------------------------------------
+// Mantener la DB en memoria al dia (bajas, cambios de huella, recargas)
 // -----------------------------------------------------------------------------
-bool Sensor::DBIdentify(const std::vector<unsigned char> &templateData,
-                        int &userId, int &score) {
-  if (!m_isInitialized || !m_dbCacheHandle) {
-    std::cerr << "(-) Sensor no inicializado o DB inválida." << std::endl;
+bool Sensor::dbRemove(int userId) {
+  if (!m_isInitialized) {
     return false;
   }
+  removeFromGroups(static_cast<unsigned int>(userId));
+  return m_cache.remove(static_cast<unsigned int>(userId)) == ZKFP_ERR_OK;
+}
 
-  if (templateData.empty()) {
-    std::cerr << "(-) Template vacío." << std::endl;
+bool Sensor::dbReplace(TemplateView templateData, int userId) {
+  if (!m_isInitialized || templateData.empty()) {
+    return false;
+  }
+  removeFromGroups(static_cast<unsigned int>(userId));
+  // quitar y agregar en un solo paso del shard: una identificacion en medio
+  // del re-enrolamiento ve el template viejo o el nuevo, nunca ninguno
+  int ret = m_cache.replace(static_cast<unsigned int>(userId),
+                            templateData.data, templateData.size);
+  if (ret != ZKFP_ERR_OK) {
+    SENSOR_LOG(LOG_LEVEL_ERROR, "db_replace", userId, LOG_NA, LOG_NA,
+               "Error al reemplazar template en la DB, código: %d (el id "
+               "quedo fuera de la DB)",
+               ret);
     return false;
   }
+  return true;
+}
+
+bool Sensor::dbClear() {
+  if (!m_isInitialized) {
+    return false;
+  }
+  freeGroups();
+  return m_cache.clear() == ZKFP_ERR_OK;
+}
 
-  // Identificar huella en la DB en memoria
-  int ret = ZKFPM_DBIdentify(m_dbCacheHandle, const_cast<unsigned char*>(templateData.data()),
-                             static_cast<unsigned int>(templateData.size()),
+int Sensor::dbCount() {
+  if (!m_isInitialized) {
+    return -1;
+  }
+  unsigned int total = 0;
+  if (m_cache.count(&total) != ZKFP_ERR_OK) {
+    return -1;
+  }
+  return static_cast<int>(total);
+}
+
+// -----------------------------------------------------------------------------
+// Identificar huella en la DB en memoria
+// -----------------------------------------------------------------------------
+bool Sensor::DBIdentify(TemplateView templateData, int &userId, int &score) {
+  std::chrono::steady_clock::time_point inicio =
+      std::chrono::steady_clock::now();
+  int ret = identifyAll(templateData, userId, score);
+  unsigned long long us = microsDesde(inicio);
+  recordIdentify(us, ret, false);
+  if (ret == ZKFP_ERR_OK) {
+    SENSOR_LOG(LOG_LEVEL_DEBUG, "identify", userId, score,
+               static_cast<long long>(us), "Huella identificada");
+  }
+  return ret == ZKFP_ERR_OK;
+}
+
+int Sensor::identifyAll(TemplateView templateData, int &userId, int &score) {
+  if (!m_isInitialized || !m_cache.isReady()) {
+    SLOG_ERROR("db", "Sensor no inicializado o DB inválida.");
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+
+  if (templateData.empty()) {
+    SLOG_ERROR("db", "Template vacío.");
+    return ZKFP_ERR_INVALID_PARAM;
+  }
+
+  // Identificar huella en todos los shards en paralelo
+  int ret = m_cache.identify(templateData.data, templateData.size,
                              (unsigned int *)&userId, (unsigned int *)&score);
 
+  // un "no esta" (ZKFP_ERR_FAIL) es normal en el kiosco, no un error
   if (ret != ZKFP_ERR_OK) {
-    std::cerr << "(-) Error al identificar template, código: " << ret
-              << std::endl;
-    return false;
+    if (ret == ZKFP_ERR_FAIL) {
+      SLOG_DEBUG("identify", "Huella no encontrada en la DB");
+    } else {
+      SLOG_ERROR("identify", "Error al identificar template, código: %d", ret);
+    }
+    return ret;
   }
+  return ZKFP_ERR_OK;
+}
 
-  std::cout << "(+) Huella identificada en la DB (ID: " << userId
-            << ", Score: " << score << ")." << std::endl;
-  return true;
+// un "no esta" del SDK (ZKFP_ERR_FAIL) es un fallo normal, no un error
+void Sensor::recordIdentify(unsigned long long us, int ret, bool inGroup) {
+  m_metrics.record(OP_IDENTIFY, us);
+  m_metrics.identifyOutcome(ret == ZKFP_ERR_OK, ahoraMs());
+  if (inGroup) {
+    m_metrics.count(CNT_IDENTIFY_GROUP_HIT);
+  }
+  if (ret != ZKFP_ERR_OK && ret != ZKFP_ERR_FAIL) {
+    m_metrics.setLastError(OP_IDENTIFY, ret);
+  }
 }
 
 // -----------------------------------------------------------------------------
@@ -199,18 +587,29 @@ bool Sensor::captureCreateTemplate(
     // datos del template
     std::vector<unsigned char> &templateData) {
 
+  // con el hilo de captura activo, esperamos su siguiente template
+  // (sin hilo, waitTemplate hace el polling directo)
+  return waitTemplate(templateData, m_timeoutMs);
+}
+
+// -----------------------------------------------------------------------------
+// Polling directo al lector hasta timeoutMs
+// -----------------------------------------------------------------------------
+bool Sensor::pollTemplate(unsigned char *out, unsigned int &size,
+                          int timeoutMs, int device, int *fromDevice) {
+
   // esta el sensor apagado?
   if (!m_isInitialized) {
     return false;
   }
 
-  // esta el buffer de imagen grayscale sin datos?
-  if (m_imageBuffer.empty()) {
+  // no hay lectores abiertos?
+  if (m_devices.empty()) {
     return false;
   }
 
-  // almacenamos el template en un buffer temporal
-  unsigned char templateBufferTemporal[MAX_TEMPLATE_SIZE];
+  // el SDK escribe el template directo en el buffer del llamador
+  const unsigned int capacidad = size;
 
   int ret = ZKFP_ERR_FAIL;
   bool success = false;
@@ -218,21 +617,16 @@ bool Sensor::captureCreateTemplate(
 
   // Creamos tiempo de espera y deadline
   auto startWait = std::chrono::steady_clock::now();
-  auto deadline = startWait + std::chrono::milliseconds(m_timeoutMs);
+  auto deadline = startWait + std::chrono::milliseconds(timeoutMs);
 
   // ciclo while para capturar la huella
   while (std::chrono::steady_clock::now() < deadline) {
 
-    // creamos un buffer temporal para almacenar la imagen
-    templateSize = MAX_TEMPLATE_SIZE; // SIEMPRE resetear
-
-    // obtenemos el tamaño real de la imagen en bytes
-    unsigned int imageSize = static_cast<unsigned int>(m_imageBuffer.size());
+    // capacidad del buffer de salida
+    templateSize = capacidad; // SIEMPRE resetear
 
-    // capturamos la huella capturada por el sensor
-    ret = ZKFPM_AcquireFingerprint(m_deviceHandle, m_imageBuffer.data(),
-                                   imageSize, templateBufferTemporal,
-                                   &templateSize);
+    // una pasada por los lectores: el primero con dedo gana
+    ret = acquireAny(out, &templateSize, device, fromDevice);
 
     // si la captura fue exitosa
     if (ret == ZKFP_ERR_OK) {
@@ -263,88 +657,454 @@ bool Sensor::captureCreateTemplate(
     return false;
   }
 
-  // Movemos el template al vector de salida
-  templateData.assign(templateBufferTemporal,
-                      templateBufferTemporal + templateSize);
-
+  // el template ya quedo en out
+  size = templateSize;
   return true;
 }
 
 // -----------------------------------------------------------------------------
-// Obtener la última imagen capturada
+// Obtener la última imagen capturada (del primer lector)
 // -----------------------------------------------------------------------------
 bool Sensor::captureLastTemplate(std::vector<unsigned char> &imgOut, int &width,
                                  int &height) {
   // sensor apagado?
-  if (!m_isInitialized) {
-    std::cerr
-        << "(-) No hay imagen disponible o el sensor no está inicializado."
-        << std::endl;
+  if (!m_isInitialized || m_devices.empty()) {
+    SLOG_ERROR("image",
+               "No hay imagen disponible o el sensor no está inicializado.");
     return false;
   }
+  Device &device = *m_devices[0];
+  // el watchdog puede cambiar el buffer al reabrir el lector
+  std::lock_guard<std::mutex> lock(device.handleMutex);
   // imagen vacia??
-  if (m_imageBuffer.empty()) {
-    std::cerr
-        << "(-) No hay imagen disponible o el sensor no está inicializado."
-        << std::endl;
+  if (device.imageBuffer.empty()) {
+    SLOG_ERROR("image",
+               "No hay imagen disponible o el sensor no está inicializado.");
     return false;
   }
 
   // definimos tamaño real
-  width = m_imageWidth;
-  height = m_imageHeight;
+  width = device.imageWidth;
+  height = device.imageHeight;
 
   // copiamos la imagen completamente
-  imgOut = m_imageBuffer;
+  imgOut = device.imageBuffer;
   return true;
 }
 
+// -----------------------------------------------------------------------------
+// Obtener el backend en uso
+// -----------------------------------------------------------------------------
+SensorBackend *Sensor::getBackend() const { return m_backend.get(); }
+
 // TODO: traspasar esto a templatemanager.cpp
 //  -----------------------------------------------------------------------------
 //  Comparar dos templates y retornar el score de coincidencia
 //  -----------------------------------------------------------------------------
-int Sensor::matchTemplate(const std::vector<unsigned char> &template1,
-                          const std::vector<unsigned char> &template2) {
+int Sensor::matchTemplate(TemplateView template1, TemplateView template2) {
   // sensor inicializado?
   if (!m_isInitialized) {
-    std::cerr << "(-) matchTemplate: sensor no inicializado." << std::endl;
+    SLOG_ERROR("match", "matchTemplate: sensor no inicializado.");
     return -1;
   }
 
   // DB inicializada
-  if (!m_dbCacheHandle) {
-    std::cerr << "(-) matchTemplate: DB no inicializada." << std::endl;
+  if (!m_cache.isReady()) {
+    SLOG_ERROR("match", "matchTemplate: DB no inicializada.");
     return -1;
   }
 
   // templates vacios?
   if (template1.empty() || template2.empty()) {
-    std::cerr << "(-) matchTemplate: uno de los templates está vacío."
-              << std::endl;
+    SLOG_ERROR("match", "matchTemplate: uno de los templates está vacío.");
     return -1;
   }
 
   // Obtenemos el tamaño (cantidad de bytes) de cada huella.
-  unsigned int size1 = static_cast<unsigned int>(template1.size());
-  unsigned int size2 = static_cast<unsigned int>(template2.size());
+  unsigned int size1 = template1.size;
+  unsigned int size2 = template2.size;
 
   // Extraemos el puntero directo a los datos crudos en memoria.
-  unsigned char *tpl1 = const_cast<unsigned char *>(template1.data());
-  unsigned char *tpl2 = const_cast<unsigned char *>(template2.data());
+  const unsigned char *tpl1 = template1.data;
+  const unsigned char *tpl2 = template2.data;
 
   // Enviamos ambas huellas para que el motor de ZKTeco las compare sengun nivel
   // de coincidencia
-  int score = ZKFPM_DBMatch(m_dbCacheHandle, tpl1, size1, tpl2, size2);
+  std::chrono::steady_clock::time_point inicio =
+      std::chrono::steady_clock::now();
+  int score = m_cache.match(tpl1, size1, tpl2, size2);
+  m_metrics.record(OP_MATCH, microsDesde(inicio));
 
   // Score negativo? Error al comparar
   if (score < 0) {
-    std::cerr << "(-) DBMatch: Error al comparar huellas, código: " << score
-              << std::endl;
+    m_metrics.setLastError(OP_MATCH, score);
+    SLOG_ERROR("match", "DBMatch: Error al comparar huellas, código: %d",
+               score);
   }
   // devuelve resultado en score
   return score;
 }
 
+// -----------------------------------------------------------------------------
+// Arena de templates: carga masiva de la cache 1:N al arrancar
+// -----------------------------------------------------------------------------
+int Sensor::openArena(const std::string &path) {
+  std::lock_guard<std::mutex> lock(m_arenaMutex);
+  if (!m_arena.open(path)) {
+    SLOG_ERROR("arena", "No se pudo abrir la arena de templates: %s",
+               path.c_str());
+    return -1;
+  }
+  return static_cast<int>(m_arena.liveCount());
+}
+
+int Sensor::loadArena() {
+  if (!m_isInitialized || !m_cache.isReady()) {
+    SLOG_ERROR("db", "Sensor no inicializado o DB inválida.");
+    return -1;
+  }
+  // la cache 1:N sigue identificando mientras se carga (cada alta toma solo
+  // su shard)
+  std::lock_guard<std::mutex> lock(m_arenaMutex);
+  if (!m_arena.isOpen()) {
+    return -1;
+  }
+
+  // los templates se leen directo del archivo mapeado (sin copias) y el SDK
+  // los copia a su cache
+  std::chrono::steady_clock::time_point inicio =
+      std::chrono::steady_clock::now();
+  const std::vector<TemplateArena::Entry> &entradas = m_arena.entries();
+  size_t total = entradas.size();
+  int cargados = 0;
+  for (size_t i = 0; i < total; ++i) {
+    const TemplateArena::Entry &e = entradas[i];
+    if (m_cache.add(e.fid, e.tpl.data, e.tpl.size) == ZKFP_ERR_OK) {
+      ++cargados;
+    }
+  }
+  m_arena.unmap(); // entradas queda vacio desde aca
+  unsigned long long us = microsDesde(inicio);
+  m_metrics.record(OP_LOAD, us);
+
+  SENSOR_LOG(LOG_LEVEL_INFO, "arena", LOG_NA, LOG_NA,
+             static_cast<long long>(us),
+             "Arena cargada en la DB: %d de %zu templates.", cargados, total);
+  return cargados;
+}
+
+bool Sensor::arenaPut(const std::string &run, int fid,
+                      TemplateView templateData) {
+  std::lock_guard<std::mutex> lock(m_arenaMutex);
+  if (!m_arena.isOpen()) {
+    return false;
+  }
+  return m_arena.put(run, static_cast<unsigned int>(fid), templateData);
+}
+
+bool Sensor::arenaRemove(const std::string &run) {
+  std::lock_guard<std::mutex> lock(m_arenaMutex);
+  if (!m_arena.isOpen()) {
+    return false;
+  }
+  return m_arena.remove(run);
+}
+
+int Sensor::arenaPutMany(const std::vector<TemplateArena::Entry> &entradas) {
+  std::lock_guard<std::mutex> lock(m_arenaMutex);
+  if (!m_arena.isOpen()) {
+    return -1;
+  }
+  return m_arena.putMany(entradas);
+}
+
+bool Sensor::resetArena() {
+  std::lock_guard<std::mutex> lock(m_arenaMutex);
+  return m_arena.reset();
+}
+
+bool Sensor::isArenaOpen() const {
+  std::lock_guard<std::mutex> lock(m_arenaMutex);
+  return m_arena.isOpen();
+}
+
+unsigned long long Sensor::arenaLiveBytes() const {
+  std::lock_guard<std::mutex> lock(m_arenaMutex);
+  return m_arena.liveBytes();
+}
+
+unsigned long long Sensor::arenaLiveChecksum() const {
+  std::lock_guard<std::mutex> lock(m_arenaMutex);
+  return m_arena.liveChecksum();
+}
+
+void Sensor::arenaMapping(std::vector<TemplateArena::Entry> &entradas) const {
+  std::lock_guard<std::mutex> lock(m_arenaMutex);
+  const std::map<std::string, TemplateArena::Live> &indice = m_arena.index();
+  entradas.clear();
+  entradas.reserve(indice.size());
+  for (std::map<std::string, TemplateArena::Live>::const_iterator it =
+           indice.begin();
+       it != indice.end(); ++it) {
+    TemplateArena::Entry e;
+    e.fid = it->second.fid;
+    e.run = it->first;
+    entradas.push_back(e);
+  }
+}
+
+const TemplateArena &Sensor::getArena() const { return m_arena; }
+
+// -----------------------------------------------------------------------------
+// Eventos al totem
+// -----------------------------------------------------------------------------
+int Sensor::startEvents(unsigned short port) { return m_events.start(port); }
+
+void Sensor::stopEvents() { m_events.stop(); }
+
+void Sensor::publishEvent(const std::string &json) { m_events.publish(json); }
+
+unsigned int Sensor::getEventClients() const {
+  return m_events.clientCount();
+}
+
+// -----------------------------------------------------------------------------
+// Diario de raciones
+// -----------------------------------------------------------------------------
+long long Sensor::openJournal(const std::string &path) {
+  if (!m_journal.open(path)) {
+    SLOG_ERROR("journal", "No se pudo abrir el diario de raciones: %s",
+               path.c_str());
+    return -1;
+  }
+  return static_cast<long long>(m_journal.durableSeq() -
+                                m_journal.appliedSeq());
+}
+
+void Sensor::closeJournal() { m_journal.close(); }
+
+RationJournal &Sensor::getJournal() { return m_journal; }
+
+// -----------------------------------------------------------------------------
+// Metricas
+// -----------------------------------------------------------------------------
+void Sensor::getMetrics(MetricsSnapshot &out) const { m_metrics.snapshot(out); }
+
+void Sensor::resetMetrics() { m_metrics.reset(); }
+
+// -----------------------------------------------------------------------------
+// Shards de la cache 1:N
+// -----------------------------------------------------------------------------
+void Sensor::setShardCount(unsigned int shards) { m_shardCount = shards; }
+
+unsigned int Sensor::getShardCount() const { return m_cache.shardCount(); }
+
+void Sensor::getShardStats(std::vector<ShardStats> &out) const {
+  m_cache.stats(out);
+}
+
+// -----------------------------------------------------------------------------
+// Grupos de candidatos: se busca primero en el grupo probable y se amplia a
+// toda la cache solo si no aparece
+// -----------------------------------------------------------------------------
+int Sensor::groupLoad(const std::string &group, const int *ids,
+                      const unsigned char *blob, const unsigned int *offsets,
+                      unsigned int count) {
+  if (!m_isInitialized) {
+    return -1;
+  }
+  if (count > 0 && (!ids || !blob || !offsets)) {
+    return -1;
+  }
+
+  // armamos la cache nueva aparte y la cambiamos de una vez
+  void *handle = m_backend->dbInit();
+  if (!handle) {
+    SLOG_ERROR("group", "No se pudo crear la cache del grupo %s",
+               group.c_str());
+    return -1;
+  }
+  unsigned int agregados = 0;
+  for (unsigned int i = 0; i < count; ++i) {
+    unsigned int inicio = offsets[i];
+    unsigned int fin = offsets[i + 1];
+    if (fin > inicio &&
+        m_backend->dbAdd(handle, static_cast<unsigned int>(ids[i]),
+                         blob + inicio, fin - inicio) == ZKFP_ERR_OK) {
+      ++agregados;
+    }
+  }
+
+  // con el lock exclusivo nadie esta identificando en el grupo viejo
+  std::unique_lock<std::shared_timed_mutex> lock(m_groupsMutex);
+  Group &g = m_groups[group];
+  if (g.handle) {
+    m_backend->dbFree(g.handle);
+  }
+  g.handle = handle;
+  g.templates = agregados;
+  return static_cast<int>(agregados);
+}
+
+bool Sensor::groupAdd(const std::string &group, int userId,
+                      TemplateView templateData) {
+  if (!m_isInitialized || templateData.empty()) {
+    return false;
+  }
+
+  std::unique_lock<std::shared_timed_mutex> lock(m_groupsMutex);
+  if (m_groups.find(group) == m_groups.end()) {
+    void *handle = m_backend->dbInit();
+    if (!handle) {
+      return false;
+    }
+    m_groups[group].handle = handle;
+  }
+  Group &g = m_groups[group];
+  if (m_backend->dbAdd(g.handle, static_cast<unsigned int>(userId),
+                       templateData.data,
+                       templateData.size) != ZKFP_ERR_OK) {
+    return false;
+  }
+  g.templates++;
+  return true;
+}
+
+void Sensor::groupClear(const std::string &group) {
+  std::unique_lock<std::shared_timed_mutex> lock(m_groupsMutex);
+  std::map<std::string, Group>::iterator it = m_groups.find(group);
+  if (it != m_groups.end()) {
+    m_backend->dbFree(it->second.handle);
+    m_groups.erase(it);
+  }
+}
+
+unsigned int Sensor::groupSize(const std::string &group) const {
+  std::shared_lock<std::shared_timed_mutex> lock(m_groupsMutex);
+  std::map<std::string, Group>::const_iterator it = m_groups.find(group);
+  return it != m_groups.end() ? it->second.templates : 0;
+}
+
+void Sensor::freeGroups() {
+  std::unique_lock<std::shared_timed_mutex> lock(m_groupsMutex);
+  for (std::map<std::string, Group>::iterator it = m_groups.begin();
+       it != m_groups.end(); ++it) {
+    m_backend->dbFree(it->second.handle);
+  }
+  m_groups.clear();
+}
+
+void Sensor::removeFromGroups(unsigned int fid) {
+  std::unique_lock<std::shared_timed_mutex> lock(m_groupsMutex);
+  for (std::map<std::string, Group>::iterator it = m_groups.begin();
+       it != m_groups.end(); ++it) {
+    if (m_backend->dbDel(it->second.handle, fid) == ZKFP_ERR_OK &&
+        it->second.templates > 0) {
+      it->second.templates--;
+    }
+  }
+}
+
+bool Sensor::DBIdentifyGroup(const std::string &group,
+                             TemplateView templateData, int &userId,
+                             int &score, bool &inGroup) {
+  inGroup = false;
+  if (!m_isInitialized || templateData.empty()) {
+    return false;
+  }
+  std::chrono::steady_clock::time_point inicio =
+      std::chrono::steady_clock::now();
+
+  // 1) el grupo probable: una cache chica, responde antes y compara contra
+  // menos alumnos (menos chances de un falso positivo)
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(m_groupsMutex);
+    std::map<std::string, Group>::iterator it = m_groups.find(group);
+    if (it != m_groups.end() && it->second.templates > 0) {
+      unsigned int fid = 0;
+      unsigned int s = 0;
+      int ret;
+      {
+        // el shared_lock solo cuida el mapa: el SDK no garantiza dos
+        // DBIdentify a la vez sobre el mismo handle (lectores y Go)
+        std::lock_guard<std::mutex> turno(it->second.lock);
+        ret = m_backend->dbIdentify(it->second.handle, templateData.data,
+                                    templateData.size, &fid, &s);
+      }
+      if (ret == ZKFP_ERR_OK) {
+        userId = static_cast<int>(fid);
+        score = static_cast<int>(s);
+        inGroup = true;
+        recordIdentify(microsDesde(inicio), ZKFP_ERR_OK, true);
+        return true;
+      }
+    }
+  }
+
+  // 2) no estaba en el grupo: ampliamos a toda la cache
+  int ret = identifyAll(templateData, userId, score);
+  recordIdentify(microsDesde(inicio), ret, false);
+  return ret == ZKFP_ERR_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Comparar un probe contra un lote de templates (1:N en una sola llamada)
+// -----------------------------------------------------------------------------
+int Sensor::matchMany(TemplateView probe, const unsigned char *blob,
+                      const unsigned int *offsets, unsigned int count,
+                      MatchResult *results, unsigned int topK, int stopScore) {
+  // sensor inicializado?
+  if (!m_isInitialized || !m_cache.isReady()) {
+    SLOG_ERROR("match", "matchMany: sensor no inicializado.");
+    return -1;
+  }
+
+  // probe vacio o lote mal formado?
+  if (probe.empty() || (count > 0 && (!blob || !offsets))) {
+    SLOG_ERROR("match", "matchMany: probe o lote invalido.");
+    return -1;
+  }
+  if (topK == 0 || !results) {
+    return 0;
+  }
+
+  unsigned int encontrados = 0;
+  for (unsigned int i = 0; i < count; ++i) {
+    unsigned int inicio = offsets[i];
+    unsigned int fin = offsets[i + 1];
+    // template vacio u offsets invertidos: lo saltamos
+    if (fin <= inicio) {
+      continue;
+    }
+
+    int score = m_cache.match(probe.data, probe.size, blob + inicio,
+                              fin - inicio);
+    // template corrupto, no cuenta (sin log por template: el lote puede ser
+    // de miles)
+    if (score < 0) {
+      continue;
+    }
+
+    // insercion ordenada en el top-k (k es chico, no vale la pena un heap)
+    if (encontrados < topK || score > results[encontrados - 1].score) {
+      unsigned int pos = encontrados < topK ? encontrados++ : topK - 1;
+      while (pos > 0 && results[pos - 1].score < score) {
+        results[pos] = results[pos - 1];
+        --pos;
+      }
+      results[pos].index = i;
+      results[pos].score = score;
+    }
+
+    // ya alcanzamos el umbral de corte?
+    if (stopScore > 0 && score >= stopScore) {
+      break;
+    }
+  }
+
+  return static_cast<int>(encontrados);
+}
+
 // -----------------------------------------------------------------------------
 // Intentar capturar huella inmediatamente (Non-while) *definicion en la
 // linea 290
@@ -353,34 +1113,638 @@ int Sensor::matchTemplate(const std::vector<unsigned char> &template1,
 // capturamos la huella inmediatamente
 bool Sensor::captureTemplateImmediate(
     std::vector<unsigned char> &templateData) {
-  if (!m_isInitialized) {
+  templateData.resize(MAX_TEMPLATE_SIZE);
+  unsigned int templateSize = MAX_TEMPLATE_SIZE;
+  if (!captureTemplateImmediate(templateData.data(), templateSize)) {
+    templateData.clear();
     return false;
   }
-  if (m_imageBuffer.empty()) {
+  templateData.resize(templateSize);
+  return true;
+}
+
+// capturamos la huella inmediatamente, directo en el buffer del llamador
+bool Sensor::captureTemplateImmediate(unsigned char *out, unsigned int &size) {
+  if (!m_isInitialized || !out) {
     return false;
   }
 
-  // iniciamos un buffer temporal para el template inmediato
-  unsigned char tempTemplateBuffer[MAX_TEMPLATE_SIZE];
-  unsigned int templateSize = MAX_TEMPLATE_SIZE;
-  unsigned int imageSize = static_cast<unsigned int>(m_imageBuffer.size());
+  // los hilos de captura son dueños de los lectores: tomamos lo que ya
+  // tengan encolado
+  if (m_captureRunning.load()) {
+    return waitTemplate(out, size, 0);
+  }
 
-  int ret =
-      ZKFPM_AcquireFingerprint(m_deviceHandle, m_imageBuffer.data(), imageSize,
-                               tempTemplateBuffer, &templateSize);
+  // el SDK escribe el template directo en out (size = capacidad)
+  unsigned int templateSize = size;
+  if (acquireAny(out, &templateSize, -1, nullptr) == ZKFP_ERR_OK) {
+    size = templateSize;
+    return true;
+  }
 
-  if (ret == ZKFP_ERR_OK) {
-    // Éxito: copiar template
-    templateData.assign(tempTemplateBuffer, tempTemplateBuffer + templateSize);
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// Captura continua: un hilo por lector, dueño del lector, encola cada huella
+// nueva
+// -----------------------------------------------------------------------------
+
+// todas las capturas pasan por aca: el SDK entrega imagen + template en una
+// llamada, asi que OP_ACQUIRE incluye la extraccion. Solo se mide la latencia
+// de las capturas con dedo (sin dedo el SDK vuelve al instante)
+int Sensor::acquireTemplate(Device &device, unsigned char *out,
+                            unsigned int *size) {
+  // un lector caido no se toca hasta que el watchdog lo reabra
+  if (device.state.load() != DEVICE_STATE_OK) {
+    return ZKFP_ERR_NO_DEVICE;
+  }
+
+  int ret;
+  std::chrono::steady_clock::time_point inicio =
+      std::chrono::steady_clock::now();
+  {
+    // el buffer se mira con el lock: reopenReader lo redimensiona desde el
+    // watchdog
+    std::lock_guard<std::mutex> lock(device.handleMutex);
+    if (!device.handle || device.imageBuffer.empty()) {
+      return ZKFP_ERR_NO_DEVICE;
+    }
+    unsigned int imageSize =
+        static_cast<unsigned int>(device.imageBuffer.size());
+    ret = m_backend->acquireFingerprint(
+        device.handle, device.imageBuffer.data(), imageSize, out, size);
+  }
+  switch (ret) {
+  case ZKFP_ERR_OK:
+    m_metrics.record(OP_ACQUIRE, microsDesde(inicio));
+    m_metrics.count(CNT_ACQUIRE_OK);
+    device.errors.store(0);
+    break;
+  case ZKFP_ERR_CAPTURE:
+    m_metrics.count(CNT_ACQUIRE_NO_FINGER);
+    device.errors.store(0);
+    break;
+  case ZKFP_ERR_EXTRACT_FP:
+    m_metrics.count(CNT_ACQUIRE_BAD_IMAGE);
+    m_metrics.setLastError(OP_ACQUIRE, ret);
+    device.errors.store(0);
+    break;
+  default:
+    m_metrics.count(CNT_ACQUIRE_ERROR);
+    m_metrics.setLastError(OP_ACQUIRE, ret);
+    device.lastError.store(ret);
+    // varios errores seguidos: el lector se cayo (USB suelto, etc.)
+    if (device.errors.fetch_add(1) + 1 >= DEVICE_MAX_ERRORS) {
+      markFailed(device, ret);
+    }
+    break;
+  }
+  return ret;
+}
+
+int Sensor::acquireAny(unsigned char *out, unsigned int *size, int device,
+                       int *fromDevice) {
+  const unsigned int capacidad = *size;
+  int ret = ZKFP_ERR_INVALID_HANDLE;
+  for (size_t i = 0; i < m_devices.size(); ++i) {
+    Device &d = *m_devices[i];
+    if (device >= 0 && d.index != device) {
+      continue;
+    }
+    *size = capacidad; // SIEMPRE resetear
+    ret = acquireTemplate(d, out, size);
+    if (ret == ZKFP_ERR_OK) {
+      if (fromDevice) {
+        *fromDevice = d.index;
+      }
+      break;
+    }
+  }
+  return ret;
+}
+
+bool Sensor::startCaptureLoop() {
+  if (!m_isInitialized || m_devices.empty()) {
+    SLOG_ERROR("capture", "startCaptureLoop: sensor no inicializado.");
+    return false;
+  }
+  if (m_captureRunning.load()) {
     return true;
   }
 
+  m_captureRunning.store(true);
+  for (size_t i = 0; i < m_devices.size(); ++i) {
+    Device *device = m_devices[i].get();
+    device->captureThread = std::thread(&Sensor::captureLoop, this, device);
+  }
+  SLOG_INFO("capture", "Hilos de captura continua iniciados (%u lectores)",
+            getDeviceCount());
+  return true;
+}
+
+void Sensor::stopCaptureLoop() {
+  // el pipeline consume las colas de los hilos de captura: cae primero
+  stopIdentifyPipeline();
+
+  if (!m_captureRunning.exchange(false)) {
+    return;
+  }
+
+  // despertamos a los que esperan para que vean que ya no hay hilo
+  {
+    std::lock_guard<std::mutex> lock(m_readyMutex);
+  }
+  m_readyCv.notify_all();
+
+  for (size_t i = 0; i < m_devices.size(); ++i) {
+    if (m_devices[i]->captureThread.joinable()) {
+      m_devices[i]->captureThread.join();
+    }
+  }
+}
+
+bool Sensor::isCaptureLoopRunning() const { return m_captureRunning.load(); }
+
+void Sensor::setCaptureIdleMs(int ms) { m_captureIdleMs = ms < 0 ? 0 : ms; }
+
+void Sensor::setRequireLift(bool requireLift) { m_requireLift = requireLift; }
+
+void Sensor::captureLoop(Device *device) {
+  unsigned char templateBuffer[MAX_TEMPLATE_SIZE];
+
+  // el mismo dedo apoyado da una captura valida en cada vuelta: solo
+  // encolamos la primera hasta que el lector vuelva a quedar vacio
+  bool dedoApoyado = false;
+
+  while (m_captureRunning.load()) {
+    unsigned int templateSize = MAX_TEMPLATE_SIZE; // SIEMPRE resetear
+    int ret = acquireTemplate(*device, templateBuffer, &templateSize);
+
+    if (ret == ZKFP_ERR_OK) {
+      if (!dedoApoyado || !m_requireLift) {
+        if (device->captureQueue.push(templateBuffer, templateSize,
+                                      ahoraMs())) {
+          m_events.publishDevice(EVENT_FINGER_DETECTED, device->index);
+          // tomamos el mutex para no perder el aviso entre el chequeo y el wait.
+          // A todos: puede esperar el pipeline y tambien un consumidor directo
+          {
+            std::lock_guard<std::mutex> lock(m_readyMutex);
+          }
+          m_readyCv.notify_all();
+        } else {
+          m_metrics.count(CNT_QUEUE_DROPPED);
+          SLOG_WARN("capture",
+                    "Cola de capturas del lector %d llena, se descarta la "
+                    "huella.",
+                    device->index);
+        }
+      }
+      dedoApoyado = true;
+    } else {
+      dedoApoyado = false;
+    }
+
+    // con el lector caido no tiene sentido girar rapido: esperamos al
+    // watchdog
+    if (device->state.load() != DEVICE_STATE_OK) {
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(DEFAULT_POLL_INTERVAL_MS));
+    } else if (m_captureIdleMs > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(m_captureIdleMs));
+    }
+  }
+}
+
+// la cola copia directo a out, descartando huellas que nadie pidio a tiempo
+// (o que no caben en el buffer del llamador). Las colas se recorren en ronda
+// para que una fila no tape a la otra
+bool Sensor::popCapture(unsigned char *out, unsigned int &size,
+                        long long &capturedMs, int device, int *fromDevice) {
+  const unsigned int capacidad = size;
+  const size_t total = m_devices.size();
+  for (size_t vuelta = 0; vuelta < total; ++vuelta) {
+    Device &d = *m_devices[(m_nextDevice + vuelta) % total];
+    if (device >= 0 && d.index != device) {
+      continue;
+    }
+    unsigned int templateSize = capacidad;
+    while (d.captureQueue.pop(out, &templateSize, &capturedMs) ||
+           templateSize > capacidad) {
+      if (templateSize <= capacidad &&
+          ahoraMs() - capturedMs <= CAPTURE_MAX_AGE_MS) {
+        size = templateSize;
+        if (fromDevice) {
+          *fromDevice = d.index;
+        }
+        m_nextDevice = static_cast<unsigned int>((m_nextDevice + vuelta + 1) %
+                                                 total);
+        return true;
+      }
+      m_metrics.count(CNT_STALE_DISCARDED);
+      templateSize = capacidad;
+    }
+  }
   return false;
 }
 
+bool Sensor::queuesEmpty(int device) const {
+  for (size_t i = 0; i < m_devices.size(); ++i) {
+    const Device &d = *m_devices[i];
+    if ((device < 0 || d.index == device) && !d.captureQueue.empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Sensor::waitTemplate(std::vector<unsigned char> &templateData,
+                          int timeoutMs) {
+  templateData.resize(MAX_TEMPLATE_SIZE);
+  unsigned int templateSize = MAX_TEMPLATE_SIZE;
+  if (!waitTemplate(templateData.data(), templateSize, timeoutMs)) {
+    templateData.clear();
+    return false;
+  }
+  templateData.resize(templateSize);
+  return true;
+}
+
+bool Sensor::waitTemplate(unsigned char *out, unsigned int &size,
+                          int timeoutMs) {
+  return waitCapture(out, size, timeoutMs, -1, nullptr);
+}
+
+bool Sensor::waitCapture(unsigned char *out, unsigned int &size,
+                         int timeoutMs, int device, int *fromDevice) {
+  if (!m_isInitialized || !out) {
+    return false;
+  }
+
+  // sin hilo de captura volvemos al polling directo
+  if (!m_captureRunning.load()) {
+    if (timeoutMs > 0) {
+      return pollTemplate(out, size, timeoutMs, device, fromDevice);
+    }
+    unsigned int templateSize = size;
+    if (acquireAny(out, &templateSize, device, fromDevice) != ZKFP_ERR_OK) {
+      return false;
+    }
+    size = templateSize;
+    return true;
+  }
+
+  ConsumidorDirecto directo(m_directConsumers);
+  std::lock_guard<std::mutex> consumidor(m_consumerMutex);
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+  long long capturadoMs = 0;
+
+  for (;;) {
+    if (popCapture(out, size, capturadoMs, device, fromDevice)) {
+      return true;
+    }
+
+    if (!m_captureRunning.load() ||
+        std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+
+    std::unique_lock<std::mutex> lock(m_readyMutex);
+    m_readyCv.wait_until(lock, deadline, [this, device] {
+      return !queuesEmpty(device) || !m_captureRunning.load();
+    });
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Pipeline de identificacion: capturar -> identificar -> entregar
+// -----------------------------------------------------------------------------
+
+// el SDK solo extrae desde archivo (ZKFPM_ExtractFromImage), asi que la etapa
+// 1 sigue siendo ZKFPM_AcquireFingerprint en el hilo de captura y las capturas
+// esperan en los slots preasignados de la cola de cada lector
+bool Sensor::startIdentifyPipeline() {
+  if (!m_captureRunning.load()) {
+    return false;
+  }
+  bool esperado = false;
+  if (!m_pipelineRunning.compare_exchange_strong(esperado, true)) {
+    return true; // ya estaba corriendo
+  }
+  for (size_t i = 0; i < m_devices.size(); ++i) {
+    Device *device = m_devices[i].get();
+    if (device->pipelineThread.joinable()) {
+      device->pipelineThread.join();
+    }
+    device->pipelineThread = std::thread(&Sensor::pipelineLoop, this, device);
+  }
+  SLOG_INFO("pipeline", "Hilos de identificacion iniciados (%u lectores)",
+            getDeviceCount());
+  return true;
+}
+
+void Sensor::stopIdentifyPipeline() {
+  if (!m_pipelineRunning.exchange(false)) {
+    return;
+  }
+
+  // despertamos a los hilos y a los que esperan un resultado
+  {
+    std::lock_guard<std::mutex> lock(m_readyMutex);
+  }
+  m_readyCv.notify_all();
+  {
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    for (size_t i = 0; i < m_devices.size(); ++i) {
+      m_devices[i]->resultHead = 0;
+      m_devices[i]->resultCount = 0;
+    }
+  }
+  m_resultCv.notify_all();
+
+  for (size_t i = 0; i < m_devices.size(); ++i) {
+    if (m_devices[i]->pipelineThread.joinable()) {
+      m_devices[i]->pipelineThread.join();
+    }
+  }
+}
+
+bool Sensor::isIdentifyPipelineRunning() const {
+  return m_pipelineRunning.load();
+}
+
+void Sensor::pipelineLoop(Device *device) {
+  unsigned char templateBuffer[MAX_TEMPLATE_SIZE];
+
+  while (m_pipelineRunning.load()) {
+    // esperamos una captura de nuestro lector; si alguien pidio el template
+    // crudo se la dejamos (el wait tiene tope porque ese consumidor no nos
+    // avisa al terminar)
+    {
+      std::unique_lock<std::mutex> lock(m_readyMutex);
+      m_readyCv.wait_for(
+          lock, std::chrono::milliseconds(DEFAULT_POLL_INTERVAL_MS),
+          [this, device] {
+            return !m_pipelineRunning.load() ||
+                   (!device->captureQueue.empty() &&
+                    m_directConsumers.load() == 0);
+          });
+    }
+
+    unsigned int templateSize = MAX_TEMPLATE_SIZE;
+    long long capturadoMs = 0;
+    {
+      std::lock_guard<std::mutex> consumidor(m_consumerMutex);
+      if (!m_pipelineRunning.load() || m_directConsumers.load() > 0 ||
+          !popCapture(templateBuffer, templateSize, capturadoMs,
+                      device->index, nullptr)) {
+        continue;
+      }
+    }
+    m_events.publishDevice(EVENT_PROCESSING, device->index);
+
+    // etapa 2: identificar mientras el hilo de captura ya espera el
+    // siguiente dedo
+    std::string grupo;
+    {
+      std::lock_guard<std::mutex> lock(m_pipelineMutex);
+      grupo = m_pipelineGroup;
+    }
+    IdentifyResult result = IdentifyResult();
+    result.device = device->index;
+    result.capturedMs = capturadoMs;
+    identifyCapture(grupo, TemplateView(templateBuffer, templateSize), result);
+
+    // etapa 3: dejar el resultado para Go
+    pushResult(*device, result);
+  }
+}
+
+void Sensor::identifyCapture(const std::string &group, TemplateView probe,
+                             IdentifyResult &result) {
+  std::chrono::steady_clock::time_point inicio =
+      std::chrono::steady_clock::now();
+  bool ok = group.empty() ? DBIdentify(probe, result.userId, result.score)
+                          : DBIdentifyGroup(group, probe, result.userId,
+                                            result.score, result.inGroup);
+  result.identifyUs = microsDesde(inicio);
+  result.status = ok ? PIPELINE_HIT : PIPELINE_MISS;
+
+  if (ok && !group.empty() && !result.inGroup) {
+    groupAdd(group, result.userId, probe);
+  }
+}
+
+void Sensor::pushResult(Device &device, const IdentifyResult &result) {
+  {
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    // nadie los esta pidiendo: se pisa el mas viejo
+    if (device.resultCount == PIPELINE_RESULT_SLOTS) {
+      device.resultHead = (device.resultHead + 1) % PIPELINE_RESULT_SLOTS;
+      --device.resultCount;
+      m_metrics.count(CNT_QUEUE_DROPPED);
+    }
+    device.results[(device.resultHead + device.resultCount) %
+                   PIPELINE_RESULT_SLOTS] = result;
+    ++device.resultCount;
+  }
+  m_resultCv.notify_all();
+}
+
+int Sensor::waitIdentify(const std::string &group, int device, int timeoutMs,
+                         IdentifyResult &result) {
+  result = IdentifyResult();
+  result.status = PIPELINE_ERROR;
+  if (!m_isInitialized) {
+    return result.status;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    m_pipelineGroup = group;
+  }
+
+  // sin hilo de captura las tres etapas van en serie en este hilo
+  if (!startIdentifyPipeline()) {
+    unsigned char templateBuffer[MAX_TEMPLATE_SIZE];
+    unsigned int templateSize = MAX_TEMPLATE_SIZE;
+    if (!waitCapture(templateBuffer, templateSize, timeoutMs, device,
+                     &result.device)) {
+      result.status = PIPELINE_TIMEOUT;
+      return result.status;
+    }
+    result.capturedMs = ahoraMs();
+    identifyCapture(group, TemplateView(templateBuffer, templateSize), result);
+    return result.status;
+  }
+
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+  std::unique_lock<std::mutex> lock(m_pipelineMutex);
+  for (;;) {
+    // el resultado mas viejo entre los lectores pedidos; los de alumnos que
+    // ya se fueron no sirven
+    for (;;) {
+      Device *elegido = nullptr;
+      for (size_t i = 0; i < m_devices.size(); ++i) {
+        Device *d = m_devices[i].get();
+        if ((device >= 0 && d->index != device) || d->resultCount == 0) {
+          continue;
+        }
+        if (!elegido || d->results[d->resultHead].capturedMs <
+                            elegido->results[elegido->resultHead].capturedMs) {
+          elegido = d;
+        }
+      }
+      if (!elegido) {
+        break;
+      }
+      IdentifyResult listo = elegido->results[elegido->resultHead];
+      elegido->resultHead = (elegido->resultHead + 1) % PIPELINE_RESULT_SLOTS;
+      --elegido->resultCount;
+      if (ahoraMs() - listo.capturedMs <= CAPTURE_MAX_AGE_MS) {
+        result = listo;
+        return result.status;
+      }
+      m_metrics.count(CNT_STALE_DISCARDED);
+    }
+
+    if (!m_pipelineRunning.load() ||
+        std::chrono::steady_clock::now() >= deadline) {
+      result.status = PIPELINE_TIMEOUT;
+      return result.status;
+    }
+    m_resultCv.wait_until(lock, deadline);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Enrolamiento: tres capturas del mismo dedo fusionadas por el SDK
+// -----------------------------------------------------------------------------
+
+bool Sensor::waitFingerLift(int timeoutMs, int device) {
+  unsigned char templateBuffer[MAX_TEMPLATE_SIZE];
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+  for (;;) {
+    unsigned int templateSize = MAX_TEMPLATE_SIZE;
+    if (acquireAny(templateBuffer, &templateSize, device, nullptr) !=
+        ZKFP_ERR_OK) {
+      return true; // lector vacio
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(m_pollIntervalMs));
+  }
+}
+
+bool Sensor::enrollTemplate(std::vector<unsigned char> &templateData,
+                            int timeoutMs, int minScore,
+                            EnrollResult &result) {
+  templateData.resize(MAX_TEMPLATE_SIZE);
+  unsigned int templateSize = MAX_TEMPLATE_SIZE;
+  if (!enrollTemplate(templateData.data(), templateSize, timeoutMs, minScore,
+                      result)) {
+    templateData.clear();
+    return false;
+  }
+  templateData.resize(templateSize);
+  return true;
+}
+
+bool Sensor::enrollTemplate(unsigned char *out, unsigned int &size,
+                            int timeoutMs, int minScore,
+                            EnrollResult &result) {
+  // las tres capturas son para nosotros aunque el pipeline este corriendo
+  ConsumidorDirecto directo(m_directConsumers);
+  std::chrono::steady_clock::time_point inicio =
+      std::chrono::steady_clock::now();
+  bool ok = enrollSamples(out, size, timeoutMs, minScore, result);
+  m_metrics.record(OP_ENROLL, microsDesde(inicio));
+  m_metrics.count(ok ? CNT_ENROLL_OK : CNT_ENROLL_FAIL);
+  if (!ok) {
+    m_metrics.setLastError(OP_ENROLL, result.status);
+  }
+  return ok;
+}
+
+bool Sensor::enrollSamples(unsigned char *out, unsigned int &size,
+                           int timeoutMs, int minScore,
+                           EnrollResult &result) {
+  result.status = ENROLL_ERR_NOT_READY;
+  result.samples = 0;
+  result.quality = 0;
+  for (int i = 0; i < ENROLL_PAIRS; ++i) {
+    result.scores[i] = -1;
+  }
+  if (!m_isInitialized || !m_cache.isReady() || !out || size == 0) {
+    return false;
+  }
+  if (minScore <= 0) {
+    minScore = ENROLL_MIN_SCORE;
+  }
+
+  unsigned char muestras[ENROLL_SAMPLES][MAX_TEMPLATE_SIZE];
+  unsigned int tamanos[ENROLL_SAMPLES];
+  int peor = 100;
+  // la primera captura puede venir de cualquier lector; las siguientes, del
+  // mismo (el alumno no cambia de fila a mitad del enrolamiento)
+  int lector = -1;
+
+  for (unsigned int i = 0; i < ENROLL_SAMPLES; ++i) {
+    // con el hilo de captura la cola ya entrega una huella por apoyo (si se
+    // exige levantar el dedo); sin el, esperamos el lector vacio a mano
+    if (i > 0 && !m_captureRunning.load() &&
+        !waitFingerLift(timeoutMs, lector)) {
+      result.status = ENROLL_ERR_TIMEOUT;
+      return false;
+    }
+    tamanos[i] = MAX_TEMPLATE_SIZE;
+    if (!waitCapture(muestras[i], tamanos[i], timeoutMs, lector, &lector)) {
+      result.status = ENROLL_ERR_TIMEOUT;
+      return false;
+    }
+    result.samples = i + 1;
+
+    // la captura nueva tiene que parecerse a todas las anteriores: un dedo
+    // distinto o una captura mala se rechaza ahora y no en el almuerzo
+    for (unsigned int j = 0; j < i; ++j) {
+      int score =
+          m_cache.match(muestras[i], tamanos[i], muestras[j], tamanos[j]);
+      result.scores[i * (i - 1) / 2 + j] = score;
+      if (score < peor) {
+        peor = score < 0 ? 0 : score;
+      }
+      if (score < minScore) {
+        result.quality = peor;
+        result.status = ENROLL_ERR_INCONSISTENT;
+        return false;
+      }
+    }
+  }
+  result.quality = peor;
+
+  unsigned int regSize = size;
+  int ret = m_cache.merge(muestras[0], tamanos[0], muestras[1], tamanos[1],
+                          muestras[2], tamanos[2], out, &regSize);
+  if (ret != ZKFP_ERR_OK) {
+    SLOG_ERROR("enroll",
+               "enrollTemplate: no se pudieron fusionar las capturas, "
+               "código: %d",
+               ret);
+    result.status = ENROLL_ERR_MERGE;
+    return false;
+  }
+
+  size = regSize;
+  result.status = ENROLL_OK;
+  return true;
+}
+
 // Diferencia en la vida de una huella:
 // - Capturar (Sensor): Escanear el dedo en vivo desde el aparato de ZKTeco.
 // - Obtener (BD): Leer la huella guardada en el disco duro para compararla
 // (Asistencia).
 // - Almacenar (BD): Guardar esa huella capturada por primera vez
-// (Enrolamiento).
\ No newline at end of file
+// (Enrolamiento).
@@ -3,39 +3,285 @@
 // el service del sensor, que se comunica con el hardware y la base de datos
 #pragma once // evita duplicados
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <vector>
-#include <windows.h>
 
-// zkteco sdk
-#include "include/libzkfp.h"
+// backend de captura/comparacion (ZKTeco o reproduccion)
+#include "SensorBackend.h"
+#include "RationJournal.h"
+#include "SensorEvents.h"
+#include "SensorMetrics.h"
+#include "ShardedCache.h"
+#include "TemplateArena.h"
+#include "TemplateQueue.h"
+#include "TemplateView.h"
 #include "include/libzkfperrdef.h"
 
+// resultado de una comparacion 1:N por lote: posicion del template dentro
+// del lote y su score
+struct MatchResult {
+  unsigned int index;
+  int score;
+};
+
+// enrolamiento con varias capturas del mismo dedo (ver enrollTemplate)
+#define ENROLL_SAMPLES 3 // ZKFPM_DBMerge fusiona exactamente tres
+#define ENROLL_PAIRS 3   // comparaciones 1-0, 2-0 y 2-1
+#define ENROLL_MIN_SCORE 50 // score 1:1 minimo entre capturas del mismo dedo
+
+// estado de un enrolamiento (los mismos valores devuelve el bridge)
+#define ENROLL_OK 0
+#define ENROLL_ERR_TIMEOUT -1      // no se apoyo (o no se levanto) el dedo
+#define ENROLL_ERR_INCONSISTENT -2 // las capturas no parecen del mismo dedo
+#define ENROLL_ERR_MERGE -3        // el SDK no pudo fusionar las capturas
+#define ENROLL_ERR_NOT_READY -4    // sensor sin iniciar o parametros invalidos
+
+struct EnrollResult {
+  int status;           // ENROLL_OK o ENROLL_ERR_*
+  unsigned int samples; // capturas tomadas (aunque haya fallado)
+  // score 1:1 entre cada par de capturas tomadas (-1 = no se comparo)
+  int scores[ENROLL_PAIRS];
+  // calidad del enrolamiento: el peor score entre pares, 0..100
+  int quality;
+};
+
+// pipeline de identificacion: resultado de cada huella (los mismos valores
+// devuelve el bridge)
+#define PIPELINE_HIT 1      // identificado
+#define PIPELINE_MISS 0     // habia dedo pero no esta en la cache
+#define PIPELINE_TIMEOUT -1 // nadie apoyo el dedo a tiempo
+#define PIPELINE_ERROR -2   // sensor sin iniciar o parametros invalidos
+
+struct IdentifyResult {
+  int status; // PIPELINE_*
+  int userId;
+  int score;
+  bool inGroup;         // el acierto vino del grupo de candidatos
+  int device;           // indice del lector que capturo la huella
+  long long capturedMs; // momento de la captura (steady_clock)
+  unsigned long long identifyUs; // lo que tardo el 1:N
+};
+
+// estado de un lector (los mismos valores devuelve el bridge)
+#define DEVICE_STATE_OK 0     // abierto y capturando
+#define DEVICE_STATE_FAILED 1 // caido o desconectado: el watchdog lo reabre
+
+struct DeviceStatus {
+  int index;               // indice del SDK
+  int state;               // DEVICE_STATE_*
+  unsigned int errors;     // errores seguidos del SDK
+  unsigned int reconnects; // veces que el watchdog lo reabrio
+  int lastError;           // ultimo codigo de error del SDK (0 = ninguno)
+};
+
 class Sensor {
 public:
 #define DEFAULT_POLL_INTERVAL_MS 100 // 100 milisegundos
 #define DEFAULT_TIMEOUT_MS 10000     // 10 segundos
 #define MAX_TEMPLATE_SIZE 2048
+#define DEFAULT_CAPTURE_IDLE_MS 5 // pausa del hilo de captura sin dedo
+#define CAPTURE_QUEUE_SIZE 8      // templates esperando consumidor
+#define CAPTURE_MAX_AGE_MS 3000   // templates mas viejos se descartan
+#define PIPELINE_RESULT_SLOTS 4   // resultados identificados esperando a Go
+#define MAX_SENSOR_DEVICES 4      // lectores que maneja un Sensor
+#define WATCHDOG_INTERVAL_MS 1000 // cada cuanto el watchdog revisa los lectores
+#define DEVICE_MAX_ERRORS 5       // errores seguidos para dar un lector por caido
+// tope de lectores a abrir (si no se fija con setMaxDevices)
+#define SENSOR_DEVICES_ENV "DIGITADOR_SENSOR_DEVICES"
+// cantidad de shards de la cache 1:N (si no se fija con setShardCount)
+#define SENSOR_SHARDS_ENV "DIGITADOR_SENSOR_SHARDS"
 
   // constructor / destructor
-  Sensor();
+  Sensor(); // usa createDefaultBackend()
+  explicit Sensor(std::unique_ptr<SensorBackend> backend);
   ~Sensor();
 
-  // iniciar / cerrar sensor
+  // iniciar / cerrar sensor. initSensor abre todos los lectores conectados
+  // (hasta setMaxDevices); falla solo si no pudo abrir ninguno
   bool initSensor();
   bool closeSensor();
 
+  // tope de lectores a abrir en initSensor (0 = SENSOR_DEVICES_ENV o todos
+  // hasta MAX_SENSOR_DEVICES). No cambia un sensor ya iniciado
+  void setMaxDevices(unsigned int devices);
+
+  // lectores abiertos y el indice del SDK de cada uno
+  unsigned int getDeviceCount() const;
+  int getDeviceIndex(unsigned int position) const;
+
+  // salud de un lector segun el watchdog. false si no existe
+  bool getDeviceStatus(unsigned int position, DeviceStatus &out) const;
+
+  // cada cuanto el watchdog revisa los lectores (0 = sin watchdog). Se fija
+  // antes de initSensor
+  void setWatchdogIntervalMs(int ms);
+
 private:
   // variables del driver
+  std::unique_ptr<SensorBackend> m_backend;
   int m_timeoutMs;
   int m_pollIntervalMs;
-  HANDLE m_deviceHandle;
-  HANDLE m_dbCacheHandle;
-  std::vector<unsigned char> m_imageBuffer;
-  int m_imageWidth;
-  int m_imageHeight;
+  ShardedCache m_cache;  // cache 1:N repartida en shards (y DBMatch)
+  unsigned int m_shardCount; // 0 = automatico
   bool m_isInitialized;
 
+  // un lector abierto. Cada uno tiene su hilo de captura (dueño del lector
+  // mientras corre), su cola y su hilo de identificacion; la cache 1:N es
+  // una sola para todos
+  struct Device {
+    int index;    // indice del SDK (ZKFPM_OpenDevice), va al id_terminal
+    // handle e imagen: los usa quien captura y los cambia el watchdog al
+    // reabrir el lector
+    std::mutex handleMutex;
+    void *handle; // nullptr mientras esta caido
+    std::vector<unsigned char> imageBuffer;
+    int imageWidth;
+    int imageHeight;
+    std::thread captureThread;
+    TemplateQueue<CAPTURE_QUEUE_SIZE, MAX_TEMPLATE_SIZE> captureQueue;
+    std::thread pipelineThread;
+    IdentifyResult results[PIPELINE_RESULT_SLOTS]; // bajo m_pipelineMutex
+    unsigned int resultHead; // el mas viejo
+    unsigned int resultCount;
+    // salud (ver DeviceStatus)
+    std::atomic<int> state;
+    std::atomic<unsigned int> errors;
+    std::atomic<unsigned int> reconnects;
+    std::atomic<int> lastError;
+  };
+  std::vector<std::unique_ptr<Device>> m_devices; // fijo entre init y close
+  unsigned int m_maxDevices; // 0 = automatico
+
+  // captura continua
+  std::atomic<bool> m_captureRunning;
+  int m_captureIdleMs;
+  bool m_requireLift; // exigir levantar el dedo entre capturas
+  std::mutex m_readyMutex;    // solo para dormir/despertar consumidores
+  std::condition_variable m_readyCv;
+  // las colas son SPSC: un consumidor a la vez (tambien protege la ronda)
+  std::mutex m_consumerMutex;
+  unsigned int m_nextDevice; // cola por la que empieza la proxima ronda
+  // quienes piden el template crudo (waitTemplate, enrolamiento): mientras
+  // haya alguno el pipeline no saca capturas de la cola
+  std::atomic<int> m_directConsumers;
+
+  // pipeline de identificacion: el hilo de captura adquiere (etapa 1), el
+  // hilo de identificacion de cada lector identifica (etapa 2) y deja el
+  // resultado en los results del lector para Go (etapa 3). Asi el lector ya
+  // esta armado para el siguiente alumno mientras se identifica o se entrega
+  // el ticket del anterior
+  std::atomic<bool> m_pipelineRunning;
+  std::mutex m_pipelineMutex; // grupo y resultados
+  std::condition_variable m_resultCv;
+  std::string m_pipelineGroup;
+
+  // archivo de templates para la carga masiva al arrancar. TemplateArena no
+  // es thread-safe: todo acceso pasa por m_arenaMutex
+  TemplateArena m_arena;
+  mutable std::mutex m_arenaMutex;
+
+  // grupos de candidatos (ej: "racion:1"): una cache del SDK chica por grupo
+  // que se revisa antes que la cache completa
+  struct Group {
+    Group() : handle(nullptr), templates(0) {}
+    void *handle;
+    unsigned int templates;
+    // el dbIdentify sobre handle: como en los shards, una llamada a la vez
+    std::mutex lock;
+  };
+  std::map<std::string, Group> m_groups;
+  // buscar un grupo para identificar lo toma compartido; cargar, sumar o
+  // borrar, exclusivo
+  mutable std::shared_timed_mutex m_groupsMutex;
+
+  void freeGroups();
+  void removeFromGroups(unsigned int fid);
+
+  // histogramas y contadores (se escriben sin locks desde cualquier hilo)
+  SensorMetrics m_metrics;
+
+  // eventos al totem por WebSocket (dedo apoyado, identificando, ...)
+  SensorEvents m_events;
+
+  // diario de raciones: el registro de cada racion aprobada llega a disco
+  // aca antes que a SQLite (se protege solo, ver RationJournal.h)
+  RationJournal m_journal;
+
+  // watchdog: un hilo que revisa la salud de los lectores y reabre los que
+  // se cayeron (sin tocar la cache 1:N ni los grupos)
+  std::thread m_watchdogThread;
+  std::mutex m_watchdogMutex;
+  std::condition_variable m_watchdogCv;
+  bool m_watchdogRunning; // bajo m_watchdogMutex
+  bool m_watchdogWake;    // un lector se acaba de caer: revisar ya
+  int m_watchdogIntervalMs;
+
+  void startWatchdog();
+  void stopWatchdog();
+  void watchdogLoop();
+  // una revision: lectores caidos y cambios en la cantidad de conectados
+  void checkReaders(int &connected);
+  // dar un lector por caido (una sola vez hasta que se reabra)
+  void markFailed(Device &device, int error);
+  // cerrar y volver a abrir el lector con el mismo indice del SDK
+  bool reopenReader(Device &device);
+
+  // abrir el lector index del SDK y sumarlo a m_devices
+  bool openReader(int index);
+  void closeReaders();
+
+  // una llamada al SDK para capturar, con sus metricas
+  int acquireTemplate(Device &device, unsigned char *out, unsigned int *size);
+
+  // una captura en cada lector (o solo en device >= 0) hasta que uno traiga
+  // dedo. Devuelve el codigo del SDK (el del ultimo lector si ninguno tuvo
+  // dedo); en fromDevice queda el indice del lector
+  int acquireAny(unsigned char *out, unsigned int *size, int device,
+                 int *fromDevice);
+
+  // 1:N en la cache completa, sin metricas (devuelve el codigo del SDK)
+  int identifyAll(TemplateView templateData, int &userId, int &score);
+  void recordIdentify(unsigned long long us, int ret, bool inGroup);
+
+  // cuerpo del hilo de captura de un lector
+  void captureLoop(Device *device);
+
+  // sacar la siguiente captura fresca de las colas (en ronda, o solo la de
+  // device >= 0), descartando las viejas. Con m_consumerMutex tomado
+  bool popCapture(unsigned char *out, unsigned int &size,
+                  long long &capturedMs, int device, int *fromDevice);
+  bool queuesEmpty(int device) const;
+
+  // waitTemplate de un lector (device = -1: cualquiera)
+  bool waitCapture(unsigned char *out, unsigned int &size, int timeoutMs,
+                   int device, int *fromDevice);
+
+  // cuerpo del hilo de identificacion de un lector (etapa 2 del pipeline)
+  void pipelineLoop(Device *device);
+  void pushResult(Device &device, const IdentifyResult &result);
+  // 1:N de una captura (grupo primero si hay) y, si acerto fuera del grupo,
+  // sumar al alumno al grupo para la proxima vez
+  void identifyCapture(const std::string &group, TemplateView probe,
+                       IdentifyResult &result);
+
+  // polling directo a los lectores hasta timeoutMs (sin hilo de captura)
+  bool pollTemplate(unsigned char *out, unsigned int &size, int timeoutMs,
+                    int device, int *fromDevice);
+
+  // sin hilo de captura: esperar hasta timeoutMs a que el lector quede vacio
+  bool waitFingerLift(int timeoutMs, int device);
+
+  // cuerpo de enrollTemplate (sin metricas)
+  bool enrollSamples(unsigned char *out, unsigned int &size, int timeoutMs,
+                     int minScore, EnrollResult &result);
+
 public:
   //====Proceso de captura====
 
@@ -45,6 +291,56 @@ public:
   // Intentar capturar huella inmediatamente (Non-blocking)
   bool captureTemplateImmediate(std::vector<unsigned char> &templateData);
 
+  // igual, pero escribe directo en el buffer del llamador.
+  // Entrada size = capacidad de out, salida = bytes del template
+  bool captureTemplateImmediate(unsigned char *out, unsigned int &size);
+
+  //====Captura continua (event-driven)====
+
+  // lanzar / detener los hilos que capturan y encolan templates (uno por
+  // lector)
+  bool startCaptureLoop();
+  void stopCaptureLoop();
+  bool isCaptureLoopRunning() const;
+
+  // esperar hasta timeoutMs por el siguiente template capturado en
+  // cualquier lector (0 = no esperar). Sin hilo de captura, hace polling
+  // directo
+  bool waitTemplate(std::vector<unsigned char> &templateData, int timeoutMs);
+  bool waitTemplate(unsigned char *out, unsigned int &size, int timeoutMs);
+
+  // pausa del hilo sin dedo y si se exige levantar el dedo entre capturas
+  void setCaptureIdleMs(int ms);
+  void setRequireLift(bool requireLift);
+
+  //====Pipeline de identificacion====
+
+  // lanzar / detener el hilo que identifica cada captura apenas llega.
+  // Necesita el hilo de captura corriendo
+  bool startIdentifyPipeline();
+  void stopIdentifyPipeline();
+  bool isIdentifyPipelineRunning() const;
+
+  // esperar hasta timeoutMs por la siguiente huella ya identificada del
+  // lector device (-1 = de cualquiera, la mas vieja primero). group es el
+  // grupo de candidatos a revisar primero ("" = toda la cache) y queda fijo
+  // para las capturas siguientes. Lanza el pipeline si hace falta; sin hilo
+  // de captura captura e identifica aca mismo. Devuelve PIPELINE_*
+  int waitIdentify(const std::string &group, int device, int timeoutMs,
+                   IdentifyResult &result);
+
+  //====Enrolamiento====
+
+  // tomar ENROLL_SAMPLES capturas del mismo dedo (levantandolo entre una y
+  // otra), exigir que cada par tenga al menos minScore (0 = ENROLL_MIN_SCORE)
+  // y fusionarlas con el SDK en un solo template de registro. Cada captura
+  // espera hasta timeoutMs. En result quedan el estado, los scores y la
+  // calidad aunque falle. size: entra la capacidad de out, sale el tamaño
+  bool enrollTemplate(unsigned char *out, unsigned int &size, int timeoutMs,
+                      int minScore, EnrollResult &result);
+  bool enrollTemplate(std::vector<unsigned char> &templateData, int timeoutMs,
+                      int minScore, EnrollResult &result);
+
   //===funciones de obtencion====
 
   // obtener el tamaño del template
@@ -68,24 +364,157 @@ public:
   // obtener el handle de la base de datos
   void *getDbCacheHandle() const;
 
+  // obtener el backend (ZKTeco o reproduccion)
+  SensorBackend *getBackend() const;
+
   // obtener el buffer de imagen
   const std::vector<unsigned char> &getImageBuffer() const;
 
   // obtener el tamaño del buffer de imagen
   size_t getImageBufferSize() const;
 
+  // (los templates se reciben como TemplateView: sirve un std::vector o un
+  // puntero + largo ajeno, sin copiar)
+
   // obtener datos la base de datos en el sensor
-  bool DBAdd(const std::vector<unsigned char> &templateData, int userId);
+  bool DBAdd(TemplateView templateData, int userId);
+
+  // agregar count templates de una vez: el i-esimo va de blob[offsets[i]] a
+  // blob[offsets[i + 1]] con el id ids[i]. En results[i] queda el codigo del
+  // SDK de cada uno (ZKFP_ERR_OK = agregado). Sin logs por template.
+  // Devuelve cuantos se agregaron, o -1 si el sensor no esta listo
+  int dbAddBatch(const int *ids, const unsigned char *blob,
+                 const unsigned int *offsets, unsigned int count,
+                 int *results);
+
+  // quitar un id de la cache (y de los grupos). false si no estaba
+  bool dbRemove(int userId);
+
+  // cambiar el template de un id (lo agrega si no estaba). El id sale de los
+  // grupos: vuelve a entrar cuando se lo identifique ampliando la busqueda.
+  // false si el template nuevo no entro: el id ya no esta en la cache
+  bool dbReplace(TemplateView templateData, int userId);
+
+  // vaciar la cache completa y los grupos (para recargar sin reiniciar)
+  bool dbClear();
+
+  // templates en la cache, o -1 si hubo error
+  int dbCount();
 
   // identificar huella en la base de datos en el sensor
-  bool DBIdentify(const std::vector<unsigned char> &templateData, int &userId,
-                  int &score);
+  bool DBIdentify(TemplateView templateData, int &userId, int &score);
+
+  //====Shards de la cache 1:N====
+
+  // cantidad de shards a crear en initSensor (0 = SENSOR_SHARDS_ENV o uno
+  // por nucleo hasta DEFAULT_MAX_DB_SHARDS). No cambia un sensor ya iniciado
+  void setShardCount(unsigned int shards);
+  unsigned int getShardCount() const;
+
+  // tiempos de identificacion por shard
+  void getShardStats(std::vector<ShardStats> &out) const;
+
+  //====Grupos de candidatos====
+
+  // reemplazar el contenido de un grupo con un lote (mismo formato que
+  // dbAddBatch). Los ids deben ser los mismos de la cache completa.
+  // Devuelve cuantos quedaron en el grupo, o -1 si hubo error
+  int groupLoad(const std::string &group, const int *ids,
+                const unsigned char *blob, const unsigned int *offsets,
+                unsigned int count);
+
+  // sumar un template a un grupo (lo crea si no existe)
+  bool groupAdd(const std::string &group, int userId,
+                TemplateView templateData);
+
+  // borrar un grupo completo
+  void groupClear(const std::string &group);
+
+  // cantidad de templates de un grupo (0 si no existe)
+  unsigned int groupSize(const std::string &group) const;
+
+  // identificar buscando primero en el grupo y, si no esta ahi, en toda la
+  // cache. inGroup indica si el acierto vino del grupo
+  bool DBIdentifyGroup(const std::string &group, TemplateView templateData,
+                       int &userId, int &score, bool &inGroup);
+
+  //====Arena de templates (carga en frio)====
+
+  // abrir (o crear) el archivo de templates. Devuelve la cantidad de
+  // templates vivos, o -1 si no se pudo abrir
+  int openArena(const std::string &path);
+
+  // cargar todos los templates de la arena en la cache 1:N en una pasada y
+  // soltar el mapeo. Devuelve cuantos se cargaron, o -1 si hubo error
+  int loadArena();
+
+  // registrar / reemplazar el template de un run en la arena
+  bool arenaPut(const std::string &run, int fid, TemplateView templateData);
+
+  // dar de baja un run en la arena
+  bool arenaRemove(const std::string &run);
+
+  // igual que arenaPut, para un lote completo (un solo flush del archivo)
+  int arenaPutMany(const std::vector<TemplateArena::Entry> &entradas);
+
+  // vaciar la arena (no toca la cache 1:N)
+  bool resetArena();
+
+  // estado de la arena y el mapeo run -> fid de los vivos (en entradas solo
+  // quedan fid y run)
+  bool isArenaOpen() const;
+  unsigned long long arenaLiveBytes() const;
+  unsigned long long arenaLiveChecksum() const;
+  void arenaMapping(std::vector<TemplateArena::Entry> &entradas) const;
+
+  // acceso directo, sin m_arenaMutex: solo con nadie mas usando el sensor
+  const TemplateArena &getArena() const;
+
+  //====Eventos al totem====
+
+  // levantar / bajar el servidor WebSocket de eventos (port 0 =
+  // EVENTS_PORT_ENV o EVENTS_DEFAULT_PORT). Devuelve el puerto, o -1 si no
+  // se levanto. Con el servidor arriba, los hilos de captura y de
+  // identificacion publican finger_detected y processing
+  int startEvents(unsigned short port);
+  void stopEvents();
+
+  // publicar un frame JSON ya armado (approved / rejected los arma Go)
+  void publishEvent(const std::string &json);
+
+  // totems conectados al servidor de eventos
+  unsigned int getEventClients() const;
+
+  //====Diario de raciones====
+
+  // abrir (o crear) el diario. Devuelve cuantas raciones quedaron sin pasar
+  // a SQLite (despues de una caida), o -1 si no se pudo abrir
+  long long openJournal(const std::string &path);
+  void closeJournal();
+
+  // agregar, esperar el disco, leer pendientes y confirmar van directo al
+  // diario, que tiene su propio lock
+  RationJournal &getJournal();
+
+  //====Metricas====
+
+  // foto de los histogramas y contadores / ponerlos en cero
+  void getMetrics(MetricsSnapshot &out) const;
+  void resetMetrics();
 
   //====Funciones de comparacion====
 
   // comparar dos templates y retornar el score de coincidencia
-  int matchTemplate(const std::vector<unsigned char> &template1,
-                    const std::vector<unsigned char> &template2);
+  int matchTemplate(TemplateView template1, TemplateView template2);
+
+  // comparar un probe contra count templates empaquetados en blob: el
+  // template i ocupa blob[offsets[i]] .. blob[offsets[i + 1]] (offsets tiene
+  // count + 1 entradas). Deja en results los topK mejores, ordenados de mayor
+  // a menor score. Si stopScore > 0 corta apenas un score lo alcanza.
+  // Devuelve cuantos resultados se escribieron, o -1 si hubo error
+  int matchMany(TemplateView probe, const unsigned char *blob,
+                const unsigned int *offsets, unsigned int count,
+                MatchResult *results, unsigned int topK, int stopScore);
 
   // obtener la última imagen capturada (para debug / mostrar huella en
   // pantalla)
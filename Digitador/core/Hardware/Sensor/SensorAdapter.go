@@ -5,8 +5,9 @@
 package digitador
 
 /*
-#cgo CXXFLAGS: -std=c++11
-#cgo LDFLAGS: -L${SRCDIR}/x64lib -llibzkfp
+#cgo CXXFLAGS: -std=c++17 -I${SRCDIR}/include
+#cgo windows LDFLAGS: -L${SRCDIR}/x64lib -llibzkfp -lws2_32 -lmswsock
+#cgo linux LDFLAGS: -lpthread
 #include "SensorBridge.h"
 #include <stdlib.h>
 */
@@ -26,11 +27,102 @@ import (
 // creamos la clase sensorAdapter para poder usar los metodos del sensor en go
 type SensorAdapter struct {
 	handle C.SensorHandle
-	mu     sync.Mutex
+	// C++ se protege solo (lectores, cache 1:N, grupos y arena con sus propios
+	// locks): ids cuida unicamente los mapas de abajo y nunca se tiene tomado
+	// durante una llamada a C++
+	ids sync.RWMutex
 	// Map to convert C-Int-IDs back to Go-String-RunIDs for 1:N mode
 	idToRunID map[int]string
 	runIDToID map[string]int
 	nextID    int
+	// sube con cada cambio de los mapas: quien guarda datos por id sabe que
+	// un RUN pudo cambiar de id (baja y alta, recarga completa)
+	generacion uint64
+	// los ultimos cambios de id, uno por generacion desde primerCambio + 1:
+	// quien guarda datos por id mueve solo esos en vez de rearmar todo
+	cambios      []CambioID
+	primerCambio uint64
+}
+
+// CambioID es un RUN que cambio de id en la cache 1:N (-1 = sin id)
+type CambioID struct {
+	RunID    string
+	Anterior int
+	Nuevo    int
+}
+
+// cambios de id que se guardan: mas que eso (una carga masiva) y conviene
+// rearmar todo
+const maxCambiosIDs = 1024
+
+// anotarCambio sube la generacion y guarda el cambio. Con ids tomado
+func (s *SensorAdapter) anotarCambio(runID string, anterior, nuevo int) {
+	s.generacion++
+	if len(s.cambios) == maxCambiosIDs {
+		// se descarta la mitad mas vieja
+		mitad := maxCambiosIDs / 2
+		s.cambios = append(s.cambios[:0], s.cambios[mitad:]...)
+		s.primerCambio += uint64(mitad)
+	}
+	s.cambios = append(s.cambios, CambioID{RunID: runID, Anterior: anterior, Nuevo: nuevo})
+}
+
+// runDeID traduce el id entero de la cache de C++ al RUN
+func (s *SensorAdapter) runDeID(id int) (string, bool) {
+	s.ids.RLock()
+	defer s.ids.RUnlock()
+	runID, ok := s.idToRunID[id]
+	return runID, ok
+}
+
+// FidDeRun devuelve el id denso del RUN en la cache 1:N (el que entrega
+// EsperarIdentificacion en Identificacion.Fid)
+func (s *SensorAdapter) FidDeRun(runID string) (int, bool) {
+	s.ids.RLock()
+	defer s.ids.RUnlock()
+	id, ok := s.runIDToID[runID]
+	return id, ok
+}
+
+// FidsDeRuns es FidDeRun para muchos RUN con un solo lock (-1 = sin id)
+func (s *SensorAdapter) FidsDeRuns(runs []string) []int {
+	fids := make([]int, len(runs))
+	s.ids.RLock()
+	defer s.ids.RUnlock()
+	for i, runID := range runs {
+		id, ok := s.runIDToID[runID]
+		if !ok {
+			id = -1
+		}
+		fids[i] = id
+	}
+	return fids
+}
+
+// GeneracionIDs cambia cada vez que cambia el mapeo RUN <-> id. Mientras no
+// cambie, los ids que se leyeron antes siguen siendo de los mismos RUN
+func (s *SensorAdapter) GeneracionIDs() uint64 {
+	s.ids.RLock()
+	defer s.ids.RUnlock()
+	return s.generacion
+}
+
+// CambiosIDsDesde devuelve los cambios de id posteriores a generacion (una
+// que devolvio GeneracionIDs o esta misma funcion) y la generacion actual.
+// ok = false si ya no estan todos (muchos cambios o una recarga completa):
+// hay que rearmar con FidsDeRuns
+func (s *SensorAdapter) CambiosIDsDesde(generacion uint64) ([]CambioID, uint64, bool) {
+	s.ids.RLock()
+	defer s.ids.RUnlock()
+	if generacion == s.generacion {
+		return nil, generacion, true
+	}
+	if generacion < s.primerCambio || generacion > s.generacion {
+		return nil, s.generacion, false
+	}
+	cambios := make([]CambioID, s.generacion-generacion)
+	copy(cambios, s.cambios[generacion-s.primerCambio:])
+	return cambios, s.generacion, true
 }
 
 // sensor falso para pruebas rapidas
@@ -45,7 +137,21 @@ func SensorFalso() (*SensorAdapter, error) {
 // creamos sensorGo para poder usar los metodos del sensor.cpp en go
 func SensorGO() (*SensorAdapter, error) {
 	// Llamamos a la función createSensor de C++ que nos devuelve un puntero void
-	handle := C.CreateSensor()
+	// (backend ZKTeco en Windows, o reproduccion si DIGITADOR_SENSOR_REPLAY existe)
+	return iniciarHandle(C.CreateSensor())
+}
+
+// SensorReplay crea un sensor con el backend de reproduccion de C++: entrega las
+// capturas grabadas en dir (ver ReplayBackend.h) o templates sinteticos si dir
+// es "". Permite correr y medir el flujo completo en Linux sin el huellero.
+func SensorReplay(dir string) (*SensorAdapter, error) {
+	cDir := C.CString(dir)
+	defer C.free(unsafe.Pointer(cDir))
+	return iniciarHandle(C.CreateSensorReplay(cDir))
+}
+
+// iniciarHandle inicializa un sensor recien creado en C++ y lo envuelve
+func iniciarHandle(handle C.SensorHandle) (*SensorAdapter, error) {
 	//se pudo crear la instancia del sensor?
 	if handle == nil {
 		//no, entonces devolvemos error
@@ -61,6 +167,12 @@ func SensorGO() (*SensorAdapter, error) {
 		return nil, errors.New("(-) [GO]:falló la inicialización del hardware del sensor")
 	}
 
+	// Lanzamos el hilo de captura continua en C++: desde ahora las capturas
+	// esperan en una cola en vez de hacer polling desde Go
+	if C.StartCaptureLoop(handle) == 0 {
+		fmt.Println("(!) [GO]: no se pudo iniciar la captura continua, se usara polling")
+	}
+
 	//si, entonces devolvemos el sensor y el tipo sensorAdapter
 	fmt.Println("(+)[GO]: Sensor inicializado correctamente")
 	return &SensorAdapter{
@@ -78,33 +190,50 @@ func SensorGO() (*SensorAdapter, error) {
 // creamos un destructor para el sensor
 func (s *SensorAdapter) Cerrar() {
 	if s.handle != nil {
+		// detenemos el hilo de captura antes de liberar el sensor
+		C.StopCaptureLoop(s.handle)
 		C.DestroySensor(s.handle)
 		s.handle = nil
 		fmt.Println("(+) [Go] Sensor cerrado y memoria liberada")
 	}
 }
 
-// protocolo de intentos para capturar la huella 10 intentos
+// esperamos la siguiente huella hasta timeout. El hilo de captura de C++ nos
+// despierta apenas el SDK entrega el template (sin dormir en Go)
 func (s *SensorAdapter) CapturarHuellaTimeout(timeout time.Duration) ([]byte, error) {
-	deadline := time.Now().Add(timeout)
+	//sensor esta inicializado?
+	if s.handle == nil {
+		return nil, errors.New("(-) [GO]:el sensor no está inicializado")
+	}
 
-	for time.Now().Before(deadline) {
-		// CapturarHuella ya está en este mismo paquete, llama a C.AcquireFingerprint (inmediato)
-		plantilla, err := s.CapturarHuella()
-		if err == nil {
-			return plantilla, nil
-		}
-		time.Sleep(100 * time.Millisecond)
+	// la espera puede durar segundos y no frena al 1:N: la cola de C++ ya
+	// serializa a los que esperan
+	bufferSize := 2048
+	outBuffer := make([]byte, bufferSize)
+	// entra la capacidad del buffer, C++ escribe directo en outBuffer
+	var actualSize C.int = C.int(bufferSize)
+
+	resultado := C.WaitFingerprint(
+		s.handle,
+		(*C.uchar)(unsafe.Pointer(&outBuffer[0])),
+		&actualSize,
+		C.int(timeout.Milliseconds()),
+	)
+	if resultado == 0 {
+		return nil, errors.New("(-) [GO]: no se detectó ningún dedo o hubo un error al capturar")
+	}
+
+	//el tamaño es muy grande o muy pequeño?
+	if int(actualSize) > bufferSize || int(actualSize) < 0 {
+		return nil, errors.New("(-) [GO]: el tamaño de la plantilla es inválido")
 	}
-	return nil, errors.New("(-) [GO]: no se detectó ningún dedo o hubo un error al capturar")
+	return outBuffer[:int(actualSize)], nil
 }
 
 // creamos una adaptacion de la funcion AquireFingerprint en go
 func (s *SensorAdapter) CapturarHuella() ([]byte, error) {
 
-	//para no saturar el huellero de gorutines posteriormente
-	s.mu.Lock()
-	defer s.mu.Unlock()
+	// sin lock en Go: C++ serializa el acceso a cada lector
 
 	//sensor esta inicializado?
 	if s.handle == nil {
@@ -117,8 +246,9 @@ func (s *SensorAdapter) CapturarHuella() ([]byte, error) {
 	bufferSize := 2048
 	outBuffer := make([]byte, bufferSize)
 
-	// Variable para guardar el tamaño real que devuelva C++
-	var actualSize C.int = 0
+	// Entra la capacidad del buffer y sale el tamaño real que devuelva C++
+	// (el SDK escribe directo en outBuffer, sin copias intermedias)
+	var actualSize C.int = C.int(bufferSize)
 
 	// Llamamos a C, convirtiendo nuestro bloque de Go en el tipo de dato que pide C
 	resultado := C.AcquireFingerprint(
@@ -152,6 +282,75 @@ func (s *SensorAdapter) CapturarHuella() ([]byte, error) {
 	return plantillaFinal, nil
 }
 
+// ResultadoEnrolamiento es el detalle de un enrolamiento con tres capturas.
+// Calidad es el peor score 1:1 entre las capturas (0..100): mientras mas alto,
+// mas parecidas fueron y menos reintentos va a tener el alumno en el totem
+type ResultadoEnrolamiento struct {
+	Plantilla []byte `json:"-"`
+	Calidad   int    `json:"calidad"`
+	Scores    []int  `json:"scores"`   // 1-0, 2-0, 2-1 (-1 = sin comparar)
+	Capturas  int    `json:"capturas"` // capturas tomadas
+}
+
+// errores de EnrolarHuella, para que la interfaz le diga al operador que hacer
+var (
+	ErrEnrolamientoTimeout   = errors.New("(-) [GO]: no se completaron las capturas de la huella a tiempo")
+	ErrHuellasInconsistentes = errors.New("(-) [GO]: las capturas no parecen del mismo dedo, repita el enrolamiento")
+)
+
+// EnrolarHuella pide tres veces el mismo dedo (levantandolo entre capturas),
+// verifica que las tres se parezcan (score 1:1 >= scoreMinimo, 0 = el de C++)
+// y las fusiona con el SDK en un solo template de registro. espera es el
+// tiempo maximo por captura. El resultado viene aunque haya error, con las
+// capturas tomadas y sus scores
+func (s *SensorAdapter) EnrolarHuella(espera time.Duration, scoreMinimo int) (*ResultadoEnrolamiento, error) {
+	if s.handle == nil {
+		return nil, errors.New("(-) [GO]:el sensor no está inicializado")
+	}
+
+	// igual que CapturarHuellaTimeout: son varios segundos de espera
+	bufferSize := 2048
+	outBuffer := make([]byte, bufferSize)
+	var actualSize C.int = C.int(bufferSize)
+	var scores [3]C.int
+	var calidad, capturas C.int
+
+	estado := C.EnrollFingerprint(
+		s.handle,
+		(*C.uchar)(unsafe.Pointer(&outBuffer[0])),
+		&actualSize,
+		C.int(espera.Milliseconds()),
+		C.int(scoreMinimo),
+		&scores[0],
+		&calidad,
+		&capturas,
+	)
+
+	resultado := &ResultadoEnrolamiento{
+		Calidad:  int(calidad),
+		Scores:   []int{int(scores[0]), int(scores[1]), int(scores[2])},
+		Capturas: int(capturas),
+	}
+
+	switch estado {
+	case 0:
+	case -1:
+		return resultado, ErrEnrolamientoTimeout
+	case -2:
+		return resultado, ErrHuellasInconsistentes
+	case -3:
+		return resultado, errors.New("(-) [GO]: el SDK no pudo fusionar las capturas")
+	default:
+		return resultado, errors.New("(-) [GO]: el sensor no está listo para enrolar")
+	}
+
+	if int(actualSize) > bufferSize || int(actualSize) <= 0 {
+		return resultado, errors.New("(-) [GO]: el tamaño de la plantilla es inválido")
+	}
+	resultado.Plantilla = outBuffer[:int(actualSize)]
+	return resultado, nil
+}
+
 // creamos funcion CompararHuellas para comparar plantilla1 con plantilla2
 func (s *SensorAdapter) CompararHuellas(plantilla1 []byte, plantilla2 []byte) (int, error) {
 	//sensor esta inicializado?
@@ -186,45 +385,375 @@ func (s *SensorAdapter) CompararHuellas(plantilla1 []byte, plantilla2 []byte) (i
 	return int(score), nil
 }
 
+// Coincidencia es un resultado de CompararHuellasLote: posicion del template en
+// el lote y su score
+type Coincidencia struct {
+	Indice int
+	Score  int
+}
+
+// CompararHuellasLote compara la plantilla contra todo el lote en una sola
+// llamada a C++ (en vez de un CompararHuellas por template). Devuelve los topK
+// mejores ordenados de mayor a menor score; si umbralCorte > 0, C++ deja de
+// comparar apenas un template lo alcanza. Los templates corruptos se ignoran.
+func (s *SensorAdapter) CompararHuellasLote(plantilla []byte, lote [][]byte, topK int, umbralCorte int) ([]Coincidencia, error) {
+	//sensor esta inicializado?
+	if s.handle == nil {
+		return nil, errors.New("(-) [GO]:el sensor no está inicializado")
+	}
+	//plantilla posee datos?
+	if len(plantilla) == 0 {
+		return nil, errors.New("(-) [GO]: la plantilla no posee datos")
+	}
+	if len(lote) == 0 || topK <= 0 {
+		return nil, nil
+	}
+
+	// empaquetamos el lote en un solo bloque contiguo + tabla de offsets
+	// (len(lote)+1 entradas), asi C++ lee todo sin copiar nada
+	total := 0
+	for _, tpl := range lote {
+		total += len(tpl)
+	}
+	if total == 0 {
+		return nil, nil
+	}
+	blob := make([]byte, 0, total)
+	offsets := make([]C.int, len(lote)+1)
+	for i, tpl := range lote {
+		offsets[i] = C.int(len(blob))
+		blob = append(blob, tpl...)
+	}
+	offsets[len(lote)] = C.int(len(blob))
+
+	if topK > len(lote) {
+		topK = len(lote)
+	}
+	indices := make([]C.int, topK)
+	scores := make([]C.int, topK)
+
+	n := C.MatchTemplatesBatch(
+		s.handle,
+		(*C.uchar)(unsafe.Pointer(&plantilla[0])),
+		C.int(len(plantilla)),
+		(*C.uchar)(unsafe.Pointer(&blob[0])),
+		&offsets[0],
+		C.int(len(lote)),
+		C.int(topK),
+		C.int(umbralCorte),
+		&indices[0],
+		&scores[0],
+	)
+
+	//resultado corrupto?
+	if n < 0 {
+		return nil, errors.New("[GO]: Error al comparar el lote de plantillas")
+	}
+
+	coincidencias := make([]Coincidencia, int(n))
+	for i := range coincidencias {
+		coincidencias[i] = Coincidencia{Indice: int(indices[i]), Score: int(scores[i])}
+	}
+	return coincidencias, nil
+}
+
+// BuscarEnTemplates busca la plantilla en un mapa run -> template (como el de
+// ObtenerTodosTemplates) con una sola comparacion por lote. Devuelve el run y
+// score del mejor candidato; run queda vacio si ninguno llega a umbral.
+func (s *SensorAdapter) BuscarEnTemplates(plantilla []byte, templates map[string][]byte, umbral int) (string, int, error) {
+	runs := make([]string, 0, len(templates))
+	lote := make([][]byte, 0, len(templates))
+	for run, tpl := range templates {
+		runs = append(runs, run)
+		lote = append(lote, tpl)
+	}
+
+	coincidencias, err := s.CompararHuellasLote(plantilla, lote, 1, umbral)
+	if err != nil {
+		return "", 0, err
+	}
+	if len(coincidencias) == 0 || coincidencias[0].Score < umbral {
+		return "", 0, nil
+	}
+	mejor := coincidencias[0]
+	return runs[mejor.Indice], mejor.Score, nil
+}
+
 // -----------------------------------------------------------------------------
 // OPERACIONES 1:N (Para modo Totem Ultra-Rápido)
 // -----------------------------------------------------------------------------
 
 // DBAdd1N agrega una huella al cache del sensor y asigna un id entero mapeado
 func (s *SensorAdapter) DBAdd1N(runID string, plantilla []byte) error {
-	s.mu.Lock()
-	defer s.mu.Unlock()
-
 	if s.handle == nil {
 		return errors.New("(-) [GO]: sensor no inicializado")
 	}
 
-	// Si ya existe, nos saltamos el incremento
+	if len(plantilla) == 0 {
+		return errors.New("(-) [GO]: la plantilla no posee datos")
+	}
+
+	// Si ya existe, nos saltamos el incremento y reemplazamos su template
+	// (el SDK no acepta dos veces el mismo id). Un RUN nuevo reserva su id y
+	// su mapeo antes de entrar al cache, asi nunca se identifica un id sin RUN
+	s.ids.Lock()
 	id, ok := s.runIDToID[runID]
 	if !ok {
 		id = s.nextID
 		s.nextID++
+		s.idToRunID[id] = runID
+		s.runIDToID[runID] = id
+		s.anotarCambio(runID, -1, id)
 	}
+	s.ids.Unlock()
 
 	pTpl := (*C.uchar)(unsafe.Pointer(&plantilla[0]))
-	res := C.DBAdd(s.handle, C.int(id), pTpl, C.int(len(plantilla)))
+	var res C.int
+	if !ok {
+		res = C.DBAdd(s.handle, C.int(id), pTpl, C.int(len(plantilla)))
+	}
+	// un alta fallida puede ser un id duplicado: otra alta del mismo RUN vio
+	// la reserva y entro primero (con DBReplace). Reintentamos como reemplazo,
+	// que si falla deja el id fuera del cache (C++); recien ahi se desmapea
+	if res == 0 {
+		res = C.DBReplace(s.handle, C.int(id), pTpl, C.int(len(plantilla)))
+	}
 
 	if res == 0 {
+		if ok {
+			// sin desmapear, el RUN quedaria sin huella y sin aviso
+			s.descartarID(runID, id)
+			return fmt.Errorf("(-) [GO]: error al reemplazar la huella de %s en la cache del sensor (C++), quedo sin huella en el 1:N", runID)
+		}
+		s.olvidarID(runID, id)
 		return errors.New("(-) [GO]: error al agregar huella a la cache del sensor (C++)")
 	}
 
-	// Guardamos el mapeo para poder reconocer el RUN despues
-	s.idToRunID[id] = runID
-	s.runIDToID[runID] = id
+	// y dejamos el template en la arena para el proximo arranque
+	// (-1 = no hay arena abierta, no es error)
+	cRun := C.CString(runID)
+	defer C.free(unsafe.Pointer(cRun))
+	if C.ArenaPut(s.handle, cRun, C.int(id), pTpl, C.int(len(plantilla))) == 0 {
+		fmt.Printf("(!) [GO]: no se pudo guardar la huella de %s en la arena\n", runID)
+	}
+
+	return nil
+}
+
+// olvidarID deshace la reserva de un id que no alcanzo a entrar al cache.
+// Solo con el id fuera del cache: si no, el 1:N lo entrega sin RUN
+func (s *SensorAdapter) olvidarID(runID string, id int) {
+	s.ids.Lock()
+	defer s.ids.Unlock()
+	if s.runIDToID[runID] == id {
+		delete(s.runIDToID, runID)
+		delete(s.idToRunID, id)
+		s.anotarCambio(runID, id, -1)
+	}
+}
+
+// descartarID desmapea un RUN cuyo template ya no esta en el cache y lo
+// saca de la arena, para que el proximo arranque no lo cargue
+func (s *SensorAdapter) descartarID(runID string, id int) {
+	s.olvidarID(runID, id)
+	cRun := C.CString(runID)
+	defer C.free(unsafe.Pointer(cRun))
+	C.ArenaRemove(s.handle, cRun)
+}
+
+// DBRemove1N saca la huella de un RUN del cache del sensor y de la arena (baja
+// o desactivacion del alumno). Si el RUN no estaba en el cache no hace nada
+func (s *SensorAdapter) DBRemove1N(runID string) error {
+	if s.handle == nil {
+		return errors.New("(-) [GO]: sensor no inicializado")
+	}
+
+	cRun := C.CString(runID)
+	defer C.free(unsafe.Pointer(cRun))
+	if C.ArenaRemove(s.handle, cRun) == 0 {
+		fmt.Printf("(!) [GO]: no se pudo dar de baja %s en la arena\n", runID)
+	}
+
+	s.ids.Lock()
+	id, ok := s.runIDToID[runID]
+	if ok {
+		delete(s.runIDToID, runID)
+		delete(s.idToRunID, id)
+		s.anotarCambio(runID, id, -1)
+	}
+	s.ids.Unlock()
+	if !ok {
+		return nil
+	}
 
+	if C.DBRemove(s.handle, C.int(id)) == 0 {
+		return fmt.Errorf("(-) [GO]: error al quitar %s del cache del sensor (C++)", runID)
+	}
 	return nil
 }
 
+// DBClear1N vacia el cache del sensor, sus grupos y la arena (antes de una
+// recarga completa)
+func (s *SensorAdapter) DBClear1N() error {
+	if s.handle == nil {
+		return errors.New("(-) [GO]: sensor no inicializado")
+	}
+
+	s.ids.Lock()
+	s.idToRunID = make(map[int]string)
+	s.runIDToID = make(map[string]int)
+	// todos cambian: los cambios anteriores ya no alcanzan para seguirlos
+	s.generacion++
+	s.cambios = s.cambios[:0]
+	s.primerCambio = s.generacion
+	s.ids.Unlock()
+	// arena cerrada (-1) no es error: solo se usa en modo totem
+	C.ArenaReset(s.handle)
+
+	if C.DBClear(s.handle) == 0 {
+		return errors.New("(-) [GO]: error al vaciar el cache del sensor (C++)")
+	}
+	return nil
+}
+
+// DBCount1N devuelve cuantas huellas tiene el cache del sensor (-1 si falla)
+func (s *SensorAdapter) DBCount1N() int {
+	if s.handle == nil {
+		return -1
+	}
+	return int(C.DBCount(s.handle))
+}
+
+// loteTemplates empaqueta ids, RUNs (bloques fijos de ARENA_RUN_SIZE) y
+// templates en memoria contigua, como los reciben DBAddBatch y ArenaPutBatch:
+// el i-esimo template va de blob[offsets[i]] a blob[offsets[i+1]]
+type loteTemplates struct {
+	ids     []C.int
+	runs    []string
+	bloque  []byte
+	blob    []byte
+	offsets []C.int
+}
+
+func nuevoLoteTemplates(cantidad, bytes int) *loteTemplates {
+	return &loteTemplates{
+		ids:     make([]C.int, 0, cantidad),
+		runs:    make([]string, 0, cantidad),
+		bloque:  make([]byte, 0, cantidad*C.ARENA_RUN_SIZE),
+		blob:    make([]byte, 0, bytes),
+		offsets: make([]C.int, 1, cantidad+1), // offsets[0] = 0
+	}
+}
+
+func (l *loteTemplates) agregar(id int, run string, tpl []byte) {
+	var bloqueRun [C.ARENA_RUN_SIZE]byte
+	copy(bloqueRun[:], run)
+	l.ids = append(l.ids, C.int(id))
+	l.runs = append(l.runs, run)
+	l.bloque = append(l.bloque, bloqueRun[:]...)
+	l.blob = append(l.blob, tpl...)
+	l.offsets = append(l.offsets, C.int(len(l.blob)))
+}
+
+func (l *loteTemplates) template(i int) []byte {
+	return l.blob[l.offsets[i]:l.offsets[i+1]]
+}
+
+// DBAddLote1N agrega muchas huellas al cache del sensor (y a la arena) con una
+// sola llamada a C++, en vez de un DBAdd1N por alumno. runs[i] es el RUN de
+// plantillas[i]. Devuelve cuantas quedaron en el cache
+func (s *SensorAdapter) DBAddLote1N(runs []string, plantillas [][]byte) (int, error) {
+	if s.handle == nil {
+		return 0, errors.New("(-) [GO]: sensor no inicializado")
+	}
+	if len(runs) != len(plantillas) {
+		return 0, errors.New("(-) [GO]: cantidad de runs y plantillas no coincide")
+	}
+
+	count := 0
+	total := 0
+	for i := range plantillas {
+		if len(plantillas[i]) > 0 && len(runs[i]) < C.ARENA_RUN_SIZE {
+			count++
+			total += len(plantillas[i])
+		}
+	}
+	if count == 0 {
+		return 0, nil
+	}
+
+	// los RUN nuevos reservan id y mapeo antes de entrar al cache (como en
+	// DBAdd1N) y van juntos a DBAddBatch. Los que ya estaban mapeados van por
+	// DBReplace: el SDK rechaza un id repetido y dejaria el template viejo
+	nuevos := nuevoLoteTemplates(count, total)
+	existentes := nuevoLoteTemplates(0, 0)
+	s.ids.Lock()
+	for i, tpl := range plantillas {
+		if len(tpl) == 0 || len(runs[i]) >= C.ARENA_RUN_SIZE {
+			continue
+		}
+		if id, ok := s.runIDToID[runs[i]]; ok {
+			existentes.agregar(id, runs[i], tpl)
+			continue
+		}
+		id := s.nextID
+		s.nextID++
+		s.idToRunID[id] = runs[i]
+		s.runIDToID[runs[i]] = id
+		s.anotarCambio(runs[i], -1, id)
+		nuevos.agregar(id, runs[i], tpl)
+	}
+	s.ids.Unlock()
+
+	// a la arena van solo los que quedaron en el cache
+	arena := nuevoLoteTemplates(count, total)
+
+	if n := len(nuevos.ids); n > 0 {
+		resultados := make([]C.int, n)
+		agregados := C.DBAddBatch(s.handle, &nuevos.ids[0], (*C.uchar)(unsafe.Pointer(&nuevos.blob[0])), &nuevos.offsets[0], C.int(n), &resultados[0])
+		if agregados < 0 {
+			for i, run := range nuevos.runs {
+				s.olvidarID(run, int(nuevos.ids[i]))
+			}
+			return 0, errors.New("(-) [GO]: error al cargar el lote en la cache del sensor (C++)")
+		}
+		for i, run := range nuevos.runs {
+			id := int(nuevos.ids[i])
+			tpl := nuevos.template(i)
+			// un id duplicado (otra alta del mismo RUN entro primero) se
+			// reintenta como reemplazo, igual que en DBAdd1N
+			if resultados[i] != 0 && C.DBReplace(s.handle, C.int(id), (*C.uchar)(unsafe.Pointer(&tpl[0])), C.int(len(tpl))) == 0 {
+				s.olvidarID(run, id)
+				continue
+			}
+			arena.agregar(id, run, tpl)
+		}
+	}
+
+	for i, run := range existentes.runs {
+		id := int(existentes.ids[i])
+		tpl := existentes.template(i)
+		if C.DBReplace(s.handle, C.int(id), (*C.uchar)(unsafe.Pointer(&tpl[0])), C.int(len(tpl))) == 0 {
+			// el id quedo fuera del cache (C++)
+			s.descartarID(run, id)
+			fmt.Printf("(!) [GO]: no se pudo reemplazar la huella de %s, quedo sin huella en el 1:N\n", run)
+			continue
+		}
+		arena.agregar(id, run, tpl)
+	}
+
+	// y lo que entro a la arena para el proximo arranque
+	if n := len(arena.ids); n > 0 {
+		if C.ArenaPutBatch(s.handle, &arena.ids[0], (*C.char)(unsafe.Pointer(&arena.bloque[0])), (*C.uchar)(unsafe.Pointer(&arena.blob[0])), &arena.offsets[0], C.int(n)) == 0 {
+			fmt.Println("(!) [GO]: no se pudo guardar el lote en la arena")
+		}
+	}
+
+	return len(arena.ids), nil
+}
+
 // DBIdentify1N busca una huella en el cache y devuelve directamente el RunID
 func (s *SensorAdapter) DBIdentify1N(plantilla []byte) (string, int, error) {
-	s.mu.Lock()
-	defer s.mu.Unlock()
-
 	if s.handle == nil {
 		return "", 0, errors.New("(-) [GO]: sensor no inicializado")
 	}
@@ -238,10 +767,605 @@ func (s *SensorAdapter) DBIdentify1N(plantilla []byte) (string, int, error) {
 		return "", 0, errors.New("no_match")
 	}
 
-	runID, ok := s.idToRunID[int(cID)]
+	runID, ok := s.runDeID(int(cID))
 	if !ok {
 		return "", 0, errors.New("run_not_mapped")
 	}
 
 	return runID, int(cScore), nil
 }
+
+// CargarGrupo1N reemplaza un grupo de candidatos (ej: "racion:1") con los
+// templates dados. Solo entran RUNs que ya estan en el cache completo (mismo
+// id), el grupo es un atajo para buscar primero. Devuelve cuantos quedaron
+func (s *SensorAdapter) CargarGrupo1N(grupo string, plantillas map[string][]byte) (int, error) {
+	if s.handle == nil {
+		return 0, errors.New("(-) [GO]: sensor no inicializado")
+	}
+
+	ids := make([]C.int, 0, len(plantillas))
+	blob := make([]byte, 0)
+	offsets := make([]C.int, 0, len(plantillas)+1)
+	s.ids.RLock()
+	for run, tpl := range plantillas {
+		id, ok := s.runIDToID[run]
+		if !ok || len(tpl) == 0 {
+			continue
+		}
+		ids = append(ids, C.int(id))
+		offsets = append(offsets, C.int(len(blob)))
+		blob = append(blob, tpl...)
+	}
+	s.ids.RUnlock()
+	offsets = append(offsets, C.int(len(blob)))
+
+	cGrupo := C.CString(grupo)
+	defer C.free(unsafe.Pointer(cGrupo))
+
+	var pIDs *C.int
+	var pBlob *C.uchar
+	if len(ids) > 0 {
+		pIDs = &ids[0]
+		pBlob = (*C.uchar)(unsafe.Pointer(&blob[0]))
+	}
+	n := C.GroupLoad(s.handle, cGrupo, pIDs, pBlob, &offsets[0], C.int(len(ids)))
+	if n < 0 {
+		return 0, fmt.Errorf("(-) [GO]: error al cargar el grupo %s en el sensor", grupo)
+	}
+	return int(n), nil
+}
+
+// DBIdentifyGrupo1N busca la huella primero en el grupo de candidatos y, si no
+// esta ahi, en todo el cache. Devuelve el RunID, el score y si vino del grupo.
+// Un acierto fuera del grupo suma al alumno al grupo para la proxima vez
+func (s *SensorAdapter) DBIdentifyGrupo1N(grupo string, plantilla []byte) (string, int, bool, error) {
+	if s.handle == nil {
+		return "", 0, false, errors.New("(-) [GO]: sensor no inicializado")
+	}
+	if len(plantilla) == 0 {
+		return "", 0, false, errors.New("no_match")
+	}
+
+	cGrupo := C.CString(grupo)
+	defer C.free(unsafe.Pointer(cGrupo))
+
+	var cID, cScore, cEnGrupo C.int
+	pTpl := (*C.uchar)(unsafe.Pointer(&plantilla[0]))
+	res := C.DBIdentifyGroup(s.handle, cGrupo, pTpl, C.int(len(plantilla)), &cID, &cScore, &cEnGrupo)
+	if res == 0 {
+		return "", 0, false, errors.New("no_match")
+	}
+
+	runID, ok := s.runDeID(int(cID))
+	if !ok {
+		return "", 0, false, errors.New("run_not_mapped")
+	}
+
+	if cEnGrupo == 0 {
+		C.GroupAdd(s.handle, cGrupo, cID, pTpl, C.int(len(plantilla)))
+	}
+	return runID, int(cScore), cEnGrupo != 0, nil
+}
+
+// Identificacion es una huella que el pipeline de C++ ya capturo e identifico
+type Identificacion struct {
+	RunID string
+	// id denso del RUN en la cache 1:N (ver FidDeRun)
+	Fid     int
+	Score   int
+	EnGrupo bool
+	// indice del lector que capturo (0 = primer lector conectado)
+	Lector int
+	// desde que se apoyo el dedo hasta que Go recibio el resultado
+	Espera time.Duration
+	// lo que tardo el 1:N (grupo + ampliacion)
+	Busqueda time.Duration
+}
+
+// ErrSinHuella indica que nadie apoyo el dedo dentro de la espera
+var ErrSinHuella = errors.New("(-) [GO]: no se detectó ningún dedo a tiempo")
+
+// EsperarIdentificacion espera la siguiente huella ya identificada. En C++ el
+// hilo de captura deja cada huella en una cola y otro hilo la identifica
+// (primero en el grupo, despues en todo el cache) apenas llega, asi que el
+// lector ya esta esperando al siguiente alumno mientras Go registra y emite el
+// ticket del anterior. grupo queda fijo para las capturas siguientes.
+// lector elige de que lector tomar la huella (-1 = el primero que tenga una).
+// Devuelve ErrSinHuella si no hubo dedo y "no_match" si no esta registrado
+func (s *SensorAdapter) EsperarIdentificacion(grupo string, lector int, espera time.Duration) (*Identificacion, error) {
+	if s.handle == nil {
+		return nil, errors.New("(-) [GO]: sensor no inicializado")
+	}
+
+	cGrupo := C.CString(grupo)
+	defer C.free(unsafe.Pointer(cGrupo))
+
+	// sin locks mientras esperamos, igual que CapturarHuellaTimeout
+	var cID, cScore, cEnGrupo, cLector C.int
+	var cHaceMs, cBusquedaUs C.longlong
+	estado := C.WaitIdentify(s.handle, cGrupo, C.int(lector), C.int(espera.Milliseconds()),
+		&cID, &cScore, &cEnGrupo, &cLector, &cHaceMs, &cBusquedaUs)
+	switch estado {
+	case 1:
+	case 0:
+		return nil, errors.New("no_match")
+	case -1:
+		return nil, ErrSinHuella
+	default:
+		return nil, errors.New("(-) [GO]: sensor no inicializado")
+	}
+
+	runID, ok := s.runDeID(int(cID))
+	if !ok {
+		return nil, errors.New("run_not_mapped")
+	}
+	return &Identificacion{
+		RunID:    runID,
+		Fid:      int(cID),
+		Score:    int(cScore),
+		EnGrupo:  cEnGrupo != 0,
+		Lector:   int(cLector),
+		Espera:   time.Duration(cHaceMs) * time.Millisecond,
+		Busqueda: time.Duration(cBusquedaUs) * time.Microsecond,
+	}, nil
+}
+
+// EstadoLector es la salud de un lector segun el watchdog de C++, que reabre
+// solo los lectores que se desconectan (sin recargar la cache 1:N)
+type EstadoLector struct {
+	Indice       int  `json:"indice"`
+	Conectado    bool `json:"conectado"`
+	Errores      int  `json:"errores"`
+	Reconexiones int  `json:"reconexiones"`
+	UltimoError  int  `json:"ultimo_error"`
+}
+
+// Lectores devuelve el estado de cada lector abierto, en el orden en que se
+// conectaron. El Indice es el que llega en Identificacion.Lector
+func (s *SensorAdapter) Lectores() []EstadoLector {
+	if s.handle == nil {
+		return nil
+	}
+	n := int(C.SensorDeviceCount(s.handle))
+	lectores := make([]EstadoLector, 0, n)
+	for i := 0; i < n; i++ {
+		var cIndice, cEstado, cErrores, cReconexiones, cUltimo C.int
+		if C.SensorDeviceStatus(s.handle, C.int(i), &cIndice, &cEstado, &cErrores, &cReconexiones, &cUltimo) != 0 {
+			continue
+		}
+		lectores = append(lectores, EstadoLector{
+			Indice:       int(cIndice),
+			Conectado:    cEstado == 0,
+			Errores:      int(cErrores),
+			Reconexiones: int(cReconexiones),
+			UltimoError:  int(cUltimo),
+		})
+	}
+	return lectores
+}
+
+// EstadisticaShard son los tiempos de identificacion de un shard de la cache
+// 1:N de C++ (en microsegundos)
+type EstadisticaShard struct {
+	Templates        int   `json:"templates"`
+	Identificaciones int64 `json:"identificaciones"`
+	UltimoUs         int64 `json:"ultimo_us"`
+	PromedioUs       int64 `json:"promedio_us"`
+	MaximoUs         int64 `json:"maximo_us"`
+}
+
+// EstadisticasShards devuelve los tiempos de cada shard, para revisar que la
+// latencia del 1:N no crezca al sumar alumnos
+func (s *SensorAdapter) EstadisticasShards() []EstadisticaShard {
+	if s.handle == nil {
+		return nil
+	}
+	total := int(C.GetShardStats(s.handle, nil, nil, nil, nil, nil, 0))
+	if total <= 0 {
+		return nil
+	}
+	templates := make([]C.int, total)
+	identifies := make([]C.longlong, total)
+	ultimo := make([]C.longlong, total)
+	acumulado := make([]C.longlong, total)
+	maximo := make([]C.longlong, total)
+	n := int(C.GetShardStats(s.handle, &templates[0], &identifies[0], &ultimo[0], &acumulado[0], &maximo[0], C.int(total)))
+	if n > total {
+		n = total
+	}
+
+	res := make([]EstadisticaShard, n)
+	for i := range res {
+		res[i] = EstadisticaShard{
+			Templates:        int(templates[i]),
+			Identificaciones: int64(identifies[i]),
+			UltimoUs:         int64(ultimo[i]),
+			MaximoUs:         int64(maximo[i]),
+		}
+		if identifies[i] > 0 {
+			res[i].PromedioUs = int64(acumulado[i]) / int64(identifies[i])
+		}
+	}
+	return res
+}
+
+// -----------------------------------------------------------------------------
+// METRICAS (histogramas y contadores de C++)
+// -----------------------------------------------------------------------------
+
+// nombres de las operaciones y contadores, en el orden de SensorMetrics.h
+var (
+	operacionesMetricas = []string{"captura", "identificacion", "match_1a1", "enrolamiento", "carga_cache"}
+	contadoresMetricas  = []string{
+		"captura_ok", "captura_sin_dedo", "captura_mala_imagen", "captura_error",
+		"cola_llena", "captura_vencida",
+		"identificacion_ok", "identificacion_fallida", "identificacion_en_grupo", "reintentos",
+		"enrolamiento_ok", "enrolamiento_fallido",
+	}
+)
+
+// MetricaOperacion resume el histograma de latencia de una operacion. Los
+// percentiles son el limite superior del bucket (error maximo ~25%)
+type MetricaOperacion struct {
+	Conteo      uint64 `json:"conteo"`
+	PromedioUs  uint64 `json:"promedio_us"`
+	P50Us       uint64 `json:"p50_us"`
+	P95Us       uint64 `json:"p95_us"`
+	P99Us       uint64 `json:"p99_us"`
+	MaximoUs    uint64 `json:"maximo_us"`
+	UltimoError int    `json:"ultimo_error"`
+}
+
+// MetricasSensor es la foto de metricas del sensor para el dashboard
+type MetricasSensor struct {
+	Operaciones map[string]MetricaOperacion `json:"operaciones"`
+	Contadores  map[string]uint64           `json:"contadores"`
+	// capturas con dedo que fallaron (mala imagen o error) sobre el total con dedo
+	TasaErrorCaptura float64 `json:"tasa_error_captura"`
+	// identificaciones fallidas sobre el total
+	TasaFalloIdentificacion float64 `json:"tasa_fallo_identificacion"`
+}
+
+// percentilBucket recorre el histograma hasta juntar la fraccion q del total
+func percentilBucket(buckets []C.ulonglong, total uint64, q float64) uint64 {
+	if total == 0 {
+		return 0
+	}
+	objetivo := uint64(q*float64(total) + 0.5)
+	if objetivo == 0 {
+		objetivo = 1
+	}
+	var acumulado uint64
+	for i, n := range buckets {
+		acumulado += uint64(n)
+		if acumulado >= objetivo {
+			return uint64(C.MetricsBucketUpperUs(C.int(i)))
+		}
+	}
+	return uint64(C.MetricsBucketUpperUs(C.int(len(buckets) - 1)))
+}
+
+// Metricas devuelve la foto actual de las metricas de C++. Se lee sin locks:
+// los contadores son atomicos y no frenan la captura ni el 1:N
+func (s *SensorAdapter) Metricas() (*MetricasSensor, error) {
+	if s.handle == nil {
+		return nil, errors.New("(-) [GO]: sensor no inicializado")
+	}
+	var datos C.SensorMetricsData
+	if C.GetSensorMetrics(s.handle, &datos) == 0 {
+		return nil, errors.New("(-) [GO]: no se pudieron leer las metricas del sensor")
+	}
+
+	m := &MetricasSensor{
+		Operaciones: make(map[string]MetricaOperacion, len(operacionesMetricas)),
+		Contadores:  make(map[string]uint64, len(contadoresMetricas)),
+	}
+	for i, nombre := range operacionesMetricas {
+		op := datos.ops[i]
+		conteo := uint64(op.count)
+		met := MetricaOperacion{
+			Conteo:      conteo,
+			MaximoUs:    uint64(op.maxUs),
+			UltimoError: int(op.lastError),
+			P50Us:       percentilBucket(op.buckets[:], conteo, 0.50),
+			P95Us:       percentilBucket(op.buckets[:], conteo, 0.95),
+			P99Us:       percentilBucket(op.buckets[:], conteo, 0.99),
+		}
+		if conteo > 0 {
+			met.PromedioUs = uint64(op.sumUs) / conteo
+		}
+		// el limite del bucket puede pasarse del maximo real
+		for _, p := range []*uint64{&met.P50Us, &met.P95Us, &met.P99Us} {
+			if *p > met.MaximoUs {
+				*p = met.MaximoUs
+			}
+		}
+		m.Operaciones[nombre] = met
+	}
+	for i, nombre := range contadoresMetricas {
+		m.Contadores[nombre] = uint64(datos.counters[i])
+	}
+
+	conDedo := m.Contadores["captura_ok"] + m.Contadores["captura_mala_imagen"] + m.Contadores["captura_error"]
+	if conDedo > 0 {
+		m.TasaErrorCaptura = float64(conDedo-m.Contadores["captura_ok"]) / float64(conDedo)
+	}
+	identificaciones := m.Contadores["identificacion_ok"] + m.Contadores["identificacion_fallida"]
+	if identificaciones > 0 {
+		m.TasaFalloIdentificacion = float64(m.Contadores["identificacion_fallida"]) / float64(identificaciones)
+	}
+	return m, nil
+}
+
+// ReiniciarMetricas pone en cero histogramas y contadores (ej: al empezar
+// un servicio de almuerzo)
+func (s *SensorAdapter) ReiniciarMetricas() {
+	if s.handle != nil {
+		C.ResetSensorMetrics(s.handle)
+	}
+}
+
+// -----------------------------------------------------------------------------
+// ARENA DE TEMPLATES (carga en frio del cache 1:N)
+// -----------------------------------------------------------------------------
+
+// AbrirArena abre (o crea) el archivo de templates de C++ y devuelve cuantos
+// templates vivos tiene, cuantos bytes suman y la suma de sus CRC-32, para
+// compararlo con la base de datos antes de confiar en el
+func (s *SensorAdapter) AbrirArena(ruta string) (int, int64, uint64, error) {
+	if s.handle == nil {
+		return 0, 0, 0, errors.New("(-) [GO]: sensor no inicializado")
+	}
+
+	cRuta := C.CString(ruta)
+	defer C.free(unsafe.Pointer(cRuta))
+
+	var cCount C.int
+	var cBytes C.longlong
+	var cChecksum C.ulonglong
+	if C.ArenaOpen(s.handle, cRuta, &cCount, &cBytes, &cChecksum) == 0 {
+		return 0, 0, 0, fmt.Errorf("(-) [GO]: no se pudo abrir la arena %s", ruta)
+	}
+	return int(cCount), int64(cBytes), uint64(cChecksum), nil
+}
+
+// CargarArena carga toda la arena en el cache del sensor con una sola llamada
+// a C++ y recupera el mapeo fid <-> RUN. Devuelve cuantos templates cargo
+func (s *SensorAdapter) CargarArena() (int, error) {
+	if s.handle == nil {
+		return 0, errors.New("(-) [GO]: sensor no inicializado")
+	}
+
+	cargados := int(C.ArenaLoad(s.handle))
+	if cargados < 0 {
+		return 0, errors.New("(-) [GO]: error al cargar la arena en el cache del sensor")
+	}
+
+	// mapeo fid <-> RUN en una sola llamada (los runs van en bloques fijos)
+	total := int(C.ArenaMapping(s.handle, nil, nil, 0))
+	if total <= 0 {
+		return cargados, nil
+	}
+	fids := make([]C.int, total)
+	runs := make([]byte, total*C.ARENA_RUN_SIZE)
+	n := int(C.ArenaMapping(s.handle, &fids[0], (*C.char)(unsafe.Pointer(&runs[0])), C.int(total)))
+
+	s.ids.Lock()
+	defer s.ids.Unlock()
+	for i := 0; i < n; i++ {
+		bloque := runs[i*C.ARENA_RUN_SIZE : (i+1)*C.ARENA_RUN_SIZE]
+		largo := 0
+		for largo < len(bloque) && bloque[largo] != 0 {
+			largo++
+		}
+		runID := string(bloque[:largo])
+		id := int(fids[i])
+		anterior, ok := s.runIDToID[runID]
+		if !ok {
+			anterior = -1
+		}
+		s.idToRunID[id] = runID
+		s.runIDToID[runID] = id
+		s.anotarCambio(runID, anterior, id)
+		if id >= s.nextID {
+			s.nextID = id + 1
+		}
+	}
+	return cargados, nil
+}
+
+// ReiniciarArena vacia la arena (cuando no coincide con la base de datos). Los
+// DBAdd1N siguientes la vuelven a llenar
+func (s *SensorAdapter) ReiniciarArena() error {
+	if s.handle == nil {
+		return errors.New("(-) [GO]: sensor no inicializado")
+	}
+	if C.ArenaReset(s.handle) == 0 {
+		return errors.New("(-) [GO]: no se pudo vaciar la arena de templates")
+	}
+	return nil
+}
+
+// -----------------------------------------------------------------------------
+// EVENTOS AL TOTEM (WebSocket)
+// -----------------------------------------------------------------------------
+
+// IniciarEventos levanta el servidor WebSocket de C++ que avisa al totem
+// apenas se apoya un dedo (finger_detected) y cuando se empieza a identificar
+// (processing). puerto 0 = DIGITADOR_EVENTS_PORT o 8081. Devuelve el puerto
+func (s *SensorAdapter) IniciarEventos(puerto int) (int, error) {
+	if s.handle == nil {
+		return 0, errors.New("(-) [GO]: sensor no inicializado")
+	}
+	escuchando := int(C.StartEvents(s.handle, C.int(puerto)))
+	if escuchando < 0 {
+		return 0, errors.New("(-) [GO]: no se pudo levantar el servidor de eventos")
+	}
+	return escuchando, nil
+}
+
+// DetenerEventos baja el servidor de eventos (Cerrar tambien lo hace)
+func (s *SensorAdapter) DetenerEventos() {
+	if s.handle != nil {
+		C.StopEvents(s.handle)
+	}
+}
+
+// PublicarEvento manda un frame JSON ya armado a todos los totems conectados
+// (approved / rejected, que dependen de la base de datos)
+func (s *SensorAdapter) PublicarEvento(frame []byte) {
+	if s.handle == nil || len(frame) == 0 {
+		return
+	}
+	cFrame := C.CString(string(frame))
+	defer C.free(unsafe.Pointer(cFrame))
+	C.PublishEvent(s.handle, cFrame)
+}
+
+// ClientesEventos devuelve cuantos totems estan conectados al WebSocket
+func (s *SensorAdapter) ClientesEventos() int {
+	if s.handle == nil {
+		return 0
+	}
+	return int(C.EventClients(s.handle))
+}
+
+// -----------------------------------------------------------------------------
+// DIARIO DE RACIONES (antes de SQLite)
+// -----------------------------------------------------------------------------
+
+// RacionDiario es una racion en el diario de C++: una fila de
+// RegistrosRaciones sin id. Seq lo asigna el diario al agregarla
+type RacionDiario struct {
+	Seq        uint64
+	RunID      string
+	Fecha      string
+	TipoRacion int
+	Terminal   string
+	HoraEvento int64
+	Estado     int
+}
+
+// errores de AnotarRacion: en los dos casos la racion hay que guardarla en
+// SQLite directo
+var (
+	ErrDiarioLleno    = errors.New("(-) [GO]: el diario de raciones esta lleno o cerrado")
+	ErrDiarioSinDisco = errors.New("(-) [GO]: la racion no llego a disco en el diario a tiempo")
+)
+
+// textoC copia texto en un arreglo de C terminado en '\0' (false si no cabe)
+func textoC(dst []C.char, texto string) bool {
+	if len(texto) >= len(dst) {
+		return false
+	}
+	for i := 0; i < len(texto); i++ {
+		dst[i] = C.char(texto[i])
+	}
+	dst[len(texto)] = 0
+	return true
+}
+
+// textoGo lee un arreglo de C terminado en '\0'
+func textoGo(src []C.char) string {
+	b := make([]byte, 0, len(src))
+	for _, c := range src {
+		if c == 0 {
+			break
+		}
+		b = append(b, byte(c))
+	}
+	return string(b)
+}
+
+// AbrirDiario abre (o crea) el diario de raciones de C++ y devuelve cuantas
+// raciones quedaron sin pasar a SQLite (despues de una caida)
+func (s *SensorAdapter) AbrirDiario(ruta string) (int, error) {
+	if s.handle == nil {
+		return 0, errors.New("(-) [GO]: sensor no inicializado")
+	}
+	cRuta := C.CString(ruta)
+	defer C.free(unsafe.Pointer(cRuta))
+
+	var cPendientes C.longlong
+	if C.JournalOpen(s.handle, cRuta, &cPendientes) == 0 {
+		return 0, fmt.Errorf("(-) [GO]: no se pudo abrir el diario de raciones %s", ruta)
+	}
+	return int(cPendientes), nil
+}
+
+// CerrarDiario pasa a disco lo que falte y cierra el diario (Cerrar tambien
+// lo hace)
+func (s *SensorAdapter) CerrarDiario() {
+	if s.handle != nil {
+		C.JournalClose(s.handle)
+	}
+}
+
+// AnotarRacion agrega la racion al diario y vuelve apenas esta en disco (las
+// que llegan juntas comparten el flush), como mucho despues de espera.
+// Devuelve el seq que le toco
+func (s *SensorAdapter) AnotarRacion(r RacionDiario, espera time.Duration) (uint64, error) {
+	if s.handle == nil {
+		return 0, errors.New("(-) [GO]: sensor no inicializado")
+	}
+	var ev C.JournalEvent
+	ev.horaEvento = C.longlong(r.HoraEvento)
+	ev.tipoRacion = C.int(r.TipoRacion)
+	ev.estado = C.int(r.Estado)
+	if !textoC(ev.run[:], r.RunID) || !textoC(ev.fecha[:], r.Fecha) || !textoC(ev.terminal[:], r.Terminal) {
+		return 0, fmt.Errorf("(-) [GO]: la racion de %s no cabe en el diario", r.RunID)
+	}
+
+	seq := int64(C.JournalAppend(s.handle, &ev, C.int(espera.Milliseconds())))
+	switch {
+	case seq == 0:
+		return 0, ErrDiarioLleno
+	case seq < 0:
+		return 0, ErrDiarioSinDisco
+	}
+	return uint64(seq), nil
+}
+
+// RacionesPendientes devuelve hasta max raciones ya en disco que faltan en
+// SQLite, la mas vieja primero
+func (s *SensorAdapter) RacionesPendientes(max int) []RacionDiario {
+	if s.handle == nil || max <= 0 {
+		return nil
+	}
+	// el buffer a la medida de lo pendiente, no de max (el diario completo
+	// son miles de JournalEvent)
+	if hay := int(C.JournalPending(s.handle, nil, 0)); hay < max {
+		max = hay
+	}
+	if max <= 0 {
+		return nil
+	}
+	eventos := make([]C.JournalEvent, max)
+	n := int(C.JournalPending(s.handle, &eventos[0], C.int(max)))
+
+	raciones := make([]RacionDiario, n)
+	for i := 0; i < n; i++ {
+		ev := &eventos[i]
+		raciones[i] = RacionDiario{
+			Seq:        uint64(ev.seq),
+			RunID:      textoGo(ev.run[:]),
+			Fecha:      textoGo(ev.fecha[:]),
+			TipoRacion: int(ev.tipoRacion),
+			Terminal:   textoGo(ev.terminal[:]),
+			HoraEvento: int64(ev.horaEvento),
+			Estado:     int(ev.estado),
+		}
+	}
+	return raciones
+}
+
+// ConfirmarRaciones avisa al diario que todas hasta seq ya estan en SQLite
+func (s *SensorAdapter) ConfirmarRaciones(seq uint64) error {
+	if s.handle == nil {
+		return errors.New("(-) [GO]: sensor no inicializado")
+	}
+	if C.JournalCheckpoint(s.handle, C.ulonglong(seq)) == 0 {
+		return fmt.Errorf("(-) [GO]: no se pudo confirmar el diario hasta %d", seq)
+	}
+	return nil
+}
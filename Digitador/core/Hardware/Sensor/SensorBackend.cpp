@@ -0,0 +1,22 @@
+// SensorBackend.cpp
+
+// eleccion del backend por defecto segun plataforma y entorno
+#include "SensorBackend.h"
+#include "ReplayBackend.h"
+#include "ZKBackend.h"
+
+#include <cstdlib>
+
+std::unique_ptr<SensorBackend> createDefaultBackend() {
+  const char *replayDir = std::getenv(SENSOR_REPLAY_ENV);
+  bool replay = replayDir && *replayDir;
+
+#ifdef _WIN32
+  if (!replay) {
+    return std::unique_ptr<SensorBackend>(new ZKBackend());
+  }
+#endif
+
+  return std::unique_ptr<SensorBackend>(
+      new ReplayBackend(replay ? replayDir : ""));
+}
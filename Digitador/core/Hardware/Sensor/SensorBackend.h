@@ -0,0 +1,86 @@
+// SensorBackend.h
+
+// interfaz abstracta entre Sensor y el motor de captura/comparacion.
+// El SDK de ZKTeco es una implementacion (ZKBackend) y el backend de
+// reproduccion (ReplayBackend) es otra, para correr todo el flujo
+// captura -> template -> identificacion en Linux sin el huellero.
+#pragma once
+
+#include <memory>
+
+// codigos de retorno ZKFP_ERR_* (solo defines, portable)
+#include "include/libzkfperrdef.h"
+
+class SensorBackend {
+public:
+  virtual ~SensorBackend() {}
+
+  //====SDK====
+
+  // inicializar / terminar el motor (ZKFPM_Init / ZKFPM_Terminate)
+  virtual int init() = 0;
+  virtual int terminate() = 0;
+
+  //====Dispositivo====
+
+  // cantidad de lectores conectados
+  virtual int getDeviceCount() = 0;
+
+  // abrir / cerrar un lector, devuelve nullptr si falla
+  virtual void *openDevice(int index) = 0;
+  virtual int closeDevice(void *device) = 0;
+
+  // ancho, alto y dpi de la imagen que entrega el lector
+  virtual int getCaptureParams(void *device, int &width, int &height,
+                               int &dpi) = 0;
+
+  // capturar imagen y extraer template en una sola llamada
+  virtual int acquireFingerprint(void *device, unsigned char *image,
+                                 unsigned int cbImage,
+                                 unsigned char *fpTemplate,
+                                 unsigned int *cbTemplate) = 0;
+
+  //====Cache 1:N====
+
+  // crear / liberar la cache de templates, devuelve nullptr si falla
+  virtual void *dbInit() = 0;
+  virtual int dbFree(void *dbCache) = 0;
+
+  // agregar un template a la cache con su fid
+  virtual int dbAdd(void *dbCache, unsigned int fid,
+                    const unsigned char *fpTemplate,
+                    unsigned int cbTemplate) = 0;
+
+  // quitar un fid / vaciar la cache / contar templates
+  // (ZKFPM_DBDel / ZKFPM_DBClear / ZKFPM_DBCount)
+  virtual int dbDel(void *dbCache, unsigned int fid) = 0;
+  virtual int dbClear(void *dbCache) = 0;
+  virtual int dbCount(void *dbCache, unsigned int *count) = 0;
+
+  // buscar el template en toda la cache
+  virtual int dbIdentify(void *dbCache, const unsigned char *fpTemplate,
+                         unsigned int cbTemplate, unsigned int *fid,
+                         unsigned int *score) = 0;
+
+  // comparar 1:1, devuelve el score o un codigo negativo
+  virtual int dbMatch(void *dbCache, const unsigned char *template1,
+                      unsigned int cbTemplate1, const unsigned char *template2,
+                      unsigned int cbTemplate2) = 0;
+
+  // fusionar tres capturas del mismo dedo en un template de registro
+  // (ZKFPM_DBMerge, que no usa los tamaños de entrada). cbRegTemp: entra la
+  // capacidad, sale el tamaño
+  virtual int dbMerge(void *dbCache, const unsigned char *template1,
+                      unsigned int cbTemplate1, const unsigned char *template2,
+                      unsigned int cbTemplate2, const unsigned char *template3,
+                      unsigned int cbTemplate3, unsigned char *regTemp,
+                      unsigned int *cbRegTemp) = 0;
+};
+
+// variable de entorno con la carpeta de capturas grabadas. Si existe se usa
+// el backend de reproduccion aunque estemos en Windows.
+#define SENSOR_REPLAY_ENV "DIGITADOR_SENSOR_REPLAY"
+
+// backend por defecto: ZKTeco en Windows, reproduccion en el resto o cuando
+// SENSOR_REPLAY_ENV esta definida
+std::unique_ptr<SensorBackend> createDefaultBackend();
@@ -2,6 +2,28 @@
 // archivo para crear el puente entre C++ y Go
 #include "SensorBridge.h"
 #include "Sensor.h" // Tu archivo original
+#include "ReplayBackend.h"
+
+#include <chrono>
+#include <cstring>
+
+// cada run del mapeo va en ARENA_RUN_SIZE bytes con su '\0'
+static_assert(ARENA_RUN_SIZE > ARENA_MAX_RUN_LEN,
+              "ARENA_RUN_SIZE no alcanza para ARENA_MAX_RUN_LEN");
+
+// la foto de metricas del bridge tiene que calzar con la de C++
+static_assert(SENSOR_METRIC_OPS == SENSOR_OP_COUNT &&
+                  SENSOR_METRIC_COUNTERS == SENSOR_COUNTER_COUNT &&
+                  SENSOR_METRIC_BUCKETS == METRICS_BUCKETS,
+              "SensorMetricsData no calza con SensorMetrics.h");
+
+// capacidad del buffer de Go: *outSize entra con la capacidad (como el
+// cbTemplate del SDK). Si viene en 0 asumimos MAX_TEMPLATE_SIZE (llamadores
+// antiguos que no la informaban)
+static unsigned int capacidadSalida(const int *outSize) {
+  return (outSize && *outSize > 0) ? static_cast<unsigned int>(*outSize)
+                                   : MAX_TEMPLATE_SIZE;
+}
 
 extern "C" {
 
@@ -10,6 +32,13 @@ SensorHandle CreateSensor() {
   return new Sensor(); // Creamos la instancia de C++
 }
 
+// creamos un sensor que reproduce capturas desde disco (sin huellero)
+SensorHandle CreateSensorReplay(const char *dir) {
+  std::string carpeta = dir ? dir : "";
+  return new Sensor(
+      std::unique_ptr<SensorBackend>(new ReplayBackend(carpeta)));
+}
+
 // creamos el destructor del sensor
 void DestroySensor(SensorHandle handle) {
   // si existia un sensor previamente?
@@ -42,19 +71,143 @@ int AcquireFingerprint(SensorHandle handle, unsigned char *outBuffer,
   // si existe, convertimos el puntero a clase sensor
   Sensor *s = static_cast<Sensor *>(handle);
 
-  // creamos un vector para almacenar el template
-  std::vector<unsigned char> templateData;
-  // Usamos el método inmediato, Go se encargará de hacer el bucle (polling)
-  if (s->captureTemplateImmediate(templateData)) {
+  // Usamos el método inmediato, el template se escribe directo en el buffer
+  // de Go (sin vector intermedio ni copia extra)
+  unsigned int templateSize = capacidadSalida(outSize);
+  if (s->captureTemplateImmediate(outBuffer, templateSize)) {
     // guardamos el tamaño del template en un puntero
-    *outSize = templateData.size();
-    // Movemos los bytes al buffer de Go
-    std::copy(templateData.begin(), templateData.end(), outBuffer);
+    *outSize = static_cast<int>(templateSize);
     return 1; // Éxito
   }
   return 0; // Falla (no hay dedo)
 }
 
+// lanzamos el hilo de captura continua del sensor
+int StartCaptureLoop(SensorHandle handle) {
+  if (!handle)
+    return 0;
+  Sensor *s = static_cast<Sensor *>(handle);
+  return s->startCaptureLoop() ? 1 : 0;
+}
+
+// detenemos el hilo de captura continua
+void StopCaptureLoop(SensorHandle handle) {
+  if (handle) {
+    static_cast<Sensor *>(handle)->stopCaptureLoop();
+  }
+}
+
+// esperamos la siguiente huella del hilo de captura (sin polling en Go)
+int WaitFingerprint(SensorHandle handle, unsigned char *outBuffer,
+                    int *outSize, int timeoutMs) {
+  if (!handle)
+    return 0;
+  Sensor *s = static_cast<Sensor *>(handle);
+
+  // la cola copia el template directo al buffer de Go
+  unsigned int templateSize = capacidadSalida(outSize);
+  if (s->waitTemplate(outBuffer, templateSize, timeoutMs)) {
+    *outSize = static_cast<int>(templateSize);
+    return 1; // Éxito
+  }
+  return 0; // timeout
+}
+
+// esperamos la siguiente huella ya identificada (ver Sensor::waitIdentify)
+int WaitIdentify(SensorHandle handle, const char *group, int device,
+                 int timeoutMs, int *outUserId, int *outScore, int *outInGroup,
+                 int *outDevice, long long *outCapturedAgoMs,
+                 long long *outIdentifyUs) {
+  if (!handle || !group)
+    return PIPELINE_ERROR;
+  Sensor *s = static_cast<Sensor *>(handle);
+
+  IdentifyResult result;
+  int status = s->waitIdentify(group, device, timeoutMs, result);
+  if (status == PIPELINE_HIT || status == PIPELINE_MISS) {
+    if (outUserId)
+      *outUserId = result.userId;
+    if (outScore)
+      *outScore = result.score;
+    if (outInGroup)
+      *outInGroup = result.inGroup ? 1 : 0;
+    if (outDevice)
+      *outDevice = result.device;
+    if (outCapturedAgoMs)
+      *outCapturedAgoMs =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now().time_since_epoch())
+              .count() -
+          result.capturedMs;
+    if (outIdentifyUs)
+      *outIdentifyUs = static_cast<long long>(result.identifyUs);
+  }
+  return status;
+}
+
+// lectores abiertos por el sensor
+int SensorDeviceCount(SensorHandle handle) {
+  if (!handle)
+    return 0;
+  return static_cast<int>(static_cast<Sensor *>(handle)->getDeviceCount());
+}
+
+int SensorDeviceIndex(SensorHandle handle, int position) {
+  if (!handle || position < 0)
+    return -1;
+  return static_cast<Sensor *>(handle)->getDeviceIndex(
+      static_cast<unsigned int>(position));
+}
+
+int SensorDeviceStatus(SensorHandle handle, int position, int *outIndex,
+                       int *outState, int *outErrors, int *outReconnects,
+                       int *outLastError) {
+  if (!handle || position < 0)
+    return -1;
+  DeviceStatus status;
+  if (!static_cast<Sensor *>(handle)->getDeviceStatus(
+          static_cast<unsigned int>(position), status))
+    return -1;
+  if (outIndex)
+    *outIndex = status.index;
+  if (outState)
+    *outState = status.state;
+  if (outErrors)
+    *outErrors = static_cast<int>(status.errors);
+  if (outReconnects)
+    *outReconnects = static_cast<int>(status.reconnects);
+  if (outLastError)
+    *outLastError = status.lastError;
+  return 0;
+}
+
+// enrolamos con tres capturas fusionadas (ver Sensor::enrollTemplate)
+int EnrollFingerprint(SensorHandle handle, unsigned char *outBuffer,
+                      int *outSize, int timeoutMs, int minScore,
+                      int *outScores, int *outQuality, int *outSamples) {
+  if (!handle || !outBuffer || !outSize)
+    return ENROLL_ERR_NOT_READY;
+  Sensor *s = static_cast<Sensor *>(handle);
+
+  EnrollResult result;
+  unsigned int templateSize = capacidadSalida(outSize);
+  s->enrollTemplate(outBuffer, templateSize, timeoutMs, minScore, result);
+
+  // el detalle se copia aunque falle, para explicarle al operador
+  if (outScores) {
+    for (int i = 0; i < ENROLL_PAIRS; ++i) {
+      outScores[i] = result.scores[i];
+    }
+  }
+  if (outQuality)
+    *outQuality = result.quality;
+  if (outSamples)
+    *outSamples = static_cast<int>(result.samples);
+  if (result.status == ENROLL_OK)
+    *outSize = static_cast<int>(templateSize);
+  return result.status;
+}
+
 // comparamos dos huellas
 int MatchTemplates(SensorHandle handle, const unsigned char *tpl1, int size1,
                    const unsigned char *tpl2, int size2) {
@@ -68,23 +221,113 @@ int MatchTemplates(SensorHandle handle, const unsigned char *tpl1, int size1,
   // si existe, convertimos el puntero a clase sensor
   Sensor *s = static_cast<Sensor *>(handle);
 
-  // Reconstruimos los vectores temporales para que tu código original funcione
-  std::vector<unsigned char> v1(tpl1, tpl1 + size1);
-  std::vector<unsigned char> v2(tpl2, tpl2 + size2);
-  // comparamos las 2 huellas sin el return
-  int score = s->matchTemplate(v1, v2);
+  // tamaños negativos no son templates validos
+  if (size1 < 0 || size2 < 0)
+    return -1;
+
+  // comparamos las 2 huellas directo sobre la memoria de Go (sin copiar)
+  int score = s->matchTemplate(
+      TemplateView(tpl1, static_cast<unsigned int>(size1)),
+      TemplateView(tpl2, static_cast<unsigned int>(size2)));
   // devolvemos el score
   return score;
 }
 
+// comparamos una huella contra un lote completo (un solo cruce de CGO)
+int MatchTemplatesBatch(SensorHandle handle, const unsigned char *probe,
+                        int probeSize, const unsigned char *blob,
+                        const int *offsets, int count, int topK, int stopScore,
+                        int *outIndex, int *outScore) {
+  if (!handle)
+    return -1;
+  if (probeSize <= 0 || count < 0 || topK < 0)
+    return -1;
+  if (count > 0 && (!offsets || offsets[0] < 0))
+    return -1;
+  if (topK > 0 && (!outIndex || !outScore))
+    return -1;
+  Sensor *s = static_cast<Sensor *>(handle);
+
+  // los offsets de Go son int; como no son negativos la vista como unsigned
+  // tiene los mismos bits y no hace falta copiarlos
+  std::vector<MatchResult> resultados(static_cast<size_t>(topK));
+  int n = s->matchMany(
+      TemplateView(probe, static_cast<unsigned int>(probeSize)), blob,
+      reinterpret_cast<const unsigned int *>(offsets),
+      static_cast<unsigned int>(count), resultados.data(),
+      static_cast<unsigned int>(topK), stopScore);
+
+  for (int i = 0; i < n; ++i) {
+    outIndex[i] = static_cast<int>(resultados[i].index);
+    outScore[i] = resultados[i].score;
+  }
+  return n;
+}
+
 // 1:N - Agregar template al cache interno
 int DBAdd(SensorHandle handle, int userId, unsigned char *fpTemplate,
           int cbTemplate) {
   if (!handle)
     return 0;
+  if (cbTemplate <= 0)
+    return 0;
+  Sensor *s = static_cast<Sensor *>(handle);
+  // el SDK copia el template a su cache, no hace falta copiarlo antes
+  return s->DBAdd(TemplateView(fpTemplate, static_cast<unsigned int>(cbTemplate)),
+                  userId)
+             ? 1
+             : 0;
+}
+
+// 1:N - Quitar un id del cache interno (baja o desactivacion)
+int DBRemove(SensorHandle handle, int userId) {
+  if (!handle)
+    return 0;
+  return static_cast<Sensor *>(handle)->dbRemove(userId) ? 1 : 0;
+}
+
+// 1:N - Cambiar el template de un id (re-enrolamiento)
+int DBReplace(SensorHandle handle, int userId, unsigned char *fpTemplate,
+              int cbTemplate) {
+  if (!handle)
+    return 0;
+  if (cbTemplate <= 0)
+    return 0;
+  Sensor *s = static_cast<Sensor *>(handle);
+  return s->dbReplace(
+             TemplateView(fpTemplate, static_cast<unsigned int>(cbTemplate)),
+             userId)
+             ? 1
+             : 0;
+}
+
+// 1:N - Vaciar el cache interno
+int DBClear(SensorHandle handle) {
+  if (!handle)
+    return 0;
+  return static_cast<Sensor *>(handle)->dbClear() ? 1 : 0;
+}
+
+// 1:N - Cantidad de templates en el cache interno
+int DBCount(SensorHandle handle) {
+  if (!handle)
+    return -1;
+  return static_cast<Sensor *>(handle)->dbCount();
+}
+
+// 1:N - Agregar un lote completo al cache interno (un solo cruce de CGO)
+int DBAddBatch(SensorHandle handle, const int *ids, const unsigned char *blob,
+               const int *offsets, int count, int *results) {
+  if (!handle || count < 0)
+    return -1;
+  if (count == 0)
+    return 0;
+  if (!offsets || offsets[0] < 0)
+    return -1;
   Sensor *s = static_cast<Sensor *>(handle);
-  std::vector<unsigned char> templateData(fpTemplate, fpTemplate + cbTemplate);
-  return s->DBAdd(templateData, userId) ? 1 : 0;
+  // offsets no negativos: misma representacion como unsigned, sin copiar
+  return s->dbAddBatch(ids, blob, reinterpret_cast<const unsigned int *>(offsets),
+                       static_cast<unsigned int>(count), results);
 }
 
 // 1:N - Identificar huella en el cache interno
@@ -92,12 +335,15 @@ int DBIdentify(SensorHandle handle, unsigned char *fpTemplate, int cbTemplate,
                int *outUserId, int *outScore) {
   if (!handle)
     return 0;
+  if (cbTemplate <= 0)
+    return 0;
   Sensor *s = static_cast<Sensor *>(handle);
-  std::vector<unsigned char> templateData(fpTemplate, fpTemplate + cbTemplate);
 
   int userId = 0;
   int score = 0;
-  if (s->DBIdentify(templateData, userId, score)) {
+  if (s->DBIdentify(
+          TemplateView(fpTemplate, static_cast<unsigned int>(cbTemplate)),
+          userId, score)) {
     *outUserId = userId;
     *outScore = score;
     return 1; // Éxito
@@ -106,4 +352,326 @@ int DBIdentify(SensorHandle handle, unsigned char *fpTemplate, int cbTemplate,
   return 0; // No encontrado o error
 }
 
-} // fin extern "C"
\ No newline at end of file
+//====GRUPOS DE CANDIDATOS====//
+
+// reemplazamos el contenido de un grupo con un lote
+int GroupLoad(SensorHandle handle, const char *group, const int *ids,
+              const unsigned char *blob, const int *offsets, int count) {
+  if (!handle || !group || count < 0)
+    return -1;
+  if (count > 0 && (!offsets || offsets[0] < 0))
+    return -1;
+  Sensor *s = static_cast<Sensor *>(handle);
+  return s->groupLoad(group, ids, blob,
+                      reinterpret_cast<const unsigned int *>(offsets),
+                      static_cast<unsigned int>(count));
+}
+
+// sumamos un template a un grupo
+int GroupAdd(SensorHandle handle, const char *group, int userId,
+             const unsigned char *fpTemplate, int cbTemplate) {
+  if (!handle || !group || cbTemplate <= 0)
+    return 0;
+  Sensor *s = static_cast<Sensor *>(handle);
+  return s->groupAdd(group, userId,
+                     TemplateView(fpTemplate,
+                                  static_cast<unsigned int>(cbTemplate)))
+             ? 1
+             : 0;
+}
+
+// identificamos buscando primero en el grupo probable
+int DBIdentifyGroup(SensorHandle handle, const char *group,
+                    unsigned char *fpTemplate, int cbTemplate, int *outUserId,
+                    int *outScore, int *outInGroup) {
+  if (!handle || !group)
+    return 0;
+  if (cbTemplate <= 0)
+    return 0;
+  Sensor *s = static_cast<Sensor *>(handle);
+
+  int userId = 0;
+  int score = 0;
+  bool enGrupo = false;
+  if (s->DBIdentifyGroup(
+          group,
+          TemplateView(fpTemplate, static_cast<unsigned int>(cbTemplate)),
+          userId, score, enGrupo)) {
+    *outUserId = userId;
+    *outScore = score;
+    if (outInGroup)
+      *outInGroup = enGrupo ? 1 : 0;
+    return 1; // Éxito
+  }
+  return 0; // No encontrado o error
+}
+
+// tiempos de cada shard de la cache 1:N
+int GetShardStats(SensorHandle handle, int *templates, long long *identifies,
+                  long long *lastUs, long long *totalUs, long long *maxUs,
+                  int count) {
+  if (!handle)
+    return 0;
+  std::vector<ShardStats> stats;
+  static_cast<Sensor *>(handle)->getShardStats(stats);
+
+  for (int i = 0; i < count && i < static_cast<int>(stats.size()); ++i) {
+    if (templates)
+      templates[i] = static_cast<int>(stats[i].templates);
+    if (identifies)
+      identifies[i] = static_cast<long long>(stats[i].identifies);
+    if (lastUs)
+      lastUs[i] = static_cast<long long>(stats[i].lastUs);
+    if (totalUs)
+      totalUs[i] = static_cast<long long>(stats[i].totalUs);
+    if (maxUs)
+      maxUs[i] = static_cast<long long>(stats[i].maxUs);
+  }
+  return static_cast<int>(stats.size());
+}
+
+//====METRICAS====//
+
+// copiamos la foto de metricas directo a la estructura de Go
+int GetSensorMetrics(SensorHandle handle, SensorMetricsData *out) {
+  if (!handle || !out)
+    return 0;
+  MetricsSnapshot foto;
+  static_cast<Sensor *>(handle)->getMetrics(foto);
+
+  for (int op = 0; op < SENSOR_OP_COUNT; ++op) {
+    const LatencySnapshot &s = foto.ops[op];
+    SensorOpMetrics &d = out->ops[op];
+    d.count = s.count;
+    d.sumUs = s.sumUs;
+    d.maxUs = s.maxUs;
+    std::memcpy(d.buckets, s.buckets, sizeof(d.buckets));
+    d.lastError = s.lastError;
+  }
+  std::memcpy(out->counters, foto.counters, sizeof(out->counters));
+  return 1;
+}
+
+void ResetSensorMetrics(SensorHandle handle) {
+  if (handle)
+    static_cast<Sensor *>(handle)->resetMetrics();
+}
+
+unsigned long long MetricsBucketUpperUs(int bucket) {
+  if (bucket < 0 || bucket >= METRICS_BUCKETS)
+    return 0;
+  return SensorMetrics::bucketUpperUs(static_cast<unsigned int>(bucket));
+}
+
+//====ARENA DE TEMPLATES====//
+
+// abrimos la arena de templates (la crea vacia si no existe)
+int ArenaOpen(SensorHandle handle, const char *path, int *outCount,
+              long long *outBytes, unsigned long long *outChecksum) {
+  if (!handle || !path)
+    return 0;
+  Sensor *s = static_cast<Sensor *>(handle);
+  int count = s->openArena(path);
+  if (count < 0)
+    return 0;
+  if (outCount)
+    *outCount = count;
+  if (outBytes)
+    *outBytes = static_cast<long long>(s->arenaLiveBytes());
+  if (outChecksum)
+    *outChecksum = s->arenaLiveChecksum();
+  return 1;
+}
+
+// cargamos la arena completa en la cache 1:N del sensor
+int ArenaLoad(SensorHandle handle) {
+  if (!handle)
+    return -1;
+  return static_cast<Sensor *>(handle)->loadArena();
+}
+
+// copiamos el mapeo fid <-> run para que Go reconozca los ids de DBIdentify
+int ArenaMapping(SensorHandle handle, int *fids, char *runs, int count) {
+  if (!handle)
+    return -1;
+  std::vector<TemplateArena::Entry> indice;
+  static_cast<Sensor *>(handle)->arenaMapping(indice);
+  if (!fids || !runs)
+    return static_cast<int>(indice.size());
+
+  int escritos = 0;
+  for (size_t i = 0; i < indice.size() && escritos < count;
+       ++i, ++escritos) {
+    fids[escritos] = static_cast<int>(indice[i].fid);
+    char *destino = runs + static_cast<size_t>(escritos) * ARENA_RUN_SIZE;
+    std::memset(destino, 0, ARENA_RUN_SIZE);
+    std::memcpy(destino, indice[i].run.data(), indice[i].run.size());
+  }
+  return escritos;
+}
+
+// agregamos o reemplazamos el template de un run en la arena
+int ArenaPut(SensorHandle handle, const char *run, int fid,
+             const unsigned char *fpTemplate, int cbTemplate) {
+  if (!handle || !run || cbTemplate <= 0)
+    return 0;
+  Sensor *s = static_cast<Sensor *>(handle);
+  if (!s->isArenaOpen())
+    return -1;
+  return s->arenaPut(run, fid,
+                     TemplateView(fpTemplate,
+                                  static_cast<unsigned int>(cbTemplate)))
+             ? 1
+             : 0;
+}
+
+// agregamos un lote completo a la arena (un solo flush)
+int ArenaPutBatch(SensorHandle handle, const int *ids, const char *runs,
+                  const unsigned char *blob, const int *offsets, int count) {
+  if (!handle || count < 0)
+    return 0;
+  Sensor *s = static_cast<Sensor *>(handle);
+  if (!s->isArenaOpen())
+    return -1;
+  if (count == 0)
+    return 0;
+  if (!ids || !runs || !blob || !offsets)
+    return 0;
+
+  std::vector<TemplateArena::Entry> entradas(static_cast<size_t>(count));
+  for (int i = 0; i < count; ++i) {
+    const char *run = runs + static_cast<size_t>(i) * ARENA_RUN_SIZE;
+    entradas[i].fid = static_cast<unsigned int>(ids[i]);
+    entradas[i].run.assign(run, strnlen(run, ARENA_RUN_SIZE));
+    if (offsets[i] >= 0 && offsets[i + 1] > offsets[i]) {
+      entradas[i].tpl = TemplateView(
+          blob + offsets[i], static_cast<unsigned int>(offsets[i + 1] - offsets[i]));
+    }
+  }
+  return s->arenaPutMany(entradas);
+}
+
+// damos de baja un run en la arena
+int ArenaRemove(SensorHandle handle, const char *run) {
+  if (!handle || !run)
+    return 0;
+  Sensor *s = static_cast<Sensor *>(handle);
+  if (!s->isArenaOpen())
+    return -1;
+  return s->arenaRemove(run) ? 1 : 0;
+}
+
+// vaciamos la arena
+int ArenaReset(SensorHandle handle) {
+  if (!handle)
+    return 0;
+  return static_cast<Sensor *>(handle)->resetArena() ? 1 : 0;
+}
+
+// levantamos el servidor de eventos del totem
+int StartEvents(SensorHandle handle, int port) {
+  if (!handle || port < 0 || port > 65535)
+    return -1;
+  return static_cast<Sensor *>(handle)->startEvents(
+      static_cast<unsigned short>(port));
+}
+
+void StopEvents(SensorHandle handle) {
+  if (handle)
+    static_cast<Sensor *>(handle)->stopEvents();
+}
+
+// publicamos un evento ya armado por Go
+void PublishEvent(SensorHandle handle, const char *json) {
+  if (handle && json)
+    static_cast<Sensor *>(handle)->publishEvent(json);
+}
+
+int EventClients(SensorHandle handle) {
+  if (!handle)
+    return 0;
+  return static_cast<int>(static_cast<Sensor *>(handle)->getEventClients());
+}
+
+// -----------------------------------------------------------------------------
+// Diario de raciones
+// -----------------------------------------------------------------------------
+static_assert(JOURNAL_RUN_SIZE == JOURNAL_MAX_RUN_LEN + 1,
+              "JOURNAL_RUN_SIZE no coincide con RationJournal");
+static_assert(JOURNAL_FECHA_SIZE == JOURNAL_MAX_FECHA_LEN + 1,
+              "JOURNAL_FECHA_SIZE no coincide con RationJournal");
+static_assert(JOURNAL_TERMINAL_SIZE == JOURNAL_MAX_TERMINAL_LEN + 1,
+              "JOURNAL_TERMINAL_SIZE no coincide con RationJournal");
+
+int JournalOpen(SensorHandle handle, const char *path, long long *outPending) {
+  if (!handle || !path)
+    return 0;
+  long long pendientes = static_cast<Sensor *>(handle)->openJournal(path);
+  if (pendientes < 0)
+    return 0;
+  if (outPending)
+    *outPending = pendientes;
+  return 1;
+}
+
+void JournalClose(SensorHandle handle) {
+  if (handle)
+    static_cast<Sensor *>(handle)->closeJournal();
+}
+
+long long JournalAppend(SensorHandle handle, const JournalEvent *event,
+                        int timeoutMs) {
+  if (!handle || !event)
+    return 0;
+  RationJournal &diario = static_cast<Sensor *>(handle)->getJournal();
+
+  JournalRecord r;
+  std::memset(&r, 0, sizeof(r));
+  r.horaEvento = event->horaEvento;
+  r.tipoRacion = static_cast<unsigned short>(event->tipoRacion);
+  r.estado = static_cast<unsigned short>(event->estado);
+  std::memcpy(r.run, event->run, sizeof(r.run));
+  std::memcpy(r.fecha, event->fecha, sizeof(r.fecha));
+  std::memcpy(r.terminal, event->terminal, sizeof(r.terminal));
+
+  unsigned long long seq = diario.append(r);
+  if (seq == 0)
+    return 0;
+  if (!diario.waitDurable(seq, timeoutMs))
+    return -1;
+  return static_cast<long long>(seq);
+}
+
+int JournalPending(SensorHandle handle, JournalEvent *out, int count) {
+  if (!handle)
+    return 0;
+  // sin destino: solo cuantas hay, para que Go pida justo eso
+  if (!out)
+    return static_cast<int>(
+        static_cast<Sensor *>(handle)->getJournal().pendingCount());
+  if (count <= 0)
+    return 0;
+  std::vector<JournalRecord> registros;
+  static_cast<Sensor *>(handle)->getJournal().pending(
+      registros, static_cast<size_t>(count));
+  for (size_t i = 0; i < registros.size(); ++i) {
+    const JournalRecord &r = registros[i];
+    JournalEvent &e = out[i];
+    e.seq = r.seq;
+    e.horaEvento = r.horaEvento;
+    e.tipoRacion = r.tipoRacion;
+    e.estado = r.estado;
+    std::memcpy(e.run, r.run, sizeof(e.run));
+    std::memcpy(e.fecha, r.fecha, sizeof(e.fecha));
+    std::memcpy(e.terminal, r.terminal, sizeof(e.terminal));
+  }
+  return static_cast<int>(registros.size());
+}
+
+int JournalCheckpoint(SensorHandle handle, unsigned long long seq) {
+  if (!handle)
+    return 0;
+  return static_cast<Sensor *>(handle)->getJournal().checkpoint(seq) ? 1 : 0;
+}
+
+} // fin extern "C"
@@ -9,15 +9,165 @@ extern "C"{
 
     //funcion para crear y gestionar un sensor
     SensorHandle CreateSensor();
+    //sensor con backend de reproduccion (capturas grabadas en dir, o sinteticas si dir es "")
+    SensorHandle CreateSensorReplay(const char* dir);
     //destructor de sensor
     void DestroySensor(SensorHandle handle);
     int InitSensor(SensorHandle handle);
+    // outSize: entra la capacidad de outBuffer, sale el tamaño del template.
+    // C++ escribe directo en outBuffer (sin copias intermedias)
     int AcquireFingerprint(SensorHandle handle, unsigned char* outBuffer, int* outSize);
+
+    // captura continua: un hilo en C++ captura y encola, Go solo espera
+    int StartCaptureLoop(SensorHandle handle);
+    void StopCaptureLoop(SensorHandle handle);
+    // bloquea hasta timeoutMs por la siguiente huella (1 = ok, 0 = timeout)
+    int WaitFingerprint(SensorHandle handle, unsigned char* outBuffer, int* outSize, int timeoutMs);
+    // pipeline: espera hasta timeoutMs la siguiente huella ya identificada por
+    // los hilos de C++ en el lector device (-1 = cualquiera). group = grupo de
+    // candidatos a revisar primero ("" = todo el cache). Devuelve 1
+    // identificado, 0 dedo no registrado, -1 timeout, -2 sin sensor.
+    // outDevice: lector que capturo, outCapturedAgoMs: ms desde la captura,
+    // outIdentifyUs: 1:N
+    int WaitIdentify(SensorHandle handle, const char* group, int device, int timeoutMs,
+                     int* outUserId, int* outScore, int* outInGroup, int* outDevice,
+                     long long* outCapturedAgoMs, long long* outIdentifyUs);
+    // lectores abiertos (todos los conectados, hasta DIGITADOR_SENSOR_DEVICES)
+    // y el indice de cada uno (el que devuelve WaitIdentify en outDevice)
+    int SensorDeviceCount(SensorHandle handle);
+    int SensorDeviceIndex(SensorHandle handle, int position);
+    // salud de un lector segun el watchdog de C++: indice del SDK, estado
+    // (0 capturando, 1 caido / reabriendose), errores seguidos del SDK,
+    // reconexiones y ultimo codigo de error. Devuelve 0, o -1 si no existe
+    int SensorDeviceStatus(SensorHandle handle, int position, int* outIndex,
+                           int* outState, int* outErrors, int* outReconnects,
+                           int* outLastError);
+    // enrolamiento: tres capturas del mismo dedo (levantandolo entre una y otra),
+    // cada par con score >= minScore (0 = por defecto), fusionadas con DBMerge.
+    // outScores recibe los 3 scores entre pares (1-0, 2-0, 2-1; -1 = sin comparar),
+    // outQuality el peor y outSamples las capturas tomadas. Devuelve 0 si enrolo,
+    // -1 timeout, -2 capturas de distinto dedo, -3 error al fusionar, -4 sin sensor
+    int EnrollFingerprint(SensorHandle handle, unsigned char* outBuffer, int* outSize, int timeoutMs,
+                          int minScore, int* outScores, int* outQuality, int* outSamples);
     int MatchTemplates(SensorHandle handle, const unsigned char* tpl1, int size1, const unsigned char* tpl2, int size2);
+    // compara probe contra count templates empaquetados en blob (el i-esimo va
+    // de offsets[i] a offsets[i+1], offsets tiene count+1 entradas) en una sola
+    // llamada. Escribe los topK mejores en outIndex/outScore (mayor score
+    // primero); si stopScore > 0 corta al alcanzarlo. Devuelve cuantos
+    // resultados escribio, o -1 si hubo error
+    int MatchTemplatesBatch(SensorHandle handle, const unsigned char* probe, int probeSize,
+                            const unsigned char* blob, const int* offsets, int count,
+                            int topK, int stopScore, int* outIndex, int* outScore);
     
     // 1:N Matching bridge
     int DBAdd(SensorHandle handle, int userId, unsigned char* fpTemplate, int cbTemplate);
     int DBIdentify(SensorHandle handle, unsigned char* fpTemplate, int cbTemplate, int* outUserId, int* outScore);
+    // mantenimiento del cache 1:N sin recargar: quitar un id, cambiar su template,
+    // vaciar todo y contar (1 = ok, 0 = error; DBCount devuelve -1 si falla)
+    int DBRemove(SensorHandle handle, int userId);
+    int DBReplace(SensorHandle handle, int userId, unsigned char* fpTemplate, int cbTemplate);
+    int DBClear(SensorHandle handle);
+    int DBCount(SensorHandle handle);
+    // carga masiva: count templates empaquetados en blob (el i-esimo va de offsets[i]
+    // a offsets[i+1], offsets tiene count+1 entradas) con el id ids[i]. En results[i]
+    // queda el codigo ZKFP_ERR_* de cada uno (0 = ok). Devuelve cuantos agrego o -1
+    int DBAddBatch(SensorHandle handle, const int* ids, const unsigned char* blob, const int* offsets, int count, int* results);
+
+    // grupos de candidatos (ej: "racion:1"): se buscan antes que la cache completa.
+    // GroupLoad reemplaza el grupo con un lote (mismo formato que DBAddBatch, ids
+    // de la cache completa) y devuelve cuantos quedaron, o -1
+    int GroupLoad(SensorHandle handle, const char* group, const int* ids, const unsigned char* blob, const int* offsets, int count);
+    int GroupAdd(SensorHandle handle, const char* group, int userId, const unsigned char* fpTemplate, int cbTemplate);
+    // identifica primero en el grupo y, si no aparece, en toda la cache.
+    // outInGroup = 1 si el acierto vino del grupo
+    int DBIdentifyGroup(SensorHandle handle, const char* group, unsigned char* fpTemplate, int cbTemplate, int* outUserId, int* outScore, int* outInGroup);
+
+    // tiempos de identificacion por shard de la cache 1:N. Llena hasta count
+    // entradas de cada arreglo y devuelve la cantidad de shards
+    int GetShardStats(SensorHandle handle, int* templates, long long* identifies,
+                      long long* lastUs, long long* totalUs, long long* maxUs, int count);
+
+    // metricas del sensor (ver SensorMetrics.h): un histograma log-lineal de
+    // latencia por operacion y contadores de resultados, copiados de una vez
+#define SENSOR_METRIC_OPS 5       // captura, identify, match 1:1, enrolamiento, carga
+#define SENSOR_METRIC_COUNTERS 12
+#define SENSOR_METRIC_BUCKETS 128
+    typedef struct {
+        unsigned long long count;
+        unsigned long long sumUs;
+        unsigned long long maxUs;
+        unsigned long long buckets[SENSOR_METRIC_BUCKETS];
+        int lastError;
+    } SensorOpMetrics;
+    typedef struct {
+        SensorOpMetrics ops[SENSOR_METRIC_OPS];
+        unsigned long long counters[SENSOR_METRIC_COUNTERS];
+    } SensorMetricsData;
+    // llena out con la foto actual (1 ok, 0 sin sensor)
+    int GetSensorMetrics(SensorHandle handle, SensorMetricsData* out);
+    void ResetSensorMetrics(SensorHandle handle);
+    // limite superior (exclusivo, en microsegundos) de un bucket del histograma
+    unsigned long long MetricsBucketUpperUs(int bucket);
+
+    // arena de templates (archivo mapeado) para cargar la cache 1:N al arrancar.
+    // Cada run ocupa ARENA_RUN_SIZE bytes en ArenaMapping (terminado en '\0')
+#define ARENA_RUN_SIZE 32
+    // abre o crea el archivo; devuelve 1 y la cantidad, los bytes y la suma de
+    // los CRC-32 de los templates vivos (la firma para compararla con la DB)
+    int ArenaOpen(SensorHandle handle, const char* path, int* outCount, long long* outBytes,
+                  unsigned long long* outChecksum);
+    // carga toda la arena en la cache 1:N (una sola llamada). Devuelve cuantos cargo o -1
+    int ArenaLoad(SensorHandle handle);
+    // copia el mapeo fid <-> run de los count primeros vivos; con fids/runs en NULL
+    // solo devuelve cuantos hay
+    int ArenaMapping(SensorHandle handle, int* fids, char* runs, int count);
+    // agrega/reemplaza un template en la arena (1 ok, 0 error, -1 arena cerrada)
+    int ArenaPut(SensorHandle handle, const char* run, int fid, const unsigned char* fpTemplate, int cbTemplate);
+    // igual que ArenaPut para un lote (mismo formato que DBAddBatch, runs en bloques
+    // de ARENA_RUN_SIZE). Devuelve cuantos escribio, -1 si la arena esta cerrada
+    int ArenaPutBatch(SensorHandle handle, const int* ids, const char* runs, const unsigned char* blob, const int* offsets, int count);
+    // da de baja un run en la arena (1 ok, 0 error, -1 arena cerrada)
+    int ArenaRemove(SensorHandle handle, const char* run);
+    // vacia la arena (cuando no coincide con la base de datos)
+    int ArenaReset(SensorHandle handle);
+
+    // eventos al totem: servidor WebSocket (ver SensorEvents.h). port 0 =
+    // DIGITADOR_EVENTS_PORT o 8081. Devuelve el puerto, o -1 si no se levanto
+    int StartEvents(SensorHandle handle, int port);
+    void StopEvents(SensorHandle handle);
+    // manda un frame JSON a todos los totems conectados
+    void PublishEvent(SensorHandle handle, const char* json);
+    // totems conectados
+    int EventClients(SensorHandle handle);
+
+    // diario de raciones (ver RationJournal.h): el totem recibe su respuesta
+    // apenas la racion esta en disco y Go la pasa a SQLite despues, en lotes.
+    // Los textos van terminados en '\0'
+#define JOURNAL_RUN_SIZE 32
+#define JOURNAL_FECHA_SIZE 16
+#define JOURNAL_TERMINAL_SIZE 32
+    typedef struct {
+        unsigned long long seq; // lo asigna el diario al agregar
+        long long horaEvento;   // epoch ms
+        int tipoRacion;
+        int estado;
+        char run[JOURNAL_RUN_SIZE];
+        char fecha[JOURNAL_FECHA_SIZE];
+        char terminal[JOURNAL_TERMINAL_SIZE];
+    } JournalEvent;
+    // abre o crea el archivo; devuelve 1 y en outPending las raciones que
+    // quedaron sin aplicar en SQLite (despues de una caida), o 0 si fallo
+    int JournalOpen(SensorHandle handle, const char* path, long long* outPending);
+    void JournalClose(SensorHandle handle);
+    // agrega la racion y espera hasta timeoutMs que este en disco (un flush
+    // para todas las que llegan juntas). Devuelve su seq, 0 si el diario esta
+    // lleno o cerrado, -1 si no llego a disco a tiempo
+    long long JournalAppend(SensorHandle handle, const JournalEvent* event, int timeoutMs);
+    // copia hasta count raciones en disco sin aplicar (la mas vieja primero).
+    // Devuelve cuantas copio; con out NULL, cuantas hay
+    int JournalPending(SensorHandle handle, JournalEvent* out, int count);
+    // todas hasta seq (inclusive) ya estan en SQLite (1 ok, 0 error)
+    int JournalCheckpoint(SensorHandle handle, unsigned long long seq);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,209 @@
+// SensorEvents.cpp
+
+// servidor WebSocket de eventos para el totem (crow + asio standalone)
+#include "SensorEvents.h"
+#include "SensorLog.h"
+
+#include "include/crow_all.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <mutex>
+
+// -----------------------------------------------------------------------------
+// Logs de crow
+// -----------------------------------------------------------------------------
+
+// crow escribe por std::cerr desde sus hilos: lo pasamos por el log del
+// sensor para no mezclar salidas ni frenar el io de la red
+namespace {
+class CrowLog : public crow::ILogHandler {
+public:
+  void log(const std::string &message, crow::LogLevel level) override {
+    switch (level) {
+    case crow::LogLevel::Debug:
+      SLOG_DEBUG("events", "%s", message.c_str());
+      break;
+    case crow::LogLevel::Info:
+      SLOG_INFO("events", "%s", message.c_str());
+      break;
+    case crow::LogLevel::Warning:
+      SLOG_WARN("events", "%s", message.c_str());
+      break;
+    default:
+      SLOG_ERROR("events", "%s", message.c_str());
+      break;
+    }
+  }
+};
+} // namespace
+
+// -----------------------------------------------------------------------------
+// Servidor
+// -----------------------------------------------------------------------------
+
+// una app de crow no se puede volver a levantar despues de stop: cada start
+// arma una nueva
+struct SensorEvents::Server {
+  crow::SimpleApp app;
+  std::future<void> running; // run_async: hay que guardarlo o run() bloquea
+  unsigned short port;
+};
+
+// puerto a usar: el pedido, EVENTS_PORT_ENV o EVENTS_DEFAULT_PORT. 0 = sin
+// servidor de eventos
+static unsigned short puertoPorDefecto(unsigned short pedido) {
+  if (pedido > 0) {
+    return pedido;
+  }
+  const char *env = std::getenv(EVENTS_PORT_ENV);
+  if (env && *env) {
+    int puerto = std::atoi(env);
+    return puerto > 0 && puerto < 65536 ? static_cast<unsigned short>(puerto)
+                                        : 0;
+  }
+  return EVENTS_DEFAULT_PORT;
+}
+
+SensorEvents::SensorEvents()
+    : m_server(), m_mutex(), m_clients(), m_clientCount(0), m_startMutex() {}
+
+SensorEvents::~SensorEvents() { stop(); }
+
+int SensorEvents::start(unsigned short port) {
+  std::lock_guard<std::mutex> lock(m_startMutex);
+  if (m_server) {
+    return m_server->port;
+  }
+  port = puertoPorDefecto(port);
+  if (port == 0) {
+    SLOG_INFO("events", "servidor de eventos deshabilitado (%s=0)",
+              EVENTS_PORT_ENV);
+    return -1;
+  }
+
+  // el logger de crow es global: se configura una vez, antes del primer
+  // servidor (sus hilos lo leen sin lock)
+  static std::once_flag logConfigurado;
+  std::call_once(logConfigurado, [] {
+    static CrowLog crowLog;
+    crow::logger::setHandler(&crowLog);
+    crow::logger::setLogLevel(crow::LogLevel::Warning);
+  });
+
+  std::unique_ptr<Server> server(new Server());
+  server->port = port;
+
+  CROW_WEBSOCKET_ROUTE(server->app, EVENTS_ROUTE)
+      .onopen([this](crow::websocket::connection &conn) {
+        addClient(&conn);
+      })
+      .onclose([this](crow::websocket::connection &conn,
+                      const std::string &, uint16_t) {
+        removeClient(&conn);
+      });
+
+  // el proceso es de Go: las señales (Ctrl+C) no son de crow
+  server->app.signal_clear();
+  server->app.port(port).concurrency(2);
+  server->running = server->app.run_async();
+  std::cv_status arranque = server->app.wait_for_server_start(
+      std::chrono::milliseconds(EVENTS_START_TIMEOUT_MS));
+
+  // si no pudo escuchar (puerto ocupado) el acceptor queda sin puerto y run()
+  // vuelve solo
+  if (arranque == std::cv_status::timeout || server->app.port() != port) {
+    server->app.stop();
+    try {
+      server->running.get();
+    } catch (const std::exception &e) {
+      SLOG_ERROR("events", "%s", e.what());
+    }
+    SLOG_ERROR("events", "no se pudo escuchar en el puerto %u",
+               static_cast<unsigned int>(port));
+    return -1;
+  }
+
+  m_server = std::move(server);
+  SLOG_INFO("events", "eventos en ws://0.0.0.0:%u%s",
+            static_cast<unsigned int>(port), EVENTS_ROUTE);
+  return port;
+}
+
+void SensorEvents::stop() {
+  std::lock_guard<std::mutex> lock(m_startMutex);
+  if (!m_server) {
+    return;
+  }
+
+  // desde aca nadie publica en las conexiones viejas
+  {
+    std::lock_guard<std::mutex> clientes(m_mutex);
+    m_clients.clear();
+    m_clientCount.store(0);
+  }
+
+  // stop le manda el close a cada totem (para que reconecte) y baja los hilos
+  m_server->app.stop();
+  try {
+    m_server->running.get();
+  } catch (const std::exception &e) {
+    SLOG_ERROR("events", "%s", e.what());
+  }
+  m_server.reset();
+
+  // por si se abrio alguna mientras se bajaba el servidor
+  std::lock_guard<std::mutex> clientes(m_mutex);
+  m_clients.clear();
+  m_clientCount.store(0);
+}
+
+bool SensorEvents::isRunning() const {
+  std::lock_guard<std::mutex> lock(m_startMutex);
+  return m_server != nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// Clientes y publicacion
+// -----------------------------------------------------------------------------
+void SensorEvents::addClient(void *conn) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_clients.insert(conn);
+  m_clientCount.store(static_cast<unsigned int>(m_clients.size()));
+}
+
+void SensorEvents::removeClient(void *conn) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_clients.erase(conn);
+  m_clientCount.store(static_cast<unsigned int>(m_clients.size()));
+}
+
+unsigned int SensorEvents::clientCount() const {
+  return m_clientCount.load(std::memory_order_relaxed);
+}
+
+// send_text solo encola el frame en el hilo de io de la conexion. crow llama
+// a onclose (que necesita m_mutex) antes de soltar la conexion, asi que con
+// m_mutex tomado los punteros del set siguen vivos
+void SensorEvents::publish(const std::string &json) {
+  if (clientCount() == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (std::set<void *>::iterator it = m_clients.begin();
+       it != m_clients.end(); ++it) {
+    static_cast<crow::websocket::connection *>(*it)->send_text(json);
+  }
+}
+
+void SensorEvents::publishDevice(const char *type, int device) {
+  if (clientCount() == 0) {
+    return;
+  }
+  char frame[96];
+  std::snprintf(frame, sizeof(frame), "{\"type\":\"%s\",\"lector\":%d}", type,
+                device);
+  publish(frame);
+}
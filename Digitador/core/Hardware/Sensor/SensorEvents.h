@@ -0,0 +1,70 @@
+// SensorEvents.h
+
+// eventos al totem por WebSocket: en vez de que cada totem pregunte por HTTP
+// cada 200 ms si hubo huella, el sensor le avisa apenas pasa algo. Cada
+// evento es un frame de texto JSON con al menos {"type": ..., "lector": N}.
+// El servidor (crow) corre en sus propios hilos; publicar desde el hilo de
+// captura o de identificacion solo encola el envio, nunca espera la red.
+//
+// crow se incluye solo en SensorEvents.cpp para no arrastrarlo (ni a asio)
+// a todo el que incluye Sensor.h
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#define EVENTS_DEFAULT_PORT 8081
+// puerto del servidor de eventos (si no se pasa uno a start). "0" = sin eventos
+#define EVENTS_PORT_ENV "DIGITADOR_EVENTS_PORT"
+#define EVENTS_ROUTE "/ws/eventos"
+#define EVENTS_START_TIMEOUT_MS 3000
+
+// tipos de evento. finger_detected y processing los publica el sensor;
+// approved y rejected los arma Go despues de registrar el ticket
+#define EVENT_FINGER_DETECTED "finger_detected"
+#define EVENT_PROCESSING "processing"
+#define EVENT_APPROVED "approved"
+#define EVENT_REJECTED "rejected"
+
+class SensorEvents {
+public:
+  SensorEvents();
+  ~SensorEvents();
+
+  // levantar el servidor (port 0 = EVENTS_PORT_ENV o EVENTS_DEFAULT_PORT).
+  // Devuelve el puerto en que quedo escuchando, o -1 si no se levanto
+  int start(unsigned short port);
+  void stop();
+  bool isRunning() const;
+
+  // mandar un frame JSON ya armado a todos los totems conectados
+  void publish(const std::string &json);
+
+  // {"type": type, "lector": device}. Sin totems conectados no arma nada
+  void publishDevice(const char *type, int device);
+
+  // totems conectados ahora
+  unsigned int clientCount() const;
+
+private:
+  struct Server; // crow::SimpleApp y su hilo (ver SensorEvents.cpp)
+  std::unique_ptr<Server> m_server;
+
+  // conexiones abiertas: las suman / quitan los handlers de crow. Publicar
+  // las recorre con m_mutex tomado, asi ninguna se cierra a mitad de envio
+  mutable std::mutex m_mutex;
+  std::set<void *> m_clients;
+  std::atomic<unsigned int> m_clientCount;
+
+  // arrancar / parar bajo m_startMutex (start y stop desde cualquier hilo)
+  mutable std::mutex m_startMutex;
+
+  void addClient(void *conn);
+  void removeClient(void *conn);
+
+  SensorEvents(const SensorEvents &) = delete;
+  SensorEvents &operator=(const SensorEvents &) = delete;
+};
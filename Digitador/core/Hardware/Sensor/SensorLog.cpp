@@ -0,0 +1,170 @@
+// SensorLog.cpp
+
+// ring buffer de log y su hilo de escritura
+#include "SensorLog.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+SensorLog &SensorLog::instance() {
+  static SensorLog log;
+  return log;
+}
+
+SensorLog::SensorLog()
+    : m_head(0), m_tail(0), m_written(0), m_dropped(0), m_droppedReported(0),
+      m_thread(), m_started(false), m_stop(false) {
+  for (unsigned long long i = 0; i < LOG_RING_SLOTS; ++i) {
+    m_slots[i].seq.store(i, std::memory_order_relaxed);
+  }
+}
+
+SensorLog::~SensorLog() {
+  m_stop.store(true, std::memory_order_release);
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  drain();
+}
+
+// -----------------------------------------------------------------------------
+// Productores (cualquier hilo, sin locks)
+// -----------------------------------------------------------------------------
+void SensorLog::write(int level, const LogFields &fields, const char *fmt,
+                      ...) {
+  if (!m_started.load(std::memory_order_acquire)) {
+    start();
+  }
+
+  // reservar un slot libre
+  unsigned long long pos = m_head.load(std::memory_order_relaxed);
+  Slot *slot = nullptr;
+  for (;;) {
+    slot = &m_slots[pos & (LOG_RING_SLOTS - 1)];
+    unsigned long long seq = slot->seq.load(std::memory_order_acquire);
+    long long diff = static_cast<long long>(seq - pos);
+    if (diff == 0) {
+      if (m_head.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // el hilo de escritura no da abasto: mejor perder la linea que frenar
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = m_head.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->level = level;
+  slot->fid = fields.fid;
+  slot->score = fields.score;
+  slot->us = fields.us;
+  std::strncpy(slot->op, fields.op ? fields.op : "", LOG_OP_SIZE - 1);
+  slot->op[LOG_OP_SIZE - 1] = '\0';
+
+  va_list args;
+  va_start(args, fmt);
+  std::vsnprintf(slot->msg, LOG_MSG_SIZE, fmt, args);
+  va_end(args);
+
+  // publicar el slot al hilo de escritura
+  slot->seq.store(pos + 1, std::memory_order_release);
+}
+
+unsigned long long SensorLog::dropped() const {
+  return m_dropped.load(std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------
+// Hilo de escritura
+// -----------------------------------------------------------------------------
+void SensorLog::start() {
+  bool esperado = false;
+  if (m_started.compare_exchange_strong(esperado, true,
+                                        std::memory_order_acq_rel)) {
+    m_thread = std::thread(&SensorLog::run, this);
+  }
+}
+
+void SensorLog::run() {
+  while (!m_stop.load(std::memory_order_acquire)) {
+    if (drain() == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(LOG_IDLE_MS));
+    }
+  }
+}
+
+// solo la llama el hilo de escritura (o el destructor, ya sin hilo)
+unsigned int SensorLog::drain() {
+  static const char *const prefijos[] = {"(-)", "(!)", "(+)", "(.)"};
+  unsigned int lineas = 0;
+
+  for (;;) {
+    Slot &slot = m_slots[m_tail & (LOG_RING_SLOTS - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != m_tail + 1) {
+      break;
+    }
+
+    int level = slot.level;
+    if (level < LOG_LEVEL_ERROR || level > LOG_LEVEL_DEBUG) {
+      level = LOG_LEVEL_INFO;
+    }
+    FILE *salida = level <= LOG_LEVEL_WARN ? stderr : stdout;
+    if (slot.op[0] != '\0') {
+      std::fprintf(salida, "%s [%s] %s", prefijos[level], slot.op, slot.msg);
+    } else {
+      std::fprintf(salida, "%s %s", prefijos[level], slot.msg);
+    }
+    if (slot.fid != LOG_NA) {
+      std::fprintf(salida, " fid=%lld", slot.fid);
+    }
+    if (slot.score != LOG_NA) {
+      std::fprintf(salida, " score=%lld", slot.score);
+    }
+    if (slot.us != LOG_NA) {
+      std::fprintf(salida, " us=%lld", slot.us);
+    }
+    std::fputc('\n', salida);
+
+    // devolver el slot a los productores
+    slot.seq.store(m_tail + LOG_RING_SLOTS, std::memory_order_release);
+    ++m_tail;
+    ++lineas;
+  }
+
+  unsigned long long perdidos = m_dropped.load(std::memory_order_relaxed);
+  if (perdidos != m_droppedReported) {
+    std::fprintf(stderr, "(!) [log] %llu mensajes descartados (ring lleno)\n",
+                 perdidos - m_droppedReported);
+    m_droppedReported = perdidos;
+    ++lineas;
+  }
+
+  if (lineas > 0) {
+    std::fflush(stdout);
+    std::fflush(stderr);
+    m_written.store(m_tail, std::memory_order_release);
+  }
+  return lineas;
+}
+
+// -----------------------------------------------------------------------------
+// Esperar a que salga lo pendiente
+// -----------------------------------------------------------------------------
+void SensorLog::flush() {
+  if (!m_started.load(std::memory_order_acquire)) {
+    return;
+  }
+  // lo reservado hasta ahora; si un productor quedo a medio escribir su slot
+  // no esperamos mas de un segundo
+  unsigned long long objetivo = m_head.load(std::memory_order_acquire);
+  std::chrono::steady_clock::time_point limite =
+      std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (m_written.load(std::memory_order_acquire) < objetivo &&
+         std::chrono::steady_clock::now() < limite) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
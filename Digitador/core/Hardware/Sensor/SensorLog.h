@@ -0,0 +1,115 @@
+// SensorLog.h
+
+// log asincrono de la capa C++ del sensor. Quien loguea solo formatea el
+// mensaje en un slot de un ring buffer preasignado (sin locks ni I/O) y un
+// hilo de fondo lo escribe a la consola. Asi un printf en el 1:N o en la
+// precarga no frena al lector.
+//
+// El nivel se filtra en compilacion: lo que quede sobre SENSOR_LOG_LEVEL
+// desaparece del binario. Para ver los mensajes de depuracion (cada template
+// agregado, cada identificacion) hay que compilar con
+//   CGO_CPPFLAGS=-DSENSOR_LOG_LEVEL=3
+//
+// Cada linea lleva la operacion y los campos que apliquen:
+//   (+) [identify] Huella identificada fid=12 score=87 us=412
+#pragma once
+
+#include <atomic>
+#include <cstdarg>
+#include <thread>
+
+#define LOG_LEVEL_ERROR 0 // (-) por stderr
+#define LOG_LEVEL_WARN 1  // (!) por stderr
+#define LOG_LEVEL_INFO 2  // (+) por stdout
+#define LOG_LEVEL_DEBUG 3 // (.) por stdout
+
+#ifndef SENSOR_LOG_LEVEL
+#define SENSOR_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SLOTS 1024 // potencia de 2
+#define LOG_MSG_SIZE 192
+#define LOG_OP_SIZE 16
+#define LOG_IDLE_MS 10 // espera del hilo cuando no hay nada que escribir
+#define LOG_NA -1      // campo que no aplica
+
+// campos estructurados de una linea (LOG_NA = no se imprime)
+struct LogFields {
+  const char *op;
+  long long fid;
+  long long score;
+  long long us;
+};
+
+// SENSOR_LOG(nivel, op, fid, score, us, formato, ...): el if es constante y
+// el compilador lo elimina si el nivel esta filtrado
+#define SENSOR_LOG(level, op, fid, score, us, ...)                            \
+  do {                                                                         \
+    if ((level) <= SENSOR_LOG_LEVEL) {                                         \
+      LogFields campos_ = {(op), (fid), (score), (us)};                        \
+      SensorLog::instance().write((level), campos_, __VA_ARGS__);              \
+    }                                                                          \
+  } while (0)
+
+#define SLOG_ERROR(op, ...)                                                    \
+  SENSOR_LOG(LOG_LEVEL_ERROR, op, LOG_NA, LOG_NA, LOG_NA, __VA_ARGS__)
+#define SLOG_WARN(op, ...)                                                     \
+  SENSOR_LOG(LOG_LEVEL_WARN, op, LOG_NA, LOG_NA, LOG_NA, __VA_ARGS__)
+#define SLOG_INFO(op, ...)                                                     \
+  SENSOR_LOG(LOG_LEVEL_INFO, op, LOG_NA, LOG_NA, LOG_NA, __VA_ARGS__)
+#define SLOG_DEBUG(op, ...)                                                    \
+  SENSOR_LOG(LOG_LEVEL_DEBUG, op, LOG_NA, LOG_NA, LOG_NA, __VA_ARGS__)
+
+class SensorLog {
+public:
+  // instancia unica; el hilo de escritura arranca con el primer mensaje
+  static SensorLog &instance();
+  ~SensorLog();
+
+  // encolar un mensaje (formato printf). Si el ring esta lleno el mensaje
+  // se descarta y se cuenta, nunca se bloquea
+  void write(int level, const LogFields &fields, const char *fmt, ...)
+#if defined(__GNUC__)
+      __attribute__((format(printf, 4, 5)))
+#endif
+      ;
+
+  // escribir todo lo pendiente antes de volver (al cerrar el sensor)
+  void flush();
+
+  // mensajes perdidos por ring lleno desde el arranque
+  unsigned long long dropped() const;
+
+private:
+  SensorLog();
+  SensorLog(const SensorLog &) = delete;
+  SensorLog &operator=(const SensorLog &) = delete;
+
+  // cola acotada multi-productor / un consumidor: cada slot tiene su numero
+  // de secuencia y los productores compiten por m_head con CAS
+  struct Slot {
+    std::atomic<unsigned long long> seq;
+    int level;
+    char op[LOG_OP_SIZE];
+    long long fid;
+    long long score;
+    long long us;
+    char msg[LOG_MSG_SIZE];
+  };
+
+  Slot m_slots[LOG_RING_SLOTS];
+  std::atomic<unsigned long long> m_head; // proximo slot a reservar
+  unsigned long long m_tail;              // proximo slot a escribir (hilo)
+  std::atomic<unsigned long long> m_written;
+  std::atomic<unsigned long long> m_dropped;
+  unsigned long long m_droppedReported;
+
+  std::thread m_thread;
+  std::atomic<bool> m_started;
+  std::atomic<bool> m_stop;
+
+  void start();
+  void run();
+  // escribir lo que haya en el ring; devuelve cuantas lineas salieron
+  unsigned int drain();
+};
@@ -0,0 +1,111 @@
+// SensorMetrics.cpp
+
+// histogramas y contadores del sensor con atomicos relajados
+#include "SensorMetrics.h"
+
+SensorMetrics::SensorMetrics() { reset(); }
+
+// -----------------------------------------------------------------------------
+// Buckets log-lineales
+// -----------------------------------------------------------------------------
+unsigned int SensorMetrics::bucketOf(unsigned long long us) {
+  if (us < METRICS_SUB_BUCKETS) {
+    return static_cast<unsigned int>(us);
+  }
+  // posicion del bit mas alto (us >= 4, asi que msb >= METRICS_SUB_BITS)
+  unsigned int msb = 0;
+  for (unsigned long long v = us; v > 1; v >>= 1) {
+    ++msb;
+  }
+  unsigned int sub = static_cast<unsigned int>(
+      (us >> (msb - METRICS_SUB_BITS)) & (METRICS_SUB_BUCKETS - 1));
+  unsigned int bucket =
+      METRICS_SUB_BUCKETS + (msb - METRICS_SUB_BITS) * METRICS_SUB_BUCKETS +
+      sub;
+  return bucket < METRICS_BUCKETS ? bucket : METRICS_BUCKETS - 1;
+}
+
+unsigned long long SensorMetrics::bucketUpperUs(unsigned int bucket) {
+  if (bucket < METRICS_SUB_BUCKETS) {
+    return bucket + 1;
+  }
+  unsigned int octava = (bucket - METRICS_SUB_BUCKETS) / METRICS_SUB_BUCKETS;
+  unsigned int sub = (bucket - METRICS_SUB_BUCKETS) % METRICS_SUB_BUCKETS;
+  unsigned int msb = octava + METRICS_SUB_BITS;
+  unsigned long long ancho = 1ull << (msb - METRICS_SUB_BITS);
+  return (1ull << msb) + (sub + 1) * ancho;
+}
+
+// -----------------------------------------------------------------------------
+// Registro (sin locks)
+// -----------------------------------------------------------------------------
+void SensorMetrics::record(SensorOp op, unsigned long long us) {
+  Histogram &h = m_ops[op];
+  h.count.fetch_add(1, std::memory_order_relaxed);
+  h.sumUs.fetch_add(us, std::memory_order_relaxed);
+  h.buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+
+  unsigned long long max = h.maxUs.load(std::memory_order_relaxed);
+  while (us > max &&
+         !h.maxUs.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+  }
+}
+
+void SensorMetrics::count(SensorCounter counter) {
+  m_counters[counter].fetch_add(1, std::memory_order_relaxed);
+}
+
+void SensorMetrics::setLastError(SensorOp op, int code) {
+  m_ops[op].lastError.store(code, std::memory_order_relaxed);
+}
+
+void SensorMetrics::identifyOutcome(bool hit, long long nowMs) {
+  long long ultimoFallo = m_lastMissMs.load(std::memory_order_relaxed);
+  if (ultimoFallo > 0 && nowMs - ultimoFallo <= METRICS_RETRY_WINDOW_MS) {
+    count(CNT_IDENTIFY_RETRY);
+  }
+  if (hit) {
+    count(CNT_IDENTIFY_HIT);
+    m_lastMissMs.store(0, std::memory_order_relaxed);
+  } else {
+    count(CNT_IDENTIFY_MISS);
+    m_lastMissMs.store(nowMs, std::memory_order_relaxed);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Foto / reinicio
+// -----------------------------------------------------------------------------
+void SensorMetrics::snapshot(MetricsSnapshot &out) const {
+  for (int op = 0; op < SENSOR_OP_COUNT; ++op) {
+    const Histogram &h = m_ops[op];
+    LatencySnapshot &s = out.ops[op];
+    s.count = h.count.load(std::memory_order_relaxed);
+    s.sumUs = h.sumUs.load(std::memory_order_relaxed);
+    s.maxUs = h.maxUs.load(std::memory_order_relaxed);
+    for (int b = 0; b < METRICS_BUCKETS; ++b) {
+      s.buckets[b] = h.buckets[b].load(std::memory_order_relaxed);
+    }
+    s.lastError = h.lastError.load(std::memory_order_relaxed);
+  }
+  for (int c = 0; c < SENSOR_COUNTER_COUNT; ++c) {
+    out.counters[c] = m_counters[c].load(std::memory_order_relaxed);
+  }
+}
+
+void SensorMetrics::reset() {
+  for (int op = 0; op < SENSOR_OP_COUNT; ++op) {
+    Histogram &h = m_ops[op];
+    h.count.store(0, std::memory_order_relaxed);
+    h.sumUs.store(0, std::memory_order_relaxed);
+    h.maxUs.store(0, std::memory_order_relaxed);
+    for (int b = 0; b < METRICS_BUCKETS; ++b) {
+      h.buckets[b].store(0, std::memory_order_relaxed);
+    }
+    h.lastError.store(0, std::memory_order_relaxed);
+  }
+  for (int c = 0; c < SENSOR_COUNTER_COUNT; ++c) {
+    m_counters[c].store(0, std::memory_order_relaxed);
+  }
+  m_lastMissMs.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,97 @@
+// SensorMetrics.h
+
+// metricas del sensor sin locks: un histograma de latencia por operacion y
+// contadores de resultados, todo con atomicos relajados para que medir no
+// frene la captura ni el 1:N. Una foto (snapshot) se copia al bridge para
+// que Go la muestre en el dashboard.
+//
+// Histograma log-lineal en microsegundos: los valores 0..3 tienen un bucket
+// cada uno y cada potencia de 2 desde 4 se parte en METRICS_SUB_BUCKETS
+// buckets iguales (error maximo ~25%). 128 buckets cubren mas de 2 horas.
+#pragma once
+
+#include <atomic>
+
+#define METRICS_BUCKETS 128
+#define METRICS_SUB_BITS 2
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BITS)
+// una identificacion fallida seguida de otra dentro de esta ventana cuenta
+// como reintento del mismo alumno
+#define METRICS_RETRY_WINDOW_MS 5000
+
+// operaciones con histograma
+enum SensorOp {
+  OP_ACQUIRE = 0,  // captura + extraccion exitosa del SDK
+  OP_IDENTIFY,     // 1:N (cache completa o grupo + ampliacion)
+  OP_MATCH,        // 1:1
+  OP_ENROLL,       // enrolamiento de tres capturas
+  OP_LOAD,         // carga masiva de la cache (lote o arena)
+  SENSOR_OP_COUNT
+};
+
+// contadores de resultados
+enum SensorCounter {
+  CNT_ACQUIRE_OK = 0,
+  CNT_ACQUIRE_NO_FINGER,  // lector vacio (ZKFP_ERR_CAPTURE)
+  CNT_ACQUIRE_BAD_IMAGE,  // dedo apoyado pero no se pudo extraer
+  CNT_ACQUIRE_ERROR,      // cualquier otro codigo del SDK
+  CNT_QUEUE_DROPPED,      // cola de capturas llena
+  CNT_STALE_DISCARDED,    // capturas que nadie pidio a tiempo
+  CNT_IDENTIFY_HIT,
+  CNT_IDENTIFY_MISS,
+  CNT_IDENTIFY_GROUP_HIT, // aciertos resueltos en el grupo de candidatos
+  CNT_IDENTIFY_RETRY,     // identificacion poco despues de un fallo
+  CNT_ENROLL_OK,
+  CNT_ENROLL_FAIL,
+  SENSOR_COUNTER_COUNT
+};
+
+// copia plana de un histograma
+struct LatencySnapshot {
+  unsigned long long count;
+  unsigned long long sumUs;
+  unsigned long long maxUs;
+  unsigned long long buckets[METRICS_BUCKETS];
+  // ultimo codigo de error (0 = ninguno): ZKFP_ERR_* del SDK, o ENROLL_ERR_*
+  // en el enrolamiento
+  int lastError;
+};
+
+struct MetricsSnapshot {
+  LatencySnapshot ops[SENSOR_OP_COUNT];
+  unsigned long long counters[SENSOR_COUNTER_COUNT];
+};
+
+class SensorMetrics {
+public:
+  SensorMetrics();
+
+  // sumar una duracion a la operacion
+  void record(SensorOp op, unsigned long long us);
+  void count(SensorCounter counter);
+  void setLastError(SensorOp op, int code);
+
+  // marcar el resultado de una identificacion (cuenta los reintentos)
+  void identifyOutcome(bool hit, long long nowMs);
+
+  // copia de todo (cada valor es atomico, la foto en conjunto no)
+  void snapshot(MetricsSnapshot &out) const;
+  void reset();
+
+  // bucket de un valor y limite superior (exclusivo) de un bucket, en us
+  static unsigned int bucketOf(unsigned long long us);
+  static unsigned long long bucketUpperUs(unsigned int bucket);
+
+private:
+  struct Histogram {
+    std::atomic<unsigned long long> count;
+    std::atomic<unsigned long long> sumUs;
+    std::atomic<unsigned long long> maxUs;
+    std::atomic<unsigned long long> buckets[METRICS_BUCKETS];
+    std::atomic<int> lastError;
+  };
+
+  Histogram m_ops[SENSOR_OP_COUNT];
+  std::atomic<unsigned long long> m_counters[SENSOR_COUNTER_COUNT];
+  std::atomic<long long> m_lastMissMs;
+};
@@ -0,0 +1,363 @@
+// ShardedCache.cpp
+
+// cache 1:N repartida en shards con identificacion en paralelo
+#include "ShardedCache.h"
+
+#include <chrono>
+
+// lock de escritura y de lectura sobre un shared_timed_mutex (m_mutex) y el
+// lock de un shard (o de la cache de comparacion)
+typedef std::unique_lock<std::shared_timed_mutex> Exclusivo;
+typedef std::shared_lock<std::shared_timed_mutex> Compartido;
+typedef std::lock_guard<std::mutex> Turno;
+
+ShardedCache::ShardedCache(SensorBackend *backend)
+    : m_backend(backend), m_count(0), m_matchHandle(nullptr), m_matchMutex(),
+      m_mutex(), m_workers(), m_poolMutex(),
+      m_workCv(), m_doneCv(), m_jobs(), m_generation(0), m_stop(false) {
+  for (unsigned int i = 0; i < MAX_DB_SHARDS; ++i) {
+    m_shards[i].handle = nullptr;
+  }
+}
+
+ShardedCache::~ShardedCache() { free(); }
+
+// -----------------------------------------------------------------------------
+// Crear / liberar los shards
+// -----------------------------------------------------------------------------
+bool ShardedCache::init(unsigned int shards) {
+  free();
+  if (!m_backend) {
+    return false;
+  }
+  if (shards < 1) {
+    shards = 1;
+  }
+  if (shards > MAX_DB_SHARDS) {
+    shards = MAX_DB_SHARDS;
+  }
+
+  Exclusivo lock(m_mutex);
+  m_matchHandle = m_backend->dbInit();
+  if (!m_matchHandle) {
+    return false;
+  }
+  for (unsigned int i = 0; i < shards; ++i) {
+    Shard &shard = m_shards[i];
+    shard.handle = m_backend->dbInit();
+    if (!shard.handle) {
+      // liberamos lo que alcanzamos a crear
+      for (unsigned int j = 0; j < i; ++j) {
+        m_backend->dbFree(m_shards[j].handle);
+        m_shards[j].handle = nullptr;
+      }
+      m_backend->dbFree(m_matchHandle);
+      m_matchHandle = nullptr;
+      return false;
+    }
+    shard.templates.store(0);
+    shard.identifies.store(0);
+    shard.lastUs.store(0);
+    shard.totalUs.store(0);
+    shard.maxUs.store(0);
+  }
+  m_count = shards;
+
+  // el shard 0 lo recorre el hilo que llama a identify. Los hilos parten
+  // desde la generacion actual para no correr un probe viejo
+  unsigned long long generacion;
+  {
+    std::lock_guard<std::mutex> pool(m_poolMutex);
+    m_stop = false;
+    generacion = m_generation;
+  }
+  for (unsigned int i = 1; i < shards; ++i) {
+    m_workers.push_back(
+        std::thread(&ShardedCache::workerLoop, this, i, generacion));
+  }
+  return true;
+}
+
+void ShardedCache::free() {
+  // esperamos a que terminen las identificaciones en curso
+  Exclusivo lock(m_mutex);
+
+  {
+    std::lock_guard<std::mutex> pool(m_poolMutex);
+    m_stop = true;
+  }
+  m_workCv.notify_all();
+  for (size_t i = 0; i < m_workers.size(); ++i) {
+    m_workers[i].join();
+  }
+  m_workers.clear();
+
+  for (unsigned int i = 0; i < m_count; ++i) {
+    m_backend->dbFree(m_shards[i].handle);
+    m_shards[i].handle = nullptr;
+  }
+  m_count = 0;
+  if (m_matchHandle) {
+    m_backend->dbFree(m_matchHandle);
+    m_matchHandle = nullptr;
+  }
+}
+
+bool ShardedCache::isReady() const { return m_count > 0; }
+
+unsigned int ShardedCache::shardCount() const { return m_count; }
+
+
+// -----------------------------------------------------------------------------
+// Agregar / identificar
+// -----------------------------------------------------------------------------
+int ShardedCache::add(unsigned int fid, const unsigned char *fpTemplate,
+                      unsigned int cbTemplate) {
+  Compartido lock(m_mutex);
+  if (m_count == 0) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  Shard &shard = m_shards[fid % m_count];
+  Turno turno(shard.lock);
+  int ret = m_backend->dbAdd(shard.handle, fid, fpTemplate, cbTemplate);
+  if (ret == ZKFP_ERR_OK) {
+    shard.templates++;
+  }
+  return ret;
+}
+
+int ShardedCache::remove(unsigned int fid) {
+  Compartido lock(m_mutex);
+  if (m_count == 0) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  Shard &shard = m_shards[fid % m_count];
+  Turno turno(shard.lock);
+  int ret = m_backend->dbDel(shard.handle, fid);
+  if (ret == ZKFP_ERR_OK && shard.templates.load() > 0) {
+    shard.templates--;
+  }
+  return ret;
+}
+
+int ShardedCache::replace(unsigned int fid, const unsigned char *fpTemplate,
+                          unsigned int cbTemplate) {
+  Compartido lock(m_mutex);
+  if (m_count == 0) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  Shard &shard = m_shards[fid % m_count];
+  Turno turno(shard.lock);
+  // el SDK no pisa un fid existente: si no estaba, el dbDel falla y da igual
+  bool estaba = m_backend->dbDel(shard.handle, fid) == ZKFP_ERR_OK;
+  int ret = m_backend->dbAdd(shard.handle, fid, fpTemplate, cbTemplate);
+  if (ret == ZKFP_ERR_OK) {
+    if (!estaba) {
+      shard.templates++;
+    }
+    return ret;
+  }
+  // un alta fallida no deja nada a medias: nos aseguramos de que el fid no
+  // quede en el shard (quien llama deshace su mapeo)
+  if (m_backend->dbDel(shard.handle, fid) == ZKFP_ERR_OK) {
+    estaba = true;
+  }
+  if (estaba && shard.templates.load() > 0) {
+    shard.templates--;
+  }
+  return ret;
+}
+
+int ShardedCache::clear() {
+  Compartido lock(m_mutex);
+  int ret = ZKFP_ERR_OK;
+  for (unsigned int i = 0; i < m_count; ++i) {
+    Turno turno(m_shards[i].lock);
+    int r = m_backend->dbClear(m_shards[i].handle);
+    if (r == ZKFP_ERR_OK) {
+      m_shards[i].templates.store(0);
+    } else {
+      ret = r;
+    }
+  }
+  return ret;
+}
+
+int ShardedCache::count(unsigned int *total) {
+  Compartido lock(m_mutex);
+  *total = 0;
+  for (unsigned int i = 0; i < m_count; ++i) {
+    Turno turno(m_shards[i].lock);
+    unsigned int n = 0;
+    int ret = m_backend->dbCount(m_shards[i].handle, &n);
+    if (ret != ZKFP_ERR_OK) {
+      return ret;
+    }
+    *total += n;
+  }
+  return ZKFP_ERR_OK;
+}
+
+int ShardedCache::identify(const unsigned char *fpTemplate,
+                           unsigned int cbTemplate, unsigned int *fid,
+                           unsigned int *score) {
+  Compartido lock(m_mutex);
+  if (m_count == 0) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+
+  Job job;
+  job.probe = TemplateView(fpTemplate, cbTemplate);
+
+  // K = 1: sin pool, directo sobre la unica cache
+  if (m_workers.empty()) {
+    runShard(0, job.probe, job.results[0]);
+  } else {
+    // encolamos para el pool y recorremos el shard 0 mientras tanto
+    {
+      std::lock_guard<std::mutex> pool(m_poolMutex);
+      job.seq = ++m_generation;
+      job.pending = static_cast<unsigned int>(m_workers.size());
+      m_jobs.push_back(&job);
+    }
+    m_workCv.notify_all();
+    runShard(0, job.probe, job.results[0]);
+
+    std::unique_lock<std::mutex> pool(m_poolMutex);
+    m_doneCv.wait(pool, [&job] { return job.pending == 0; });
+    for (std::deque<Job *>::iterator it = m_jobs.begin(); it != m_jobs.end();
+         ++it) {
+      if (*it == &job) {
+        m_jobs.erase(it);
+        break;
+      }
+    }
+  }
+
+  // gana el mejor score entre los shards que acertaron
+  int ret = job.results[0].ret;
+  bool encontrado = false;
+  for (unsigned int i = 0; i < m_count; ++i) {
+    const ShardResult &r = job.results[i];
+    if (r.ret != ZKFP_ERR_OK) {
+      continue;
+    }
+    if (!encontrado || r.score > *score) {
+      *fid = r.fid;
+      *score = r.score;
+      encontrado = true;
+    }
+  }
+  return encontrado ? ZKFP_ERR_OK : ret;
+}
+
+int ShardedCache::match(const unsigned char *template1,
+                        unsigned int cbTemplate1,
+                        const unsigned char *template2,
+                        unsigned int cbTemplate2) {
+  Compartido lock(m_mutex);
+  if (!m_matchHandle) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  Turno turno(m_matchMutex);
+  return m_backend->dbMatch(m_matchHandle, template1, cbTemplate1, template2,
+                            cbTemplate2);
+}
+
+int ShardedCache::merge(const unsigned char *template1,
+                        unsigned int cbTemplate1,
+                        const unsigned char *template2,
+                        unsigned int cbTemplate2,
+                        const unsigned char *template3,
+                        unsigned int cbTemplate3, unsigned char *regTemp,
+                        unsigned int *cbRegTemp) {
+  Compartido lock(m_mutex);
+  if (!m_matchHandle) {
+    return ZKFP_ERR_INVALID_HANDLE;
+  }
+  Turno turno(m_matchMutex);
+  return m_backend->dbMerge(m_matchHandle, template1, cbTemplate1, template2,
+                            cbTemplate2, template3, cbTemplate3, regTemp,
+                            cbRegTemp);
+}
+
+void ShardedCache::stats(std::vector<ShardStats> &out) const {
+  Compartido lock(m_mutex);
+  out.clear();
+  for (unsigned int i = 0; i < m_count; ++i) {
+    const Shard &shard = m_shards[i];
+    ShardStats s;
+    s.templates = shard.templates.load();
+    s.identifies = shard.identifies.load();
+    s.lastUs = shard.lastUs.load();
+    s.totalUs = shard.totalUs.load();
+    s.maxUs = shard.maxUs.load();
+    out.push_back(s);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Pool de hilos
+// -----------------------------------------------------------------------------
+
+// cada hilo recorre los Job en el orden en que se encolaron. Un Job sale de la
+// cola solo cuando todos los hilos lo terminaron, asi que el siguiente de este
+// hilo (seq visto + 1) siempre sigue ahi
+void ShardedCache::workerLoop(unsigned int shard,
+                              unsigned long long visto) {
+  std::unique_lock<std::mutex> pool(m_poolMutex);
+  for (;;) {
+    m_workCv.wait(pool, [&] { return m_stop || m_generation != visto; });
+    if (m_stop) {
+      return;
+    }
+    Job *job = nullptr;
+    for (size_t i = 0; i < m_jobs.size(); ++i) {
+      if (m_jobs[i]->seq == visto + 1) {
+        job = m_jobs[i];
+        break;
+      }
+    }
+    ++visto;
+    if (!job) {
+      continue;
+    }
+
+    pool.unlock();
+    runShard(shard, job->probe, job->results[shard]);
+    pool.lock();
+
+    if (--job->pending == 0) {
+      m_doneCv.notify_all();
+    }
+  }
+}
+
+// cada identificacion escribe en su propio ShardResult: solo se lee el shard
+void ShardedCache::runShard(unsigned int shard, TemplateView probe,
+                            ShardResult &out) {
+  Shard &s = m_shards[shard];
+  std::chrono::steady_clock::time_point inicio =
+      std::chrono::steady_clock::now();
+
+  out.fid = 0;
+  out.score = 0;
+  {
+    // exclusivo: dos identificaciones se turnan este shard, pero cada una
+    // recorre los demas en paralelo
+    Turno turno(s.lock);
+    out.ret = m_backend->dbIdentify(s.handle, probe.data, probe.size,
+                                    &out.fid, &out.score);
+  }
+
+  unsigned long long us = static_cast<unsigned long long>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - inicio)
+          .count());
+  s.identifies++;
+  s.lastUs.store(us);
+  s.totalUs += us;
+  unsigned long long maximo = s.maxUs.load();
+  while (us > maximo && !s.maxUs.compare_exchange_weak(maximo, us)) {
+  }
+}
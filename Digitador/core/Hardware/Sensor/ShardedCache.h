@@ -0,0 +1,146 @@
+// ShardedCache.h
+
+// cache 1:N repartida en K caches del SDK (shards). Cada template va al shard
+// fid % K y una identificacion consulta todos los shards en paralelo con un
+// pool fijo de hilos: gana el mejor score. Cada shard ya filtra con el umbral
+// 1:N del SDK (FP_MTHRESHOLD_CODE), asi que cualquier acierto es valido.
+// Con K = 1 no se crean hilos y se identifica directo sobre la unica cache.
+//
+// Cada shard tiene su propio lock y toda llamada al SDK sobre su handle lo
+// toma exclusivo: nada garantiza que ZKFPM_DBIdentify se pueda llamar desde
+// dos hilos sobre la misma cache. El paralelismo esta entre shards: dos
+// identificaciones se cruzan recorriendo shards distintos y un alta solo
+// espera a su shard, no a todo el 1:N.
+//
+// Las comparaciones 1:1 y la fusion del enrolamiento (DBMatch / DBMerge)
+// usan una cache del SDK aparte, sin templates, con su propio lock: no
+// esperan a las identificaciones ni las frenan.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "SensorBackend.h"
+#include "TemplateView.h"
+
+#define MAX_DB_SHARDS 16
+#define DEFAULT_MAX_DB_SHARDS 4 // tope cuando se usa un shard por nucleo
+
+// tiempos de un shard (microsegundos), para ver que la latencia no crece al
+// sumar alumnos
+struct ShardStats {
+  unsigned int templates;      // templates en el shard
+  unsigned long long identifies;
+  unsigned long long lastUs;
+  unsigned long long totalUs;
+  unsigned long long maxUs;
+};
+
+class ShardedCache {
+public:
+  explicit ShardedCache(SensorBackend *backend);
+  ~ShardedCache();
+
+  // crear las K caches del SDK y los K - 1 hilos (el shard 0 lo recorre el
+  // hilo que identifica). false si alguna cache no se pudo crear
+  bool init(unsigned int shards);
+  void free();
+  bool isReady() const;
+
+  unsigned int shardCount() const;
+
+  // agregar al shard que le corresponde al fid
+  int add(unsigned int fid, const unsigned char *fpTemplate,
+          unsigned int cbTemplate);
+
+  // quitar un fid de su shard
+  int remove(unsigned int fid);
+
+  // cambiar el template de un fid (lo agrega si no estaba): quitar y agregar
+  // con el shard tomado una sola vez, asi ninguna identificacion lo ve a
+  // medias. Si el alta falla el fid queda fuera del shard (el SDK no permite
+  // leer el template viejo para devolverlo)
+  int replace(unsigned int fid, const unsigned char *fpTemplate,
+              unsigned int cbTemplate);
+
+  // vaciar todos los shards (las caches siguen creadas)
+  int clear();
+
+  // templates en todas las caches (segun el SDK)
+  int count(unsigned int *total);
+
+  // buscar en todos los shards en paralelo. ZKFP_ERR_OK si alguno acerto.
+  // Se puede llamar desde varios hilos a la vez
+  int identify(const unsigned char *fpTemplate, unsigned int cbTemplate,
+               unsigned int *fid, unsigned int *score);
+
+  // comparar 1:1 (score o codigo negativo del SDK). Se puede llamar desde
+  // varios hilos: se turnan la cache de comparacion
+  int match(const unsigned char *template1, unsigned int cbTemplate1,
+            const unsigned char *template2, unsigned int cbTemplate2);
+
+  // fusionar tres capturas en un template de registro (ver
+  // SensorBackend::dbMerge)
+  int merge(const unsigned char *template1, unsigned int cbTemplate1,
+            const unsigned char *template2, unsigned int cbTemplate2,
+            const unsigned char *template3, unsigned int cbTemplate3,
+            unsigned char *regTemp, unsigned int *cbRegTemp);
+
+  // copia de los tiempos por shard
+  void stats(std::vector<ShardStats> &out) const;
+
+private:
+  struct Shard {
+    void *handle;
+    // toda llamada al SDK sobre handle (identify, add, remove, ...)
+    std::mutex lock;
+    // tiempos: los actualizan identificaciones concurrentes
+    std::atomic<unsigned int> templates;
+    std::atomic<unsigned long long> identifies;
+    std::atomic<unsigned long long> lastUs;
+    std::atomic<unsigned long long> totalUs;
+    std::atomic<unsigned long long> maxUs;
+  };
+
+  // resultado de un shard para una identificacion
+  struct ShardResult {
+    int ret;
+    unsigned int fid;
+    unsigned int score;
+  };
+
+  // una identificacion en curso: vive en la pila de quien llamo a identify
+  // hasta que todos los hilos del pool la recorrieron
+  struct Job {
+    unsigned long long seq;
+    TemplateView probe;
+    unsigned int pending; // bajo m_poolMutex
+    ShardResult results[MAX_DB_SHARDS];
+  };
+
+  SensorBackend *m_backend;
+  Shard m_shards[MAX_DB_SHARDS];
+  unsigned int m_count; // shards creados
+  // cache sin templates para DBMatch / DBMerge, una llamada a la vez
+  void *m_matchHandle;
+  std::mutex m_matchMutex;
+  // compartido para operar, exclusivo para crear / liberar los shards
+  mutable std::shared_timed_mutex m_mutex;
+
+  // pool fijo: el hilo del shard i recorre en orden cada Job de la cola
+  std::vector<std::thread> m_workers;
+  std::mutex m_poolMutex;
+  std::condition_variable m_workCv;
+  std::condition_variable m_doneCv;
+  std::deque<Job *> m_jobs;
+  unsigned long long m_generation; // seq del ultimo Job encolado
+  bool m_stop;
+
+  void workerLoop(unsigned int shard, unsigned long long visto);
+  void runShard(unsigned int shard, TemplateView probe, ShardResult &out);
+};
@@ -0,0 +1,452 @@
+// TemplateArena.cpp
+
+// arena de templates en disco, mapeada en memoria para la carga masiva
+#include "TemplateArena.h"
+#include "Crc32.h"
+#include "SensorLog.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(ArenaHeader) == 24, "ArenaHeader debe medir 24 bytes");
+static_assert(sizeof(ArenaRecord) == 16, "ArenaRecord debe medir 16 bytes");
+
+// compactamos cuando los registros muertos superan a los vivos (con holgura
+// para no reescribir por unos pocos reemplazos)
+#define ARENA_COMPACT_SLACK 64
+
+// cada registro ocupa un multiplo de 4 bytes
+static size_t largoRegistro(unsigned int runLen, unsigned int size) {
+  size_t largo = sizeof(ArenaRecord) + runLen + size;
+  return (largo + 3) & ~static_cast<size_t>(3);
+}
+
+static ArenaHeader headerVacio() {
+  ArenaHeader h;
+  h.magic = ARENA_MAGIC;
+  h.version = ARENA_VERSION;
+  h.records = 0;
+  h.reserved = 0;
+  h.dataBytes = 0;
+  return h;
+}
+
+TemplateArena::TemplateArena()
+    : m_path(), m_file(nullptr), m_header(headerVacio()), m_index(),
+      m_liveBytes(0), m_liveChecksum(0), m_maxFid(0), m_map(nullptr),
+      m_mapSize(0),
+      m_mapHandle(nullptr), m_entries() {}
+
+TemplateArena::~TemplateArena() { close(); }
+
+// -----------------------------------------------------------------------------
+// Abrir / cerrar
+// -----------------------------------------------------------------------------
+bool TemplateArena::open(const std::string &path) {
+  close();
+  m_path = path;
+
+  // abrimos para lectura/escritura, o creamos el archivo si no existe
+  m_file = std::fopen(path.c_str(), "r+b");
+  if (!m_file) {
+    return reset();
+  }
+
+  // mapeamos y validamos; si no es una arena valida empezamos vacio
+  if (!mapFile() || !scan()) {
+    SLOG_WARN("arena", "Arena de templates invalida, se reconstruye: %s",
+              path.c_str());
+    return reset();
+  }
+
+  // demasiados registros reemplazados o dados de baja?
+  if (m_header.records > 2 * m_index.size() + ARENA_COMPACT_SLACK) {
+    if (!compact()) {
+      SLOG_WARN("arena", "No se pudo compactar la arena de templates.");
+    }
+  }
+  return true;
+}
+
+void TemplateArena::close() {
+  unmap();
+  if (m_file) {
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+  m_header = headerVacio();
+  m_index.clear();
+  m_liveBytes = 0;
+  m_liveChecksum = 0;
+  m_maxFid = 0;
+}
+
+bool TemplateArena::isOpen() const { return m_file != nullptr; }
+
+const std::vector<TemplateArena::Entry> &TemplateArena::entries() const {
+  return m_entries;
+}
+
+const std::map<std::string, TemplateArena::Live> &TemplateArena::index() const {
+  return m_index;
+}
+
+// -----------------------------------------------------------------------------
+// Mapeo del archivo
+// -----------------------------------------------------------------------------
+bool TemplateArena::mapFile() {
+  unmap();
+  std::fflush(m_file);
+
+#ifdef _WIN32
+  HANDLE archivo =
+      CreateFileA(m_path.c_str(), GENERIC_READ,
+                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (archivo == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER largo;
+  if (!GetFileSizeEx(archivo, &largo) ||
+      largo.QuadPart < static_cast<LONGLONG>(sizeof(ArenaHeader))) {
+    CloseHandle(archivo);
+    return false;
+  }
+  HANDLE mapping =
+      CreateFileMappingA(archivo, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  // el mapping mantiene vivo el archivo, el handle ya no hace falta
+  CloseHandle(archivo);
+  if (!mapping) {
+    return false;
+  }
+  void *vista = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!vista) {
+    CloseHandle(mapping);
+    return false;
+  }
+  m_mapHandle = mapping;
+  m_map = static_cast<const unsigned char *>(vista);
+  m_mapSize = static_cast<size_t>(largo.QuadPart);
+#else
+  int fd = ::open(m_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      st.st_size < static_cast<off_t>(sizeof(ArenaHeader))) {
+    ::close(fd);
+    return false;
+  }
+  void *vista = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                     MAP_SHARED, fd, 0);
+  // el mapeo sigue valido despues de cerrar el descriptor
+  ::close(fd);
+  if (vista == MAP_FAILED) {
+    return false;
+  }
+  m_map = static_cast<const unsigned char *>(vista);
+  m_mapSize = static_cast<size_t>(st.st_size);
+#endif
+  return true;
+}
+
+void TemplateArena::unmap() {
+  m_entries.clear();
+  if (!m_map) {
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(m_map);
+  CloseHandle(static_cast<HANDLE>(m_mapHandle));
+  m_mapHandle = nullptr;
+#else
+  munmap(const_cast<unsigned char *>(m_map), m_mapSize);
+#endif
+  m_map = nullptr;
+  m_mapSize = 0;
+}
+
+// -----------------------------------------------------------------------------
+// Recorrer los registros y armar el indice
+// -----------------------------------------------------------------------------
+bool TemplateArena::scan() {
+  std::memcpy(&m_header, m_map, sizeof(ArenaHeader));
+  if (m_header.magic != ARENA_MAGIC || m_header.version != ARENA_VERSION) {
+    return false;
+  }
+
+  // un agregado cortado a la mitad (corte de luz) queda fuera de dataBytes,
+  // pero igual no leemos mas alla del archivo
+  size_t fin = sizeof(ArenaHeader);
+  if (m_header.dataBytes <= m_mapSize - sizeof(ArenaHeader)) {
+    fin += static_cast<size_t>(m_header.dataBytes);
+  } else {
+    fin = m_mapSize;
+  }
+
+  // ultimo registro de cada run (el que manda) y su posicion
+  struct Ultimo {
+    unsigned int fid;
+    unsigned int size;
+    unsigned int crc;
+    size_t offset;
+  };
+  std::map<std::string, Ultimo> ultimos;
+  unsigned int registros = 0;
+
+  size_t pos = sizeof(ArenaHeader);
+  while (pos + sizeof(ArenaRecord) <= fin) {
+    ArenaRecord rec;
+    std::memcpy(&rec, m_map + pos, sizeof(ArenaRecord));
+    size_t largo = largoRegistro(rec.runLen, rec.size);
+    if (rec.runLen == 0 || rec.runLen > ARENA_MAX_RUN_LEN ||
+        pos + largo > fin) {
+      break; // registro incompleto o basura: lo que sigue no es confiable
+    }
+    std::string run(reinterpret_cast<const char *>(m_map + pos) +
+                        sizeof(ArenaRecord),
+                    rec.runLen);
+    Ultimo &u = ultimos[run];
+    u.fid = rec.fid;
+    u.size = rec.size;
+    u.crc = rec.crc;
+    u.offset = pos + sizeof(ArenaRecord) + rec.runLen;
+    pos += largo;
+    ++registros;
+  }
+  m_header.dataBytes = pos - sizeof(ArenaHeader);
+  m_header.records = registros;
+
+  // indice de vivos y vistas en el orden del archivo
+  std::map<size_t, Entry> porOffset;
+  for (std::map<std::string, Ultimo>::const_iterator it = ultimos.begin();
+       it != ultimos.end(); ++it) {
+    const Ultimo &u = it->second;
+    if (u.size == 0) {
+      continue; // baja
+    }
+    Live live;
+    live.fid = u.fid;
+    live.size = u.size;
+    live.crc = u.crc;
+    m_index[it->first] = live;
+    m_liveBytes += u.size;
+    m_liveChecksum += live.crc;
+    if (u.fid > m_maxFid) {
+      m_maxFid = u.fid;
+    }
+    Entry e;
+    e.fid = u.fid;
+    e.run = it->first;
+    e.tpl = TemplateView(m_map + u.offset, u.size);
+    porOffset[u.offset] = e;
+  }
+  m_entries.reserve(porOffset.size());
+  for (std::map<size_t, Entry>::const_iterator it = porOffset.begin();
+       it != porOffset.end(); ++it) {
+    m_entries.push_back(it->second);
+  }
+  return true;
+}
+
+// reescribe el archivo solo con los registros vivos y lo vuelve a mapear
+bool TemplateArena::compact() {
+  std::string tmp = m_path + ".tmp";
+  std::FILE *f = std::fopen(tmp.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+
+  ArenaHeader h = headerVacio();
+  bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+  static const unsigned char relleno[4] = {0, 0, 0, 0};
+  for (size_t i = 0; ok && i < m_entries.size(); ++i) {
+    const Entry &e = m_entries[i];
+    ArenaRecord rec;
+    rec.fid = e.fid;
+    rec.size = e.tpl.size;
+    rec.runLen = static_cast<unsigned short>(e.run.size());
+    rec.flags = 0;
+    std::map<std::string, Live>::const_iterator vivo = m_index.find(e.run);
+    rec.crc = vivo != m_index.end() ? vivo->second.crc
+                                    : crc32Bytes(e.tpl.data, e.tpl.size);
+    size_t largo = largoRegistro(rec.runLen, rec.size);
+    size_t sobra = largo - sizeof(rec) - rec.runLen - rec.size;
+    ok = std::fwrite(&rec, sizeof(rec), 1, f) == 1 &&
+         std::fwrite(e.run.data(), 1, e.run.size(), f) == e.run.size() &&
+         std::fwrite(e.tpl.data, 1, e.tpl.size, f) == e.tpl.size &&
+         std::fwrite(relleno, 1, sobra, f) == sobra;
+    h.records++;
+    h.dataBytes += largo;
+  }
+  if (ok) {
+    ok = std::fseek(f, 0, SEEK_SET) == 0 &&
+         std::fwrite(&h, sizeof(h), 1, f) == 1;
+  }
+  ok = std::fclose(f) == 0 && ok;
+  if (!ok) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+
+  // reemplazamos el archivo (en Windows rename no pisa uno existente)
+  std::string path = m_path;
+  close();
+  std::remove(path.c_str());
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    return false;
+  }
+  m_path = path;
+  m_file = std::fopen(path.c_str(), "r+b");
+  return m_file && mapFile() && scan();
+}
+
+// -----------------------------------------------------------------------------
+// Escritura incremental
+// -----------------------------------------------------------------------------
+bool TemplateArena::put(const std::string &run, unsigned int fid,
+                        TemplateView tpl) {
+  if (tpl.empty()) {
+    return false;
+  }
+  unsigned int crc = crc32Bytes(tpl.data, tpl.size);
+  if (!writeRecord(run, fid, tpl, crc)) {
+    return false;
+  }
+  indexLive(run, fid, tpl.size, crc);
+  return writeHeader();
+}
+
+int TemplateArena::putMany(const std::vector<Entry> &entradas) {
+  int escritos = 0;
+  for (size_t i = 0; i < entradas.size(); ++i) {
+    const Entry &e = entradas[i];
+    if (e.tpl.empty()) {
+      continue;
+    }
+    unsigned int crc = crc32Bytes(e.tpl.data, e.tpl.size);
+    if (!writeRecord(e.run, e.fid, e.tpl, crc)) {
+      continue;
+    }
+    indexLive(e.run, e.fid, e.tpl.size, crc);
+    ++escritos;
+  }
+  // un solo header (y un solo flush) para todo el lote
+  if (escritos > 0 && !writeHeader()) {
+    return -1;
+  }
+  return escritos;
+}
+
+void TemplateArena::indexLive(const std::string &run, unsigned int fid,
+                              unsigned int size, unsigned int crc) {
+  std::map<std::string, Live>::iterator it = m_index.find(run);
+  if (it != m_index.end()) {
+    m_liveBytes -= it->second.size;
+    m_liveChecksum -= it->second.crc;
+  }
+  Live live;
+  live.fid = fid;
+  live.size = size;
+  live.crc = crc;
+  m_index[run] = live;
+  m_liveBytes += live.size;
+  m_liveChecksum += live.crc;
+  if (fid > m_maxFid) {
+    m_maxFid = fid;
+  }
+}
+
+bool TemplateArena::remove(const std::string &run) {
+  std::map<std::string, Live>::iterator it = m_index.find(run);
+  if (it == m_index.end()) {
+    return true;
+  }
+  if (!writeRecord(run, it->second.fid, TemplateView(), 0)) {
+    return false;
+  }
+  m_liveBytes -= it->second.size;
+  m_liveChecksum -= it->second.crc;
+  m_index.erase(it);
+  return writeHeader();
+}
+
+bool TemplateArena::reset() {
+  std::string path = m_path;
+  close();
+  m_path = path;
+  if (path.empty()) {
+    return false;
+  }
+  m_file = std::fopen(path.c_str(), "w+b");
+  if (!m_file) {
+    SLOG_ERROR("arena", "No se pudo crear la arena de templates: %s",
+               path.c_str());
+    return false;
+  }
+  return writeHeader();
+}
+
+bool TemplateArena::writeRecord(const std::string &run, unsigned int fid,
+                                TemplateView tpl, unsigned int crc) {
+  if (!m_file || run.empty() || run.size() > ARENA_MAX_RUN_LEN) {
+    return false;
+  }
+
+  ArenaRecord rec;
+  rec.fid = fid;
+  rec.size = tpl.empty() ? 0 : tpl.size;
+  rec.runLen = static_cast<unsigned short>(run.size());
+  rec.flags = 0;
+  rec.crc = tpl.empty() ? 0 : crc;
+  size_t largo = largoRegistro(rec.runLen, rec.size);
+  size_t sobra = largo - sizeof(rec) - rec.runLen - rec.size;
+  static const unsigned char relleno[4] = {0, 0, 0, 0};
+
+  // solo los datos: el header se escribe despues (writeHeader). Si se corta
+  // en el medio, el registro queda fuera de dataBytes y se ignora al abrir
+  long offset = static_cast<long>(sizeof(ArenaHeader) + m_header.dataBytes);
+  if (std::fseek(m_file, offset, SEEK_SET) != 0 ||
+      std::fwrite(&rec, sizeof(rec), 1, m_file) != 1 ||
+      std::fwrite(run.data(), 1, run.size(), m_file) != run.size() ||
+      (rec.size > 0 &&
+       std::fwrite(tpl.data, 1, rec.size, m_file) != rec.size) ||
+      std::fwrite(relleno, 1, sobra, m_file) != sobra) {
+    return false;
+  }
+  m_header.records++;
+  m_header.dataBytes += largo;
+  return true;
+}
+
+bool TemplateArena::writeHeader() {
+  if (std::fseek(m_file, 0, SEEK_SET) != 0 ||
+      std::fwrite(&m_header, sizeof(m_header), 1, m_file) != 1) {
+    return false;
+  }
+  return std::fflush(m_file) == 0;
+}
+
+// -----------------------------------------------------------------------------
+// Estado
+// -----------------------------------------------------------------------------
+unsigned int TemplateArena::liveCount() const {
+  return static_cast<unsigned int>(m_index.size());
+}
+
+unsigned long long TemplateArena::liveBytes() const { return m_liveBytes; }
+
+unsigned long long TemplateArena::liveChecksum() const {
+  return m_liveChecksum;
+}
+
+unsigned int TemplateArena::maxFid() const { return m_maxFid; }
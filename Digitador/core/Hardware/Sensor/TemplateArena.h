@@ -0,0 +1,128 @@
+// TemplateArena.h
+
+// archivo de templates empaquetados (arena) junto a la base de datos. Guarda
+// cada template con su fid y su run_id uno detras de otro, asi al arrancar el
+// Sensor mapea el archivo y carga todo en la cache 1:N de una vez, sin pasar
+// por SQLite ni cruzar CGO por alumno.
+//
+// Formato (little endian):
+//   ArenaHeader
+//   registros: ArenaRecord + run (runLen bytes) + template (size bytes),
+//              rellenado a multiplo de 4. El registro trae el CRC-32 del
+//              template para armar la firma al abrir sin recorrer los datos
+// Es de solo agregar: un enrolamiento nuevo o un reemplazo agrega un registro
+// y el ultimo registro de cada run manda. Un registro con size 0 es una baja.
+#pragma once
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TemplateView.h"
+
+#define ARENA_MAGIC 0x41544744u // "DGTA"
+#define ARENA_VERSION 2
+#define ARENA_MAX_RUN_LEN 31 // el run_id chileno sin DV cabe de sobra
+
+struct ArenaHeader {
+  unsigned int magic;
+  unsigned int version;
+  unsigned int records;         // registros escritos (incluye reemplazos)
+  unsigned int reserved;
+  unsigned long long dataBytes; // bytes validos despues del header
+};
+
+struct ArenaRecord {
+  unsigned int fid;
+  unsigned int size; // bytes del template, 0 = baja
+  unsigned short runLen;
+  unsigned short flags;
+  unsigned int crc; // CRC-32 del template, 0 en una baja
+};
+
+class TemplateArena {
+public:
+  // template vivo dentro del archivo mapeado
+  struct Entry {
+    unsigned int fid;
+    std::string run;
+    TemplateView tpl; // valido hasta unmap() / close()
+  };
+
+  // ultimo registro vivo de un run
+  struct Live {
+    unsigned int fid;
+    unsigned int size;
+    unsigned int crc; // CRC-32 del template (ver liveChecksum)
+  };
+
+  TemplateArena();
+  ~TemplateArena();
+
+  // abrir (o crear vacio) el archivo, mapearlo y armar el indice. Si hay
+  // muchos registros reemplazados, compacta el archivo antes de mapearlo.
+  // Un archivo corrupto o de otra version se descarta y se empieza vacio
+  bool open(const std::string &path);
+  void close();
+  bool isOpen() const;
+
+  // templates vivos, en el orden del archivo (solo mientras este mapeado)
+  const std::vector<Entry> &entries() const;
+
+  // indice run -> fid de todos los vivos (se mantiene al agregar/quitar)
+  const std::map<std::string, Live> &index() const;
+
+  // soltar el mapeo despues de cargar la cache del SDK (que copia los
+  // templates). El indice run -> fid se conserva para seguir agregando
+  void unmap();
+
+  // agregar o reemplazar el template de un run
+  bool put(const std::string &run, unsigned int fid, TemplateView tpl);
+
+  // agregar o reemplazar varios de una vez (un solo flush del header).
+  // Devuelve cuantos se escribieron, o -1 si fallo el header
+  int putMany(const std::vector<Entry> &entradas);
+
+  // dar de baja un run (no hace nada si no estaba)
+  bool remove(const std::string &run);
+
+  // vaciar el archivo (cuando no coincide con la base de datos)
+  bool reset();
+
+  //====Estado====
+
+  unsigned int liveCount() const;
+  unsigned long long liveBytes() const;
+  // suma de los CRC-32 de los templates vivos: con liveCount y liveBytes es
+  // la firma que se compara con SUM(checksum) de TemplatesHuella (un template
+  // cambiado por otro del mismo largo cambia la suma)
+  unsigned long long liveChecksum() const;
+  unsigned int maxFid() const;
+
+private:
+  std::string m_path;
+  std::FILE *m_file;
+  ArenaHeader m_header;
+  std::map<std::string, Live> m_index; // run -> ultimo registro vivo
+  unsigned long long m_liveBytes;
+  unsigned long long m_liveChecksum;
+  unsigned int m_maxFid;
+
+  // mapeo de solo lectura del archivo completo
+  const unsigned char *m_map;
+  size_t m_mapSize;
+  void *m_mapHandle; // HANDLE del mapping en Windows, sin uso en POSIX
+  std::vector<Entry> m_entries;
+
+  bool mapFile();
+  // recorre los registros mapeados; false si el archivo no es una arena valida
+  bool scan();
+  bool compact();
+  // agrega el registro sin tocar el header en disco
+  bool writeRecord(const std::string &run, unsigned int fid, TemplateView tpl,
+                   unsigned int crc);
+  bool writeHeader();
+  void indexLive(const std::string &run, unsigned int fid, unsigned int size,
+                 unsigned int crc);
+};
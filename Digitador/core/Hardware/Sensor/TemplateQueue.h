@@ -0,0 +1,71 @@
+// TemplateQueue.h
+
+// cola lock-free de un solo productor y un solo consumidor (SPSC) con slots
+// preasignados. El hilo de captura del Sensor es el productor; los que piden
+// huellas (Go / HTTP) son el consumidor, serializados por el Sensor.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+template <size_t Capacidad, size_t TamSlot> class TemplateQueue {
+public:
+  TemplateQueue() : m_head(0), m_tail(0) {}
+
+  // solo productor: false si la cola esta llena o el template no cabe
+  bool push(const unsigned char *data, unsigned int size,
+            long long timestampMs) {
+    if (size > TamSlot) {
+      return false;
+    }
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t siguiente = (tail + 1) % Capacidad;
+    if (siguiente == m_head.load(std::memory_order_acquire)) {
+      return false; // llena
+    }
+    Slot &slot = m_slots[tail];
+    std::memcpy(slot.data, data, size);
+    slot.size = size;
+    slot.timestampMs = timestampMs;
+    m_tail.store(siguiente, std::memory_order_release);
+    return true;
+  }
+
+  // solo consumidor: copia el siguiente template directo al buffer del
+  // llamador. Entrada *size = capacidad de out, salida = bytes escritos.
+  // false si la cola esta vacia; si no cabe, se descarta el template y
+  // *size queda en el tamaño que hacia falta
+  bool pop(unsigned char *out, unsigned int *size, long long *timestampMs) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return false; // vacia
+    }
+    const Slot &slot = m_slots[head];
+    bool cabe = slot.size <= *size;
+    if (cabe) {
+      std::memcpy(out, slot.data, slot.size);
+    }
+    *size = slot.size;
+    *timestampMs = slot.timestampMs;
+    m_head.store((head + 1) % Capacidad, std::memory_order_release);
+    return cabe;
+  }
+
+  // se puede llamar desde cualquier hilo (resultado aproximado)
+  bool empty() const {
+    return m_head.load(std::memory_order_acquire) ==
+           m_tail.load(std::memory_order_acquire);
+  }
+
+private:
+  struct Slot {
+    unsigned char data[TamSlot];
+    unsigned int size;
+    long long timestampMs; // momento de la captura (steady_clock)
+  };
+
+  Slot m_slots[Capacidad]; // un slot siempre queda libre para distinguir llena
+  std::atomic<size_t> m_head; // siguiente a leer (consumidor)
+  std::atomic<size_t> m_tail; // siguiente a escribir (productor)
+};
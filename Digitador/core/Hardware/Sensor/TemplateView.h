@@ -0,0 +1,22 @@
+// TemplateView.h
+
+// vistas puntero + largo sobre templates, para que Go (o quien llame) pase
+// sus propios buffers al SDK sin copiarlos a un std::vector intermedio
+#pragma once
+
+#include <vector>
+
+// vista de solo lectura sobre un template ajeno (no es dueña de los bytes)
+struct TemplateView {
+  const unsigned char *data;
+  unsigned int size;
+
+  TemplateView() : data(nullptr), size(0) {}
+  TemplateView(const unsigned char *d, unsigned int s) : data(d), size(s) {}
+
+  // implicita: los llamadores con std::vector siguen funcionando igual
+  TemplateView(const std::vector<unsigned char> &v)
+      : data(v.data()), size(static_cast<unsigned int>(v.size())) {}
+
+  bool empty() const { return data == nullptr || size == 0; }
+};
@@ -0,0 +1,94 @@
+// ZKBackend.cpp
+
+// implementacion del backend con el SDK de ZKTeco (solo Windows)
+#include "ZKBackend.h"
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+// zkteco sdk
+#include "include/libzkfp.h"
+
+// el SDK no declara const en sus punteros de entrada, pero no los modifica
+static unsigned char *sinConst(const unsigned char *p) {
+  return const_cast<unsigned char *>(p);
+}
+
+int ZKBackend::init() { return ZKFPM_Init(); }
+
+int ZKBackend::terminate() { return ZKFPM_Terminate(); }
+
+int ZKBackend::getDeviceCount() { return ZKFPM_GetDeviceCount(); }
+
+void *ZKBackend::openDevice(int index) { return ZKFPM_OpenDevice(index); }
+
+int ZKBackend::closeDevice(void *device) {
+  return ZKFPM_CloseDevice(static_cast<HANDLE>(device));
+}
+
+int ZKBackend::getCaptureParams(void *device, int &width, int &height,
+                                int &dpi) {
+  return ZKFPM_GetCaptureParamsEx(static_cast<HANDLE>(device), &width,
+                                  &height, &dpi);
+}
+
+int ZKBackend::acquireFingerprint(void *device, unsigned char *image,
+                                  unsigned int cbImage,
+                                  unsigned char *fpTemplate,
+                                  unsigned int *cbTemplate) {
+  return ZKFPM_AcquireFingerprint(static_cast<HANDLE>(device), image, cbImage,
+                                  fpTemplate, cbTemplate);
+}
+
+void *ZKBackend::dbInit() { return ZKFPM_DBInit(); }
+
+int ZKBackend::dbFree(void *dbCache) {
+  return ZKFPM_DBFree(static_cast<HANDLE>(dbCache));
+}
+
+int ZKBackend::dbAdd(void *dbCache, unsigned int fid,
+                     const unsigned char *fpTemplate,
+                     unsigned int cbTemplate) {
+  return ZKFPM_DBAdd(static_cast<HANDLE>(dbCache), fid, sinConst(fpTemplate),
+                     cbTemplate);
+}
+
+int ZKBackend::dbDel(void *dbCache, unsigned int fid) {
+  return ZKFPM_DBDel(static_cast<HANDLE>(dbCache), fid);
+}
+
+int ZKBackend::dbClear(void *dbCache) {
+  return ZKFPM_DBClear(static_cast<HANDLE>(dbCache));
+}
+
+int ZKBackend::dbCount(void *dbCache, unsigned int *count) {
+  return ZKFPM_DBCount(static_cast<HANDLE>(dbCache), count);
+}
+
+int ZKBackend::dbIdentify(void *dbCache, const unsigned char *fpTemplate,
+                          unsigned int cbTemplate, unsigned int *fid,
+                          unsigned int *score) {
+  return ZKFPM_DBIdentify(static_cast<HANDLE>(dbCache), sinConst(fpTemplate),
+                          cbTemplate, fid, score);
+}
+
+int ZKBackend::dbMatch(void *dbCache, const unsigned char *template1,
+                       unsigned int cbTemplate1,
+                       const unsigned char *template2,
+                       unsigned int cbTemplate2) {
+  return ZKFPM_DBMatch(static_cast<HANDLE>(dbCache), sinConst(template1),
+                       cbTemplate1, sinConst(template2), cbTemplate2);
+}
+
+int ZKBackend::dbMerge(void *dbCache, const unsigned char *template1,
+                       unsigned int, const unsigned char *template2,
+                       unsigned int, const unsigned char *template3,
+                       unsigned int, unsigned char *regTemp,
+                       unsigned int *cbRegTemp) {
+  return ZKFPM_DBMerge(static_cast<HANDLE>(dbCache), sinConst(template1),
+                       sinConst(template2), sinConst(template3), regTemp,
+                       cbRegTemp);
+}
+
+#endif // _WIN32
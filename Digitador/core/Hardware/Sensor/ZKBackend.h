@@ -0,0 +1,44 @@
+// ZKBackend.h
+
+// backend real: envuelve las llamadas ZKFPM_* del SDK de ZKTeco
+#pragma once
+
+#include "SensorBackend.h"
+
+#ifdef _WIN32
+
+class ZKBackend : public SensorBackend {
+public:
+  int init() override;
+  int terminate() override;
+
+  int getDeviceCount() override;
+  void *openDevice(int index) override;
+  int closeDevice(void *device) override;
+  int getCaptureParams(void *device, int &width, int &height,
+                       int &dpi) override;
+  int acquireFingerprint(void *device, unsigned char *image,
+                         unsigned int cbImage, unsigned char *fpTemplate,
+                         unsigned int *cbTemplate) override;
+
+  void *dbInit() override;
+  int dbFree(void *dbCache) override;
+  int dbAdd(void *dbCache, unsigned int fid, const unsigned char *fpTemplate,
+            unsigned int cbTemplate) override;
+  int dbDel(void *dbCache, unsigned int fid) override;
+  int dbClear(void *dbCache) override;
+  int dbCount(void *dbCache, unsigned int *count) override;
+  int dbIdentify(void *dbCache, const unsigned char *fpTemplate,
+                 unsigned int cbTemplate, unsigned int *fid,
+                 unsigned int *score) override;
+  int dbMatch(void *dbCache, const unsigned char *template1,
+              unsigned int cbTemplate1, const unsigned char *template2,
+              unsigned int cbTemplate2) override;
+  int dbMerge(void *dbCache, const unsigned char *template1,
+              unsigned int cbTemplate1, const unsigned char *template2,
+              unsigned int cbTemplate2, const unsigned char *template3,
+              unsigned int cbTemplate3, unsigned char *regTemp,
+              unsigned int *cbRegTemp) override;
+};
+
+#endif // _WIN32
@@ -12240,7 +12240,9 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             /// Also destroys the object if the Close flag is set.
             void do_write()
             {
-                if (write_buffers_.empty()) return;
+                // Only one async_write in flight: the completion handler
+                // calls do_write again for whatever was queued meanwhile
+                if (write_buffers_.empty() || !sending_buffers_.empty()) return;
 
                 sending_buffers_.swap(write_buffers_);
                 std::vector<asio::const_buffer> buffers;
@@ -15057,6 +15059,8 @@ namespace crow
 
         void close_websockets()
         {
+            // add/remove_websocket run on the io threads
+            std::lock_guard<std::mutex> lock(websockets_mutex_);
             for (auto websocket : websockets_)
             {
                 CROW_LOG_INFO << "Quitting Websocket: " << websocket;
@@ -15067,11 +15071,13 @@ namespace crow
 
         void add_websocket(std::shared_ptr<websocket::connection> conn)
         {
+            std::lock_guard<std::mutex> lock(websockets_mutex_);
             websockets_.push_back(conn);
         }
 
         void remove_websocket(std::shared_ptr<websocket::connection> conn)
         {
+            std::lock_guard<std::mutex> lock(websockets_mutex_);
             websockets_.erase(std::remove(websockets_.begin(), websockets_.end(), conn), websockets_.end());
         }
 
@@ -15285,6 +15291,7 @@ namespace crow
         std::condition_variable cv_started_;
         std::mutex start_mutex_;
         std::vector<std::shared_ptr<websocket::connection>> websockets_;
+        std::mutex websockets_mutex_;
     };
 
     /// \brief Alias of Crow<Middlewares...>. Useful if you want
@@ -54,7 +54,8 @@ type Usuario struct {
 	NombreCompleto string     `json:"nombre_completo"`
 	IDRol          RolUsuario `json:"id_rol"`
 	PasswordHash   string     `json:"-"`
-	TemplateHuella []byte     `json:"-"`
+	TemplateHuella []byte     `json:"-"` // solo al guardar: las lecturas no traen el BLOB
+	TieneHuella    bool       `json:"tiene_huella"`
 	Activo         bool       `json:"activo"` // <-- Maneja el estado de la huella/alumno sin borrarlo
 }
 
@@ -87,7 +88,7 @@ type PerfilEstudiante struct {
 	DV             string     `json:"dv"`
 	NombreCompleto string     `json:"nombre_completo"`
 	IDRol          RolUsuario `json:"id_rol"`
-	TemplateHuella []byte     `json:"-"`
+	TieneHuella    bool       `json:"tiene_huella"`
 	Activo         bool       `json:"activo"`
 	// Aquí en el DTO sí devolvemos el string para que el frontend lo lea fácil
 	Curso string `json:"curso"`
@@ -128,6 +129,24 @@ type Stats struct {
 	Desayunos int `json:"desayunos"`
 	Almuerzos int `json:"almuerzos"`
 	Total     int `json:"total"`
+	// solo en las globales: lo de hoy, con el desglose por curso
+	Hoy *StatsDia `json:"hoy,omitempty"`
+}
+
+type StatsDia struct {
+	Fecha     string       `json:"fecha"`
+	Desayunos int          `json:"desayunos"`
+	Almuerzos int          `json:"almuerzos"`
+	Total     int          `json:"total"`
+	Cursos    []StatsCurso `json:"cursos"`
+}
+
+type StatsCurso struct {
+	Curso     string `json:"curso"`
+	Letra     string `json:"letra"`
+	Desayunos int    `json:"desayunos"`
+	Almuerzos int    `json:"almuerzos"`
+	Total     int    `json:"total"`
 }
 
 // -- mapping y adaptadores--
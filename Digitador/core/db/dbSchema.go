@@ -4,8 +4,18 @@ package db
 import (
 	"database/sql"
 	"fmt"
+	"hash/crc32"
 )
 
+// DedoPrincipal es el indice_dedo del template que usa el 1:N (0-9, hoy se
+// enrola un solo dedo por alumno)
+const DedoPrincipal = 0
+
+// ChecksumTemplate es el CRC-32 (IEEE) que se guarda junto a cada template
+func ChecksumTemplate(plantilla []byte) uint32 {
+	return crc32.ChecksumIEEE(plantilla)
+}
+
 // InitDatabase construye la base de datos (tablas) y puebla los catálogos
 // solo si no existen los datos en las tablas Curso y Letra.
 func InitDatabase(db *sql.DB) error {
@@ -27,10 +37,21 @@ func InitDatabase(db *sql.DB) error {
 			nombre_completo TEXT NOT NULL,
 			id_rol INTEGER NOT NULL DEFAULT 3,
 			password_hash TEXT,
-			template_huella BLOB,
 			activo INTEGER NOT NULL DEFAULT 1 -- 1=TRUE, 0=FALSE
 		);`,
 
+		// los templates van aparte: asi listar, exportar o buscar un perfil
+		// no arrastra ~1 KB de BLOB por alumno
+		`CREATE TABLE IF NOT EXISTS TemplatesHuella (
+			run_id TEXT NOT NULL,
+			indice_dedo INTEGER NOT NULL DEFAULT 0, -- 0-9
+			template BLOB NOT NULL,
+			largo INTEGER NOT NULL, -- bytes del template
+			checksum INTEGER NOT NULL, -- CRC-32 del template
+			PRIMARY KEY (run_id, indice_dedo),
+			FOREIGN KEY (run_id) REFERENCES Usuarios (run_id) ON DELETE CASCADE
+		);`,
+
 		`CREATE TABLE IF NOT EXISTS DetailsEstudiante (
 			run_id TEXT PRIMARY KEY NOT NULL,
 			id_curso INTEGER NOT NULL,
@@ -58,6 +79,55 @@ func InitDatabase(db *sql.DB) error {
 			tipo_racion INTEGER NOT NULL DEFAULT 0,
 			puerto_impresora TEXT NOT NULL DEFAULT 'COM3'
 		);`,
+
+		// contadores de raciones para las estadisticas: los mantienen los
+		// triggers de abajo con cada INSERT / DELETE en RegistrosRaciones,
+		// asi /api/stats no recorre todo el historial
+		`CREATE TABLE IF NOT EXISTS ContadoresRaciones (
+			fecha_servicio TEXT NOT NULL,
+			tipo_racion INTEGER NOT NULL,
+			id_curso INTEGER NOT NULL, -- 0 = alumno sin curso
+			id_letra INTEGER NOT NULL,
+			cantidad INTEGER NOT NULL DEFAULT 0,
+			PRIMARY KEY (fecha_servicio, tipo_racion, id_curso, id_letra)
+		) WITHOUT ROWID;`,
+
+		`CREATE TABLE IF NOT EXISTS ContadoresEstudiante (
+			run_id TEXT NOT NULL,
+			tipo_racion INTEGER NOT NULL,
+			cantidad INTEGER NOT NULL DEFAULT 0,
+			PRIMARY KEY (run_id, tipo_racion)
+		) WITHOUT ROWID;`,
+
+		// el curso es el que tiene el alumno al recibir la racion
+		`CREATE TRIGGER IF NOT EXISTS ContarRacion AFTER INSERT ON RegistrosRaciones
+		BEGIN
+			INSERT INTO ContadoresRaciones (fecha_servicio, tipo_racion, id_curso, id_letra, cantidad)
+			VALUES (NEW.fecha_servicio, NEW.tipo_racion,
+				IFNULL((SELECT id_curso FROM DetailsEstudiante WHERE run_id = NEW.id_estudiante), 0),
+				IFNULL((SELECT id_letra FROM DetailsEstudiante WHERE run_id = NEW.id_estudiante), 0),
+				1)
+			ON CONFLICT (fecha_servicio, tipo_racion, id_curso, id_letra) DO UPDATE SET cantidad = cantidad + 1;
+			INSERT INTO ContadoresEstudiante (run_id, tipo_racion, cantidad)
+			VALUES (NEW.id_estudiante, NEW.tipo_racion, 1)
+			ON CONFLICT (run_id, tipo_racion) DO UPDATE SET cantidad = cantidad + 1;
+		END;`,
+
+		// si el alumno se cambio de curso despues, se descuenta de otro curso
+		// del mismo dia y racion: el total del dia nunca queda desfasado
+		`CREATE TRIGGER IF NOT EXISTS DescontarRacion AFTER DELETE ON RegistrosRaciones
+		BEGIN
+			UPDATE ContadoresRaciones SET cantidad = cantidad - 1
+			WHERE (fecha_servicio, tipo_racion, id_curso, id_letra) IN (
+				SELECT c.fecha_servicio, c.tipo_racion, c.id_curso, c.id_letra
+				FROM ContadoresRaciones c
+				LEFT JOIN DetailsEstudiante d ON d.run_id = OLD.id_estudiante
+				WHERE c.fecha_servicio = OLD.fecha_servicio AND c.tipo_racion = OLD.tipo_racion AND c.cantidad > 0
+				ORDER BY (c.id_curso = IFNULL(d.id_curso, 0) AND c.id_letra = IFNULL(d.id_letra, 0)) DESC
+				LIMIT 1);
+			UPDATE ContadoresEstudiante SET cantidad = cantidad - 1
+			WHERE run_id = OLD.id_estudiante AND tipo_racion = OLD.tipo_racion AND cantidad > 0;
+		END;`,
 	}
 
 	for _, q := range queries {
@@ -99,5 +169,97 @@ func InitDatabase(db *sql.DB) error {
 	// 3. Inicializar configuración global si no existe (id_unica = 1 siempre)
 	db.Exec("INSERT OR IGNORE INTO ConfiguracionGlobal (id_unica, id_terminal, tipo_racion, puerto_impresora) VALUES (1, 'TOTEM-1', 0, 'COM3')")
 
+	// 4. Una base de antes de los contadores: los armamos una vez desde el
+	// historial (solo si estan vacios y hay registros)
+	for _, q := range LlenarContadores {
+		if _, err := db.Exec(q); err != nil {
+			return fmt.Errorf("error llenando contadores de raciones: %w", err)
+		}
+	}
+
+	// 5. Una base de antes de TemplatesHuella: mover los templates
+	if err := migrarTemplates(db); err != nil {
+		return fmt.Errorf("error migrando templates: %w", err)
+	}
+
+	return nil
+}
+
+// migrarTemplates pasa los templates de la columna vieja
+// Usuarios.template_huella a TemplatesHuella (como DedoPrincipal, con su
+// largo y checksum) y borra la columna, todo en una transaccion. Sin la
+// columna no hace nada
+func migrarTemplates(db *sql.DB) error {
+	var columna int
+	err := db.QueryRow(`SELECT COUNT(*) FROM pragma_table_info('Usuarios') WHERE name = 'template_huella'`).Scan(&columna)
+	if err != nil || columna == 0 {
+		return err
+	}
+
+	tx, err := db.Begin()
+	if err != nil {
+		return err
+	}
+	defer tx.Rollback()
+
+	type template struct {
+		run       string
+		plantilla []byte
+	}
+	var templates []template
+	rows, err := tx.Query(`SELECT run_id, template_huella FROM Usuarios WHERE LENGTH(template_huella) > 0`)
+	if err != nil {
+		return err
+	}
+	for rows.Next() {
+		var t template
+		if err := rows.Scan(&t.run, &t.plantilla); err != nil {
+			rows.Close()
+			return err
+		}
+		templates = append(templates, t)
+	}
+	rows.Close()
+	if err := rows.Err(); err != nil {
+		return err
+	}
+
+	stmt, err := tx.Prepare(`INSERT OR IGNORE INTO TemplatesHuella (run_id, indice_dedo, template, largo, checksum)
+		VALUES (?, ?, ?, ?, ?)`)
+	if err != nil {
+		return err
+	}
+	defer stmt.Close()
+	for _, t := range templates {
+		if _, err := stmt.Exec(t.run, DedoPrincipal, t.plantilla, len(t.plantilla), ChecksumTemplate(t.plantilla)); err != nil {
+			return err
+		}
+	}
+
+	if _, err := tx.Exec(`ALTER TABLE Usuarios DROP COLUMN template_huella`); err != nil {
+		return err
+	}
+	if err := tx.Commit(); err != nil {
+		return err
+	}
+	fmt.Printf("(+) [DB]: %d templates movidos a TemplatesHuella.\n", len(templates))
 	return nil
 }
+
+// LlenarContadores arma los contadores desde RegistrosRaciones cuando estan
+// vacios (base creada antes de los triggers). Cada sentencia revisa su propia
+// tabla, asi no duplica lo que ya contaron los triggers
+var LlenarContadores = []string{
+	`INSERT INTO ContadoresRaciones (fecha_servicio, tipo_racion, id_curso, id_letra, cantidad)
+	SELECT r.fecha_servicio, r.tipo_racion, IFNULL(d.id_curso, 0), IFNULL(d.id_letra, 0), COUNT(*)
+	FROM RegistrosRaciones r
+	LEFT JOIN DetailsEstudiante d ON d.run_id = r.id_estudiante
+	WHERE NOT EXISTS (SELECT 1 FROM ContadoresRaciones)
+	GROUP BY 1, 2, 3, 4;`,
+
+	`INSERT INTO ContadoresEstudiante (run_id, tipo_racion, cantidad)
+	SELECT id_estudiante, tipo_racion, COUNT(*)
+	FROM RegistrosRaciones
+	WHERE NOT EXISTS (SELECT 1 FROM ContadoresEstudiante)
+	GROUP BY 1, 2;`,
+}
@@ -10,73 +10,253 @@ import (
 	"os/exec"
 	"path/filepath"
 	"strings"
+	"sync"
+	"time"
 
 	db "Pydigitador/core/db" //archivo de python para transformar .xlsx a .sql
 
 	_ "github.com/mattn/go-sqlite3"
 )
 
+// ObservadorTemplates recibe cada cambio de huellas en la base de datos para
+// que la cache 1:N del sensor no quede desfasada (alumno borrado que sigue
+// identificando, huella nueva que no aparece hasta reiniciar)
+type ObservadorTemplates interface {
+	// el alumno quedo activo con esta huella (alta, reemplazo o reactivacion)
+	TemplateActualizado(runID string, plantilla []byte)
+	// el alumno ya no debe identificarse (baja, desactivacion o sin huella)
+	TemplateEliminado(runID string)
+	// cambio masivo: hay que recargar todo desde la base de datos
+	TemplatesRecargados()
+}
+
+// ObservadorRegistros se entera cuando se borran raciones ya registradas,
+// para que quien lleva la cuenta de las servidas hoy (el diario de raciones
+// del totem) no siga rechazando como repetida una racion que ya no esta
+type ObservadorRegistros interface {
+	RegistrosBorrados()
+}
+
+// ObservadorPerfiles se entera de cada cambio en los datos de un alumno
+// (nombre, curso, activo), para que el directorio de perfiles del totem no
+// tenga que leer SQLite en cada huella
+type ObservadorPerfiles interface {
+	// el alumno se creo o cambio: hay que volver a leerlo
+	PerfilActualizado(runID string)
+	PerfilEliminado(runID string)
+	// cambio masivo: hay que recargar todos
+	PerfilesRecargados()
+}
+
+// vigenciaStats es cuanto se sirven las estadisticas desde memoria sin
+// mirar la base: lo que se registra por este repositorio las invalida al
+// tiro, el plazo es solo para lo que escriben otros procesos (C++, python)
+const vigenciaStats = 5 * time.Second
+
+// cacheStats guarda las ultimas estadisticas globales leidas de los
+// contadores (ContadoresRaciones)
+type cacheStats struct {
+	mu     sync.Mutex
+	valida bool
+	hasta  time.Time
+	stats  db.Stats
+}
+
 // creamos la estructura del repositorio
 type SQLiteUserRepository struct {
-	db *sql.DB
+	db                  *sql.DB // la unica conexion que escribe
+	lectura             *sql.DB // pool de solo lectura
+	sql                 *sentencias
+	dbPath              string
+	observador          ObservadorTemplates
+	observadorRegistros ObservadorRegistros
+	observadorPerfiles  ObservadorPerfiles
+	stats               cacheStats
 }
 
 // creamos esta funcion para instanciar el repositorio
 func NewSQLiteUserRepository(dbPath string) (*SQLiteUserRepository, error) {
-	//definimos usar los mismos parametros que en C
-	dbConn, err := sql.Open("sqlite3", fmt.Sprintf("file:%s?cache=shared&mode=rwc&_mutex=full", dbPath))
+	// una sola conexion escribe (como en C++: WAL + busy timeout), asi las
+	// escrituras nunca pelean entre ellas dentro del proceso
+	dbConn, err := sql.Open("sqlite3", dsnEscritura(dbPath))
 
 	//se abrio la base de datos correctamente?
 	if err != nil {
 		//no, reportar error
 		return nil, fmt.Errorf("error abriendo DB: %w", err)
 	}
+	dbConn.SetMaxOpenConns(1)
+	dbConn.SetMaxIdleConns(1)
+	dbConn.SetConnMaxLifetime(0)
 
 	// esta conectada la base de datos?
 	if err = dbConn.Ping(); err != nil {
 		//no, reportar error
+		dbConn.Close()
 		return nil, fmt.Errorf("error conectando a DB: %w", err)
 	}
 
-	// Habilitamos las foreign_keys (como en C++)
-	_, err = dbConn.Exec("PRAGMA foreign_keys = ON")
-	//se habilitaron las foreign_keys?
-	if err != nil {
-		//no
+	// las foreign_keys van en el DSN; confirmamos que quedaron (como en C++)
+	var fk int
+	if err := dbConn.QueryRow("PRAGMA foreign_keys").Scan(&fk); err != nil || fk != 1 {
 		log.Printf("(-) [DB]: No se pudo habilitar foreign_keys: %v", err)
 	}
 
 	// Inicializamos las tablas y el poblamiento de datos por defecto (evitamos shadowing del paquete con dbConn)
 	if err := db.InitDatabase(dbConn); err != nil {
 		log.Printf("(-) [DB]: Error inicializando esquema: %v", err)
+		dbConn.Close()
+		return nil, fmt.Errorf("error inicializando DB: %w", err)
+	}
+
+	// los lectores se abren despues: la base ya existe y ya esta en WAL. En
+	// WAL leen la ultima version confirmada sin esperar al que escribe
+	lectura, err := sql.Open("sqlite3", dsnLectura(dbPath))
+	if err != nil {
+		dbConn.Close()
+		return nil, fmt.Errorf("error abriendo DB de lectura: %w", err)
+	}
+	lectores := cantidadLectores()
+	lectura.SetMaxOpenConns(lectores)
+	lectura.SetMaxIdleConns(lectores)
+	lectura.SetConnMaxLifetime(0)
+
+	preparadas, err := prepararSentencias(dbConn, lectura)
+	if err != nil {
+		lectura.Close()
+		dbConn.Close()
 		return nil, fmt.Errorf("error inicializando DB: %w", err)
 	}
 
 	//si, devolvemos el repositorio
-	return &SQLiteUserRepository{db: dbConn}, nil
+	return &SQLiteUserRepository{db: dbConn, lectura: lectura, sql: preparadas, dbPath: dbPath}, nil
+}
+
+// SetObservadorTemplates registra quien se entera de los cambios de huellas
+// (nil para dejar de avisar)
+func (r *SQLiteUserRepository) SetObservadorTemplates(o ObservadorTemplates) {
+	r.observador = o
+}
+
+// avisamos al observador como quedo un alumno despues de un cambio
+func (r *SQLiteUserRepository) notificarTemplate(runID string, plantilla []byte, activo bool) {
+	if r.observador == nil {
+		return
+	}
+	if activo && len(plantilla) > 0 {
+		r.observador.TemplateActualizado(runID, plantilla)
+	} else {
+		r.observador.TemplateEliminado(runID)
+	}
+}
+
+func (r *SQLiteUserRepository) notificarEliminado(runID string) {
+	if r.observador != nil {
+		r.observador.TemplateEliminado(runID)
+	}
+}
+
+func (r *SQLiteUserRepository) notificarRecarga() {
+	if r.observador != nil {
+		r.observador.TemplatesRecargados()
+	}
+}
+
+// SetObservadorRegistros registra quien se entera de los borrados de
+// raciones (nil para dejar de avisar)
+func (r *SQLiteUserRepository) SetObservadorRegistros(o ObservadorRegistros) {
+	r.observadorRegistros = o
+}
+
+// SetObservadorPerfiles registra quien se entera de los cambios de alumnos
+// (nil para dejar de avisar)
+func (r *SQLiteUserRepository) SetObservadorPerfiles(o ObservadorPerfiles) {
+	r.observadorPerfiles = o
+}
+
+func (r *SQLiteUserRepository) notificarPerfil(runID string) {
+	if r.observadorPerfiles != nil {
+		r.observadorPerfiles.PerfilActualizado(runID)
+	}
+}
+
+func (r *SQLiteUserRepository) notificarPerfilEliminado(runID string) {
+	if r.observadorPerfiles != nil {
+		r.observadorPerfiles.PerfilEliminado(runID)
+	}
+}
+
+func (r *SQLiteUserRepository) notificarPerfilesRecargados() {
+	if r.observadorPerfiles != nil {
+		r.observadorPerfiles.PerfilesRecargados()
+	}
 }
 
-// creamos esta funcion para guardar los datos de un usuario
+func (r *SQLiteUserRepository) notificarRegistrosBorrados() {
+	if r.observadorRegistros != nil {
+		r.observadorRegistros.RegistrosBorrados()
+	}
+}
+
+// creamos esta funcion para guardar los datos de un usuario. El template va
+// a TemplatesHuella: si viene se reemplaza, si no viene y TieneHuella es
+// false se borra, y si no viene pero TieneHuella es true (un usuario leido
+// con GetUser, que no trae el BLOB) queda el que estaba
 func (r *SQLiteUserRepository) SaveUser(user db.Usuario) error {
-	query := `
-        INSERT OR REPLACE INTO Usuarios 
-        (run_id, dv, nombre_completo, id_rol, template_huella, activo) 
-        VALUES (?, ?, ?, ?, ?, ?)
-    `
-	_, err := r.db.Exec(query,
+	tx, err := r.db.Begin()
+	if err != nil {
+		return fmt.Errorf("(-) [GO]: error guardando usuario: %w", err)
+	}
+	defer tx.Rollback()
+
+	// UPSERT y no INSERT OR REPLACE: REPLACE borra la fila y con ella (ON
+	// DELETE CASCADE) el curso y el template del alumno
+	_, err = tx.Stmt(r.sql.guardarUsuario).Exec(
 		user.RunID,
 		user.DV,
 		user.NombreCompleto,
 		user.IDRol,
-		user.TemplateHuella,
 		user.Activo,
 	)
 	if err != nil {
 		return fmt.Errorf("(-) [GO]: error guardando usuario: %w", err)
 	}
+
+	switch {
+	case len(user.TemplateHuella) > 0:
+		_, err = tx.Stmt(r.sql.guardarTemplate).Exec(user.RunID, db.DedoPrincipal, user.TemplateHuella,
+			len(user.TemplateHuella), db.ChecksumTemplate(user.TemplateHuella))
+	case !user.TieneHuella:
+		_, err = tx.Stmt(r.sql.borrarTemplates).Exec(user.RunID)
+	}
+	if err != nil {
+		return fmt.Errorf("(-) [GO]: error guardando huella del usuario: %w", err)
+	}
+	if err := tx.Commit(); err != nil {
+		return fmt.Errorf("(-) [GO]: error guardando usuario: %w", err)
+	}
+
+	plantilla := user.TemplateHuella
+	if len(plantilla) == 0 && user.TieneHuella && user.Activo {
+		// huella sin cambios: la cache 1:N la vuelve a recibir igual
+		plantilla, _ = r.plantillaDe(user.RunID)
+	}
+	r.notificarTemplate(user.RunID, plantilla, user.Activo)
+	r.notificarPerfil(user.RunID)
 	return nil
 }
 
+// plantillaDe lee el template del dedo principal de un alumno (nil si no
+// tiene)
+func (r *SQLiteUserRepository) plantillaDe(runID string) ([]byte, error) {
+	var plantilla []byte
+	err := r.sql.templateDe.QueryRow(runID).Scan(&plantilla)
+	if err == sql.ErrNoRows {
+		return nil, nil
+	}
+	return plantilla, err
+}
+
 // creamos esta funcion para guardar los datos de un usuario (Insert o Update)
 func (r *SQLiteUserRepository) AddStudent(user db.Usuario) error {
 	return r.SaveUser(user)
@@ -97,12 +277,17 @@ func (r *SQLiteUserRepository) UpdateStudentCourse(runID string, idCurso int, id
 	if err != nil {
 		return fmt.Errorf("(-) [GO]: error guardando curso/letra: %w", err)
 	}
+	r.notificarPerfil(runID)
 	return nil
 }
 
 func (r *SQLiteUserRepository) DeleteStudentByRun(runID string) error {
 	_, err := r.db.Exec("DELETE FROM DetailsEstudiante WHERE run_id = ?", runID)
 	_, err = r.db.Exec("DELETE FROM Usuarios WHERE run_id = ?", runID)
+	if err == nil {
+		r.notificarEliminado(runID)
+		r.notificarPerfilEliminado(runID)
+	}
 	return err
 }
 
@@ -113,12 +298,16 @@ func (r *SQLiteUserRepository) DeleteAllStudents() error {
 	}
 	// Solo borramos estudiantes, si hay otros roles no se tocan
 	_, err = r.db.Exec("DELETE FROM Usuarios WHERE id_rol = 3")
+	if err == nil {
+		r.notificarRecarga()
+		r.notificarPerfilesRecargados()
+	}
 	return err
 }
 
 func (r *SQLiteUserRepository) DeleteStudentsByCourse(idCurso int, idLetra int) error {
 	query := `SELECT run_id FROM DetailsEstudiante WHERE id_curso = ? AND id_letra = ?`
-	rows, err := r.db.Query(query, idCurso, idLetra)
+	rows, err := r.lectura.Query(query, idCurso, idLetra)
 	if err != nil {
 		return err
 	}
@@ -134,33 +323,27 @@ func (r *SQLiteUserRepository) DeleteStudentsByCourse(idCurso int, idLetra int)
 
 	for _, id := range runIDs {
 		r.db.Exec("DELETE FROM DetailsEstudiante WHERE run_id = ?", id)
-		r.db.Exec("DELETE FROM Usuarios WHERE run_id = ?", id)
+		if _, err := r.db.Exec("DELETE FROM Usuarios WHERE run_id = ?", id); err == nil {
+			r.notificarEliminado(id)
+			r.notificarPerfilEliminado(id)
+		}
 	}
 
 	return nil
 }
 
-// Creamos la funcion para obtener los datos de un usuario
+// Creamos la funcion para obtener los datos de un usuario (sin el template:
+// TieneHuella dice si tiene)
 func (r *SQLiteUserRepository) GetUser(runID string) (*db.Usuario, error) {
-	//buscamos datos del usuario a traves de sql
-	query := `SELECT run_id, 
-              dv, 
-              nombre_completo, 
-              id_rol, 
-              template_huella,
-              activo 
-              FROM Usuarios 
-              WHERE run_id = ?`
-
-	//Recopilasmos los datos del usuario y los almacenamos dentro de la variable user
+	//Recopilasmos los datos del usuario (sentencia sqlUsuario) y los almacenamos dentro de la variable user
 	var user db.Usuario
-	err := r.db.QueryRow(query, runID).Scan(
+	err := r.sql.usuario.QueryRow(runID).Scan(
 		&user.RunID,
 		&user.DV,
 		&user.NombreCompleto,
 		&user.IDRol,
-		&user.TemplateHuella,
 		&user.Activo,
+		&user.TieneHuella,
 	)
 
 	//se encontraron filas en la consulta sql???
@@ -180,10 +363,8 @@ func (r *SQLiteUserRepository) GetUser(runID string) (*db.Usuario, error) {
 // creamos la funcion para obtener todos los usuarios (por si el cliente la pide)
 func (r *SQLiteUserRepository) GetAllUsers() ([]db.Usuario, error) {
 	// Consultamos a la base de datos que nos mande todos los datos de la tabla Usuarios
-	query := `SELECT run_id, dv, nombre_completo, id_rol, template_huella, activo FROM Usuarios`
-
 	// generamos una variable que capture los errores de consulta (si existen XD)
-	rows, err := r.db.Query(query)
+	rows, err := r.sql.usuarios.Query()
 
 	// hubo un error consultando usuarios?
 	if err != nil {
@@ -200,7 +381,7 @@ func (r *SQLiteUserRepository) GetAllUsers() ([]db.Usuario, error) {
 	for rows.Next() {
 		var user db.Usuario
 		// extraemos los valores de la fila actual y los "mapeamos" a los campos del struct
-		err := rows.Scan(&user.RunID, &user.DV, &user.NombreCompleto, &user.IDRol, &user.TemplateHuella, &user.Activo)
+		err := rows.Scan(&user.RunID, &user.DV, &user.NombreCompleto, &user.IDRol, &user.Activo, &user.TieneHuella)
 
 		// si falla el escaneo de una fila, avisamos qué pasó
 		if err != nil {
@@ -222,15 +403,7 @@ func (r *SQLiteUserRepository) GetAllUsers() ([]db.Usuario, error) {
 
 // creamos la funcion para obtener todos los perfiles, incluyendo el curso (con JOINs normalizados)
 func (r *SQLiteUserRepository) GetAllProfiles() ([]db.PerfilEstudiante, error) {
-	query := `
-		SELECT u.run_id, u.dv, u.nombre_completo, u.id_rol, u.template_huella, u.activo,
-		       IFNULL(c.nombre, 'N/A') as curso, IFNULL(l.caracter, '') as letra
-		FROM Usuarios u
-		LEFT JOIN DetailsEstudiante d ON u.run_id = d.run_id
-		LEFT JOIN Curso c ON d.id_curso = c.id_curso
-		LEFT JOIN Letra l ON d.id_letra = l.id_letra
-	`
-	rows, err := r.db.Query(query)
+	rows, err := r.sql.perfiles.Query()
 	if err != nil {
 		return nil, fmt.Errorf("error consultando perfiles: %w", err)
 	}
@@ -239,7 +412,7 @@ func (r *SQLiteUserRepository) GetAllProfiles() ([]db.PerfilEstudiante, error) {
 	var profiles []db.PerfilEstudiante
 	for rows.Next() {
 		var p db.PerfilEstudiante
-		err := rows.Scan(&p.RunID, &p.DV, &p.NombreCompleto, &p.IDRol, &p.TemplateHuella, &p.Activo, &p.Curso, &p.Letra)
+		err := rows.Scan(&p.RunID, &p.DV, &p.NombreCompleto, &p.IDRol, &p.Activo, &p.TieneHuella, &p.Curso, &p.Letra)
 		if err != nil {
 			return nil, fmt.Errorf("error escaneando perfil: %w", err)
 		}
@@ -253,28 +426,76 @@ func (r *SQLiteUserRepository) GetAllProfiles() ([]db.PerfilEstudiante, error) {
 	return profiles, nil
 }
 
-// creamos la funcion para obtener todos los templates
+// creamos la funcion para obtener todos los templates (alumnos activos, dedo
+// principal), directo desde TemplatesHuella. Un template cuyo checksum no
+// coincide se salta: mejor sin huella que con una corrupta en el 1:N
 func (r *SQLiteUserRepository) ObtenerTodosTemplates() (map[string][]byte, error) {
-	//pedimos todos los usuarios a la base de datos
-	users, err := r.GetAllUsers()
-	//hubo un error obteniendo usuarios?
+	rows, err := r.sql.templatesActivos.Query()
 	if err != nil {
-		//si, retornar error
-		return nil, fmt.Errorf("error obteniendo usuarios para templates: %w", err)
+		return nil, fmt.Errorf("error consultando templates: %w", err)
 	}
+	defer rows.Close()
 
 	//creamos un mapa para guardar los templates
 	templates := make(map[string][]byte)
-	//iteramos por cada usuario
-	for _, u := range users {
-		//si el template no esta vacio Y el usuario esta activo
-		if len(u.TemplateHuella) > 0 && u.Activo {
-			//lo guardamos en el mapa
-			templates[u.RunID] = u.TemplateHuella
+	for rows.Next() {
+		var run string
+		var tpl []byte
+		var checksum int64
+		if err := rows.Scan(&run, &tpl, &checksum); err != nil {
+			return nil, fmt.Errorf("error escaneando template: %w", err)
+		}
+		if uint32(checksum) != db.ChecksumTemplate(tpl) {
+			log.Printf("(-) [DB]: template de %s con checksum invalido, se omite", run)
+			continue
 		}
+		templates[run] = tpl
 	}
 	//devolvemos el mapa de templates
-	return templates, nil
+	return templates, rows.Err()
+}
+
+// CarpetaDatos devuelve la carpeta donde vive el archivo de la base de datos
+// (ahi mismo se guardan los archivos auxiliares, como la arena de templates)
+func (r *SQLiteUserRepository) CarpetaDatos() string {
+	return filepath.Dir(r.dbPath)
+}
+
+// FirmaTemplates cuenta los templates que ObtenerTodosTemplates devolveria y
+// suma sus bytes y sus checksums, sin leer los BLOB. Sirve para saber si una
+// copia externa (la arena del sensor) sigue al dia: un template reemplazado
+// por otro del mismo largo cambia la suma de checksums
+func (r *SQLiteUserRepository) FirmaTemplates() (int, int64, uint64, error) {
+	var cantidad int
+	var bytes int64
+	var checksums int64
+	err := r.sql.firmaTemplates.QueryRow().Scan(&cantidad, &bytes, &checksums)
+	if err != nil {
+		return 0, 0, 0, fmt.Errorf("error contando templates: %w", err)
+	}
+	return cantidad, bytes, uint64(checksums), nil
+}
+
+// TemplatesPorRacion devuelve los templates (run -> template) de los alumnos
+// activos que recibieron ese tipo de racion desde la fecha indicada
+// ("YYYY-MM-DD"). Sirve para armar el grupo de candidatos probables del 1:N
+func (r *SQLiteUserRepository) TemplatesPorRacion(tipo db.TipoRacion, desde string) (map[string][]byte, error) {
+	rows, err := r.sql.templatesPorRacion.Query(tipo, desde)
+	if err != nil {
+		return nil, fmt.Errorf("error consultando templates por racion: %w", err)
+	}
+	defer rows.Close()
+
+	templates := make(map[string][]byte)
+	for rows.Next() {
+		var run string
+		var tpl []byte
+		if err := rows.Scan(&run, &tpl); err != nil {
+			return nil, fmt.Errorf("error escaneando template: %w", err)
+		}
+		templates[run] = tpl
+	}
+	return templates, rows.Err()
 }
 
 // ADVERTENCIA ESTO FUNCIONA EN LIFO (ultimo en registrar primero en borrar)
@@ -309,17 +530,15 @@ func (r *SQLiteUserRepository) BorrarUsuario() bool {
 
 	// Si llegamos aquí, se borró correctamente
 	fmt.Printf("(+) [GO]: Último registro borrado exitosamente\n")
+	// no sabemos que run era: recargamos la cache completa
+	r.notificarRecarga()
+	r.notificarPerfilesRecargados()
 	return true
 }
 
 // GuardarRegistroRacion inserta el ticket generado en la base de datos
 func (r *SQLiteUserRepository) GuardarRegistroRacion(registro db.RegistroRacion) error {
-	query := `
-        INSERT INTO RegistrosRaciones 
-        (id_estudiante, fecha_servicio, tipo_racion, id_terminal, hora_evento, estado_registro) 
-        VALUES (?, ?, ?, ?, ?, ?)
-    `
-	_, err := r.db.Exec(query,
+	_, err := r.sql.insertarRacion.Exec(
 		registro.IDEstudiante,
 		registro.FechaServicio,
 		registro.TipoRacion,
@@ -330,9 +549,74 @@ func (r *SQLiteUserRepository) GuardarRegistroRacion(registro db.RegistroRacion)
 	if err != nil {
 		return fmt.Errorf("(-) [GO]: error guardando registro de racion: %w", err)
 	}
+	r.invalidarStats()
 	return nil
 }
 
+// GuardarRegistrosRacion inserta un lote de raciones en una sola transaccion
+// (un solo commit para todo el lote). Las que ya estaban (UNIQUE de RF2) o
+// cuyo alumno ya no existe se saltan sin frenar al resto: vienen del diario
+// de raciones, que puede volver a aplicar unas pocas despues de una caida.
+// Devuelve cuantas se insertaron
+func (r *SQLiteUserRepository) GuardarRegistrosRacion(registros []db.RegistroRacion) (int, error) {
+	tx, err := r.db.Begin()
+	if err != nil {
+		return 0, fmt.Errorf("(-) [GO]: error abriendo transaccion de raciones: %w", err)
+	}
+	defer tx.Rollback()
+
+	// la sentencia ya esta preparada en la conexion de escritura: tx.Stmt la
+	// reusa sin volver a compilarla
+	stmt := tx.Stmt(r.sql.insertarRacionLote)
+	defer stmt.Close()
+
+	insertados := 0
+	for _, registro := range registros {
+		res, err := stmt.Exec(
+			registro.IDEstudiante,
+			registro.FechaServicio,
+			registro.TipoRacion,
+			registro.IDTerminal,
+			registro.HoraEvento,
+			registro.EstadoRegistro,
+		)
+		if err != nil {
+			return 0, fmt.Errorf("(-) [GO]: error guardando lote de raciones: %w", err)
+		}
+		if n, err := res.RowsAffected(); err == nil {
+			insertados += int(n)
+		}
+	}
+
+	if err := tx.Commit(); err != nil {
+		return 0, fmt.Errorf("(-) [GO]: error confirmando lote de raciones: %w", err)
+	}
+	if insertados > 0 {
+		r.invalidarStats()
+	}
+	return insertados, nil
+}
+
+// RegistrosDelDia devuelve run y tipo de las raciones ya servidas en fecha
+// ("YYYY-MM-DD")
+func (r *SQLiteUserRepository) RegistrosDelDia(fecha string) ([]db.RegistroRacion, error) {
+	rows, err := r.sql.racionesDelDia.Query(fecha)
+	if err != nil {
+		return nil, fmt.Errorf("(-) [GO]: error leyendo raciones del dia: %w", err)
+	}
+	defer rows.Close()
+
+	var registros []db.RegistroRacion
+	for rows.Next() {
+		registro := db.RegistroRacion{FechaServicio: fecha}
+		if err := rows.Scan(&registro.IDEstudiante, &registro.TipoRacion); err != nil {
+			return nil, fmt.Errorf("(-) [GO]: error leyendo raciones del dia: %w", err)
+		}
+		registros = append(registros, registro)
+	}
+	return registros, rows.Err()
+}
+
 // ADVERTENCIA ESTO FUNCIONA EN LIFO (ultimo en registrar primero en borrar)
 // creamos la funcion para borrar ultimo registro (lifo)
 func (r *SQLiteUserRepository) BorrarRegistro() bool {
@@ -365,6 +649,8 @@ func (r *SQLiteUserRepository) BorrarRegistro() bool {
 
 	// Si llegamos aquí, se borró correctamente
 	fmt.Printf("(+) [GO]: Último registro borrado exitosamente\n")
+	r.invalidarStats()
+	r.notificarRegistrosBorrados()
 	return true
 }
 
@@ -372,7 +658,7 @@ func (r *SQLiteUserRepository) BorrarRegistro() bool {
 func (r *SQLiteUserRepository) ObtenerUltimosRegistros() ([]db.RegistroRacion, error) {
 	query := `SELECT id_registro, id_estudiante, fecha_servicio, tipo_racion FROM RegistrosRaciones ORDER BY id_registro DESC LIMIT 10`
 
-	rows, err := r.db.Query(query)
+	rows, err := r.lectura.Query(query)
 	if err != nil {
 		return nil, fmt.Errorf("error consultando registros: %w", err)
 	}
@@ -392,27 +678,7 @@ func (r *SQLiteUserRepository) ObtenerUltimosRegistros() ([]db.RegistroRacion, e
 
 // creamos la funcion para revisar los ultimos X registros con datos del alumno (JOINs normalizados)
 func (r *SQLiteUserRepository) GetRecentRecords(limit int) ([]db.RegistroRecienteDTO, error) {
-	query := `
-		SELECT 
-			r.id_registro, 
-			u.nombre_completo, 
-			u.run_id, 
-			COALESCE(c.nombre, 'N/A') as curso,
-			COALESCE(l.caracter, '') as letra,
-			r.fecha_servicio, 
-			r.hora_evento, 
-			r.tipo_racion, 
-			r.id_terminal, 
-			r.estado_registro 
-		FROM RegistrosRaciones r
-		JOIN Usuarios u ON r.id_estudiante = u.run_id
-		LEFT JOIN DetailsEstudiante de ON u.run_id = de.run_id
-		LEFT JOIN Curso c ON de.id_curso = c.id_curso
-		LEFT JOIN Letra l ON de.id_letra = l.id_letra
-		ORDER BY r.id_registro DESC 
-		LIMIT ?`
-
-	rows, err := r.db.Query(query, limit)
+	rows, err := r.sql.recientes.Query(limit)
 	if err != nil {
 		return nil, fmt.Errorf("error consultando registros recientes: %w", err)
 	}
@@ -499,7 +765,7 @@ func (r *SQLiteUserRepository) GetExportRecords(startDate, endDate string, cours
 
 	query += " ORDER BY r.id_registro DESC"
 
-	rows, err := r.db.Query(query, args...)
+	rows, err := r.lectura.Query(query, args...)
 	if err != nil {
 		return nil, fmt.Errorf("error consultando registros de exportación: %w", err)
 	}
@@ -528,24 +794,75 @@ func (r *SQLiteUserRepository) GetExportRecords(startDate, endDate string, cours
 	return registros, nil
 }
 
-// Estadisticas globales del dia (o historicas)
+// invalidarStats hace que el proximo GetStats vuelva a leer los contadores
+func (r *SQLiteUserRepository) invalidarStats() {
+	r.stats.mu.Lock()
+	r.stats.valida = false
+	r.stats.mu.Unlock()
+}
+
+// Estadisticas globales historicas, con lo de hoy desglosado por curso. Salen
+// de ContadoresRaciones (los triggers los llevan al dia), no de contar
+// RegistrosRaciones, y quedan en memoria hasta el proximo registro o borrado
 func (r *SQLiteUserRepository) GetStats() db.Stats {
-	var stats db.Stats
-	// Contar desayunos (TipoRacion 1)
-	r.db.QueryRow("SELECT COUNT(*) FROM RegistrosRaciones WHERE tipo_racion = 1").Scan(&stats.Desayunos)
-	// Contar almuerzos (TipoRacion 2)
-	r.db.QueryRow("SELECT COUNT(*) FROM RegistrosRaciones WHERE tipo_racion = 2").Scan(&stats.Almuerzos)
-	stats.Total = stats.Desayunos + stats.Almuerzos
+	hoy := time.Now().Format("2006-01-02")
+
+	r.stats.mu.Lock()
+	defer r.stats.mu.Unlock()
+	if r.stats.valida && r.stats.stats.Hoy.Fecha == hoy && time.Now().Before(r.stats.hasta) {
+		return r.stats.stats
+	}
+
+	stats, err := r.leerStats(hoy)
+	if err != nil {
+		fmt.Printf("(-) [GO]: Error leyendo contadores de raciones: %v\n", err)
+		return stats
+	}
+	r.stats.stats = stats
+	r.stats.valida = true
+	r.stats.hasta = time.Now().Add(vigenciaStats)
 	return stats
 }
 
+// leerStats arma las estadisticas desde los contadores: una fila por dia,
+// racion y curso, asi el costo no crece con el historial
+func (r *SQLiteUserRepository) leerStats(hoy string) (db.Stats, error) {
+	stats := db.Stats{Hoy: &db.StatsDia{Fecha: hoy, Cursos: []db.StatsCurso{}}}
+
+	// historicas (TipoRacion 1 = desayuno, 2 = almuerzo)
+	err := r.sql.statsTotales.QueryRow().Scan(&stats.Desayunos, &stats.Almuerzos)
+	if err != nil {
+		return stats, err
+	}
+	stats.Total = stats.Desayunos + stats.Almuerzos
+
+	// hoy, por curso (id_curso 0 = alumno sin curso)
+	rows, err := r.sql.statsHoy.Query(hoy)
+	if err != nil {
+		return stats, err
+	}
+	defer rows.Close()
+
+	for rows.Next() {
+		var c db.StatsCurso
+		if err := rows.Scan(&c.Curso, &c.Letra, &c.Desayunos, &c.Almuerzos); err != nil {
+			return stats, err
+		}
+		c.Total = c.Desayunos + c.Almuerzos
+		if c.Total == 0 {
+			continue // solo raciones N/A
+		}
+		stats.Hoy.Desayunos += c.Desayunos
+		stats.Hoy.Almuerzos += c.Almuerzos
+		stats.Hoy.Cursos = append(stats.Hoy.Cursos, c)
+	}
+	stats.Hoy.Total = stats.Hoy.Desayunos + stats.Hoy.Almuerzos
+	return stats, rows.Err()
+}
+
 // Historial de un estudiante especifico
 func (r *SQLiteUserRepository) GetStudentHistory(runID string) ([]db.HistorialRacion, error) {
-	query := `SELECT fecha_servicio, tipo_racion, estado_registro 
-	          FROM RegistrosRaciones WHERE id_estudiante = ? 
-	          ORDER BY id_registro DESC`
-
-	rows, err := r.db.Query(query, runID)
+	rows, err := r.sql.historial.Query(runID)
 	if err != nil {
 		return nil, err
 	}
@@ -579,11 +896,11 @@ func (r *SQLiteUserRepository) GetStudentHistory(runID string) ([]db.HistorialRa
 	return historial, nil
 }
 
-// Estadisticas de un estudiante especifico
+// Estadisticas de un estudiante especifico (lectura por clave en
+// ContadoresEstudiante, sin recorrer sus registros)
 func (r *SQLiteUserRepository) GetStudentStats(runID string) db.Stats {
 	var stats db.Stats
-	r.db.QueryRow("SELECT COUNT(*) FROM RegistrosRaciones WHERE id_estudiante = ? AND tipo_racion = 1", runID).Scan(&stats.Desayunos)
-	r.db.QueryRow("SELECT COUNT(*) FROM RegistrosRaciones WHERE id_estudiante = ? AND tipo_racion = 2", runID).Scan(&stats.Almuerzos)
+	r.sql.statsEstudiante.QueryRow(runID).Scan(&stats.Desayunos, &stats.Almuerzos)
 	stats.Total = stats.Desayunos + stats.Almuerzos
 	return stats
 }
@@ -595,6 +912,10 @@ func (r *SQLiteUserRepository) SincronizarRegistros() error {
 
 func (r *SQLiteUserRepository) DeleteAllRecords() error {
 	_, err := r.db.Exec("DELETE FROM RegistrosRaciones")
+	if err == nil {
+		r.invalidarStats()
+		r.notificarRegistrosBorrados()
+	}
 	return err
 }
 
@@ -604,22 +925,14 @@ func (r *SQLiteUserRepository) AddRecord(record db.RegistroRacion) error {
 
 // ObtenerPerfilPorRunID devuelve el PerfilEstudiante dado un RunID, incluyendo su curso y letra (JOINs normalizados)
 func (r *SQLiteUserRepository) ObtenerPerfilPorRunID(runID string) (*db.PerfilEstudiante, error) {
-	query := `SELECT u.run_id, u.dv, u.nombre_completo, u.id_rol, u.template_huella, u.activo,
-	                 IFNULL(c.nombre, 'N/A') as curso, IFNULL(l.caracter, '') as letra
-	          FROM Usuarios u
-	          LEFT JOIN DetailsEstudiante d ON u.run_id = d.run_id
-	          LEFT JOIN Curso c ON d.id_curso = c.id_curso
-	          LEFT JOIN Letra l ON d.id_letra = l.id_letra
-	          WHERE u.run_id = ?`
-
 	var p db.PerfilEstudiante
-	err := r.db.QueryRow(query, runID).Scan(
+	err := r.sql.perfil.QueryRow(runID).Scan(
 		&p.RunID,
 		&p.DV,
 		&p.NombreCompleto,
 		&p.IDRol,
-		&p.TemplateHuella,
 		&p.Activo,
+		&p.TieneHuella,
 		&p.Curso,
 		&p.Letra,
 	)
@@ -651,6 +964,10 @@ func (r *SQLiteUserRepository) BorrarTodo() bool {
 	}
 
 	fmt.Printf("(+) [GO]: Base de datos limpiada por completo (DANGER ZONE)\n")
+	r.invalidarStats()
+	r.notificarRegistrosBorrados()
+	r.notificarRecarga()
+	r.notificarPerfilesRecargados()
 	return true
 }
 
@@ -659,7 +976,7 @@ func (r *SQLiteUserRepository) BorrarTodo() bool {
 
 func (r *SQLiteUserRepository) SubirPlantillaExcel(path string, force bool) error {
 	var existe int 
-	err := r.db.QueryRow("SELECT COUNT(*) FROM Usuarios WHERE id_rol = 3").Scan(&existe)
+	err := r.lectura.QueryRow("SELECT COUNT(*) FROM Usuarios WHERE id_rol = 3").Scan(&existe)
 
 	if err == nil && existe > 0 && !force {
 		return fmt.Errorf("CONFLICT_STUDENTS")
@@ -716,6 +1033,8 @@ func (r *SQLiteUserRepository) SubirPlantillaExcel(path string, force bool) erro
 	}
 
 	fmt.Println("(+) [GO]: Base de datos poblada con éxito desde el Excel.")
+	r.notificarRecarga()
+	r.notificarPerfilesRecargados()
 	return nil
 }
 
@@ -725,6 +1044,8 @@ func (r *SQLiteUserRepository) DesactivarEstudiante(runID string) error {
 	if err != nil {
 		return fmt.Errorf("(-) [GO]: error desactivando estudiante: %w", err)
 	}
+	r.notificarEliminado(runID)
+	r.notificarPerfil(runID)
 	return nil
 }
 
@@ -734,13 +1055,21 @@ func (r *SQLiteUserRepository) ReactivarEstudiante(runID string) error {
 	if err != nil {
 		return fmt.Errorf("(-) [GO]: error reactivando estudiante: %w", err)
 	}
+	// vuelve a la cache con la huella que tenia guardada
+	if r.observador != nil {
+		plantilla, err := r.plantillaDe(runID)
+		if err == nil {
+			r.notificarTemplate(runID, plantilla, true)
+		}
+	}
+	r.notificarPerfil(runID)
 	return nil
 }
 
 // GetAllCursos devuelve todos los cursos disponibles para los dropdowns
 func (r *SQLiteUserRepository) GetAllCursos() ([]db.Curso, error) {
 	query := `SELECT id_curso, nombre FROM Curso ORDER BY id_curso`
-	rows, err := r.db.Query(query)
+	rows, err := r.lectura.Query(query)
 	if err != nil {
 		return nil, fmt.Errorf("error consultando cursos: %w", err)
 	}
@@ -760,7 +1089,7 @@ func (r *SQLiteUserRepository) GetAllCursos() ([]db.Curso, error) {
 // GetAllLetras devuelve todas las letras disponibles para los dropdowns
 func (r *SQLiteUserRepository) GetAllLetras() ([]db.Letra, error) {
 	query := `SELECT id_letra, caracter FROM Letra ORDER BY id_letra`
-	rows, err := r.db.Query(query)
+	rows, err := r.lectura.Query(query)
 	if err != nil {
 		return nil, fmt.Errorf("error consultando letras: %w", err)
 	}
@@ -777,16 +1106,29 @@ func (r *SQLiteUserRepository) GetAllLetras() ([]db.Letra, error) {
 	return letras, nil
 }
 
-// Actualizar la huella de un alumno (separado de los datos personales)
+// Actualizar la huella de un alumno (separado de los datos personales): el
+// template del dedo principal en TemplatesHuella (sin huella = se borra)
 func (r *SQLiteUserRepository) UpdateStudentHuella(runID string, huella []byte) error {
-	_, err := r.db.Exec("UPDATE Usuarios SET template_huella = ? WHERE run_id = ?", huella, runID)
+	var err error
+	if len(huella) > 0 {
+		_, err = r.sql.guardarTemplate.Exec(runID, db.DedoPrincipal, huella, len(huella), db.ChecksumTemplate(huella))
+	} else {
+		_, err = r.sql.borrarTemplates.Exec(runID)
+	}
 	if err != nil {
 		return fmt.Errorf("(-) [GO]: error actualizando huella: %w", err)
 	}
+	// solo los activos viven en la cache
+	var activo bool
+	if err := r.lectura.QueryRow("SELECT activo FROM Usuarios WHERE run_id = ?", runID).Scan(&activo); err == nil {
+		r.notificarTemplate(runID, huella, activo)
+	}
 	return nil
 }
 
-// cerramos la conexion a la base de datos
+// cerramos las conexiones a la base de datos (primero las sentencias)
 func (r *SQLiteUserRepository) Close() error {
+	r.sql.cerrar()
+	r.lectura.Close()
 	return r.db.Close()
 }
@@ -0,0 +1,252 @@
+// dbSentencias abre las conexiones del repositorio y prepara las sentencias
+// calientes una sola vez (las mismas reglas que legacy_cpp/dbConexion)
+package DB
+
+import (
+	"database/sql"
+	"fmt"
+	"runtime"
+)
+
+// mismos valores que DB_BUSY_TIMEOUT_MS en legacy_cpp/dbConexion.hpp
+const busyTimeoutMs = 5000
+
+// maximoLectores acota las conexiones de solo lectura (dashboard, exportar,
+// perfiles del totem): mas que eso solo compite por CPU
+const maximoLectores = 4
+
+// dsnEscritura: la unica conexion que escribe. WAL para que los lectores no
+// la esperen, synchronous NORMAL (en WAL no se pierde consistencia) y las FK
+// en el DSN para que cada conexion nueva las tenga. database/sql nunca usa
+// una conexion desde dos goroutines, asi que sin mutex de SQLite (NOMUTEX) y
+// sin cache compartido (con cache=shared los lectores bloquean tablas)
+func dsnEscritura(dbPath string) string {
+	return fmt.Sprintf("file:%s?mode=rwc&_mutex=no&_journal_mode=WAL&_synchronous=NORMAL&_foreign_keys=1&_busy_timeout=%d&_txlock=immediate",
+		dbPath, busyTimeoutMs)
+}
+
+// dsnLectura: conexiones de solo lectura sobre la misma base (ya en WAL)
+func dsnLectura(dbPath string) string {
+	return fmt.Sprintf("file:%s?mode=ro&_mutex=no&_foreign_keys=1&_busy_timeout=%d",
+		dbPath, busyTimeoutMs)
+}
+
+func cantidadLectores() int {
+	n := runtime.NumCPU()
+	if n < 2 {
+		return 2
+	}
+	if n > maximoLectores {
+		return maximoLectores
+	}
+	return n
+}
+
+// ----
+
+// sentencias preparadas al abrir el repositorio. Las de escritura viven en
+// la conexion de escritura y las de lectura en el pool de lectores
+// (database/sql las vuelve a preparar sola en cada conexion nueva del pool)
+type sentencias struct {
+	// escritura
+	insertarRacion     *sql.Stmt
+	insertarRacionLote *sql.Stmt
+	guardarUsuario     *sql.Stmt
+	guardarTemplate    *sql.Stmt
+	borrarTemplates    *sql.Stmt
+
+	// lectura
+	usuario            *sql.Stmt
+	usuarios           *sql.Stmt
+	perfil             *sql.Stmt
+	perfiles           *sql.Stmt
+	firmaTemplates     *sql.Stmt
+	templatesActivos   *sql.Stmt
+	templatesPorRacion *sql.Stmt
+	templateDe         *sql.Stmt
+	racionesDelDia     *sql.Stmt
+	recientes          *sql.Stmt
+	historial          *sql.Stmt
+	statsTotales       *sql.Stmt
+	statsHoy           *sql.Stmt
+	statsEstudiante    *sql.Stmt
+}
+
+const (
+	sqlInsertarRacion = `
+        INSERT INTO RegistrosRaciones
+        (id_estudiante, fecha_servicio, tipo_racion, id_terminal, hora_evento, estado_registro)
+        VALUES (?, ?, ?, ?, ?, ?)`
+
+	// las repetidas (UNIQUE de RF2) o de alumnos borrados se saltan
+	sqlInsertarRacionLote = `
+        INSERT OR IGNORE INTO RegistrosRaciones
+        (id_estudiante, fecha_servicio, tipo_racion, id_terminal, hora_evento, estado_registro)
+        SELECT ?1, ?2, ?3, ?4, ?5, ?6
+        WHERE EXISTS (SELECT 1 FROM Usuarios WHERE run_id = ?1)`
+
+	// el resto de los datos (password_hash) no lo toca
+	sqlGuardarUsuario = `
+        INSERT INTO Usuarios (run_id, dv, nombre_completo, id_rol, activo)
+        VALUES (?1, ?2, ?3, ?4, ?5)
+        ON CONFLICT (run_id) DO UPDATE SET
+            dv = excluded.dv, nombre_completo = excluded.nombre_completo,
+            id_rol = excluded.id_rol, activo = excluded.activo`
+
+	sqlGuardarTemplate = `
+        INSERT INTO TemplatesHuella (run_id, indice_dedo, template, largo, checksum)
+        VALUES (?1, ?2, ?3, ?4, ?5)
+        ON CONFLICT (run_id, indice_dedo) DO UPDATE SET
+            template = excluded.template, largo = excluded.largo, checksum = excluded.checksum`
+
+	sqlBorrarTemplates = `DELETE FROM TemplatesHuella WHERE run_id = ?`
+
+	// los datos del alumno sin BLOB: si tiene huella sale del indice de
+	// TemplatesHuella, sin leer el template
+	sqlUsuarios = `SELECT u.run_id, u.dv, u.nombre_completo, u.id_rol, u.activo,
+	                      EXISTS (SELECT 1 FROM TemplatesHuella t WHERE t.run_id = u.run_id)
+	               FROM Usuarios u`
+
+	sqlUsuario = sqlUsuarios + `
+	              WHERE u.run_id = ?`
+
+	sqlPerfiles = `
+		SELECT u.run_id, u.dv, u.nombre_completo, u.id_rol, u.activo,
+		       EXISTS (SELECT 1 FROM TemplatesHuella t WHERE t.run_id = u.run_id),
+		       IFNULL(c.nombre, 'N/A') as curso, IFNULL(l.caracter, '') as letra
+		FROM Usuarios u
+		LEFT JOIN DetailsEstudiante d ON u.run_id = d.run_id
+		LEFT JOIN Curso c ON d.id_curso = c.id_curso
+		LEFT JOIN Letra l ON d.id_letra = l.id_letra`
+
+	sqlPerfil = sqlPerfiles + `
+		WHERE u.run_id = ?`
+
+	// los templates que entran al 1:N: alumnos activos, dedo principal
+	// (indice_dedo 0 = db.DedoPrincipal)
+	sqlTemplatesActivos = `SELECT t.run_id, t.template, t.checksum
+		FROM TemplatesHuella t
+		JOIN Usuarios u ON u.run_id = t.run_id
+		WHERE u.activo = 1 AND t.indice_dedo = 0 AND t.largo > 0`
+
+	// lo mismo sin leer los BLOB (largo ya esta en la fila)
+	sqlFirmaTemplates = `SELECT COUNT(*), COALESCE(SUM(t.largo), 0), COALESCE(SUM(t.checksum), 0)
+		FROM TemplatesHuella t
+		JOIN Usuarios u ON u.run_id = t.run_id
+		WHERE u.activo = 1 AND t.indice_dedo = 0 AND t.largo > 0`
+
+	sqlTemplatesPorRacion = `SELECT t.run_id, t.template
+		FROM TemplatesHuella t
+		JOIN Usuarios u ON u.run_id = t.run_id
+		WHERE u.activo = 1 AND t.indice_dedo = 0 AND t.largo > 0
+		  AND EXISTS (SELECT 1 FROM RegistrosRaciones r
+		              WHERE r.id_estudiante = t.run_id
+		                AND r.tipo_racion = ? AND r.fecha_servicio >= ?)`
+
+	sqlTemplateDe = `SELECT template FROM TemplatesHuella WHERE run_id = ? AND indice_dedo = 0`
+
+	sqlRacionesDelDia = `SELECT id_estudiante, tipo_racion FROM RegistrosRaciones WHERE fecha_servicio = ?`
+
+	sqlRecientes = `
+		SELECT
+			r.id_registro,
+			u.nombre_completo,
+			u.run_id,
+			COALESCE(c.nombre, 'N/A') as curso,
+			COALESCE(l.caracter, '') as letra,
+			r.fecha_servicio,
+			r.hora_evento,
+			r.tipo_racion,
+			r.id_terminal,
+			r.estado_registro
+		FROM RegistrosRaciones r
+		JOIN Usuarios u ON r.id_estudiante = u.run_id
+		LEFT JOIN DetailsEstudiante de ON u.run_id = de.run_id
+		LEFT JOIN Curso c ON de.id_curso = c.id_curso
+		LEFT JOIN Letra l ON de.id_letra = l.id_letra
+		ORDER BY r.id_registro DESC
+		LIMIT ?`
+
+	sqlHistorial = `SELECT fecha_servicio, tipo_racion, estado_registro
+	                FROM RegistrosRaciones WHERE id_estudiante = ?
+	                ORDER BY id_registro DESC`
+
+	// TipoRacion 1 = desayuno, 2 = almuerzo
+	sqlStatsTotales = `SELECT IFNULL(SUM(CASE WHEN tipo_racion = 1 THEN cantidad END), 0),
+	                          IFNULL(SUM(CASE WHEN tipo_racion = 2 THEN cantidad END), 0)
+	                   FROM ContadoresRaciones`
+
+	// id_curso 0 = alumno sin curso
+	sqlStatsHoy = `SELECT IFNULL(c.nombre, 'N/A'), IFNULL(l.caracter, ''),
+	                      SUM(CASE WHEN k.tipo_racion = 1 THEN k.cantidad ELSE 0 END),
+	                      SUM(CASE WHEN k.tipo_racion = 2 THEN k.cantidad ELSE 0 END)
+	               FROM ContadoresRaciones k
+	               LEFT JOIN Curso c ON k.id_curso = c.id_curso
+	               LEFT JOIN Letra l ON k.id_letra = l.id_letra
+	               WHERE k.fecha_servicio = ? AND k.cantidad > 0
+	               GROUP BY k.id_curso, k.id_letra
+	               ORDER BY k.id_curso, k.id_letra`
+
+	sqlStatsEstudiante = `SELECT IFNULL(SUM(CASE WHEN tipo_racion = 1 THEN cantidad END), 0),
+	                             IFNULL(SUM(CASE WHEN tipo_racion = 2 THEN cantidad END), 0)
+	                      FROM ContadoresEstudiante WHERE run_id = ?`
+)
+
+// prepararSentencias compila todas las sentencias de una vez: un error de SQL
+// aparece al abrir el repositorio y no en medio del servicio
+func prepararSentencias(escritura, lectura *sql.DB) (*sentencias, error) {
+	s := &sentencias{}
+	lista := []struct {
+		destino **sql.Stmt
+		conn    *sql.DB
+		query   string
+	}{
+		{&s.insertarRacion, escritura, sqlInsertarRacion},
+		{&s.insertarRacionLote, escritura, sqlInsertarRacionLote},
+		{&s.guardarUsuario, escritura, sqlGuardarUsuario},
+		{&s.guardarTemplate, escritura, sqlGuardarTemplate},
+		{&s.borrarTemplates, escritura, sqlBorrarTemplates},
+
+		{&s.usuario, lectura, sqlUsuario},
+		{&s.usuarios, lectura, sqlUsuarios},
+		{&s.perfil, lectura, sqlPerfil},
+		{&s.perfiles, lectura, sqlPerfiles},
+		{&s.firmaTemplates, lectura, sqlFirmaTemplates},
+		{&s.templatesActivos, lectura, sqlTemplatesActivos},
+		{&s.templatesPorRacion, lectura, sqlTemplatesPorRacion},
+		{&s.templateDe, lectura, sqlTemplateDe},
+		{&s.racionesDelDia, lectura, sqlRacionesDelDia},
+		{&s.recientes, lectura, sqlRecientes},
+		{&s.historial, lectura, sqlHistorial},
+		{&s.statsTotales, lectura, sqlStatsTotales},
+		{&s.statsHoy, lectura, sqlStatsHoy},
+		{&s.statsEstudiante, lectura, sqlStatsEstudiante},
+	}
+
+	for _, item := range lista {
+		stmt, err := item.conn.Prepare(item.query)
+		if err != nil {
+			s.cerrar()
+			return nil, fmt.Errorf("error preparando sentencia: %w\n%s", err, item.query)
+		}
+		*item.destino = stmt
+	}
+	return s, nil
+}
+
+// cerrar libera las sentencias ya preparadas (las nil se saltan)
+func (s *sentencias) cerrar() {
+	for _, stmt := range []*sql.Stmt{
+		s.insertarRacion, s.insertarRacionLote,
+		s.guardarUsuario, s.guardarTemplate, s.borrarTemplates,
+		s.usuario, s.usuarios, s.perfil, s.perfiles,
+		s.firmaTemplates, s.templatesActivos, s.templatesPorRacion, s.templateDe,
+		s.racionesDelDia,
+		s.recientes, s.historial,
+		s.statsTotales, s.statsHoy, s.statsEstudiante,
+	} {
+		if stmt != nil {
+			stmt.Close()
+		}
+	}
+}
@@ -0,0 +1,176 @@
+// conexion a la base de datos con cache de sentencias preparadas
+
+#include "dbConexion.hpp"
+#include <iostream>
+
+// las sentencias calientes, en el orden de SentenciaId. Son las mismas
+// consultas que usa infra/DB/dbRepository.go
+static const char *const SQL_SENTENCIAS[SQL_SENTENCIA_COUNT] = {
+    // SQL_INSERTAR_REGISTRO
+    "INSERT INTO RegistrosRaciones "
+    "(id_estudiante, fecha_servicio, tipo_racion, id_terminal, hora_evento, "
+    "estado_registro) "
+    "VALUES (?1, ?2, ?3, ?4, ?5, ?6);",
+
+    // SQL_PERFIL_POR_RUN
+    "SELECT u.run_id, u.dv, u.nombre_completo, u.id_rol, "
+    "EXISTS (SELECT 1 FROM TemplatesHuella t WHERE t.run_id = u.run_id), "
+    "u.activo, IFNULL(c.nombre, 'N/A'), IFNULL(l.caracter, '') "
+    "FROM Usuarios u "
+    "LEFT JOIN DetailsEstudiante d ON u.run_id = d.run_id "
+    "LEFT JOIN Curso c ON d.id_curso = c.id_curso "
+    "LEFT JOIN Letra l ON d.id_letra = l.id_letra "
+    "WHERE u.run_id = ?1;",
+
+    // SQL_REGISTROS_RECIENTES
+    "SELECT r.id_registro, u.nombre_completo, u.run_id, "
+    "COALESCE(c.nombre, 'N/A'), COALESCE(l.caracter, ''), r.fecha_servicio, "
+    "r.hora_evento, r.tipo_racion, r.id_terminal, r.estado_registro "
+    "FROM RegistrosRaciones r "
+    "JOIN Usuarios u ON r.id_estudiante = u.run_id "
+    "LEFT JOIN DetailsEstudiante de ON u.run_id = de.run_id "
+    "LEFT JOIN Curso c ON de.id_curso = c.id_curso "
+    "LEFT JOIN Letra l ON de.id_letra = l.id_letra "
+    "ORDER BY r.id_registro DESC "
+    "LIMIT ?1;",
+};
+
+// -----------------------------------------------------------------------------
+// Abrir / cerrar
+// -----------------------------------------------------------------------------
+DB_Conexion::DB_Conexion(sqlite3 *db, const std::string &db_path)
+    : m_db(db), m_ruta(db_path) {
+  for (int i = 0; i < SQL_SENTENCIA_COUNT; ++i) {
+    m_sentencias[i] = nullptr;
+  }
+}
+
+std::unique_ptr<DB_Conexion> DB_Conexion::Abrir(const std::string &db_path,
+                                                int busyTimeoutMs) {
+  sqlite3 *db = nullptr;
+  int rc = sqlite3_open_v2(db_path.c_str(), &db,
+                           SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+                               SQLITE_OPEN_NOMUTEX,
+                           nullptr);
+  if (rc != SQLITE_OK) {
+    std::cerr << "[DB_Backend] ERROR: No se pudo abrir/crear DB en: "
+              << db_path << " - "
+              << (db ? sqlite3_errmsg(db) : sqlite3_errstr(rc)) << "\n";
+    sqlite3_close(db);
+    return nullptr;
+  }
+
+  std::unique_ptr<DB_Conexion> conexion(new DB_Conexion(db, db_path));
+
+  // el busy timeout va primero: cambiar a WAL tambien necesita el lock
+  sqlite3_busy_timeout(db, busyTimeoutMs);
+
+  // WAL queda grabado en el archivo; synchronous NORMAL es seguro en WAL
+  // (se puede perder el ultimo commit si se corta la luz, nunca corromper)
+  if (!conexion->ejecutar("PRAGMA journal_mode = WAL;") ||
+      !conexion->ejecutar("PRAGMA synchronous = NORMAL;")) {
+    std::cerr << "[DB_Backend] WARN: No se pudo activar WAL en: " << db_path
+              << "\n";
+  }
+
+  // Habilitar soporte de Foreign Keys (es por conexion)
+  if (!conexion->ejecutar("PRAGMA foreign_keys = ON;")) {
+    std::cerr << "[DB_Backend] WARN: No se pudo habilitar foreign_keys.\n";
+  }
+  return conexion;
+}
+
+DB_Conexion::~DB_Conexion() {
+  for (int i = 0; i < SQL_SENTENCIA_COUNT; ++i) {
+    sqlite3_finalize(m_sentencias[i]);
+  }
+  // una transaccion abierta se deshace sola al cerrar
+  sqlite3_close(m_db);
+}
+
+sqlite3 *DB_Conexion::handle() const { return m_db; }
+
+const std::string &DB_Conexion::ruta() const { return m_ruta; }
+
+const char *DB_Conexion::ultimoError() const { return sqlite3_errmsg(m_db); }
+
+// -----------------------------------------------------------------------------
+// Sentencias
+// -----------------------------------------------------------------------------
+sqlite3_stmt *DB_Conexion::sentencia(SentenciaId id) {
+  if (id < 0 || id >= SQL_SENTENCIA_COUNT) {
+    return nullptr;
+  }
+
+  sqlite3_stmt *stmt = m_sentencias[id];
+  if (!stmt) {
+    // SQLITE_PREPARE_PERSISTENT: le avisa a sqlite que se va a reusar mucho
+    if (sqlite3_prepare_v3(m_db, SQL_SENTENCIAS[id], -1,
+                           SQLITE_PREPARE_PERSISTENT, &stmt,
+                           nullptr) != SQLITE_OK) {
+      std::cerr << "[DB_Backend] ERROR: Falló prepare de la sentencia " << id
+                << ": " << sqlite3_errmsg(m_db) << "\n";
+      return nullptr;
+    }
+    m_sentencias[id] = stmt;
+    return stmt;
+  }
+
+  // el uso anterior pudo quedar a medias (ej: un SELECT que no se leyo entero)
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return stmt;
+}
+
+bool DB_Conexion::ejecutar(const char *sql) {
+  char *error = nullptr;
+  if (sqlite3_exec(m_db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+    std::cerr << "[DB_Backend] ERROR: " << (error ? error : "sqlite3_exec")
+              << "\n";
+    sqlite3_free(error);
+    return false;
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// Transacciones
+// -----------------------------------------------------------------------------
+bool DB_Conexion::comenzar() { return ejecutar("BEGIN IMMEDIATE;"); }
+
+bool DB_Conexion::confirmar() { return ejecutar("COMMIT;"); }
+
+bool DB_Conexion::deshacer() {
+  // si sqlite ya la deshizo sola (ej: error de disco) no hay nada que hacer
+  if (!enTransaccion()) {
+    return true;
+  }
+  return ejecutar("ROLLBACK;");
+}
+
+bool DB_Conexion::enTransaccion() const {
+  return sqlite3_get_autocommit(m_db) == 0;
+}
+
+DB_Transaccion::DB_Transaccion(DB_Conexion &conexion)
+    : m_conexion(conexion), m_activa(conexion.comenzar()) {}
+
+DB_Transaccion::~DB_Transaccion() {
+  if (m_activa) {
+    m_conexion.deshacer();
+  }
+}
+
+bool DB_Transaccion::activa() const { return m_activa; }
+
+bool DB_Transaccion::confirmar() {
+  if (!m_activa) {
+    return false;
+  }
+  if (!m_conexion.confirmar()) {
+    // COMMIT fallido (ej: SQLITE_BUSY): el destructor la deshace
+    return false;
+  }
+  m_activa = false;
+  return true;
+}
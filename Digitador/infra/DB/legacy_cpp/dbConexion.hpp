@@ -0,0 +1,81 @@
+// una conexion a la base de datos con su cache de sentencias preparadas
+
+// Se abre en modo WAL (los lectores no esperan al que escribe) con un busy
+// timeout, asi el proceso de Go y el de C++ pueden compartir el archivo sin
+// SQLITE_BUSY inmediatos. Las sentencias calientes (registrar racion, perfil
+// por run, ultimos registros) se preparan una sola vez por conexion y se
+// reusan con reset + bind.
+//
+// Una conexion NO es thread-safe (se abre con SQLITE_OPEN_NOMUTEX y el cache
+// es de la conexion): una por hilo.
+#pragma once
+#include "sqlite3.h"
+#include <memory>
+#include <string>
+
+#define DB_BUSY_TIMEOUT_MS 5000 // espera por el lock de escritura de otro proceso
+
+// sentencias del cache (ver SQL_SENTENCIAS en dbConexion.cpp)
+enum SentenciaId {
+  SQL_INSERTAR_REGISTRO = 0, // RegistrosRaciones
+  SQL_PERFIL_POR_RUN,        // Usuarios + curso y letra
+  SQL_REGISTROS_RECIENTES,   // ultimos N registros con datos del alumno
+  SQL_SENTENCIA_COUNT
+};
+
+class DB_Conexion {
+public:
+  // abre (o crea) la base en db_path, en WAL y con busy timeout. nullptr si
+  // no se pudo abrir
+  static std::unique_ptr<DB_Conexion> Abrir(const std::string &db_path,
+                                            int busyTimeoutMs = DB_BUSY_TIMEOUT_MS);
+  ~DB_Conexion(); // finaliza las sentencias y cierra
+
+  sqlite3 *handle() const;
+  const std::string &ruta() const;
+
+  // sentencia lista para bind (ya reseteada y sin binds viejos). Se prepara
+  // la primera vez que se pide. nullptr si no compila
+  sqlite3_stmt *sentencia(SentenciaId id);
+
+  // ejecutar SQL sin resultados (uno o varios statements separados por ;)
+  bool ejecutar(const char *sql);
+
+  // transaccion explicita. BEGIN IMMEDIATE toma el lock de escritura al
+  // empezar: si otro proceso esta escribiendo esperamos aca (busy timeout)
+  // y no a mitad de la transaccion
+  bool comenzar();
+  bool confirmar();
+  bool deshacer();
+  bool enTransaccion() const;
+
+  // ultimo error de sqlite en esta conexion
+  const char *ultimoError() const;
+
+private:
+  explicit DB_Conexion(sqlite3 *db, const std::string &db_path);
+
+  sqlite3 *m_db;
+  std::string m_ruta;
+  sqlite3_stmt *m_sentencias[SQL_SENTENCIA_COUNT];
+
+  DB_Conexion(const DB_Conexion &) = delete;
+  DB_Conexion &operator=(const DB_Conexion &) = delete;
+};
+
+// transaccion con alcance: si no se confirma, se deshace al salir
+class DB_Transaccion {
+public:
+  explicit DB_Transaccion(DB_Conexion &conexion);
+  ~DB_Transaccion();
+
+  bool activa() const; // false si el BEGIN fallo
+  bool confirmar();
+
+private:
+  DB_Conexion &m_conexion;
+  bool m_activa;
+
+  DB_Transaccion(const DB_Transaccion &) = delete;
+  DB_Transaccion &operator=(const DB_Transaccion &) = delete;
+};
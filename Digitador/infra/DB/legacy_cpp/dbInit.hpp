@@ -1,20 +1,25 @@
 // Funcion que se encarga de iniciar y destruir la instancia de la base de datos
 
 #pragma once
-#include "sqlite3.h"
-#include <mutex>
-#include <optional>
+#include "dbConexion.hpp"
+#include <cstddef>
+#include <memory>
 #include <string>
 
 class DB_init {
 public:
-  // devuelve true si salio todo bien
-  static bool Inicializar_DB(const std::string &db_path, sqlite3 *&db_handle);
-
-  static bool Inicializar_DB(const std::string &db_path);
+  // abre (o crea) la base en db_path, en WAL, y deja el esquema y los
+  // catalogos listos. nullptr si algo fallo
+  static std::unique_ptr<DB_Conexion> Inicializar_DB(const std::string &db_path);
 
 private:
-  // Helper para ejecutar SQL simple (como CREATE TABLE)
-  static bool _ejecutar_sql_script(sqlite3 *&db_handle, const char *sql);
-  static bool insertarAdminBase(sqlite3 *db);
-};
\ No newline at end of file
+  // Helper para ejecutar una lista de sentencias SQL simples (como CREATE
+  // TABLE) dentro de la transaccion de inicializacion
+  static bool _ejecutar_sql_script(DB_Conexion &conexion,
+                                   const char *const *sentencias,
+                                   size_t cantidad);
+
+  // base de antes de TemplatesHuella: mover los templates de Usuarios (sin
+  // la columna vieja no hace nada)
+  static bool _migrar_templates(DB_Conexion &conexion);
+};
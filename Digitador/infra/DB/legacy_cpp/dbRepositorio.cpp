@@ -0,0 +1,165 @@
+// repositorio nativo sobre las sentencias preparadas de DB_Conexion
+
+#include "dbRepositorio.hpp"
+#include <iostream>
+
+// columna de texto a std::string (NULL = "")
+static std::string textoColumna(sqlite3_stmt *stmt, int col) {
+  const unsigned char *texto = sqlite3_column_text(stmt, col);
+  if (!texto) {
+    return std::string();
+  }
+  return std::string(reinterpret_cast<const char *>(texto),
+                     static_cast<size_t>(sqlite3_column_bytes(stmt, col)));
+}
+
+DB_Repositorio::DB_Repositorio(DB_Conexion &conexion) : m_conexion(conexion) {}
+
+// codigo de sqlite de un step fallido a DB_*
+int DB_Repositorio::resultadoDe(int rc) const {
+  if (rc == SQLITE_CONSTRAINT) {
+    // la extendida distingue el UNIQUE de la racion de una FK rota
+    int extendido = sqlite3_extended_errcode(m_conexion.handle());
+    if (extendido == SQLITE_CONSTRAINT_UNIQUE) {
+      return DB_ERR_DUPLICADO;
+    }
+  }
+  if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+    return DB_ERR_OCUPADA;
+  }
+  std::cerr << "[DB_Backend] ERROR: " << m_conexion.ultimoError() << "\n";
+  return DB_ERR_SQL;
+}
+
+// -----------------------------------------------------------------------------
+// Registrar raciones
+// -----------------------------------------------------------------------------
+int DB_Repositorio::insertarRegistro(RegistroRacion &registro) {
+  sqlite3_stmt *stmt = m_conexion.sentencia(SQL_INSERTAR_REGISTRO);
+  if (!stmt) {
+    return DB_ERR_SQL;
+  }
+
+  // SQLITE_STATIC: los strings viven hasta el step
+  sqlite3_bind_text(stmt, 1, registro.idEstudiante.c_str(),
+                    static_cast<int>(registro.idEstudiante.size()),
+                    SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, registro.fechaServicio.c_str(),
+                    static_cast<int>(registro.fechaServicio.size()),
+                    SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 3, registro.tipoRacion);
+  sqlite3_bind_text(stmt, 4, registro.idTerminal.c_str(),
+                    static_cast<int>(registro.idTerminal.size()),
+                    SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 5, registro.horaEvento);
+  sqlite3_bind_int(stmt, 6, registro.estadoRegistro);
+
+  int rc = sqlite3_step(stmt);
+  // soltamos la sentencia ya (y los punteros a los strings del registro)
+  sqlite3_reset(stmt);
+  if (rc != SQLITE_DONE) {
+    return resultadoDe(rc);
+  }
+  registro.idRegistro = sqlite3_last_insert_rowid(m_conexion.handle());
+  return DB_OK;
+}
+
+int DB_Repositorio::guardarRegistroRacion(RegistroRacion &registro) {
+  // un INSERT suelto ya es su propia transaccion
+  return insertarRegistro(registro);
+}
+
+int DB_Repositorio::guardarRegistrosRacion(
+    std::vector<RegistroRacion> &registros, std::vector<int> &resultados) {
+  resultados.assign(registros.size(), DB_ERR_SQL);
+
+  DB_Transaccion transaccion(m_conexion);
+  if (!transaccion.activa()) {
+    return -1;
+  }
+
+  int guardados = 0;
+  for (size_t i = 0; i < registros.size(); ++i) {
+    // un INSERT que falla por constraint solo deshace esa fila
+    resultados[i] = insertarRegistro(registros[i]);
+    if (resultados[i] == DB_OK) {
+      ++guardados;
+    } else if (resultados[i] != DB_ERR_DUPLICADO) {
+      // error de disco o similar: no confirmamos la mitad del lote
+      return -1;
+    }
+  }
+
+  if (!transaccion.confirmar()) {
+    resultados.assign(registros.size(), DB_ERR_SQL);
+    return -1;
+  }
+  return guardados;
+}
+
+// -----------------------------------------------------------------------------
+// Consultas
+// -----------------------------------------------------------------------------
+int DB_Repositorio::obtenerPerfilPorRun(const std::string &runId,
+                                        PerfilEstudiante &perfil) {
+  sqlite3_stmt *stmt = m_conexion.sentencia(SQL_PERFIL_POR_RUN);
+  if (!stmt) {
+    return DB_ERR_SQL;
+  }
+  sqlite3_bind_text(stmt, 1, runId.c_str(), static_cast<int>(runId.size()),
+                    SQLITE_STATIC);
+
+  int rc = sqlite3_step(stmt);
+  if (rc == SQLITE_DONE) {
+    sqlite3_reset(stmt);
+    return DB_ERR_NO_ENCONTRADO;
+  }
+  if (rc != SQLITE_ROW) {
+    sqlite3_reset(stmt);
+    return resultadoDe(rc);
+  }
+
+  perfil.runId = textoColumna(stmt, 0);
+  perfil.dv = textoColumna(stmt, 1);
+  perfil.nombreCompleto = textoColumna(stmt, 2);
+  perfil.idRol = sqlite3_column_int(stmt, 3);
+  perfil.tieneHuella = sqlite3_column_int(stmt, 4) != 0;
+  perfil.activo = sqlite3_column_int(stmt, 5) != 0;
+  perfil.curso = textoColumna(stmt, 6);
+  perfil.letra = textoColumna(stmt, 7);
+
+  sqlite3_reset(stmt);
+  return DB_OK;
+}
+
+int DB_Repositorio::registrosRecientes(int limite,
+                                       std::vector<RegistroReciente> &out) {
+  out.clear();
+  sqlite3_stmt *stmt = m_conexion.sentencia(SQL_REGISTROS_RECIENTES);
+  if (!stmt) {
+    return DB_ERR_SQL;
+  }
+  sqlite3_bind_int(stmt, 1, limite);
+
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    RegistroReciente r;
+    r.id = sqlite3_column_int64(stmt, 0);
+    r.nombreCompleto = textoColumna(stmt, 1);
+    r.run = textoColumna(stmt, 2);
+    r.curso = textoColumna(stmt, 3);
+    r.letra = textoColumna(stmt, 4);
+    r.fechaServicio = textoColumna(stmt, 5);
+    r.horaEvento = sqlite3_column_int64(stmt, 6);
+    r.tipoRacion = sqlite3_column_int(stmt, 7);
+    r.terminal = textoColumna(stmt, 8);
+    r.estadoRegistro = sqlite3_column_int(stmt, 9);
+    out.push_back(r);
+  }
+  sqlite3_reset(stmt);
+  if (rc != SQLITE_DONE) {
+    out.clear();
+    return resultadoDe(rc);
+  }
+  return DB_OK;
+}
@@ -0,0 +1,83 @@
+// repositorio nativo: el camino rapido de escritura del proceso del sensor
+
+// Las mismas operaciones calientes que infra/DB/dbRepository.go (registrar
+// una racion, perfil por run, ultimos registros) sobre una DB_Conexion y sus
+// sentencias preparadas. Un repositorio por conexion, una conexion por hilo.
+#pragma once
+#include "dbConexion.hpp"
+#include <string>
+#include <vector>
+
+// resultado de las operaciones (los mismos valores para todas)
+#define DB_OK 0
+#define DB_ERR_DUPLICADO -1     // ya recibio esa racion hoy (UNIQUE RF2)
+#define DB_ERR_NO_ENCONTRADO -2 // no existe el run
+#define DB_ERR_OCUPADA -3       // otro proceso tuvo el lock mas que el busy timeout
+#define DB_ERR_SQL -4           // cualquier otro error de sqlite
+
+// una fila de RegistrosRaciones (ver db.RegistroRacion en Go)
+struct RegistroRacion {
+  long long idRegistro; // lo asigna la base al insertar
+  std::string idEstudiante;
+  std::string fechaServicio; // "YYYY-MM-DD"
+  int tipoRacion;            // 0=N/A, 1=Desayuno, 2=Almuerzo
+  std::string idTerminal;
+  long long horaEvento; // epoch ms
+  int estadoRegistro;   // 0=PENDIENTE, 1=SINCRONIZADO
+};
+
+// alumno con su curso y letra (ver db.PerfilEstudiante en Go)
+struct PerfilEstudiante {
+  std::string runId;
+  std::string dv;
+  std::string nombreCompleto;
+  int idRol;
+  bool tieneHuella; // el template esta en TemplatesHuella, no se lee aca
+  bool activo;
+  std::string curso;
+  std::string letra;
+};
+
+// registro con los datos del alumno para el dashboard (ver
+// db.RegistroRecienteDTO en Go)
+struct RegistroReciente {
+  long long id;
+  std::string nombreCompleto;
+  std::string run;
+  std::string curso;
+  std::string letra;
+  std::string fechaServicio;
+  long long horaEvento;
+  int tipoRacion;
+  std::string terminal;
+  int estadoRegistro;
+};
+
+class DB_Repositorio {
+public:
+  explicit DB_Repositorio(DB_Conexion &conexion);
+
+  // registrar una racion. En registro.idRegistro queda el id asignado.
+  // Devuelve DB_OK, DB_ERR_DUPLICADO, DB_ERR_OCUPADA o DB_ERR_SQL
+  int guardarRegistroRacion(RegistroRacion &registro);
+
+  // registrar un lote en una sola transaccion (un solo fsync). En
+  // resultados[i] queda el DB_* de cada uno: un duplicado no frena al resto.
+  // Devuelve cuantos se guardaron, o -1 si la transaccion no se pudo hacer
+  int guardarRegistrosRacion(std::vector<RegistroRacion> &registros,
+                             std::vector<int> &resultados);
+
+  // perfil del alumno por run. DB_OK, DB_ERR_NO_ENCONTRADO o DB_ERR_SQL
+  int obtenerPerfilPorRun(const std::string &runId, PerfilEstudiante &perfil);
+
+  // los ultimos limite registros, del mas nuevo al mas viejo. DB_OK o
+  // DB_ERR_SQL
+  int registrosRecientes(int limite, std::vector<RegistroReciente> &out);
+
+private:
+  DB_Conexion &m_conexion;
+
+  // insertar con la sentencia del cache, sin transaccion propia
+  int insertarRegistro(RegistroRacion &registro);
+  int resultadoDe(int rc) const;
+};
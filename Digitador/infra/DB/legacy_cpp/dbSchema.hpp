@@ -1,48 +1,159 @@
 // archivo para construir la base de datos
 
+// el esquema lo manda core/db/dbSchema.go (InitDatabase): esta es la misma
+// lista de sentencias para cuando el proceso de C++ abre la base primero. Si
+// cambia una tabla alla, se cambia aca (schema.txt es solo de referencia)
 #pragma once
-#include <string>
 
 namespace Schema {
-// Usamos R"(...)" para escribir SQL multilínea sin morir en el intento
-const std::string TABLAS =
-    R"(
-        // Usuarios
-      "CREATE TABLE IF NOT EXISTS Usuarios ("
-      "    run_id TEXT PRIMARY KEY NOT NULL,"
-      "    dv CHAR(1) NOT NULL,"
-      "    nombre_completo TEXT NOT NULL,"
-      "    id_rol INTEGER NOT NULL DEFAULT 3," // 3=Estudiante
-      "    password_hash TEXT,"
-      "    template_huella BLOB NOT NULL"
-      ");"
-      // DetallesEstudiante
-      "CREATE TABLE IF NOT EXISTS DetallesEstudiante ("
-      "    run_id TEXT PRIMARY KEY NOT NULL,"
-      "    curso TEXT,"
-      "    FOREIGN KEY (run_id) REFERENCES Usuarios (run_id) ON DELETE CASCADE"
-      ");"
-      // RegistrosRaciones (PLURAL)
-      "CREATE TABLE IF NOT EXISTS RegistrosRaciones ("
-      "    id_registro INTEGER PRIMARY KEY AUTOINCREMENT,"
-      "    id_estudiante TEXT NOT NULL,"
-      "    fecha_servicio TEXT NOT NULL," // "YYYY-MM-DD"
-      "    tipo_racion INTEGER NOT NULL," // 0, 1, 2
-      "    id_terminal TEXT NOT NULL,"
-      "    hora_evento INTEGER NOT NULL,"     // epoch ms
-      "    estado_registro INTEGER NOT NULL," // 0=PENDIENTE, 1=SINCRONIZADO
-      "    FOREIGN KEY (id_estudiante) REFERENCES Usuarios (run_id),"
-      "    UNIQUE (id_estudiante, fecha_servicio, tipo_racion)" // (RF2)
-    ");"
-    // Configuración global
+// tablas, en orden de dependencia
+static const char *const TABLAS[] = {
+    "CREATE TABLE IF NOT EXISTS Curso ("
+    "    id_curso INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "    nombre TEXT NOT NULL UNIQUE"
+    ");",
+
+    "CREATE TABLE IF NOT EXISTS Letra ("
+    "    id_letra INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "    caracter TEXT NOT NULL UNIQUE"
+    ");",
+
+    "CREATE TABLE IF NOT EXISTS Usuarios ("
+    "    run_id TEXT PRIMARY KEY NOT NULL,"
+    "    dv TEXT NOT NULL,"
+    "    nombre_completo TEXT NOT NULL,"
+    "    id_rol INTEGER NOT NULL DEFAULT 3," // 3=Estudiante
+    "    password_hash TEXT,"
+    "    activo INTEGER NOT NULL DEFAULT 1" // 1=TRUE, 0=FALSE
+    ");",
+
+    // los templates van aparte (listar alumnos no arrastra los BLOB)
+    "CREATE TABLE IF NOT EXISTS TemplatesHuella ("
+    "    run_id TEXT NOT NULL,"
+    "    indice_dedo INTEGER NOT NULL DEFAULT 0," // 0-9
+    "    template BLOB NOT NULL,"
+    "    largo INTEGER NOT NULL,"    // bytes del template
+    "    checksum INTEGER NOT NULL," // CRC-32 del template
+    "    PRIMARY KEY (run_id, indice_dedo),"
+    "    FOREIGN KEY (run_id) REFERENCES Usuarios (run_id) ON DELETE CASCADE"
+    ");",
+
+    "CREATE TABLE IF NOT EXISTS DetailsEstudiante ("
+    "    run_id TEXT PRIMARY KEY NOT NULL,"
+    "    id_curso INTEGER NOT NULL,"
+    "    id_letra INTEGER NOT NULL,"
+    "    FOREIGN KEY (run_id) REFERENCES Usuarios (run_id) ON DELETE CASCADE,"
+    "    FOREIGN KEY (id_curso) REFERENCES Curso (id_curso),"
+    "    FOREIGN KEY (id_letra) REFERENCES Letra (id_letra)"
+    ");",
+
+    "CREATE TABLE IF NOT EXISTS RegistrosRaciones ("
+    "    id_registro INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "    id_estudiante TEXT NOT NULL,"
+    "    fecha_servicio TEXT NOT NULL,"              // "YYYY-MM-DD"
+    "    tipo_racion INTEGER NOT NULL,"              // 0=N/A, 1=Desayuno, 2=Almuerzo
+    "    id_terminal TEXT NOT NULL,"
+    "    hora_evento INTEGER NOT NULL,"              // epoch ms
+    "    estado_registro INTEGER NOT NULL DEFAULT 0," // 0=PENDIENTE, 1=SINCRONIZADO
+    "    FOREIGN KEY (id_estudiante) REFERENCES Usuarios (run_id),"
+    "    UNIQUE (id_estudiante, fecha_servicio, tipo_racion)" // (RF2)
+    ");",
+
     "CREATE TABLE IF NOT EXISTS ConfiguracionGlobal ("
     "    id_unica INTEGER PRIMARY KEY CHECK (id_unica = 1),"
-    "    id_terminal TEXT NOT NULL,"
-    "    tipo_racion INTEGER NOT NULL CHECK (tipo_racion IN (0,1,2)),"
+    "    id_terminal TEXT NOT NULL DEFAULT 'TOTEM-1',"
+    "    tipo_racion INTEGER NOT NULL DEFAULT 0,"
     "    puerto_impresora TEXT NOT NULL DEFAULT 'COM3'"
-    ");";
+    ");",
+
+    // contadores para las estadisticas, mantenidos por los triggers
+    "CREATE TABLE IF NOT EXISTS ContadoresRaciones ("
+    "    fecha_servicio TEXT NOT NULL,"
+    "    tipo_racion INTEGER NOT NULL,"
+    "    id_curso INTEGER NOT NULL," // 0 = alumno sin curso
+    "    id_letra INTEGER NOT NULL,"
+    "    cantidad INTEGER NOT NULL DEFAULT 0,"
+    "    PRIMARY KEY (fecha_servicio, tipo_racion, id_curso, id_letra)"
+    ") WITHOUT ROWID;",
+
+    "CREATE TABLE IF NOT EXISTS ContadoresEstudiante ("
+    "    run_id TEXT NOT NULL,"
+    "    tipo_racion INTEGER NOT NULL,"
+    "    cantidad INTEGER NOT NULL DEFAULT 0,"
+    "    PRIMARY KEY (run_id, tipo_racion)"
+    ") WITHOUT ROWID;",
+
+    "CREATE TRIGGER IF NOT EXISTS ContarRacion AFTER INSERT ON RegistrosRaciones"
+    " BEGIN"
+    "  INSERT INTO ContadoresRaciones (fecha_servicio, tipo_racion, id_curso, id_letra, cantidad)"
+    "  VALUES (NEW.fecha_servicio, NEW.tipo_racion,"
+    "   IFNULL((SELECT id_curso FROM DetailsEstudiante WHERE run_id = NEW.id_estudiante), 0),"
+    "   IFNULL((SELECT id_letra FROM DetailsEstudiante WHERE run_id = NEW.id_estudiante), 0),"
+    "   1)"
+    "  ON CONFLICT (fecha_servicio, tipo_racion, id_curso, id_letra) DO UPDATE SET cantidad = cantidad + 1;"
+    "  INSERT INTO ContadoresEstudiante (run_id, tipo_racion, cantidad)"
+    "  VALUES (NEW.id_estudiante, NEW.tipo_racion, 1)"
+    "  ON CONFLICT (run_id, tipo_racion) DO UPDATE SET cantidad = cantidad + 1;"
+    " END;",
+
+    "CREATE TRIGGER IF NOT EXISTS DescontarRacion AFTER DELETE ON RegistrosRaciones"
+    " BEGIN"
+    "  UPDATE ContadoresRaciones SET cantidad = cantidad - 1"
+    "  WHERE (fecha_servicio, tipo_racion, id_curso, id_letra) IN ("
+    "   SELECT c.fecha_servicio, c.tipo_racion, c.id_curso, c.id_letra"
+    "   FROM ContadoresRaciones c"
+    "   LEFT JOIN DetailsEstudiante d ON d.run_id = OLD.id_estudiante"
+    "   WHERE c.fecha_servicio = OLD.fecha_servicio AND c.tipo_racion = OLD.tipo_racion AND c.cantidad > 0"
+    "   ORDER BY (c.id_curso = IFNULL(d.id_curso, 0) AND c.id_letra = IFNULL(d.id_letra, 0)) DESC"
+    "   LIMIT 1);"
+    "  UPDATE ContadoresEstudiante SET cantidad = cantidad - 1"
+    "  WHERE run_id = OLD.id_estudiante AND tipo_racion = OLD.tipo_racion AND cantidad > 0;"
+    " END;",
+};
+
+// catalogos y configuracion por defecto (INSERT OR IGNORE: no pisa nada)
+static const char *const DATOS_BASE[] = {
+    "INSERT OR IGNORE INTO Curso (nombre) VALUES"
+    " ('1° Básico'), ('2° Básico'), ('3° Básico'), ('4° Básico'),"
+    " ('5° Básico'), ('6° Básico'), ('7° Básico'), ('8° Básico'),"
+    " ('1° Medio'), ('2° Medio'), ('3° Medio'), ('4° Medio');",
+
+    "INSERT OR IGNORE INTO Letra (caracter) VALUES"
+    " ('A'), ('B'), ('C'), ('D');",
+
+    "INSERT OR IGNORE INTO ConfiguracionGlobal"
+    " (id_unica, id_terminal, tipo_racion, puerto_impresora)"
+    " VALUES (1, 'TOTEM-1', 0, 'COM3');",
+
+    // base anterior a los contadores: se arman una vez desde el historial
+    "INSERT INTO ContadoresRaciones (fecha_servicio, tipo_racion, id_curso, id_letra, cantidad)"
+    " SELECT r.fecha_servicio, r.tipo_racion, IFNULL(d.id_curso, 0), IFNULL(d.id_letra, 0), COUNT(*)"
+    " FROM RegistrosRaciones r"
+    " LEFT JOIN DetailsEstudiante d ON d.run_id = r.id_estudiante"
+    " WHERE NOT EXISTS (SELECT 1 FROM ContadoresRaciones)"
+    " GROUP BY 1, 2, 3, 4;",
+
+    "INSERT INTO ContadoresEstudiante (run_id, tipo_racion, cantidad)"
+    " SELECT id_estudiante, tipo_racion, COUNT(*)"
+    " FROM RegistrosRaciones"
+    " WHERE NOT EXISTS (SELECT 1 FROM ContadoresEstudiante)"
+    " GROUP BY 1, 2;",
+};
+
+// base de antes de TemplatesHuella (Usuarios todavia con template_huella):
+// mover los templates como dedo 0 y borrar la columna. crc32() la registra
+// DB_init antes de correrlo (ver migrarTemplates en core/db/dbSchema.go)
+static const char *const COLUMNA_TEMPLATE_VIEJA =
+    "SELECT COUNT(*) FROM pragma_table_info('Usuarios')"
+    " WHERE name = 'template_huella';";
+
+static const char *const MIGRAR_TEMPLATES[] = {
+    "INSERT OR IGNORE INTO TemplatesHuella"
+    " (run_id, indice_dedo, template, largo, checksum)"
+    " SELECT run_id, 0, template_huella, LENGTH(template_huella),"
+    " crc32(template_huella)"
+    " FROM Usuarios WHERE LENGTH(template_huella) > 0;",
 
-const std::string SEED_ADMIN = "INSERT OR IGNORE INTO Usuarios (run_id, "
-                               "nombre_completo, id_rol, template_huella) "
-                               "VALUES (?, ?, ?, ?);";
-} // namespace Schema
\ No newline at end of file
+    "ALTER TABLE Usuarios DROP COLUMN template_huella;",
+};
+} // namespace Schema
@@ -1,106 +1,97 @@
 // funcion que se encarga de construir e inicializar la base de datos
 
-#include "DB/dbInit.hpp"
-#include "Server/Utilities/ServerStartup.hpp"
+#include "dbInit.hpp"
+#include "dbSchema.hpp"
 #include <iostream>
-#include <stdexcept> // Para std::runtime_error
-#include <stdlib.h>
-#include <vector>
 
-// 1. INICIALIZAR DB (esto lo va a hacer ServerStartup al iniciar el sistema)
-bool DB_init::Inicializar_DB(const std::string &db_path, sqlite3 *&db_handle) {
-  int rc = sqlite3_open_v2(db_path_.c_str(), &db_handle_,
-                           SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
-                               SQLITE_OPEN_FULLMUTEX,
-                           nullptr);
-
-  if (rc != SQLITE_OK) {
-    std::cerr << "[DB_Backend] ERROR: No se pudo abrir/crear DB en: "
-              << db_path_ << " - " << sqlite3_errmsg(db_handle_) << "\n";
-    return false;
-  }
-
-  // Habilitar soporte de Foreign Keys
-  if (!_ejecutar_sql_script("PRAGMA foreign_keys = ON;")) {
-    std::cerr << "[DB_Backend] WARN: No se pudo habilitar foreign_keys.\n";
+// 1. INICIALIZAR DB (lo hace el proceso que abre la base primero)
+std::unique_ptr<DB_Conexion> DB_init::Inicializar_DB(const std::string &db_path) {
+  std::unique_ptr<DB_Conexion> conexion = DB_Conexion::Abrir(db_path);
+  if (!conexion) {
+    return nullptr;
   }
 
-  // Esquema
-  const char *sql_schema =
-      // Usuarios
-      "CREATE TABLE IF NOT EXISTS Usuarios ("
-      "    run_id TEXT PRIMARY KEY NOT NULL,"
-      "    dv CHAR(1) NOT NULL,"
-      "    nombre_completo TEXT NOT NULL,"
-      "    id_rol INTEGER NOT NULL DEFAULT 3," // 3=Estudiante
-      "    password_hash TEXT,"
-      "    template_huella BLOB NOT NULL"
-      ");"
-      // DetallesEstudiante
-      "CREATE TABLE IF NOT EXISTS DetallesEstudiante ("
-      "    run_id TEXT PRIMARY KEY NOT NULL,"
-      "    curso TEXT,"
-      "    FOREIGN KEY (run_id) REFERENCES Usuarios (run_id) ON DELETE CASCADE"
-      ");"
-      // RegistrosRaciones (PLURAL)
-      "CREATE TABLE IF NOT EXISTS RegistrosRaciones ("
-      "    id_registro INTEGER PRIMARY KEY AUTOINCREMENT,"
-      "    id_estudiante TEXT NOT NULL,"
-      "    fecha_servicio TEXT NOT NULL," // "YYYY-MM-DD"
-      "    tipo_racion INTEGER NOT NULL," // 0, 1, 2
-      "    id_terminal TEXT NOT NULL,"
-      "    hora_evento INTEGER NOT NULL,"     // epoch ms
-      "    estado_registro INTEGER NOT NULL," // 0=PENDIENTE, 1=SINCRONIZADO
-      "    FOREIGN KEY (id_estudiante) REFERENCES Usuarios (run_id),"
-      "    UNIQUE (id_estudiante, fecha_servicio, tipo_racion)" // (RF2)
-      ");"
-      // Configuración global
-      "CREATE TABLE IF NOT EXISTS ConfiguracionGlobal ("
-      "    id_unica INTEGER PRIMARY KEY CHECK (id_unica = 1),"
-      "    id_terminal TEXT NOT NULL,"
-      "    tipo_racion INTEGER NOT NULL CHECK (tipo_racion IN (0,1,2)),"
-      "    puerto_impresora TEXT NOT NULL DEFAULT 'COM3'"
-      ");";
-
-  if (!_ejecutar_sql_script(sql_schema)) {
+  // Esquema y catalogos en una sola transaccion: o queda todo o nada
+  DB_Transaccion transaccion(*conexion);
+  if (!transaccion.activa() ||
+      !_ejecutar_sql_script(*conexion, Schema::TABLAS,
+                            sizeof(Schema::TABLAS) / sizeof(Schema::TABLAS[0])) ||
+      !_ejecutar_sql_script(*conexion, Schema::DATOS_BASE,
+                            sizeof(Schema::DATOS_BASE) /
+                                sizeof(Schema::DATOS_BASE[0])) ||
+      !_migrar_templates(*conexion) || !transaccion.confirmar()) {
     std::cerr << "[DB_Backend] ERROR: Falló la inicialización del esquema.\n";
-    sqlite3_close(db_handle_);
-    db_handle_ = nullptr;
-    return false;
+    return nullptr;
   }
 
-  const char *sql_admin =
-      "INSERT OR IGNORE INTO Usuarios "
-      "(run_id, dv, nombre_completo, id_rol, password_hash, template_huella) "
-      "VALUES (?1, ?2, ?3, ?4, ?5, ?6);";
+  std::cout << "[DB_Backend]: Base de datos inicializada en: " << db_path
+            << "\n";
+  return conexion;
+}
 
-  sqlite3_stmt *stmt_admin = nullptr;
-  if (sqlite3_prepare_v2(db_handle_, sql_admin, -1, &stmt_admin, nullptr) ==
-      SQLITE_OK) {
+bool DB_init::_ejecutar_sql_script(DB_Conexion &conexion,
+                                   const char *const *sentencias,
+                                   size_t cantidad) {
+  for (size_t i = 0; i < cantidad; ++i) {
+    if (!conexion.ejecutar(sentencias[i])) {
+      return false;
+    }
+  }
+  return true;
+}
 
-    sqlite3_bind_text(stmt_admin, 1, Root_Admin::DEFAULT_RUN.c_str(), -1,
-                      SQLITE_STATIC);
-    sqlite3_bind_text(stmt_admin, 2, Root_Admin::DEFAULT_DV.c_str(), -1,
-                      SQLITE_STATIC);
-    sqlite3_bind_text(stmt_admin, 3, Root_Admin::DEFAULT_NAME.c_str(), -1,
-                      SQLITE_STATIC);
-    sqlite3_bind_int(stmt_admin, 4, Root_Admin::DEFAULT_ROLE);
-    sqlite3_bind_text(stmt_admin, 5, Root_Admin::DEFAULT_PASS_HASH.c_str(), -1,
-                      SQLITE_STATIC);
-    sqlite3_bind_zeroblob(stmt_admin, 6, 0);
+// -----------------------------------------------------------------------------
+// Migracion de templates
+// -----------------------------------------------------------------------------
 
-    if (sqlite3_step(stmt_admin) != SQLITE_DONE) {
-      std::cerr
-          << "[DB_Backend] WARN: No se pudo insertar el Admin por defecto.\n";
+// CRC-32 (IEEE, el mismo que hash/crc32.ChecksumIEEE de Go), bit a bit: solo
+// se usa una vez, al migrar
+static unsigned int crc32Template(const unsigned char *datos, int largo) {
+  unsigned int crc = 0xFFFFFFFFu;
+  for (int i = 0; i < largo; ++i) {
+    crc ^= datos[i];
+    for (int b = 0; b < 8; ++b) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
     }
-    sqlite3_finalize(stmt_admin);
-  } else {
-    std::cerr << "[DB_Backend] ERROR: Falló prepare del Admin Seed.\n";
   }
+  return crc ^ 0xFFFFFFFFu;
+}
 
-  std::cout << "[DB_Backend]: Base de datos inicializada en: " << db_path_
-            << "\n";
-  return true;
+// crc32(blob) para el SQL de Schema::MIGRAR_TEMPLATES
+static void funcionCrc32(sqlite3_context *ctx, int, sqlite3_value **args) {
+  const unsigned char *datos =
+      static_cast<const unsigned char *>(sqlite3_value_blob(args[0]));
+  int largo = sqlite3_value_bytes(args[0]);
+  sqlite3_result_int64(ctx, crc32Template(datos, datos ? largo : 0));
 }
 
-// ok, pero ahora como le pido al ServerStartup que inicialice?
\ No newline at end of file
+bool DB_init::_migrar_templates(DB_Conexion &conexion) {
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(conexion.handle(), Schema::COLUMNA_TEMPLATE_VIEJA, -1,
+                         &stmt, nullptr) != SQLITE_OK) {
+    return false;
+  }
+  bool columnaVieja =
+      sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) > 0;
+  sqlite3_finalize(stmt);
+  if (!columnaVieja) {
+    return true;
+  }
+
+  if (sqlite3_create_function_v2(conexion.handle(), "crc32", 1,
+                                 SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                                 funcionCrc32, nullptr, nullptr,
+                                 nullptr) != SQLITE_OK) {
+    return false;
+  }
+  bool ok = _ejecutar_sql_script(conexion, Schema::MIGRAR_TEMPLATES,
+                                 sizeof(Schema::MIGRAR_TEMPLATES) /
+                                     sizeof(Schema::MIGRAR_TEMPLATES[0]));
+  // la funcion era solo para esto
+  sqlite3_create_function_v2(conexion.handle(), "crc32", 1, SQLITE_UTF8,
+                             nullptr, nullptr, nullptr, nullptr, nullptr);
+  if (ok) {
+    std::cout << "[DB_Backend]: templates movidos a TemplatesHuella.\n";
+  }
+  return ok;
+}
@@ -23,7 +23,13 @@ function createWindow() {
         backgroundColor: '#1a1a1a'
     });
 
-    mainWindow.loadFile('index.html');
+    // --lector=N: con varios lectores en el mismo PC cada totem atiende el suyo
+    const lectorArg = process.argv.find(arg => arg.startsWith('--lector='));
+    if (lectorArg) {
+        mainWindow.loadFile('index.html', { query: { lector: lectorArg.split('=')[1] } });
+    } else {
+        mainWindow.loadFile('index.html');
+    }
 
     // Open DevTools in development mode
     if (!process.argv.includes('--kiosk')) {
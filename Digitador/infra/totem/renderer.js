@@ -1,10 +1,25 @@
 // C:\Digitador\totem\renderer.js
 
 const API_URL = 'http://localhost:8080';
+// lector que atiende este totem (main.js lo pasa como ?lector=N); sin el,
+// el servidor entrega la huella de cualquier lector
+const LECTOR = new URLSearchParams(window.location.search).get('lector');
+const VERIFY_URL = LECTOR !== null
+    ? `${API_URL}/api/verify_finger?lector=${encodeURIComponent(LECTOR)}`
+    : `${API_URL}/api/verify_finger`;
 let currentScreen = 'waiting';
 let autoReturnTimeout = null;
 let pollingActive = false;
 
+// eventos por WebSocket: el servidor avisa apenas se apoya el dedo y empuja
+// el resultado. El puerto lo informa /api/sensor/status (0 = sin eventos);
+// si el WebSocket se cae volvemos al polling hasta reconectar
+let puertoEventos = 0;
+let socketEventos = null;
+const RECONEXION_EVENTOS_MS = 3000;
+// si despues de "processing" no llega el resultado, volvemos a waiting
+const ESPERA_RESULTADO_MS = 5000;
+
 // Screen elements
 const screens = {
     waiting: document.getElementById('screen-waiting'),
@@ -95,7 +110,7 @@ function mostrarRechazado(razon, nombre = '') {
 
 async function verificarHuella() {
     try {
-        const response = await fetch(`${API_URL}/api/verify_finger`, {
+        const response = await fetch(VERIFY_URL, {
             method: 'GET',
             headers: { 'Accept': 'application/json' }
         });
@@ -194,9 +209,13 @@ async function iniciarBucleHuella() {
                 showScreen('processing');
                 procesarRespuesta(resultado);
             }
+
+            // el servidor ya espero el dedo (long-poll): volvemos a pedir sin pausa
+            if (resultado && resultado.status === 'waiting') {
+                continue;
+            }
         }
 
-        // Ultra-fast polling for instant feel
         await new Promise(resolve => setTimeout(resolve, 200));
     }
 
@@ -208,6 +227,83 @@ function detenerBucleHuella() {
     console.log('[POLLING] Bucle detenido');
 }
 
+// ============================================
+// EVENTOS POR WEBSOCKET
+// ============================================
+
+function procesarEvento(evento) {
+    // cada totem atiende solo su lector (sin ?lector=N, todos)
+    if (LECTOR !== null && String(evento.lector) !== LECTOR) {
+        return;
+    }
+
+    // los resultados traen el payload de /api/verify_finger y el evento aparte
+    switch (evento.event || evento.type) {
+        case 'finger_detected':
+        case 'processing':
+            if (currentScreen === 'waiting') {
+                showScreen('processing');
+                autoReturnToWaiting(ESPERA_RESULTADO_MS);
+            }
+            break;
+        case 'approved':
+        case 'rejected':
+            // el mismo payload que /api/verify_finger
+            procesarRespuesta(evento);
+            break;
+        default:
+            console.log('[EVENTOS] Evento no manejado:', evento);
+    }
+}
+
+function conectarEventos() {
+    if (!puertoEventos) {
+        console.log('[EVENTOS] Servidor sin eventos, uso polling');
+        iniciarBucleHuella();
+        return;
+    }
+
+    const url = `ws://localhost:${puertoEventos}/ws/eventos`;
+    console.log('[EVENTOS] Conectando a', url);
+    const socket = new WebSocket(url);
+    socketEventos = socket;
+
+    socket.onopen = () => {
+        console.log('[EVENTOS] ✓ Conectado, polling detenido');
+        detenerBucleHuella();
+    };
+
+    socket.onmessage = (mensaje) => {
+        try {
+            procesarEvento(JSON.parse(mensaje.data));
+        } catch (error) {
+            console.error('[EVENTOS] Frame invalido:', error.message);
+        }
+    };
+
+    socket.onerror = () => {
+        console.error('[EVENTOS] Error en el WebSocket');
+    };
+
+    socket.onclose = () => {
+        if (socketEventos !== socket) {
+            return;
+        }
+        socketEventos = null;
+        console.log(`[EVENTOS] Desconectado: polling y reintento en ${RECONEXION_EVENTOS_MS}ms`);
+        iniciarBucleHuella();
+        setTimeout(conectarEventos, RECONEXION_EVENTOS_MS);
+    };
+}
+
+function desconectarEventos() {
+    if (socketEventos) {
+        const socket = socketEventos;
+        socketEventos = null;
+        socket.close();
+    }
+}
+
 // ============================================
 // VERIFICAR CONEXIÓN CON SERVIDOR
 // ============================================
@@ -218,6 +314,7 @@ async function verificarConexion() {
         const data = await response.json();
 
         console.log('[CONEXIÓN] Estado del sensor:', data);
+        puertoEventos = data.eventos || 0;
         return data.available === true;
     } catch (error) {
         console.error('[CONEXIÓN] Error:', error.message);
@@ -256,8 +353,8 @@ async function inicializar() {
         return;
     }
 
-    console.log('[INIT] Iniciando polling de huella...');
-    iniciarBucleHuella();
+    console.log('[INIT] Esperando huella (eventos o polling)...');
+    conectarEventos();
 }
 
 if (document.readyState === 'loading') {
@@ -267,5 +364,6 @@ if (document.readyState === 'loading') {
 }
 
 window.addEventListener('beforeunload', () => {
+    desconectarEventos();
     detenerBucleHuella();
 });
\ No newline at end of file
@@ -6,6 +6,7 @@ package web
 import (
 	"encoding/csv"
 	"encoding/json"
+	"errors"
 	"fmt"
 	"io"
 	"net/http"
@@ -23,7 +24,10 @@ import (
 
 // definimos la estructura que go convertira a Json
 type SensorStatus struct {
-	Availeble bool `json:"available"`
+	Availeble bool                  `json:"available"`
+	Lectores  []Sensor.EstadoLector `json:"lectores"`
+	// puerto del WebSocket de eventos del totem (0 = sin eventos, solo polling)
+	Eventos int `json:"eventos"`
 }
 
 type Stats struct {
@@ -32,32 +36,397 @@ type Stats struct {
 	Total     int `json:"total"`
 }
 
+// tiempo que un request espera la huella del hilo de captura del sensor.
+// El totem hace long-poll: la respuesta llega apenas el SDK entrega el template.
+// En el enrolamiento la espera es por cada una de las tres capturas
+const (
+	esperaHuellaTotem        = 5 * time.Second
+	esperaHuellaEnrolamiento = 10 * time.Second
+	// sin totems en el WebSocket de eventos, cada cuanto se vuelve a revisar
+	esperaSinTotems = 200 * time.Millisecond
+)
+
+// archivo con los templates empaquetados para el cache 1:N, junto a la DB
+const archivoArenaTemplates = "templates.arena"
+
+// dias de historial para armar el grupo de candidatos de cada racion
+const diasGrupoRacion = 30
+
+// racionActual aplica la regla de horario: antes de las 11 es desayuno
+func racionActual() (string, Database.TipoRacion) {
+	if time.Now().Hour() < 11 {
+		return "Desayuno", Database.Desayuno
+	}
+	return "Almuerzo", Database.Almuerzo
+}
+
+// grupoRacion es el nombre del grupo de candidatos del sensor para una racion
+func grupoRacion(tipo Database.TipoRacion) string {
+	return fmt.Sprintf("racion:%d", tipo)
+}
+
+// lectorPedido es el lector que atiende un totem (?lector=N). Sin parametro
+// (o invalido) el totem toma la huella de cualquier lector
+func lectorPedido(r_req *http.Request) int {
+	lector, err := strconv.Atoi(r_req.URL.Query().Get("lector"))
+	if err != nil || lector < 0 {
+		return -1
+	}
+	return lector
+}
+
+// terminalDeLector es el id_terminal que queda en el registro: TOTEM-1 para el
+// primer lector, TOTEM-2 para el segundo, etc.
+func terminalDeLector(lector int) string {
+	return fmt.Sprintf("TOTEM-%d", lector+1)
+}
+
+// cargarGruposRacion arma en el sensor un grupo por racion con los alumnos que
+// la recibieron en los ultimos diasGrupoRacion dias. El totem busca primero en
+// el grupo de la racion en curso y solo amplia a todo el colegio si no aparece
+func cargarGruposRacion(s *Sensor.SensorAdapter, r *Repo.SQLiteUserRepository) {
+	desde := time.Now().AddDate(0, 0, -diasGrupoRacion).Format("2006-01-02")
+	for _, tipo := range []Database.TipoRacion{Database.Desayuno, Database.Almuerzo} {
+		templates, err := r.TemplatesPorRacion(tipo, desde)
+		if err != nil {
+			fmt.Printf("(!) [WEB]: %v\n", err)
+			continue
+		}
+		n, err := s.CargarGrupo1N(grupoRacion(tipo), templates)
+		if err != nil {
+			fmt.Printf("(!) [WEB]: %v\n", err)
+			continue
+		}
+		fmt.Printf("(+) [WEB]: grupo %s listo con %d alumnos.\n", grupoRacion(tipo), n)
+	}
+}
+
+// precargarCacheSensor llena el cache 1:N del sensor. Si la arena de templates
+// coincide con la base de datos se carga de una vez desde el archivo mapeado;
+// si no, se reconstruye desde SQLite (y la arena queda al dia para el proximo
+// arranque)
+func precargarCacheSensor(s *Sensor.SensorAdapter, r *Repo.SQLiteUserRepository) {
+	inicio := time.Now()
+	ruta := filepath.Join(r.CarpetaDatos(), archivoArenaTemplates)
+
+	enArena, bytesArena, sumaArena, errArena := s.AbrirArena(ruta)
+	enDB, bytesDB, sumaDB, errDB := r.FirmaTemplates()
+	if errArena == nil && errDB == nil && enArena == enDB && bytesArena == bytesDB && sumaArena == sumaDB {
+		cargados, err := s.CargarArena()
+		if err == nil {
+			fmt.Printf("(+) [WEB]: %d de %d templates cargados desde la arena en %v.\n", cargados, enArena, time.Since(inicio))
+			return
+		}
+		fmt.Printf("(!) [WEB]: %v\n", err)
+	}
+
+	// la arena no existe o quedo desfasada: la vaciamos y la reconstruimos.
+	// Una CargarArena que fallo a medias ya dejo templates en el cache (y
+	// mapeados): se vacia todo junto, como en TemplatesRecargados
+	if err := s.DBClear1N(); err != nil {
+		fmt.Printf("(!) [WEB]: %v\n", err)
+	}
+	fmt.Println("(+) [WEB]: Pre-cargando templates en el cache del sensor en memoria...")
+	templates, err := r.ObtenerTodosTemplates()
+	if err != nil {
+		// el totem arranca con el cache vacio: que quede en el log
+		fmt.Printf("(!) [WEB]: no se pudieron leer los templates para el cache del sensor: %v\n", err)
+		return
+	}
+	runs := make([]string, 0, len(templates))
+	plantillas := make([][]byte, 0, len(templates))
+	for run, tpl := range templates {
+		runs = append(runs, run)
+		plantillas = append(plantillas, tpl)
+	}
+	// todo el lote en una sola llamada a C++
+	count, err := s.DBAddLote1N(runs, plantillas)
+	if err != nil {
+		fmt.Printf("(!) [WEB]: %v\n", err)
+	}
+	fmt.Printf("(+) [WEB]: %d de %d templates cargados correctamente en el motor biométrico.\n", count, len(templates))
+}
+
+// respuestaErrorEnrolamiento explica por que fallo un enrolamiento de tres
+// capturas (timeout o dedos distintos) con lo que alcanzo a medir el sensor
+func respuestaErrorEnrolamiento(w http.ResponseWriter, e *Sensor.ResultadoEnrolamiento, err error) {
+	codigo := "FINGERPRINT_TIMEOUT"
+	mensaje := "Error al leer la huella o timeout"
+	if errors.Is(err, Sensor.ErrHuellasInconsistentes) {
+		codigo = "FINGERPRINT_INCONSISTENT"
+		mensaje = "Las capturas no coinciden, apoye siempre el mismo dedo"
+	} else if !errors.Is(err, Sensor.ErrEnrolamientoTimeout) {
+		codigo = "FINGERPRINT_ERROR"
+		mensaje = err.Error()
+	}
+	respuesta := map[string]interface{}{
+		"success":    false,
+		"error_code": codigo,
+		"message":    mensaje,
+	}
+	if e != nil {
+		respuesta["capturas"] = e.Capturas
+		respuesta["scores"] = e.Scores
+	}
+	json.NewEncoder(w).Encode(respuesta)
+}
+
+// sincronizadorSensor mantiene el cache 1:N (y la arena) al dia con cada
+// cambio de huellas que hace el repositorio
+type sincronizadorSensor struct {
+	s *Sensor.SensorAdapter
+	r *Repo.SQLiteUserRepository
+}
+
+func (x sincronizadorSensor) TemplateActualizado(runID string, plantilla []byte) {
+	if err := x.s.DBAdd1N(runID, plantilla); err != nil {
+		fmt.Printf("(!) [WEB]: %v\n", err)
+	}
+}
+
+func (x sincronizadorSensor) TemplateEliminado(runID string) {
+	if err := x.s.DBRemove1N(runID); err != nil {
+		fmt.Printf("(!) [WEB]: %v\n", err)
+	}
+}
+
+// cambio masivo (excel, borrar todo): vaciamos el cache y lo volvemos a
+// llenar desde SQLite en un solo lote
+func (x sincronizadorSensor) TemplatesRecargados() {
+	if err := x.s.DBClear1N(); err != nil {
+		fmt.Printf("(!) [WEB]: %v\n", err)
+		return
+	}
+	templates, err := x.r.ObtenerTodosTemplates()
+	if err != nil {
+		fmt.Printf("(!) [WEB]: %v\n", err)
+		return
+	}
+	runs := make([]string, 0, len(templates))
+	plantillas := make([][]byte, 0, len(templates))
+	for run, tpl := range templates {
+		runs = append(runs, run)
+		plantillas = append(plantillas, tpl)
+	}
+	count, err := x.s.DBAddLote1N(runs, plantillas)
+	if err != nil {
+		fmt.Printf("(!) [WEB]: %v\n", err)
+	}
+	fmt.Printf("(+) [WEB]: cache del sensor recargado con %d de %d templates.\n", count, len(templates))
+	cargarGruposRacion(x.s, x.r)
+}
+
+// rechazoDoble es la respuesta al totem cuando el alumno ya recibio la racion
+func rechazoDoble(nombre string, racion string) map[string]interface{} {
+	return map[string]interface{}{
+		"type": "ticket", "status": "rejected_double",
+		"data": map[string]string{"nombre": nombre, "racion": racion},
+	}
+}
+
+// verificarHuella espera la siguiente huella identificada del lector (-1 =
+// cualquiera), registra la racion (en el diario si hay) y devuelve la
+// respuesta para el totem: la misma para /api/verify_finger y para el
+// WebSocket de eventos. El perfil sale del directorio en memoria: de la
+// huella al ticket no se lee SQLite
+func verificarHuella(s *Sensor.SensorAdapter, r *Repo.SQLiteUserRepository, d *diarioRaciones, p *directorioPerfiles, lector int) map[string]interface{} {
+	racionStr, racionEnum := racionActual()
+
+	// bloquea hasta que C++ entregue una huella ya identificada (o
+	// timeout). La captura y el 1:N corren en hilos propios: mientras
+	// registramos e imprimimos este ticket el lector ya espera al
+	// siguiente. Primero los alumnos que suelen recibir esta racion,
+	// despues todo el colegio. Con varios lectores cada totem pide el suyo
+	identificacion, err := s.EsperarIdentificacion(grupoRacion(racionEnum), lector, esperaHuellaTotem)
+	if errors.Is(err, Sensor.ErrSinHuella) {
+		return map[string]interface{}{"type": "no_match", "status": "waiting"}
+	}
+	if err != nil {
+		// Si no hay match o error
+		return map[string]interface{}{"type": "no_match", "status": "rejected"}
+	}
+	runID := identificacion.RunID
+
+	// RF2 en memoria: la segunda pasada del dia se rechaza sin escribir nada
+	// (el perfil solo hace falta para el nombre en pantalla)
+	if d.yaServida(identificacion.Fid, racionEnum) {
+		return rechazoDoble(p.nombre(identificacion.Fid, runID), racionStr)
+	}
+
+	perfil := p.perfil(identificacion.Fid, runID)
+	if perfil == nil {
+		// huella en la cache de un alumno que ya no esta en la base
+		return map[string]interface{}{"type": "no_match", "status": "rejected"}
+	}
+	fechaDB := time.Now().Format("2006-01-02")
+	fechaTXT := time.Now().Format("02/01/2006 15:04")
+
+	nuevoRegistro := Database.RegistroRacion{
+		IDEstudiante:   runID,
+		FechaServicio:  fechaDB,
+		TipoRacion:     racionEnum,
+		IDTerminal:     terminalDeLector(identificacion.Lector),
+		HoraEvento:     time.Now().UnixMilli(),
+		EstadoRegistro: Database.Pendiente,
+	}
+
+	// apenas la racion esta en disco en el diario; SQLite la recibe despues
+	err = registrarRacion(d, r, nuevoRegistro, identificacion.Fid)
+	if err != nil {
+		return rechazoDoble(perfil.NombreCompleto, racionStr)
+	}
+
+	// Emitimos ticket en segundo plano para no bloquear la respuesta (Rápido!)
+	go ticket.EmitirTicket(*perfil, fechaTXT, racionStr)
+
+	return map[string]interface{}{
+		"type": "ticket", "status": "approved",
+		"data": map[string]string{
+			"nombre": perfil.NombreCompleto, "run": perfil.RunID + "-" + perfil.DV,
+			"curso": perfil.Curso, "letra": perfil.Letra, "racion": racionStr,
+		},
+	}
+}
+
+// empujarEventos atiende cada lector en su propia goroutine mientras haya
+// algun totem conectado al WebSocket de eventos: identifica, registra y le
+// empuja el resultado (approved / rejected) sin que el totem pregunte. C++ ya
+// avisa finger_detected y processing. Sin totems conectados no consume
+// huellas, asi un totem que cae al polling de /api/verify_finger sigue
+// funcionando
+func empujarEventos(s *Sensor.SensorAdapter, r *Repo.SQLiteUserRepository, d *diarioRaciones, p *directorioPerfiles) {
+	for _, lector := range s.Lectores() {
+		go func(indice int) {
+			for {
+				if s.ClientesEventos() == 0 {
+					time.Sleep(esperaSinTotems)
+					continue
+				}
+				respuesta := verificarHuella(s, r, d, p, indice)
+				evento := eventoDeRespuesta(respuesta)
+				if evento == "" {
+					continue
+				}
+				respuesta["event"] = evento
+				respuesta["lector"] = indice
+				frame, err := json.Marshal(respuesta)
+				if err != nil {
+					fmt.Printf("(!) [WEB]: %v\n", err)
+					continue
+				}
+				s.PublicarEvento(frame)
+			}
+		}(lector.Indice)
+	}
+}
+
+// eventoDeRespuesta traduce la respuesta de verificarHuella al evento del
+// WebSocket ("" = nada que avisar, ej: nadie apoyo el dedo)
+func eventoDeRespuesta(respuesta map[string]interface{}) string {
+	switch respuesta["status"] {
+	case "approved":
+		return "approved"
+	case "rejected", "rejected_double":
+		return "rejected"
+	}
+	return ""
+}
+
 func StartApiServer(port int, s *Sensor.SensorAdapter, r *Repo.SQLiteUserRepository) {
 
 	//funcion mux para manejar las peticiones de api
 	mux := http.NewServeMux()
 
+	// diario de raciones e indice RF2 en memoria (ver diarioRaciones.go) y
+	// perfiles de los alumnos por fid (ver directorioPerfiles.go)
+	var diario *diarioRaciones
+	var perfiles *directorioPerfiles
+	if s != nil {
+		diario = abrirDiarioRaciones(s, r)
+		perfiles = abrirDirectorioPerfiles(s, r)
+	}
+
+	// puerto de los eventos al totem (0 = sin eventos): se levantan despues
+	// de la precarga del cache, mas abajo
+	puertoEventos := 0
+
 	//endpoint para verificar estado del sensor
 	mux.HandleFunc("/api/sensor/status", func(w http.ResponseWriter, r *http.Request) {
 		w.Header().Set("Content-Type", "application/json")
+		// disponible = al menos un lector capturando (si se soltaron todos el
+		// watchdog de C++ los esta reabriendo)
 		status := SensorStatus{
-			Availeble: s != nil,
+			Lectores: []Sensor.EstadoLector{},
+			Eventos:  puertoEventos,
+		}
+		if s != nil {
+			status.Lectores = s.Lectores()
+			for _, lector := range status.Lectores {
+				if lector.Conectado {
+					status.Availeble = true
+				}
+			}
 		}
 		json.NewEncoder(w).Encode(status)
 	})
 
+	//endpoint con los tiempos de identificacion de cada shard del motor 1:N
+	mux.HandleFunc("/api/sensor/shards", func(w http.ResponseWriter, r *http.Request) {
+		w.Header().Set("Content-Type", "application/json")
+		if s == nil {
+			json.NewEncoder(w).Encode([]Sensor.EstadisticaShard{})
+			return
+		}
+		json.NewEncoder(w).Encode(s.EstadisticasShards())
+	})
+
+	//endpoint con las metricas del sensor (latencias por operacion y contadores)
+	mux.HandleFunc("GET /api/sensor/metrics", func(w http.ResponseWriter, r *http.Request) {
+		w.Header().Set("Content-Type", "application/json")
+		if s == nil {
+			w.WriteHeader(http.StatusServiceUnavailable)
+			json.NewEncoder(w).Encode(map[string]string{"error": "Sensor desconectado"})
+			return
+		}
+		metricas, err := s.Metricas()
+		if err != nil {
+			w.WriteHeader(http.StatusInternalServerError)
+			json.NewEncoder(w).Encode(map[string]string{"error": err.Error()})
+			return
+		}
+		json.NewEncoder(w).Encode(metricas)
+	})
+
+	// reiniciar las metricas (ej: al empezar el servicio de almuerzo)
+	mux.HandleFunc("DELETE /api/sensor/metrics", func(w http.ResponseWriter, r *http.Request) {
+		w.Header().Set("Content-Type", "application/json")
+		if s != nil {
+			s.ReiniciarMetricas()
+		}
+		json.NewEncoder(w).Encode(map[string]string{"status": "success"})
+	})
+
 	// Pre-cargar todos los templates en el cache del sensor (Modo Ultra-Rápido)
 	if s != nil {
-		fmt.Println("(+) [WEB]: Pre-cargando templates en el cache del sensor en memoria...")
-		templates, _ := r.ObtenerTodosTemplates()
-		count := 0
-		for run, tpl := range templates {
-			err := s.DBAdd1N(run, tpl)
-			if err == nil {
-				count++
-			}
+		precargarCacheSensor(s, r)
+		// los grupos por racion se arman en segundo plano: sin ellos el
+		// totem igual busca en todo el cache
+		go cargarGruposRacion(s, r)
+		// desde aqui cada alta, baja o cambio de huella llega al cache
+		r.SetObservadorTemplates(sincronizadorSensor{s: s, r: r})
+
+		// eventos al totem por WebSocket (C++), recien con el cache lleno: un
+		// totem que se conecta durante la precarga recibiria rechazos de
+		// alumnos enrolados. Si no se levanta, el totem sigue con el polling
+		// de /api/verify_finger
+		puerto, err := s.IniciarEventos(0)
+		if err != nil {
+			fmt.Printf("(!) [WEB]: %v\n", err)
+		} else {
+			puertoEventos = puerto
+			empujarEventos(s, r, diario, perfiles)
+			fmt.Printf("(+) [WEB]: eventos del totem en ws://localhost:%d/ws/eventos\n", puerto)
 		}
-		fmt.Printf("(+) [WEB]: %d de %d templates cargados correctamente en el motor biométrico.\n", count, len(templates))
 	}
 
 	//endpoint para obtener estadisticas
@@ -104,7 +473,7 @@ func StartApiServer(port int, s *Sensor.SensorAdapter, r *Repo.SQLiteUserReposit
 				"nombre":    s.NombreCompleto,
 				"curso":     s.Curso,
 				"letra":     s.Letra,
-				"hasHuella": len(s.TemplateHuella) > 0,
+				"hasHuella": s.TieneHuella,
 				"activo":    s.Activo,
 			})
 		}
@@ -123,8 +492,8 @@ func StartApiServer(port int, s *Sensor.SensorAdapter, r *Repo.SQLiteUserReposit
 			return
 		}
 
-		// Check if it really has a fingerprint 
-		hasHuella := len(perfil.TemplateHuella) > 0
+		// Check if it really has a fingerprint (en TemplatesHuella)
+		hasHuella := perfil.TieneHuella
 
 		json.NewEncoder(w).Encode(map[string]interface{}{
 			"success": true,
@@ -167,6 +536,7 @@ func StartApiServer(port int, s *Sensor.SensorAdapter, r *Repo.SQLiteUserReposit
 
 		// La huella es OPCIONAL en el nuevo modelo (RUT prima)
 		var plantilla []byte
+		calidad := 0
 		if reqData.ConHuella {
 			if s == nil {
 				w.WriteHeader(http.StatusServiceUnavailable)
@@ -178,16 +548,15 @@ func StartApiServer(port int, s *Sensor.SensorAdapter, r *Repo.SQLiteUserReposit
 				return
 			}
 
-			var err error
-			plantilla, err = s.CapturarHuella()
+			// tres capturas fusionadas: una sola captura mala se paga despues
+			// con reintentos en el totem
+			enrolamiento, err := s.EnrolarHuella(esperaHuellaEnrolamiento, 0)
 			if err != nil {
-				json.NewEncoder(w).Encode(map[string]interface{}{
-					"success":    false,
-					"error_code": "FINGERPRINT_TIMEOUT",
-					"message":    "Error al leer la huella o timeout",
-				})
+				respuestaErrorEnrolamiento(w, enrolamiento, err)
 				return
 			}
+			plantilla = enrolamiento.Plantilla
+			calidad = enrolamiento.Calidad
 		}
 
 		user := Database.Usuario{
@@ -216,6 +585,7 @@ func StartApiServer(port int, s *Sensor.SensorAdapter, r *Repo.SQLiteUserReposit
 			"success":          true,
 			"has_huella":       len(plantilla) > 0,
 			"fingerprint_size": len(plantilla),
+			"calidad":          calidad,
 		})
 	})
 
@@ -357,27 +727,23 @@ func StartApiServer(port int, s *Sensor.SensorAdapter, r *Repo.SQLiteUserReposit
 			return
 		}
 
-		plantilla, err := s.CapturarHuella()
+		enrolamiento, err := s.EnrolarHuella(esperaHuellaEnrolamiento, 0)
 		if err != nil {
-			json.NewEncoder(w).Encode(map[string]interface{}{
-				"success": false,
-				"message": "Error al leer la huella o timeout",
-			})
+			respuestaErrorEnrolamiento(w, enrolamiento, err)
 			return
 		}
 
-		err = r.UpdateStudentHuella(runID, plantilla)
+		err = r.UpdateStudentHuella(runID, enrolamiento.Plantilla)
 		if err != nil {
 			json.NewEncoder(w).Encode(map[string]interface{}{"success": false, "message": err.Error()})
 			return
 		}
 
-		// También agregar al cache del motor biométrico si está disponible
-		s.DBAdd1N(runID, plantilla)
-
 		json.NewEncoder(w).Encode(map[string]interface{}{
 			"success":          true,
-			"fingerprint_size": len(plantilla),
+			"fingerprint_size": len(enrolamiento.Plantilla),
+			"calidad":          enrolamiento.Calidad,
+			"scores":           enrolamiento.Scores,
 		})
 	})
 
@@ -552,7 +918,7 @@ func StartApiServer(port int, s *Sensor.SensorAdapter, r *Repo.SQLiteUserReposit
 		w.Header().Set("Content-Type", "application/json")
 		var record Database.RegistroRacion
 		json.NewDecoder(r_req.Body).Decode(&record)
-		r.AddRecord(record)
+		registrarRacion(diario, r, record, -1)
 		json.NewEncoder(w).Encode(map[string]string{"status": "success"})
 	})
 
@@ -563,7 +929,8 @@ func StartApiServer(port int, s *Sensor.SensorAdapter, r *Repo.SQLiteUserReposit
 		json.NewEncoder(w).Encode(map[string]string{"status": "success"})
 	})
 
-	// endpoint para verificar huella (Usado por el Totem)
+	// endpoint para verificar huella (Usado por el Totem). Un totem conectado
+	// al WebSocket de eventos recibe lo mismo sin preguntar (ver empujarEventos)
 	mux.HandleFunc("/api/verify_finger", func(w http.ResponseWriter, r_req *http.Request) {
 		w.Header().Set("Content-Type", "application/json")
 
@@ -572,62 +939,7 @@ func StartApiServer(port int, s *Sensor.SensorAdapter, r *Repo.SQLiteUserReposit
 			return
 		}
 
-		plantilla, err := s.CapturarHuella()
-		if err != nil {
-			json.NewEncoder(w).Encode(map[string]string{"type": "no_match", "status": "waiting"})
-			return
-		}
-
-		// USAMOS EL NUEVO MOTOR 1:N (ULTRA-RÁPIDO)
-		runID, _, err := s.DBIdentify1N(plantilla)
-		if err != nil {
-			// Si no hay match o error
-			json.NewEncoder(w).Encode(map[string]string{"type": "no_match", "status": "rejected"})
-			return
-		}
-
-		perfil, _ := r.ObtenerPerfilPorRunID(runID)
-		fechaDB := time.Now().Format("2006-01-02")
-		fechaTXT := time.Now().Format("02/01/2006 15:04")
-		var racionStr string
-		var racionEnum Database.TipoRacion
-
-		if time.Now().Hour() < 11 {
-			racionStr = "Desayuno"
-			racionEnum = Database.Desayuno
-		} else {
-			racionStr = "Almuerzo"
-			racionEnum = Database.Almuerzo
-		}
-
-		nuevoRegistro := Database.RegistroRacion{
-			IDEstudiante:   runID,
-			FechaServicio:  fechaDB,
-			TipoRacion:     racionEnum,
-			IDTerminal:     "TOTEM-1",
-			HoraEvento:     time.Now().UnixMilli(),
-			EstadoRegistro: Database.Pendiente,
-		}
-
-		err = r.AddRecord(nuevoRegistro)
-		if err != nil {
-			json.NewEncoder(w).Encode(map[string]interface{}{
-				"type": "ticket", "status": "rejected_double",
-				"data": map[string]string{"nombre": perfil.NombreCompleto, "racion": racionStr},
-			})
-			return
-		}
-
-		// Emitimos ticket en segundo plano para no bloquear la respuesta HTTP (Rápido!)
-		go ticket.EmitirTicket(*perfil, fechaTXT, racionStr)
-
-		json.NewEncoder(w).Encode(map[string]interface{}{
-			"type": "ticket", "status": "approved",
-			"data": map[string]string{
-				"nombre": perfil.NombreCompleto, "run": perfil.RunID + "-" + perfil.DV,
-				"curso": perfil.Curso, "letra": perfil.Letra, "racion": racionStr,
-			},
-		})
+		json.NewEncoder(w).Encode(verificarHuella(s, r, diario, perfiles, lectorPedido(r_req)))
 	})
 
 	//servir archivos estaticos
@@ -0,0 +1,452 @@
+// diario de raciones del totem: la racion aprobada queda primero en el diario
+// de C++ (en disco, un flush para todas las que llegan juntas) y el totem
+// recibe su ticket sin esperar el commit de SQLite. Un aplicador en segundo
+// plano la pasa despues a RegistrosRaciones en lotes. La segunda pasada del
+// dia se rechaza antes, con un indice en memoria (un bit por fid)
+
+package web
+
+import (
+	"errors"
+	"fmt"
+	"path/filepath"
+	"sync"
+	"time"
+
+	Sensor "Pydigitador/core/Hardware/Sensor"
+	Database "Pydigitador/core/db"
+	Repo "Pydigitador/infra/DB"
+)
+
+// archivo del diario, junto a la DB
+const archivoDiarioRaciones = "raciones.journal"
+
+const (
+	// lo maximo que un totem espera que su racion llegue a disco en el
+	// diario antes de guardarla en SQLite directo
+	esperaDiarioDisco = 2 * time.Second
+	// raciones por transaccion del aplicador
+	loteDiario = 256
+	// el aplicador espera un poco despues de despertar para juntar lote
+	pausaAplicador = 20 * time.Millisecond
+	// cada cuanto reintenta si SQLite fallo (o por si se perdio un aviso)
+	reintentoAplicador = time.Second
+	// lo que cabe en el diario (JOURNAL_CAPACITY de C++)
+	capacidadDiario = 16384
+)
+
+var errRacionRepetida = errors.New("(-) [GO]: el alumno ya recibio esta racion hoy")
+
+// claveRacion identifica una racion del reglamento (RF2: una de cada tipo por
+// dia)
+type claveRacion struct {
+	run   string
+	fecha string
+	tipo  Database.TipoRacion
+}
+
+// tipos de racion en el indice (0=N/A, 1=Desayuno, 2=Almuerzo)
+const tiposRacion = 3
+
+// racionesServidas es el RF2 en memoria: un bit por fid de la cache 1:N para
+// cada tipo de racion del dia. Dice "ya recibio hoy" sin pasar por SQLite,
+// que con su UNIQUE sigue siendo la autoridad. porRun guarda lo mismo por RUN
+// (un bit por tipo): cuando un RUN cambia de fid sus bits se mueven sin
+// volver a leer SQLite ni el diario
+type racionesServidas struct {
+	fecha  string
+	bits   [tiposRacion][]uint64
+	porRun map[string]uint8
+}
+
+func (b *racionesServidas) servida(fid int, tipo Database.TipoRacion) bool {
+	if fid < 0 || tipo < 0 || int(tipo) >= tiposRacion {
+		return false
+	}
+	palabras := b.bits[tipo]
+	i := fid >> 6
+	return i < len(palabras) && palabras[i]&(1<<(uint(fid)&63)) != 0
+}
+
+// marcar anota la racion del RUN (fid -1 = sin huella en la cache 1:N)
+func (b *racionesServidas) marcar(run string, fid int, tipo Database.TipoRacion) {
+	if tipo < 0 || int(tipo) >= tiposRacion {
+		return
+	}
+	if b.porRun == nil {
+		b.porRun = map[string]uint8{}
+	}
+	b.porRun[run] |= 1 << uint(tipo)
+	b.marcarBit(fid, tipo)
+}
+
+func (b *racionesServidas) marcarBit(fid int, tipo Database.TipoRacion) {
+	if fid < 0 || tipo < 0 || int(tipo) >= tiposRacion {
+		return
+	}
+	i := fid >> 6
+	for len(b.bits[tipo]) <= i {
+		b.bits[tipo] = append(b.bits[tipo], 0)
+	}
+	b.bits[tipo][i] |= 1 << (uint(fid) & 63)
+}
+
+func (b *racionesServidas) desmarcar(run string, fid int, tipo Database.TipoRacion) {
+	if tipo < 0 || int(tipo) >= tiposRacion {
+		return
+	}
+	if mascara, ok := b.porRun[run]; ok {
+		if mascara &^= 1 << uint(tipo); mascara == 0 {
+			delete(b.porRun, run)
+		} else {
+			b.porRun[run] = mascara
+		}
+	}
+	b.desmarcarBit(fid, tipo)
+}
+
+func (b *racionesServidas) desmarcarBit(fid int, tipo Database.TipoRacion) {
+	if b.servida(fid, tipo) {
+		b.bits[tipo][fid>>6] &^= 1 << (uint(fid) & 63)
+	}
+}
+
+// mover pasa las raciones del RUN de un fid a otro (-1 = sin fid). El fid
+// anterior ya no es de nadie: se limpia completo
+func (b *racionesServidas) mover(run string, anterior, nuevo int) {
+	for t := Database.TipoRacion(0); t < tiposRacion; t++ {
+		b.desmarcarBit(anterior, t)
+	}
+	mascara := b.porRun[run]
+	for t := Database.TipoRacion(0); t < tiposRacion; t++ {
+		if mascara&(1<<uint(t)) != 0 {
+			b.marcarBit(nuevo, t)
+		}
+	}
+}
+
+// reindexar rearma los bits desde porRun con los fids actuales (sin SQLite)
+func (b *racionesServidas) reindexar(s *Sensor.SensorAdapter) {
+	for t := range b.bits {
+		clear(b.bits[t])
+	}
+	runs := make([]string, 0, len(b.porRun))
+	for run := range b.porRun {
+		runs = append(runs, run)
+	}
+	for i, fid := range s.FidsDeRuns(runs) {
+		b.mover(runs[i], -1, fid)
+	}
+}
+
+// vaciar deja el indice listo para otro dia (sin soltar la memoria)
+func (b *racionesServidas) vaciar(fecha string) {
+	b.fecha = fecha
+	for t := range b.bits {
+		b.bits[t] = b.bits[t][:0]
+	}
+	clear(b.porRun)
+}
+
+// diarioRaciones registra las raciones del totem: rechaza la repetida con el
+// indice en memoria y deja la aprobada en el diario (o en SQLite si no hay)
+type diarioRaciones struct {
+	s *Sensor.SensorAdapter
+	r *Repo.SQLiteUserRepository
+	// sin diario (no se pudo abrir) las raciones van directo a SQLite
+	conDiario bool
+
+	mu       sync.Mutex
+	servidas racionesServidas
+	// GeneracionIDs del sensor que ya siguen los bits de servidas: si cambia
+	// se mueven los RUN que cambiaron de fid (CambiosIDsDesde)
+	generacion uint64
+	anotando   map[claveRacion]struct{} // entrando al diario en este momento
+
+	despertar chan struct{}
+}
+
+// abrirDiarioRaciones abre el diario junto a la DB, pasa a SQLite lo que
+// quedo de una caida y levanta el aplicador. Si el diario no abre, las
+// raciones van directo a SQLite como antes (con el mismo indice en memoria)
+func abrirDiarioRaciones(s *Sensor.SensorAdapter, r *Repo.SQLiteUserRepository) *diarioRaciones {
+	d := &diarioRaciones{
+		s:         s,
+		r:         r,
+		anotando:  map[claveRacion]struct{}{},
+		despertar: make(chan struct{}, 1),
+	}
+	r.SetObservadorRegistros(d)
+
+	ruta := filepath.Join(r.CarpetaDatos(), archivoDiarioRaciones)
+	pendientes, err := s.AbrirDiario(ruta)
+	if err != nil {
+		fmt.Printf("(!) [WEB]: %v\n", err)
+		d.armar()
+		return d
+	}
+	d.conDiario = true
+
+	// el diario manda sobre SQLite: lo que no alcanzo a aplicarse antes de la
+	// caida entra ahora, antes de atender al primer alumno
+	if pendientes > 0 {
+		aplicadas := 0
+		for {
+			n, err := d.aplicarLote()
+			if err != nil {
+				fmt.Printf("(!) [WEB]: %v\n", err)
+				break
+			}
+			if n == 0 {
+				break
+			}
+			aplicadas += n
+		}
+		fmt.Printf("(+) [WEB]: %d de %d raciones del diario recuperadas en SQLite.\n", aplicadas, pendientes)
+	}
+
+	d.armar()
+	go d.aplicador()
+	return d
+}
+
+// armar lee las raciones de hoy una vez al abrir. Desde ahi el indice se
+// sigue en memoria: los fids que todavia no estan (la cache 1:N se carga
+// despues) llegan con CambiosIDsDesde
+func (d *diarioRaciones) armar() {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	d.reconstruir()
+}
+
+// registrarRacion deja la racion en el diario (o en SQLite si no hay diario)
+// y vuelve apenas esta en disco. fid es el de la identificacion (-1 = buscarlo)
+func registrarRacion(d *diarioRaciones, r *Repo.SQLiteUserRepository, registro Database.RegistroRacion, fid int) error {
+	if d == nil {
+		return r.AddRecord(registro)
+	}
+	return d.registrar(registro, fid)
+}
+
+// yaServida responde con el indice en memoria si el alumno ya recibio hoy
+// esta racion, sin tocar SQLite
+func (d *diarioRaciones) yaServida(fid int, tipo Database.TipoRacion) bool {
+	if d == nil {
+		return false
+	}
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	d.alDia()
+	return d.servidas.servida(fid, tipo)
+}
+
+// alDia vacia el indice si cambio el dia y mueve los bits de los RUN que
+// cambiaron de fid. El indice es siempre el de hoy (reloj del servidor): una
+// racion con otra fecha no lo toca. Con d.mu tomado
+func (d *diarioRaciones) alDia() {
+	if fecha := time.Now().Format("2006-01-02"); fecha != d.servidas.fecha {
+		// dia nuevo: lo de ayer ya no sirve para rechazar
+		d.servidas.vaciar(fecha)
+	}
+	cambios, generacion, ok := d.s.CambiosIDsDesde(d.generacion)
+	if generacion == d.generacion {
+		return
+	}
+	if ok {
+		// un alta o una baja: un bit por tipo, sin rearmar nada
+		for _, c := range cambios {
+			d.servidas.mover(c.RunID, c.Anterior, c.Nuevo)
+		}
+	} else {
+		// recarga completa o muchos cambios juntos: desde porRun, sin SQL
+		d.servidas.reindexar(d.s)
+	}
+	d.generacion = generacion
+}
+
+func (d *diarioRaciones) registrar(registro Database.RegistroRacion, fid int) error {
+	if fid < 0 {
+		var ok bool
+		if fid, ok = d.s.FidDeRun(registro.IDEstudiante); !ok {
+			// sin huella en la cache no hay bit: decide el UNIQUE de SQLite.
+			// Queda anotada por RUN, por si se enrola hoy mismo
+			if err := d.r.AddRecord(registro); err != nil {
+				return err
+			}
+			d.mu.Lock()
+			d.alDia()
+			if registro.FechaServicio == d.servidas.fecha {
+				d.servidas.marcar(registro.IDEstudiante, -1, registro.TipoRacion)
+			}
+			d.mu.Unlock()
+			return nil
+		}
+	}
+	clave := claveRacion{run: registro.IDEstudiante, fecha: registro.FechaServicio, tipo: registro.TipoRacion}
+
+	// la reservamos antes de escribir: dos lectores con el mismo alumno no
+	// pueden servirle dos veces
+	d.mu.Lock()
+	d.alDia()
+	if registro.FechaServicio != d.servidas.fecha {
+		// otra fecha (la puso el cliente, o se calculo antes de medianoche):
+		// el indice de hoy no sabe nada de ese dia, decide el UNIQUE de SQLite
+		d.mu.Unlock()
+		return d.r.AddRecord(registro)
+	}
+	if d.servidas.servida(fid, registro.TipoRacion) {
+		d.mu.Unlock()
+		return errRacionRepetida
+	}
+	d.servidas.marcar(registro.IDEstudiante, fid, registro.TipoRacion)
+	d.anotando[clave] = struct{}{}
+	d.mu.Unlock()
+
+	var err error
+	if d.conDiario {
+		_, err = d.s.AnotarRacion(Sensor.RacionDiario{
+			RunID:      registro.IDEstudiante,
+			Fecha:      registro.FechaServicio,
+			TipoRacion: int(registro.TipoRacion),
+			Terminal:   registro.IDTerminal,
+			HoraEvento: registro.HoraEvento,
+			Estado:     int(registro.EstadoRegistro),
+		}, esperaDiarioDisco)
+		if err == nil {
+			d.avisarAplicador()
+		} else {
+			// diario lleno o sin disco: SQLite directo, como antes. Si la
+			// racion igual llega al diario, el aplicador la salta por repetida
+			fmt.Printf("(!) [WEB]: %v\n", err)
+		}
+	}
+	if !d.conDiario || err != nil {
+		err = d.r.AddRecord(registro)
+	}
+
+	d.mu.Lock()
+	delete(d.anotando, clave)
+	// pasada la medianoche el indice ya es de otro dia: no hay que soltar nada
+	if err != nil && registro.FechaServicio == d.servidas.fecha {
+		// el RUN pudo cambiar de fid mientras tanto: se suelta el de ahora
+		// (si todavia no se movio, mover limpia el fid viejo completo)
+		actual, ok := d.s.FidDeRun(registro.IDEstudiante)
+		if !ok {
+			actual = -1
+		}
+		d.servidas.desmarcar(registro.IDEstudiante, actual, registro.TipoRacion)
+	}
+	d.mu.Unlock()
+	return err
+}
+
+// reconstruir arma el indice de hoy desde SQLite, lo que falta aplicar del
+// diario y lo que esta entrando. Solo al abrir y cuando se borran raciones:
+// un cambio de fids lo sigue alDia. Con d.mu tomado
+func (d *diarioRaciones) reconstruir() {
+	generacion := d.s.GeneracionIDs()
+	fecha := time.Now().Format("2006-01-02")
+
+	var runs []string
+	var tipos []Database.TipoRacion
+	// primero el diario: una racion aplicada entre las dos lecturas ya esta
+	// en SQLite
+	if d.conDiario {
+		for _, racion := range d.s.RacionesPendientes(capacidadDiario) {
+			if racion.Fecha == fecha {
+				runs = append(runs, racion.RunID)
+				tipos = append(tipos, Database.TipoRacion(racion.TipoRacion))
+			}
+		}
+	}
+	registros, err := d.r.RegistrosDelDia(fecha)
+	if err != nil {
+		fmt.Printf("(!) [WEB]: %v\n", err)
+	}
+	for _, registro := range registros {
+		runs = append(runs, registro.IDEstudiante)
+		tipos = append(tipos, registro.TipoRacion)
+	}
+	for clave := range d.anotando {
+		if clave.fecha == fecha {
+			runs = append(runs, clave.run)
+			tipos = append(tipos, clave.tipo)
+		}
+	}
+
+	d.servidas.vaciar(fecha)
+	for i, fid := range d.s.FidsDeRuns(runs) {
+		d.servidas.marcar(runs[i], fid, tipos[i])
+	}
+	d.generacion = generacion
+}
+
+// RegistrosBorrados: se borraron raciones en la DB (ultimo registro, todo)
+func (d *diarioRaciones) RegistrosBorrados() {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	d.reconstruir()
+}
+
+func (d *diarioRaciones) avisarAplicador() {
+	select {
+	case d.despertar <- struct{}{}:
+	default:
+	}
+}
+
+// aplicador pasa el diario a RegistrosRaciones mientras viva el servidor
+func (d *diarioRaciones) aplicador() {
+	for {
+		select {
+		case <-d.despertar:
+			time.Sleep(pausaAplicador)
+		case <-time.After(reintentoAplicador):
+		}
+		for {
+			n, err := d.aplicarLote()
+			if err != nil {
+				fmt.Printf("(!) [WEB]: %v\n", err)
+				break
+			}
+			if n < loteDiario {
+				break
+			}
+		}
+	}
+}
+
+// aplicarLote inserta hasta loteDiario raciones del diario en una sola
+// transaccion y las confirma en el diario. Devuelve cuantas saco del diario
+func (d *diarioRaciones) aplicarLote() (int, error) {
+	raciones := d.s.RacionesPendientes(loteDiario)
+	if len(raciones) == 0 {
+		return 0, nil
+	}
+
+	registros := make([]Database.RegistroRacion, len(raciones))
+	for i, racion := range raciones {
+		registros[i] = Database.RegistroRacion{
+			IDEstudiante:   racion.RunID,
+			FechaServicio:  racion.Fecha,
+			TipoRacion:     Database.TipoRacion(racion.TipoRacion),
+			IDTerminal:     racion.Terminal,
+			HoraEvento:     racion.HoraEvento,
+			EstadoRegistro: Database.EstadoRegistro(racion.Estado),
+		}
+	}
+	insertadas, err := d.r.GuardarRegistrosRacion(registros)
+	if err != nil {
+		// quedan en el diario: el proximo intento las vuelve a leer
+		return 0, err
+	}
+	if omitidas := len(registros) - insertadas; omitidas > 0 {
+		// ya estaban (aplicadas antes de una caida o guardadas directo) o el
+		// alumno se borro entremedio
+		fmt.Printf("(+) [WEB]: %d raciones del diario omitidas (repetidas o sin alumno).\n", omitidas)
+	}
+	if err := d.s.ConfirmarRaciones(raciones[len(raciones)-1].Seq); err != nil {
+		return 0, err
+	}
+	return len(raciones), nil
+}
@@ -0,0 +1,166 @@
+// directorio de perfiles del totem: nombre, run, curso y letra de cada alumno
+// en memoria, indexados por el mismo fid que entrega el 1:N. Asi el camino
+// huella -> ticket no lee SQLite (ni los templates, que el ticket no usa). El
+// repositorio avisa cada alta, cambio o baja de alumno (ObservadorPerfiles)
+
+package web
+
+import (
+	"fmt"
+	"sync"
+
+	Sensor "Pydigitador/core/Hardware/Sensor"
+	Database "Pydigitador/core/db"
+	Repo "Pydigitador/infra/DB"
+)
+
+// directorioPerfiles guarda los perfiles (sin template). Un perfil no se
+// modifica despues de entrar: un cambio pone otro, asi quien ya tiene el
+// puntero lo puede leer sin lock
+type directorioPerfiles struct {
+	s *Sensor.SensorAdapter
+	r *Repo.SQLiteUserRepository
+
+	mu     sync.RWMutex
+	porRun map[string]*Database.PerfilEstudiante
+	porFid []*Database.PerfilEstudiante
+	// GeneracionIDs del sensor con la que se armo porFid: si cambia, un RUN
+	// pudo cambiar de fid y hay que rearmarlo
+	generacion uint64
+}
+
+// abrirDirectorioPerfiles carga todos los perfiles (una sola consulta, los
+// templates estan en otra tabla) y se registra en el repositorio para seguir
+// los cambios
+func abrirDirectorioPerfiles(s *Sensor.SensorAdapter, r *Repo.SQLiteUserRepository) *directorioPerfiles {
+	p := &directorioPerfiles{s: s, r: r, porRun: map[string]*Database.PerfilEstudiante{}}
+	p.PerfilesRecargados()
+	r.SetObservadorPerfiles(p)
+	return p
+}
+
+// perfil devuelve el perfil del alumno identificado (fid y RUN de la
+// Identificacion). Solo va a SQLite si el alumno no esta en el directorio
+// (ej: lo agrego otro proceso). nil si no existe
+func (p *directorioPerfiles) perfil(fid int, runID string) *Database.PerfilEstudiante {
+	if p == nil {
+		return nil
+	}
+	generacion := p.s.GeneracionIDs()
+
+	p.mu.RLock()
+	alDia := p.generacion == generacion
+	if alDia && fid >= 0 && fid < len(p.porFid) {
+		if perfil := p.porFid[fid]; perfil != nil && perfil.RunID == runID {
+			p.mu.RUnlock()
+			return perfil
+		}
+	}
+	perfil := p.porRun[runID]
+	p.mu.RUnlock()
+
+	if !alDia {
+		p.mu.Lock()
+		if p.generacion != generacion {
+			p.reindexar(generacion)
+		}
+		p.mu.Unlock()
+	}
+	if perfil != nil {
+		return perfil
+	}
+
+	perfil, err := p.r.ObtenerPerfilPorRunID(runID)
+	if err != nil {
+		fmt.Printf("(!) [WEB]: %v\n", err)
+		return nil
+	}
+	p.guardar(perfil)
+	return perfil
+}
+
+// nombre es el nombre para mostrar en el totem ("" si no se encuentra)
+func (p *directorioPerfiles) nombre(fid int, runID string) string {
+	if perfil := p.perfil(fid, runID); perfil != nil {
+		return perfil.NombreCompleto
+	}
+	return ""
+}
+
+// reindexar arma porFid desde porRun con los fids actuales del sensor (sin
+// SQL). Llamar con mu tomado para escribir
+func (p *directorioPerfiles) reindexar(generacion uint64) {
+	runs := make([]string, 0, len(p.porRun))
+	for run := range p.porRun {
+		runs = append(runs, run)
+	}
+	fids := p.s.FidsDeRuns(runs)
+
+	for i := range p.porFid {
+		p.porFid[i] = nil
+	}
+	p.porFid = p.porFid[:0]
+	for i, fid := range fids {
+		if fid < 0 {
+			continue // sin huella en la cache 1:N
+		}
+		for len(p.porFid) <= fid {
+			p.porFid = append(p.porFid, nil)
+		}
+		p.porFid[fid] = p.porRun[runs[i]]
+	}
+	p.generacion = generacion
+}
+
+// guardar deja el perfil (nuevo o cambiado) en el directorio
+func (p *directorioPerfiles) guardar(perfil *Database.PerfilEstudiante) {
+	fid, conFid := p.s.FidDeRun(perfil.RunID)
+
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	p.porRun[perfil.RunID] = perfil
+	if conFid && fid < len(p.porFid) {
+		p.porFid[fid] = perfil
+	}
+	// un fid nuevo (mas alla de porFid) llega con otra generacion: se indexa
+	// en el proximo reindexar
+}
+
+// ----
+// ObservadorPerfiles (lo llama el repositorio despues de cada cambio)
+
+func (p *directorioPerfiles) PerfilActualizado(runID string) {
+	perfil, err := p.r.ObtenerPerfilPorRunID(runID)
+	if err != nil {
+		// ya no esta (ej: el cambio fallo a medias)
+		p.PerfilEliminado(runID)
+		return
+	}
+	p.guardar(perfil)
+}
+
+func (p *directorioPerfiles) PerfilEliminado(runID string) {
+	p.mu.Lock()
+	delete(p.porRun, runID)
+	p.mu.Unlock()
+	// su entrada en porFid queda hasta el proximo reindexar: sacarlo de la
+	// cache 1:N cambia la generacion, y el 1:N ya no lo entrega
+}
+
+func (p *directorioPerfiles) PerfilesRecargados() {
+	perfiles, err := p.r.GetAllProfiles()
+	if err != nil {
+		fmt.Printf("(!) [WEB]: %v\n", err)
+		return
+	}
+	porRun := make(map[string]*Database.PerfilEstudiante, len(perfiles))
+	for i := range perfiles {
+		porRun[perfiles[i].RunID] = &perfiles[i]
+	}
+
+	p.mu.Lock()
+	p.porRun = porRun
+	p.reindexar(p.s.GeneracionIDs())
+	p.mu.Unlock()
+	fmt.Printf("(+) [WEB]: directorio de perfiles con %d alumnos.\n", len(porRun))
+}
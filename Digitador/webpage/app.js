@@ -757,7 +757,7 @@ async function handleEnrollStudent(event) {
         modalBody.insertBefore(statusDiv, modalBody.firstChild);
     }
 
-    statusDiv.innerHTML = '⏳ Esperando huella... Por favor, coloque su dedo en el sensor.';
+    statusDiv.innerHTML = '⏳ Esperando huella... Apoye el mismo dedo 3 veces, levantándolo entre cada captura.';
     statusDiv.style.display = 'block';
 
     try {
@@ -786,7 +786,7 @@ async function handleEnrollStudent(event) {
                 alert(`✓ Estudiante enrolado exitosamente\n\n` +
                     `Nombre: ${nombreCompleto}\n` +
                     `RUN: ${formData.run}\n` +
-                    `Huella: ${result.fingerprint_size} bytes capturados`);
+                    `Huella: ${result.fingerprint_size} bytes capturados (calidad ${result.calidad}/100)`);
                 closeEnrollModal();
                 fetchStudents();
                 checkSensorStatus();
@@ -801,6 +801,9 @@ async function handleEnrollStudent(event) {
             } else if (result.error_code === 'FINGERPRINT_TIMEOUT') {
                 errorIcon = '⏱️';
                 errorMsg = 'Tiempo agotado. No se detectó el dedo en el sensor.';
+            } else if (result.error_code === 'FINGERPRINT_INCONSISTENT') {
+                errorIcon = '👆';
+                errorMsg = 'Las capturas no coinciden. Apoye siempre el mismo dedo y reintente.';
             } else if (result.error_code === 'DATABASE_ERROR') {
                 errorIcon = '🗄️';
                 errorMsg = 'Error de base de datos. El RUN podría estar duplicado.';
@@ -1418,7 +1421,7 @@ async function handleCaptureHuellaSeparate(run) {
     const student = allStudents.find(s => s.run === run);
     if (!student) return;
 
-    if (!confirm(`¿Desea capturar la huella para ${student.nombre}?\n\nPida al alumno que coloque su dedo en el sensor cuando presione OK.`)) {
+    if (!confirm(`¿Desea capturar la huella para ${student.nombre}?\n\nPida al alumno que apoye el mismo dedo 3 veces, levantándolo entre cada captura, cuando presione OK.`)) {
         return;
     }
 
@@ -1428,7 +1431,7 @@ async function handleCaptureHuellaSeparate(run) {
         const result = await response.json();
 
         if (result.success) {
-            alert(`✅ Huella de ${student.nombre} registrada correctamente.`);
+            alert(`✅ Huella de ${student.nombre} registrada correctamente (calidad ${result.calidad}/100).`);
             
             // Actualizar estado local
             student.hasHuella = true;